@@ -0,0 +1,179 @@
+/*
+ * Fast Binary Formatting in C
+ * Print whole buffers in binary - and see how much faster it gets!
+ * Compile: gcc -O2 4_binary_format.c -o binary_format
+ * Run: ./binary_format [megabytes]
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "binfmt.h"
+
+// The original one-printf-per-bit loop from 2_binary_ops.c
+void printBinary(FILE *out, int n) {
+    for (int i = 7; i >= 0; i--) {
+        int bit = (n >> i) & 1;
+        fprintf(out, "%d", bit);
+    }
+}
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Slow but obviously correct reference: one bit at a time
+size_t referenceFormat(char *dst, const void *src, size_t count,
+                       const binfmt_options *opt) {
+    const uint8_t *in = (const uint8_t *)src;
+    size_t bytes = (size_t)opt->width / 8;
+    char *out = dst;
+    for (size_t w = 0; w < count; w++) {
+        uint64_t value = 0;
+        memcpy(&value, in + w * bytes, bytes);
+        if (w > 0 && opt->word_sep) *out++ = opt->word_sep;
+        for (int bit = opt->width - 1; bit >= 0; bit--) {
+            *out++ = (char)('0' + ((value >> bit) & 1));
+            if (bit > 0 && opt->group > 0 && bit % opt->group == 0) {
+                *out++ = opt->group_sep;
+            }
+        }
+    }
+    return (size_t)(out - dst);
+}
+
+// Check every kernel against the reference for all widths and layouts
+int selfTest(void) {
+    uint8_t data[8 * 37 + 5];
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)(i * 131 + 7);
+
+    const int widths[] = {8, 16, 32, 64};
+    const binfmt_options layouts[] = {
+        {0, 0, 0, 0}, {0, 4, '_', 0}, {0, 8, ' ', ' '}, {0, 3, '_', '\n'}, {0, 0, 0, ','}
+    };
+    binfmt_kernel best = binfmt_detect();
+    char *want = malloc(8192);
+    char *got = malloc(8192);
+    int failures = 0;
+
+    for (int k = 0; k <= (int)best; k++) {
+        for (int w = 0; w < 4; w++) {
+            for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+                binfmt_options opt = layouts[l];
+                opt.width = widths[w];
+                // Odd counts exercise the leftover-word path too
+                size_t count = (sizeof(data) * 8) / (size_t)opt.width;
+                size_t n1 = referenceFormat(want, data, count, &opt);
+                size_t n2 = binfmt_format_with((binfmt_kernel)k, got, data, count, &opt);
+                if (n1 != n2 || n1 != binfmt_size(count, &opt) || memcmp(want, got, n1) != 0) {
+                    printf("   MISMATCH: kernel=%s width=%d layout=%zu\n",
+                           binfmt_kernel_name((binfmt_kernel)k), opt.width, l);
+                    failures++;
+                }
+            }
+        }
+    }
+    free(want);
+    free(got);
+    return failures;
+}
+
+// The text is 8 bytes for every input byte: 2 GB at most
+#define MAX_MEGABYTES 256
+
+int main(int argc, char *argv[]) {
+    size_t megabytes = 8;
+    if (argc > 1) {
+        char *end;
+        errno = 0;
+        unsigned long value = strtoul(argv[1], &end, 10);
+        if (!isdigit((unsigned char)argv[1][0]) || *end || errno == ERANGE || value == 0 || value > MAX_MEGABYTES) {
+            fprintf(stderr, "Usage: %s [megabytes]  (1 to %d)\n", argv[0], MAX_MEGABYTES);
+            return 1;
+        }
+        megabytes = value;
+    }
+
+    printf("==================================================\n");
+    printf("FAST BINARY FORMATTING IN C\n");
+    printf("==================================================\n");
+
+    binfmt_kernel best = binfmt_detect();
+    printf("\n1. Your CPU's best kernel: %s\n", binfmt_kernel_name(best));
+
+    // Same numbers as 2_binary_ops.c, printed in one call
+    printf("\n2. Formatting a whole buffer at once:\n");
+    uint8_t bytes[] = {5, 3, 5 & 3, 5 | 3, 5 ^ 3};
+    uint16_t words[] = {0x1234, 0xBEEF};
+    uint32_t color = 0xFF6496;
+    char text[256];
+
+    binfmt_options byte_opt = {8, 0, 0, ' '};
+    size_t len = binfmt_format(text, bytes, 5, &byte_opt);
+    printf("   bytes 5 3 1 7 6  -> %.*s\n", (int)len, text);
+
+    binfmt_options word_opt = {16, 4, '_', ' '};
+    len = binfmt_format(text, words, 2, &word_opt);
+    printf("   0x1234 0xBEEF    -> %.*s\n", (int)len, text);
+
+    binfmt_options color_opt = {32, 8, ' ', 0};
+    len = binfmt_format(text, &color, 1, &color_opt);
+    printf("   color 0x%06X -> %.*s\n", color, (int)len, text);
+
+    printf("\n3. Checking every kernel against a bit-by-bit loop:\n");
+    int failures = selfTest();
+    printf("   %s\n", failures == 0 ? "All kernels agree!" : "Kernels DISAGREE!");
+
+    printf("\n==================================================\n");
+    printf("SPEED TEST (%zu MB of bytes -> text)\n", megabytes);
+    printf("==================================================\n\n");
+
+    size_t size = megabytes * 1024 * 1024;
+    uint8_t *input = malloc(size);
+    char *output = malloc(size * 8);
+    if (!input || !output) {
+        fprintf(stderr, "Out of memory for %zu MB\n", megabytes);
+        free(input);
+        free(output);
+        return 1;
+    }
+    for (size_t i = 0; i < size; i++) input[i] = (uint8_t)(rand() & 0xFF);
+
+    // printf once per bit, like printBinary() (output thrown away)
+    FILE *sink = fopen("/dev/null", "w");
+    size_t printf_bytes = size < (1 << 20) ? size : (1 << 20);
+    double start = now_seconds();
+    for (size_t i = 0; i < printf_bytes; i++) printBinary(sink, input[i]);
+    double printf_time = now_seconds() - start;
+    fclose(sink);
+    double printf_rate = printf_bytes / printf_time / 1e6;
+    printf("   %-22s %10.1f MB/s of input\n", "printf per bit", printf_rate);
+
+    binfmt_options plain = {8, 0, 0, 0};
+    for (int k = 0; k <= (int)best; k++) {
+        double best_time = 1e9;
+        for (int run = 0; run < 5; run++) {
+            start = now_seconds();
+            binfmt_format_with((binfmt_kernel)k, output, input, size, &plain);
+            double t = now_seconds() - start;
+            if (t < best_time) best_time = t;
+        }
+        double rate = size / best_time / 1e6;
+        printf("   binfmt %-15s %10.1f MB/s of input (%.0fx printf)\n",
+               binfmt_kernel_name((binfmt_kernel)k), rate, rate / printf_rate);
+    }
+
+    free(input);
+    free(output);
+
+    printf("\n==================================================\n");
+    printf("Doing 64 bits at once beats one printf per bit! 🚀\n");
+    printf("==================================================\n");
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/*
+ * Hex Dumps in C
+ * Look inside ANY file, byte by byte - just like the xxd tool!
+ * Compile: gcc -O2 5_hex_dump.c -o hex_dump
+ * Run: ./hex_dump                 (a quick demo)
+ *      ./hex_dump file.bin        (xxd-style dump)
+ *      ./hex_dump -p file.bin     (plain hex, one long line)
+ *      ./hex_dump -r file.hex     (plain hex back to bytes)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hexcodec.h"
+
+// Read a whole file (or stdin for "-") into memory
+unsigned char *readAll(const char *path, size_t *size) {
+    FILE *in = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+    if (!in) return NULL;
+    size_t capacity = 1 << 16;
+    size_t used = 0;
+    unsigned char *data = malloc(capacity);
+    size_t got;
+    while (data && (got = fread(data + used, 1, capacity - used, in)) > 0) {
+        used += got;
+        if (used == capacity) {
+            capacity *= 2;
+            unsigned char *bigger = realloc(data, capacity);
+            if (!bigger) free(data);
+            data = bigger;
+        }
+    }
+    if (in != stdin) fclose(in);
+    *size = used;
+    return data;
+}
+
+void demo(void) {
+    printf("==================================================\n");
+    printf("HEX DUMPS IN C\n");
+    printf("==================================================\n");
+
+    printf("\n1. Hex is just bytes, written 4 bits per digit:\n");
+    unsigned char color[] = {0xFF, 0x64, 0x96};
+    char text[16];
+    hex_encode(text, color, sizeof(color), 1);
+    printf("   Color bytes FF 64 96 -> \"%.6s\"\n", text);
+
+    printf("\n2. And back again (upper or lower case both work):\n");
+    unsigned char back[3];
+    if (hex_decode(back, "ff6496", 6, NULL) == HEX_OK) {
+        printf("   \"ff6496\" -> %d %d %d\n", back[0], back[1], back[2]);
+    }
+
+    size_t bad = 0;
+    hex_status status = hex_decode(back, "ff64g6", 6, &bad);
+    printf("   \"ff64g6\" -> %s at position %zu\n",
+           status == HEX_BAD_CHAR ? "bad character" : "ok", bad);
+
+    printf("\n3. A dump shows address, hex and text side by side:\n");
+    const char *message = "Hello, world!\nBinary is fun. Hex is shorter!";
+    size_t len = strlen(message);
+    char *dump = malloc(hex_dump_size(len));
+    size_t written = hex_dump(dump, message, len, 0);
+    fwrite(dump, 1, written, stdout);
+    free(dump);
+
+    printf("\n   Kernel used on this CPU: %s\n", hex_kernel_name(hex_detect()));
+
+    printf("\n==================================================\n");
+    printf("Try it on a real file: ./hex_dump hex_dump 🔍\n");
+    printf("==================================================\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        demo();
+        return 0;
+    }
+
+    const char *mode = argc > 2 ? argv[1] : "";
+    const char *path = argv[argc - 1];
+    size_t size;
+    unsigned char *data = readAll(path, &size);
+    if (!data) {
+        fprintf(stderr, "Can't read %s\n", path);
+        return 1;
+    }
+
+    int result = 0;
+    if (strcmp(mode, "-r") == 0) {
+        // Ignore line breaks and spaces so "-p" output round-trips
+        size_t n = 0;
+        for (size_t i = 0; i < size; i++) {
+            if (data[i] != '\n' && data[i] != '\r' && data[i] != ' ') data[n++] = data[i];
+        }
+        unsigned char *bytes = malloc(n / 2 + 1);
+        size_t bad = 0;
+        hex_status status = hex_decode(bytes, (const char *)data, n, &bad);
+        if (status == HEX_OK) {
+            fwrite(bytes, 1, n / 2, stdout);
+        } else {
+            fprintf(stderr, "%s at hex digit %zu\n",
+                    status == HEX_ODD_LENGTH ? "Odd number of digits" : "Not a hex digit", bad);
+            result = 1;
+        }
+        free(bytes);
+    } else if (strcmp(mode, "-p") == 0) {
+        char *text = malloc(2 * size + 1);
+        hex_encode(text, data, size, 0);
+        text[2 * size] = '\n';
+        fwrite(text, 1, 2 * size + 1, stdout);
+        free(text);
+    } else {
+        char *dump = malloc(hex_dump_size(size));
+        size_t written = hex_dump(dump, data, size, 0);
+        fwrite(dump, 1, written, stdout);
+        free(dump);
+    }
+
+    free(data);
+    return result;
+}
@@ -0,0 +1,115 @@
+/*
+ * Arenas and Pools in C
+ * Faster ways to use the heap when you make LOTS of small things!
+ * Compile: gcc -O2 6_arena.c -o arena
+ * Run: ./arena
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "arena.h"
+
+#define COUNT 1000000
+
+typedef struct {
+    int id;
+    float x, y, z;
+} Particle;
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main() {
+    printf("==================================================\n");
+    printf("ARENAS AND POOLS IN C\n");
+    printf("==================================================\n");
+
+    // 1. Arena: bump a pointer through one big block
+    arena a;
+    arena_init(&a, 64 * 1024);
+
+    printf("\n1. Arena Allocation:\n");
+    int *numbers = arena_alloc(&a, 4 * sizeof(int), _Alignof(int));
+    for (int i = 0; i < 4; i++) numbers[i] = (i + 1) * 10;
+    double *pi = arena_alloc(&a, sizeof(double), _Alignof(double));
+    *pi = 3.14159;
+    for (int i = 0; i < 4; i++) {
+        printf("   numbers[%d] = %d at %p\n", i, numbers[i], (void *)&numbers[i]);
+    }
+    printf("   pi = %.5f at %p (right after, lined up to 8 bytes)\n", *pi, (void *)pi);
+
+    // Marks let you throw away just the newest allocations
+    arena_mark before = arena_get_mark(&a);
+    char *scratch = arena_alloc(&a, 100, 1);
+    printf("\n   Scratch space at %p\n", (void *)scratch);
+    arena_rewind(&a, before);
+    char *again = arena_alloc(&a, 100, 1);
+    printf("   After rewind, next allocation at %p (%s)\n",
+           (void *)again, again == scratch ? "same spot!" : "different");
+
+    // 2. Pool: freed objects are reused right away
+    pool p;
+    pool_init(&p, sizeof(Particle), 1024);
+
+    printf("\n2. Pool Allocation (every object is %zu bytes):\n", sizeof(Particle));
+    Particle *first = pool_alloc(&p);
+    Particle *second = pool_alloc(&p);
+    printf("   first  at %p\n", (void *)first);
+    printf("   second at %p\n", (void *)second);
+    pool_free(&p, first);
+    Particle *third = pool_alloc(&p);
+    printf("   Freed first, then allocated third at %p (%s)\n",
+           (void *)third, third == first ? "reused first's spot!" : "new spot");
+    pool_free(&p, second);
+    pool_free(&p, third);
+
+    printf("\n==================================================\n");
+    printf("SPEED TEST (%d particles)\n", COUNT);
+    printf("==================================================\n\n");
+
+    Particle **list = malloc(COUNT * sizeof(Particle *));
+    double start, took;
+
+    start = now_seconds();
+    for (int i = 0; i < COUNT; i++) {
+        list[i] = malloc(sizeof(Particle));
+        list[i]->id = i;
+    }
+    for (int i = 0; i < COUNT; i++) free(list[i]);
+    took = now_seconds() - start;
+    printf("   malloc + free:       %6.1f ms\n", took * 1000);
+    double malloc_time = took;
+
+    start = now_seconds();
+    for (int i = 0; i < COUNT; i++) {
+        list[i] = pool_alloc(&p);
+        list[i]->id = i;
+    }
+    for (int i = 0; i < COUNT; i++) pool_free(&p, list[i]);
+    took = now_seconds() - start;
+    printf("   pool_alloc + free:   %6.1f ms (%.1fx faster)\n", took * 1000, malloc_time / took);
+
+    arena_reset(&a);
+    start = now_seconds();
+    for (int i = 0; i < COUNT; i++) {
+        list[i] = arena_alloc(&a, sizeof(Particle), _Alignof(Particle));
+        list[i]->id = i;
+    }
+    arena_reset(&a);  // all of them, in one step
+    took = now_seconds() - start;
+    printf("   arena_alloc + reset: %6.1f ms (%.1fx faster)\n", took * 1000, malloc_time / took);
+
+    free(list);
+    pool_destroy(&p);
+    arena_destroy(&a);
+
+    printf("\n==================================================\n");
+    printf("Same heap, smarter bookkeeping! 🧹\n");
+    printf("==================================================\n");
+
+    return 0;
+}
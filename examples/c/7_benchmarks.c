@@ -0,0 +1,207 @@
+/*
+ * Measuring Speed in C
+ * Are the speed claims in the other examples actually true? Let's time them!
+ * Compile: gcc -O2 7_benchmarks.c -o benchmarks
+ * Run: ./benchmarks              (text table)
+ *      ./benchmarks --json       (JSON report on stdout)
+ *      ./benchmarks --json=out.json --runs=101
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench.h"
+
+#define VALUES 4096  // a 16 KB array fits in the L1 cache
+
+static int values[VALUES];
+
+// ==================================================
+// Suite 1: STACK vs HEAP (from 3_memory.c)
+// ==================================================
+
+void stackArray(void *ctx, size_t iterations) {
+    (void)ctx;
+    for (size_t i = 0; i < iterations; i++) {
+        int numbers[16];
+        numbers[0] = (int)i;
+        bench_escape(numbers);  // the array "is used", so it must exist
+    }
+}
+
+void heapArray(void *ctx, size_t iterations) {
+    (void)ctx;
+    for (size_t i = 0; i < iterations; i++) {
+        int *numbers = malloc(16 * sizeof(int));
+        numbers[0] = (int)i;
+        bench_escape(numbers);
+        free(numbers);
+    }
+}
+
+// Many heap blocks alive at once: malloc has to do real bookkeeping
+void heapBatch(void *ctx, size_t iterations) {
+    (void)ctx;
+    int *live[64];
+    for (size_t i = 0; i < iterations; i += 64) {
+        for (int j = 0; j < 64; j++) live[j] = malloc(16 * sizeof(int));
+        bench_escape(live);
+        for (int j = 0; j < 64; j++) free(live[j]);
+    }
+}
+
+// ==================================================
+// Suite 2: SHIFT vs MULTIPLY/DIVIDE (from 2_binary_ops.c)
+// Each step depends on the last one, so this measures latency.
+// ==================================================
+
+void shiftLeft(void *ctx, size_t iterations) {
+    (void)ctx;
+    unsigned x = 1;
+    for (size_t i = 0; i < iterations; i++) {
+        x = (x << 1) ^ (unsigned)i;
+        BENCH_HIDE(x);
+    }
+    BENCH_KEEP(x);
+}
+
+// "* 2" with a constant: the compiler turns it into a shift (or an add)
+void multiplyByTwo(void *ctx, size_t iterations) {
+    (void)ctx;
+    unsigned x = 1;
+    for (size_t i = 0; i < iterations; i++) {
+        x = (x * 2) ^ (unsigned)i;
+        BENCH_HIDE(x);
+    }
+    BENCH_KEEP(x);
+}
+
+// The multiplier is hidden from the compiler, so a real multiply runs
+void multiplyUnknown(void *ctx, size_t iterations) {
+    (void)ctx;
+    unsigned x = 1, two = 2;
+    BENCH_HIDE(two);
+    for (size_t i = 0; i < iterations; i++) {
+        x = (x * two) ^ (unsigned)i;
+        BENCH_HIDE(x);
+    }
+    BENCH_KEEP(x);
+}
+
+void shiftRight(void *ctx, size_t iterations) {
+    (void)ctx;
+    int x = 1 << 30;
+    for (size_t i = 0; i < iterations; i++) {
+        x = (x >> 1) | (1 << 30);
+        BENCH_HIDE(x);
+    }
+    BENCH_KEEP(x);
+}
+
+// Signed "/ 2" rounds toward zero, so it needs a fix-up for negatives
+void divideByTwo(void *ctx, size_t iterations) {
+    (void)ctx;
+    int x = 1 << 30;
+    for (size_t i = 0; i < iterations; i++) {
+        x = (x / 2) | (1 << 30);
+        BENCH_HIDE(x);
+    }
+    BENCH_KEEP(x);
+}
+
+// A divisor the compiler can't see: the real (slow) divide instruction
+void divideUnknown(void *ctx, size_t iterations) {
+    (void)ctx;
+    int x = 1 << 30, two = 2;
+    BENCH_HIDE(two);
+    for (size_t i = 0; i < iterations; i++) {
+        x = (x / two) | (1 << 30);
+        BENCH_HIDE(x);
+    }
+    BENCH_KEEP(x);
+}
+
+// ==================================================
+// Suite 3: "& 1" vs "% 2" to test for odd numbers
+// Counts the odd numbers in an array (throughput).
+// ==================================================
+
+void oddAnd(void *ctx, size_t iterations) {
+    (void)ctx;
+    unsigned odd = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        odd += values[i % VALUES] & 1;
+    }
+    BENCH_KEEP(odd);
+}
+
+void oddModulo(void *ctx, size_t iterations) {
+    (void)ctx;
+    unsigned odd = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        odd += values[i % VALUES] % 2 != 0;
+    }
+    BENCH_KEEP(odd);
+}
+
+void oddModuloUnknown(void *ctx, size_t iterations) {
+    (void)ctx;
+    unsigned odd = 0;
+    int two = 2;
+    BENCH_HIDE(two);
+    for (size_t i = 0; i < iterations; i++) {
+        odd += values[i % VALUES] % two != 0;
+    }
+    BENCH_KEEP(odd);
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite s;
+    bench_init(&s, "c_examples", argc, argv);
+
+    for (int i = 0; i < VALUES; i++) values[i] = rand() - RAND_MAX / 2;
+
+    if (!s.quiet) {
+        printf("==================================================\n");
+        printf("MEASURING SPEED IN C\n");
+        printf("==================================================\n");
+        printf("\n%d runs each (after %d warmup runs), time per operation.\n",
+               s.runs, s.warmup_runs);
+        printf("Cycle counter: %.2f GHz\n", s.tsc_ghz);
+    }
+
+    bench_section(&s, "1. STACK vs HEAP (\"STACK: Fast / HEAP: Slower\"):");
+    bench_run(&s, "stack int[16]", stackArray, NULL);
+    bench_run(&s, "malloc+free int[16]", heapArray, NULL);
+    bench_run(&s, "64 live mallocs, then frees", heapBatch, NULL);
+    bench_compare(&s, "malloc+free int[16]", "stack int[16]");
+
+    bench_section(&s, "2. SHIFT vs MULTIPLY/DIVIDE (\"Bitwise operations are SUPER fast!\"):");
+    bench_run(&s, "x << 1", shiftLeft, NULL);
+    bench_run(&s, "x * 2", multiplyByTwo, NULL);
+    bench_run(&s, "x * two (unknown)", multiplyUnknown, NULL);
+    bench_run(&s, "x >> 1", shiftRight, NULL);
+    bench_run(&s, "x / 2 (signed)", divideByTwo, NULL);
+    bench_run(&s, "x / two (unknown)", divideUnknown, NULL);
+    bench_compare(&s, "x * two (unknown)", "x << 1");
+    bench_compare(&s, "x / two (unknown)", "x >> 1");
+
+    bench_section(&s, "3. ODD TEST: & 1 vs % 2 (\"We check the last bit\"):");
+    bench_run(&s, "n & 1", oddAnd, NULL);
+    bench_run(&s, "n % 2", oddModulo, NULL);
+    bench_run(&s, "n % two (unknown)", oddModuloUnknown, NULL);
+    bench_compare(&s, "n % two (unknown)", "n & 1");
+
+    if (!s.quiet) {
+        printf("\n==================================================\n");
+        printf("WHAT DID WE LEARN?\n");
+        printf("==================================================\n");
+        printf("   * With a constant like 2, the compiler already turns * and /\n");
+        printf("     into shifts - so \"x * 2\" and \"x << 1\" run the same code.\n");
+        printf("   * Real divide instructions ARE much slower than shifts.\n");
+        printf("   * The stack is faster because there is nothing to look up:\n");
+        printf("     the space is reserved when the function starts.\n");
+    }
+
+    bench_finish(&s);
+    return 0;
+}
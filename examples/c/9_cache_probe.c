@@ -0,0 +1,371 @@
+/*
+ * How Fast Is Memory, Really? (C)
+ * 3_memory.c shows arrays are stored side by side - this shows what
+ * that buys you: L1, L2, L3 and main memory, measured.
+ * Compile: gcc -O2 9_cache_probe.c -o cache_probe
+ * Run: ./cache_probe [--max-mb=N] [--json] [--json=FILE] [--runs=N]
+ *
+ * 1. LATENCY: follow a chain of pointers through a buffer in random
+ *    order. Each load needs the one before it, so nothing overlaps and
+ *    the time per step is the time one load really takes.
+ * 2. BANDWIDTH: read and write whole buffers of each size in order.
+ * 3. STRIDE: read one 8-byte value every N bytes of a big buffer.
+ * 4. TLB: the CPU also caches address translations, one per page.
+ *    Visit one line per page, with normal 4 KB pages and then with
+ *    2 MB "huge" pages (madvise(MADV_HUGEPAGE)).
+ *
+ * --json gives the same numbers as JSON, with the detected cache
+ * boundaries under "info", for comparing machines.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "bench.h"
+
+#define LINE 64
+#define PAGE 4096
+#define HUGE_PAGE (2u << 20)
+#define MAX_POINTS 64
+
+// ==================================================
+// Memory: mmap, so we can ask for (or refuse) huge pages
+// ==================================================
+
+typedef struct {
+    void *base;      // what mmap returned
+    size_t mapped;
+    uint8_t *data;   // 2 MB aligned start
+    size_t size;
+} region;
+
+int regionMap(region *r, size_t size, int huge) {
+    r->mapped = size + HUGE_PAGE;
+    r->base = mmap(NULL, r->mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r->base == MAP_FAILED) return 0;
+    r->data = (uint8_t *)(((uintptr_t)r->base + HUGE_PAGE - 1) & ~(uintptr_t)(HUGE_PAGE - 1));
+    r->size = size;
+#ifdef MADV_HUGEPAGE
+    madvise(r->data, size, huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#endif
+    memset(r->data, 1, size);  // get every page now, not while timing
+    return 1;
+}
+
+void regionUnmap(region *r) {
+    munmap(r->base, r->mapped);
+}
+
+// How much of the region the kernel really backs with huge pages
+size_t hugeBytes(const region *r) {
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) return 0;
+    char line[256];
+    size_t total = 0;
+    int inside = 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long start, end;
+        size_t kb;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2 && strchr(line, '-') < strchr(line, ' ')) {
+            inside = start < (uintptr_t)r->data + r->size && end > (uintptr_t)r->data;
+        } else if (inside && sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) {
+            total += kb * 1024;
+        }
+    }
+    fclose(f);
+    return total;
+}
+
+// Small fast random numbers (xorshift), the same every run
+static uint64_t rng_state = 88172645463325252ULL;
+uint64_t nextRandom(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// A random order of 0..n-1 that forms ONE cycle (Sattolo's shuffle),
+// so following it visits every slot before coming back
+void randomCycle(uint32_t *order, size_t n) {
+    for (size_t i = 0; i < n; i++) order[i] = (uint32_t)i;
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = nextRandom() % i;
+        uint32_t t = order[i]; order[i] = order[j]; order[j] = t;
+    }
+}
+
+// Where the pointer for `slot` lives. With random_line it's a
+// scrambled line inside the slot, so slots don't all land in the
+// same few cache sets.
+uint8_t *slotAddress(uint8_t *data, size_t slot, size_t spacing, int random_line) {
+    size_t line = random_line ? (size_t)((slot * 0x9E3779B97F4A7C15ULL) >> 40) % (spacing / LINE) : 0;
+    return data + slot * spacing + line * LINE;
+}
+
+// Link `count` slots, `spacing` bytes apart, into one random chain
+void *buildChain(uint8_t *data, size_t count, size_t spacing, int random_line, uint32_t *order) {
+    randomCycle(order, count);
+    for (size_t i = 0; i < count; i++) {
+        uint8_t *from = slotAddress(data, order[i], spacing, random_line);
+        *(void **)from = slotAddress(data, order[(i + 1) % count], spacing, random_line);
+    }
+    return slotAddress(data, order[0], spacing, random_line);
+}
+
+// ==================================================
+// The measured loops
+// ==================================================
+
+typedef struct {
+    void *cursor;       // chase: where the chain is now
+    const uint8_t *data;
+    size_t size;
+    size_t stride;
+    size_t position;    // stride: next offset to read
+} probe;
+
+// One dependent load per iteration
+void chase(void *ctx, size_t iterations) {
+    probe *p = (probe *)ctx;
+    void **cursor = (void **)p->cursor;
+    for (size_t i = 0; i < iterations; i++) cursor = (void **)*cursor;
+    p->cursor = cursor;
+    BENCH_KEEP(cursor);
+}
+
+// One iteration = one pass over the buffer
+void readAll(void *ctx, size_t iterations) {
+    probe *p = (probe *)ctx;
+    const uint64_t *words = (const uint64_t *)p->data;
+    size_t n = p->size / 8;
+    for (size_t k = 0; k < iterations; k++) {
+        uint64_t a = 0, b = 0, c = 0, d = 0;
+        for (size_t i = 0; i < n; i += 4) {
+            a += words[i]; b += words[i + 1]; c += words[i + 2]; d += words[i + 3];
+        }
+        BENCH_KEEP(a + b + c + d);
+    }
+}
+
+void writeAll(void *ctx, size_t iterations) {
+    probe *p = (probe *)ctx;
+    for (size_t k = 0; k < iterations; k++) {
+        memset((void *)p->data, (int)k, p->size);
+        bench_clobber();
+    }
+}
+
+// One iteration = one 8-byte read; loads don't depend on each other
+void strided(void *ctx, size_t iterations) {
+    probe *p = (probe *)ctx;
+    size_t pos = p->position, mask = p->size - 1;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        sum += *(const uint64_t *)(p->data + pos);
+        pos = (pos + p->stride) & mask;
+    }
+    p->position = pos;
+    BENCH_KEEP(sum);
+}
+
+// ==================================================
+// Reporting helpers
+// ==================================================
+
+// "48 KB", "2 MB", "1.5 MB"
+const char *formatBytes(char *buf, size_t n, size_t bytes) {
+    if (bytes >= (1u << 20)) {
+        double mb = (double)bytes / (1u << 20);
+        snprintf(buf, n, mb == (double)(size_t)mb ? "%.0f MB" : "%.1f MB", mb);
+    } else {
+        double kb = (double)bytes / 1024;
+        snprintf(buf, n, kb == (double)(size_t)kb ? "%.0f KB" : "%.1f KB", kb);
+    }
+    return buf;
+}
+
+// Cache size the kernel reports, e.g. (1, "Data") -> 49152 (0 if unknown)
+size_t reportedCacheSize(int level, const char *type) {
+    for (int index = 0; index < 8; index++) {
+        char path[96], text[32];
+        int lvl = 0;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+        FILE *f = fopen(path, "r");
+        if (!f) break;
+        if (fscanf(f, "%d", &lvl) != 1) lvl = 0;
+        fclose(f);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+        f = fopen(path, "r");
+        if (!f) continue;
+        int match = fscanf(f, "%31s", text) == 1 && lvl == level && strcmp(text, type) == 0;
+        fclose(f);
+        if (!match) continue;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        f = fopen(path, "r");
+        if (!f) continue;
+        size_t size = 0;
+        char unit = 'K';
+        if (fscanf(f, "%zu%c", &size, &unit) >= 1) size *= unit == 'M' ? (1u << 20) : 1024;
+        fclose(f);
+        return size;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite s;
+    bench_init(&s, "cache_probe", argc, argv);
+
+    size_t max_bytes = (size_t)512 << 20;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--max-mb=", 9) == 0) max_bytes = (size_t)atol(argv[i] + 9) << 20;
+    }
+    // Keep it a power of two (the stride test wraps with a mask)
+    size_t pow2 = 64 << 10;
+    while (pow2 * 2 <= max_bytes) pow2 *= 2;
+    max_bytes = pow2;
+
+    region mem;
+    if (!regionMap(&mem, max_bytes, 0)) {
+        fprintf(stderr, "can't map %zu MB (try --max-mb=N)\n", max_bytes >> 20);
+        return 1;
+    }
+    uint32_t *order = malloc((max_bytes / LINE) * sizeof(uint32_t));
+    if (!order) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    char text[32], name[64];
+    const char *levels[] = {"L1d", "L2", "L3"};
+    size_t reported[3] = {reportedCacheSize(1, "Data"), reportedCacheSize(2, "Unified"),
+                          reportedCacheSize(3, "Unified")};
+    bench_info_number(&s, "max_bytes", (double)max_bytes);
+    for (int i = 0; i < 3; i++) {
+        snprintf(name, sizeof(name), "reported_%s_bytes", levels[i]);
+        bench_info_number(&s, name, (double)reported[i]);
+    }
+
+    if (!s.quiet) {
+        printf("==================================================\n");
+        printf("HOW FAST IS MEMORY, REALLY?\n");
+        printf("==================================================\n");
+        printf("\nThe kernel says this CPU has:");
+        for (int i = 0; i < 3; i++) {
+            if (reported[i]) printf(" %s %s", levels[i], formatBytes(text, sizeof(text), reported[i]));
+        }
+        printf("\nTesting working sets up to %s.\n", formatBytes(text, sizeof(text), max_bytes));
+    }
+
+    // ---- 1. Latency: random pointer chasing ----
+    size_t sizes[MAX_POINTS];
+    double latency[MAX_POINTS];
+    int points = 0;
+    for (size_t size = 4 << 10; size <= max_bytes && points < MAX_POINTS - 1; size *= 2) {
+        sizes[points++] = size;
+        if (size + size / 2 <= max_bytes) sizes[points++] = size + size / 2;
+    }
+
+    bench_section(&s, "1. LATENCY: one load at a time, random order (4 KB pages)");
+    for (int i = 0; i < points; i++) {
+        probe p = {0};
+        p.cursor = buildChain(mem.data, sizes[i] / LINE, LINE, 0, order);
+        snprintf(name, sizeof(name), "chase %s", formatBytes(text, sizeof(text), sizes[i]));
+        latency[i] = bench_run(&s, name, chase, &p)->median_ns;
+    }
+
+    // A boundary is where latency jumps; a jump spread over several
+    // sizes counts once, at the last size before it started
+    if (!s.quiet) printf("\n   Where the latency jumps (cache boundaries):\n");
+    int found = 0;
+    for (int i = 1; i < points; i++) {
+        if (latency[i] < latency[i - 1] * 1.25) continue;
+        int start = i - 1;
+        while (i + 1 < points && latency[i + 1] >= latency[i] * 1.25) i++;
+        found++;
+        if (!s.quiet) {
+            printf("   * above %-8s %6.2f ns -> %6.2f ns\n", formatBytes(text, sizeof(text), sizes[start]),
+                   latency[start], latency[i]);
+        }
+        snprintf(name, sizeof(name), "boundary_%d_bytes", found);
+        bench_info_number(&s, name, (double)sizes[start]);
+        snprintf(name, sizeof(name), "boundary_%d_ns_before", found);
+        bench_info_number(&s, name, latency[start]);
+        snprintf(name, sizeof(name), "boundary_%d_ns_after", found);
+        bench_info_number(&s, name, latency[i]);
+    }
+    if (!s.quiet && found == 0) printf("   * none found (is --max-mb big enough?)\n");
+
+    // ---- 2. Bandwidth over working-set sizes ----
+    bench_section(&s, "2. BANDWIDTH: reading and writing whole buffers");
+    for (size_t size = 16 << 10; size <= max_bytes; size *= 4) {
+        probe p = {0};
+        p.data = mem.data;
+        p.size = size;
+        snprintf(name, sizeof(name), "read %s", formatBytes(text, sizeof(text), size));
+        bench_run(&s, name, readAll, &p);
+        bench_rate(&s, (double)size, "B");
+        snprintf(name, sizeof(name), "write %s", formatBytes(text, sizeof(text), size));
+        bench_run(&s, name, writeAll, &p);
+        bench_rate(&s, (double)size, "B");
+    }
+
+    // ---- 3. Strides: same number of reads, more and more lines ----
+    size_t stride_bytes = max_bytes < ((size_t)64 << 20) ? max_bytes : (size_t)64 << 20;
+    snprintf(name, sizeof(name), "3. STRIDE: one 8-byte read every N bytes of %s",
+             formatBytes(text, sizeof(text), stride_bytes));
+    bench_section(&s, name);
+    for (size_t stride = 8; stride <= 8192; stride *= 2) {
+        probe p = {0};
+        p.data = mem.data;
+        p.size = stride_bytes;
+        p.stride = stride + (stride >= PAGE ? LINE : 0);  // don't hit the same cache set
+        snprintf(name, sizeof(name), "stride %zu", stride);
+        bench_run(&s, name, strided, &p);
+        bench_rate(&s, 8.0, "B");
+    }
+
+    // ---- 4. TLB: one line per page, normal vs huge pages ----
+    region huge;
+    int have_huge = regionMap(&huge, max_bytes, 1);
+    size_t huge_backed = have_huge ? hugeBytes(&huge) : 0;
+    bench_info_number(&s, "huge_page_bytes_backed", (double)huge_backed);
+    if (!s.quiet) {
+        printf("\nHuge pages the kernel actually gave us: %s of %s\n",
+               formatBytes(text, sizeof(text), huge_backed),
+               formatBytes(name, sizeof(name), max_bytes));
+    }
+    bench_section(&s, "4. TLB: random pages, one line each (4 KB vs 2 MB pages)");
+    for (size_t size = 1 << 20; size <= max_bytes; size *= 4) {
+        probe p = {0};
+        p.cursor = buildChain(mem.data, size / PAGE, PAGE, 1, order);
+        snprintf(name, sizeof(name), "4 KB pages, %s", formatBytes(text, sizeof(text), size));
+        bench_run(&s, name, chase, &p);
+        if (!have_huge) continue;
+        char huge_name[64];
+        p.cursor = buildChain(huge.data, size / PAGE, PAGE, 1, order);
+        snprintf(huge_name, sizeof(huge_name), "2 MB pages, %s", text);
+        bench_run(&s, huge_name, chase, &p);
+        bench_compare(&s, name, huge_name);
+    }
+
+    if (!s.quiet) {
+        printf("\n==================================================\n");
+        printf("WHAT DID WE LEARN?\n");
+        printf("==================================================\n");
+        printf("   * Small working sets are many times faster: keep hot data small.\n");
+        printf("   * Reading in order is fast even from main memory, because\n");
+        printf("     the CPU fetches the next lines before you ask.\n");
+        printf("   * Past 64 bytes, a bigger stride costs a whole line per read.\n");
+        printf("   * Huge pages help when jumping around a big buffer.\n");
+    }
+
+    if (have_huge) regionUnmap(&huge);
+    regionUnmap(&mem);
+    free(order);
+    bench_finish(&s);
+    return 0;
+}
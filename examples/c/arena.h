@@ -0,0 +1,244 @@
+/*
+ * arena.h - Arena and Pool Allocators
+ * Two simple ways to get heap memory much faster than malloc/free.
+ *
+ * 3_memory.c calls malloc() for every value and free() for each one.
+ * When a program makes lots of small, short-lived objects, that adds up.
+ *
+ *   ARENA: grab a big block, hand out pieces by bumping a pointer, and
+ *          free everything at once with arena_reset() (or go back to an
+ *          earlier point with arena_rewind()).
+ *   POOL:  every object is the same size, so freed objects go on a
+ *          "free list" and the next allocation just takes one off.
+ *
+ * Neither one locks: give each thread its own arena or pool.
+ *
+ * Header-only: just #include "arena.h" (works from C and C++).
+ *
+ *   arena a;
+ *   arena_init(&a, 64 * 1024);
+ *   int *numbers = arena_alloc(&a, 5 * sizeof(int), _Alignof(int));
+ *   arena_reset(&a);      // everything is gone, blocks are kept for reuse
+ *   arena_destroy(&a);    // give the blocks back to the system
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Alignment of anything malloc() can return
+#define ARENA_MAX_ALIGN 16
+
+// ----------------------------------------------------------------------
+// Arena (bump-pointer) allocator
+// ----------------------------------------------------------------------
+
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t size;             // usable bytes after this header
+    size_t used;
+} arena_block;
+
+typedef struct {
+    arena_block *first;      // blocks are kept in order for reuse
+    arena_block *current;    // the block we are bumping through
+    size_t block_size;       // size of normal blocks
+} arena;
+
+// A saved position, for arena_rewind()
+typedef struct {
+    arena_block *block;
+    size_t used;
+} arena_mark;
+
+static inline void arena_init(arena *a, size_t block_size) {
+    a->first = NULL;
+    a->current = NULL;
+    a->block_size = block_size < 256 ? 256 : block_size;
+}
+
+static inline size_t arena_align_up(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+// Block header, padded so the data after it stays aligned
+static inline size_t arena_header_size(void) {
+    return arena_align_up(sizeof(arena_block), ARENA_MAX_ALIGN);
+}
+
+static inline char *arena_block_data(arena_block *b) {
+    return (char *)b + arena_header_size();
+}
+
+// Slow path: move on to the next block that fits (or make a new one)
+static inline void *arena_alloc_slow(arena *a, size_t size, size_t align) {
+    size_t extra = align > ARENA_MAX_ALIGN ? align : 0;
+    // A size this big would wrap around below: fail like malloc would
+    if (size > SIZE_MAX - arena_header_size() - extra) return NULL;
+    size_t needed = size + extra;
+    arena_block *b = a->current ? a->current->next : a->first;
+    while (b && b->size < needed) b = b->next;
+
+    if (!b) {
+        size_t data = needed > a->block_size ? needed : a->block_size;
+        if (data > SIZE_MAX - arena_header_size()) return NULL;
+        b = (arena_block *)malloc(arena_header_size() + data);
+        if (!b) return NULL;
+        b->size = data;
+        // Link it in right after the current block
+        if (a->current) {
+            b->next = a->current->next;
+            a->current->next = b;
+        } else {
+            b->next = a->first;
+            a->first = b;
+        }
+    }
+    b->used = 0;
+    a->current = b;
+
+    uintptr_t base = (uintptr_t)arena_block_data(b);
+    size_t start = arena_align_up(base, align) - base;
+    b->used = start + size;
+    return (void *)(base + start);
+}
+
+// Allocate size bytes aligned to align (a power of two). Never freed on
+// its own - use arena_reset(), arena_rewind() or arena_destroy().
+static inline void *arena_alloc(arena *a, size_t size, size_t align) {
+    arena_block *b = a->current;
+    if (b) {
+        uintptr_t base = (uintptr_t)arena_block_data(b);
+        size_t start = arena_align_up(base + b->used, align) - base;
+        if (start <= b->size && size <= b->size - start) {  // start + size could wrap
+            b->used = start + size;
+            return (void *)(base + start);
+        }
+    }
+    return arena_alloc_slow(a, size, align);
+}
+
+static inline arena_mark arena_get_mark(const arena *a) {
+    arena_mark m;
+    m.block = a->current;
+    m.used = a->current ? a->current->used : 0;
+    return m;
+}
+
+// Free everything allocated since the mark was taken
+static inline void arena_rewind(arena *a, arena_mark m) {
+    a->current = m.block;
+    if (m.block) m.block->used = m.used;
+}
+
+// Free everything, but keep the blocks for the next round
+static inline void arena_reset(arena *a) {
+    a->current = NULL;
+}
+
+// Bytes of block memory the arena is holding on to
+static inline size_t arena_bytes_reserved(const arena *a) {
+    size_t total = 0;
+    for (arena_block *b = a->first; b; b = b->next) total += b->size;
+    return total;
+}
+
+static inline void arena_destroy(arena *a) {
+    arena_block *b = a->first;
+    while (b) {
+        arena_block *next = b->next;
+        free(b);
+        b = next;
+    }
+    a->first = a->current = NULL;
+}
+
+// ----------------------------------------------------------------------
+// Fixed-size object pool with a free list
+// ----------------------------------------------------------------------
+
+// A free object stores the pointer to the next free object inside itself
+typedef struct pool_free_node {
+    struct pool_free_node *next;
+} pool_free_node;
+
+typedef struct pool_chunk {
+    struct pool_chunk *next;
+} pool_chunk;
+
+typedef struct {
+    pool_free_node *free_list;   // objects given back with pool_free()
+    char *fresh;                 // never-used objects in the newest chunk
+    char *fresh_end;
+    pool_chunk *chunks;          // every chunk, so we can free them all
+    size_t object_size;
+    size_t per_chunk;
+} pool;
+
+// Every object is object_size bytes; memory is fetched per_chunk objects at a time
+static inline void pool_init(pool *p, size_t object_size, size_t per_chunk) {
+    if (object_size < sizeof(pool_free_node)) object_size = sizeof(pool_free_node);
+    p->object_size = arena_align_up(object_size, object_size >= ARENA_MAX_ALIGN ? ARENA_MAX_ALIGN : sizeof(void *));
+    p->per_chunk = per_chunk ? per_chunk : 1024;
+    p->free_list = NULL;
+    p->fresh = p->fresh_end = NULL;
+    p->chunks = NULL;
+}
+
+static inline void *pool_alloc_slow(pool *p) {
+    size_t header = arena_align_up(sizeof(pool_chunk), ARENA_MAX_ALIGN);
+    if (p->per_chunk > (SIZE_MAX - header) / p->object_size) return NULL;
+    pool_chunk *c = (pool_chunk *)malloc(header + p->object_size * p->per_chunk);
+    if (!c) return NULL;
+    c->next = p->chunks;
+    p->chunks = c;
+    p->fresh = (char *)c + header + p->object_size;
+    p->fresh_end = (char *)c + header + p->object_size * p->per_chunk;
+    return (char *)c + header;
+}
+
+static inline void *pool_alloc(pool *p) {
+    pool_free_node *node = p->free_list;
+    if (node) {
+        p->free_list = node->next;
+        return node;
+    }
+    if (p->fresh < p->fresh_end) {
+        void *obj = p->fresh;
+        p->fresh += p->object_size;
+        return obj;
+    }
+    return pool_alloc_slow(p);
+}
+
+// Give an object back. It must have come from this pool.
+static inline void pool_free(pool *p, void *obj) {
+    pool_free_node *node = (pool_free_node *)obj;
+    node->next = p->free_list;
+    p->free_list = node;
+}
+
+static inline void pool_destroy(pool *p) {
+    pool_chunk *c = p->chunks;
+    while (c) {
+        pool_chunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    p->chunks = NULL;
+    p->free_list = NULL;
+    p->fresh = p->fresh_end = NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ARENA_H
@@ -0,0 +1,378 @@
+/*
+ * bench.h - A Tiny Microbenchmark Harness
+ * Turns "this is fast" into "this takes 0.31 ns".
+ *
+ * Timing very short pieces of code is tricky:
+ *   - The first runs are slow (cold caches, CPU still speeding up),
+ *     so we do some WARMUP runs and throw them away.
+ *   - One run can be unlucky (an interrupt, another program), so we do
+ *     many runs and report the MEDIAN and the 99th PERCENTILE (p99).
+ *   - The compiler deletes work whose result is never used, so we use
+ *     "do not optimize" barriers to make it keep the code we measure.
+ *
+ * Time comes from clock_gettime(), and on x86 also from the CPU's cycle
+ * counter (rdtsc) for cycles per operation. Modern CPUs tick that counter
+ * at a fixed rate, so "cycles" are reference cycles, not core clocks.
+ *
+ * Header-only: just #include "bench.h" (works from C and C++).
+ *
+ *   void addLoop(void *ctx, size_t iterations) {
+ *       uint64_t sum = 0;
+ *       for (size_t i = 0; i < iterations; i++) {
+ *           sum += i;
+ *           BENCH_HIDE(sum);      // stop the compiler doing it all at once
+ *       }
+ *       BENCH_KEEP(sum);          // the result "is used"
+ *   }
+ *
+ *   bench_suite s;
+ *   bench_init(&s, "demo", argc, argv);     // understands --json, --runs=N
+ *   bench_run(&s, "add", addLoop, NULL);
+ *   bench_finish(&s);                       // prints JSON if asked
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#else
+#define BENCH_HAS_TSC 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ----------------------------------------------------------------------
+// "Do not optimize" barriers
+// ----------------------------------------------------------------------
+
+// Pretend to read x, so the code that computed it must run
+#define BENCH_KEEP(x) __asm__ volatile("" : : "r,m"(x) : "memory")
+
+// Pretend x (a number or pointer) might have changed, so the compiler
+// can't precompute anything with it
+#define BENCH_HIDE(x) __asm__ volatile("" : "+r"(x))
+
+// Pretend someone looked at the memory p points to
+static inline void bench_escape(const void *p) {
+    __asm__ volatile("" : : "g"(p) : "memory");
+}
+
+// Pretend all memory was read and written
+static inline void bench_clobber(void) {
+    __asm__ volatile("" : : : "memory");
+}
+
+// ----------------------------------------------------------------------
+// Clocks
+// ----------------------------------------------------------------------
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Cycle counter, fenced so earlier instructions finish first
+static inline uint64_t bench_cycles(void) {
+#if BENCH_HAS_TSC
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+#else
+    return 0;
+#endif
+}
+
+// ----------------------------------------------------------------------
+// Results and suites
+// ----------------------------------------------------------------------
+
+#define BENCH_MAX_RESULTS 256
+#define BENCH_MAX_RUNS 1000
+#define BENCH_MAX_NAME 64
+#define BENCH_MAX_INFO 32
+
+typedef struct {
+    char name[BENCH_MAX_NAME];  // copied, so callers may build it in a buffer
+    size_t ops_per_run;      // operations timed in each run
+    int runs;
+    double median_ns;        // per operation
+    double p99_ns;
+    double min_ns;
+    double mean_ns;
+    double median_cycles;    // per operation (0 without rdtsc)
+    double ops_per_sec;      // from the median
+    double rate;             // units per second, set by bench_rate()
+    const char *rate_unit;   // e.g. "B" or "bit" (NULL = no rate)
+} bench_result;
+
+typedef void (*bench_fn)(void *ctx, size_t iterations);
+
+// Extra facts for the JSON report ("l2_bytes": 2097152, "host": "...")
+typedef struct {
+    char key[BENCH_MAX_NAME];
+    char text[96];
+    double number;
+    int is_number;
+} bench_info_item;
+
+typedef struct {
+    const char *name;
+    int warmup_runs;
+    int runs;
+    uint64_t min_run_ns;     // each run is made at least this long
+    const char *json_path;   // NULL = no JSON, "-" = stdout
+    int quiet;               // only JSON on stdout
+    double tsc_ghz;          // cycle counter ticks per nanosecond
+    bench_result results[BENCH_MAX_RESULTS];
+    int count;
+    bench_info_item info[BENCH_MAX_INFO];
+    int info_count;
+} bench_suite;
+
+// Measure how fast the cycle counter ticks (it runs at a fixed rate)
+static inline double bench_tsc_ghz(void) {
+#if BENCH_HAS_TSC
+    uint64_t t0 = bench_now_ns(), c0 = bench_cycles();
+    while (bench_now_ns() - t0 < 20000000) {}
+    uint64_t t1 = bench_now_ns(), c1 = bench_cycles();
+    return (double)(c1 - c0) / (double)(t1 - t0);
+#else
+    return 0;
+#endif
+}
+
+// Options: --json (to stdout), --json=FILE, --runs=N, --warmup=N, --min-ms=N
+static inline void bench_init(bench_suite *s, const char *name, int argc, char **argv) {
+    memset(s, 0, sizeof(*s));
+    s->name = name;
+    s->warmup_runs = 5;
+    s->runs = 51;
+    s->min_run_ns = 1000000;  // 1 ms
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--json") == 0) { s->json_path = "-"; s->quiet = 1; }
+        else if (strncmp(arg, "--json=", 7) == 0) s->json_path = arg + 7;
+        else if (strncmp(arg, "--runs=", 7) == 0) s->runs = atoi(arg + 7);
+        else if (strncmp(arg, "--warmup=", 9) == 0) s->warmup_runs = atoi(arg + 9);
+        else if (strncmp(arg, "--min-ms=", 9) == 0) s->min_run_ns = (uint64_t)(atof(arg + 9) * 1e6);
+    }
+    if (s->runs < 1) s->runs = 1;
+    if (s->runs > BENCH_MAX_RUNS) s->runs = BENCH_MAX_RUNS;
+    s->tsc_ghz = bench_tsc_ghz();
+}
+
+static inline int bench_compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Value below which `fraction` of the sorted samples fall
+static inline double bench_percentile(const double *sorted, int n, double fraction) {
+    int index = (int)(fraction * (n - 1) + 0.5);
+    return sorted[index < n ? index : n - 1];
+}
+
+// "12.345 ns", "1.234 us" or "5.678 ms" - whichever reads best
+static inline const char *bench_format_time(char *buf, size_t size, double ns) {
+    if (ns < 1e4) snprintf(buf, size, "%.3f ns", ns);
+    else if (ns < 1e7) snprintf(buf, size, "%.3f us", ns / 1e3);
+    else snprintf(buf, size, "%.3f ms", ns / 1e6);
+    return buf;
+}
+
+// Print a suite heading (text mode only)
+static inline void bench_section(const bench_suite *s, const char *title) {
+    if (s->quiet) return;
+    printf("\n%s\n", title);
+    printf("   %-30s %12s %12s %12s %14s\n", "benchmark", "median", "p99", "cycles", "ops/sec");
+}
+
+// Time fn. It is called with an iteration count and must do that many
+// operations. The count is picked so each run lasts at least min_run_ns.
+static inline const bench_result *bench_run(bench_suite *s, const char *name,
+                                            bench_fn fn, void *ctx) {
+    // Find an iteration count big enough that the clock is accurate
+    size_t iterations = 1;
+    for (;;) {
+        uint64_t start = bench_now_ns();
+        fn(ctx, iterations);
+        uint64_t took = bench_now_ns() - start;
+        if (took >= s->min_run_ns || iterations >= ((size_t)1 << 40)) break;
+        size_t scale = took > 0 ? (size_t)(s->min_run_ns / took) + 1 : 100;
+        iterations *= scale < 2 ? 2 : scale > 100 ? 100 : scale;
+    }
+
+    for (int i = 0; i < s->warmup_runs; i++) fn(ctx, iterations);
+
+    static double ns[BENCH_MAX_RUNS], cycles[BENCH_MAX_RUNS];
+    double total = 0;
+    for (int i = 0; i < s->runs; i++) {
+        uint64_t c0 = bench_cycles();
+        uint64_t t0 = bench_now_ns();
+        fn(ctx, iterations);
+        uint64_t t1 = bench_now_ns();
+        uint64_t c1 = bench_cycles();
+        ns[i] = (double)(t1 - t0) / (double)iterations;
+        cycles[i] = (double)(c1 - c0) / (double)iterations;
+        total += ns[i];
+    }
+    qsort(ns, (size_t)s->runs, sizeof(double), bench_compare_double);
+    qsort(cycles, (size_t)s->runs, sizeof(double), bench_compare_double);
+
+    bench_result r;
+    snprintf(r.name, sizeof(r.name), "%s", name);
+    r.ops_per_run = iterations;
+    r.runs = s->runs;
+    r.median_ns = bench_percentile(ns, s->runs, 0.5);
+    r.p99_ns = bench_percentile(ns, s->runs, 0.99);
+    r.min_ns = ns[0];
+    r.mean_ns = total / s->runs;
+    r.median_cycles = BENCH_HAS_TSC ? bench_percentile(cycles, s->runs, 0.5) : 0;
+    r.ops_per_sec = r.median_ns > 0 ? 1e9 / r.median_ns : 0;
+    r.rate = 0;
+    r.rate_unit = NULL;
+
+    if (!s->quiet) {
+        char median[32], p99[32];
+        printf("   %-30s %12s %12s %12.2f %14.0f\n", name,
+               bench_format_time(median, sizeof(median), r.median_ns),
+               bench_format_time(p99, sizeof(p99), r.p99_ns),
+               r.median_cycles, r.ops_per_sec);
+        fflush(stdout);
+    }
+    if (s->count < BENCH_MAX_RESULTS) s->results[s->count++] = r;
+    return s->count > 0 ? &s->results[s->count - 1] : NULL;
+}
+
+// Turn the latest result into a throughput: each operation handled
+// `per_op` units (bytes, bits, pixels...). Prints e.g. "= 12.3 GB/s".
+static inline void bench_rate(bench_suite *s, double per_op, const char *unit) {
+    if (s->count == 0) return;
+    bench_result *r = &s->results[s->count - 1];
+    r->rate = r->median_ns > 0 ? per_op * 1e9 / r->median_ns : 0;
+    r->rate_unit = unit;
+    if (s->quiet) return;
+    const char *prefix = "";
+    double value = r->rate;
+    if (value >= 1e9) { value /= 1e9; prefix = "G"; }
+    else if (value >= 1e6) { value /= 1e6; prefix = "M"; }
+    else if (value >= 1e3) { value /= 1e3; prefix = "k"; }
+    printf("   %-30s = %.2f %s%s/s\n", "", value, prefix, unit);
+}
+
+// Record a number or a string in the JSON report's "info" object
+static inline void bench_info_number(bench_suite *s, const char *key, double value) {
+    if (s->info_count >= BENCH_MAX_INFO) return;
+    bench_info_item *item = &s->info[s->info_count++];
+    snprintf(item->key, sizeof(item->key), "%s", key);
+    item->text[0] = '\0';
+    item->number = value;
+    item->is_number = 1;
+}
+
+static inline void bench_info_text(bench_suite *s, const char *key, const char *value) {
+    if (s->info_count >= BENCH_MAX_INFO) return;
+    bench_info_item *item = &s->info[s->info_count++];
+    snprintf(item->key, sizeof(item->key), "%s", key);
+    snprintf(item->text, sizeof(item->text), "%s", value);
+    item->number = 0;
+    item->is_number = 0;
+}
+
+// Find the latest result with this name (handy for "2.5x faster than ...")
+static inline const bench_result *bench_find(const bench_suite *s, const char *name) {
+    for (int i = s->count - 1; i >= 0; i--) {
+        if (strcmp(s->results[i].name, name) == 0) return &s->results[i];
+    }
+    return NULL;
+}
+
+// Print "fast is Nx faster than slow" (text mode only)
+static inline void bench_compare(const bench_suite *s, const char *slow, const char *fast) {
+    const bench_result *a = bench_find(s, slow);
+    const bench_result *b = bench_find(s, fast);
+    if (s->quiet || !a || !b) return;
+    printf("   -> %s is %.1fx faster than %s\n", fast, a->median_ns / b->median_ns, slow);
+}
+
+// Write a string with the characters JSON cares about escaped
+static inline void bench_json_string(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', out);
+        if ((unsigned char)*c >= 0x20) fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static inline void bench_write_json(const bench_suite *s, FILE *out) {
+    fprintf(out, "{\n  \"suite\": ");
+    bench_json_string(out, s->name);
+    fprintf(out, ",\n  \"runs\": %d,\n  \"warmup_runs\": %d,\n", s->runs, s->warmup_runs);
+    fprintf(out, "  \"tsc_ghz\": %.4f,\n", s->tsc_ghz);
+    if (s->info_count > 0) {
+        fprintf(out, "  \"info\": {");
+        for (int i = 0; i < s->info_count; i++) {
+            fprintf(out, "%s\n    ", i > 0 ? "," : "");
+            bench_json_string(out, s->info[i].key);
+            fprintf(out, ": ");
+            if (s->info[i].is_number) fprintf(out, "%.17g", s->info[i].number);
+            else bench_json_string(out, s->info[i].text);
+        }
+        fprintf(out, "\n  },\n");
+    }
+    fprintf(out, "  \"results\": [\n");
+    for (int i = 0; i < s->count; i++) {
+        const bench_result *r = &s->results[i];
+        fprintf(out, "    {\"name\": ");
+        bench_json_string(out, r->name);
+        fprintf(out,
+                ", \"ops_per_run\": %zu, \"median_ns\": %.4f, "
+                "\"p99_ns\": %.4f, \"min_ns\": %.4f, \"mean_ns\": %.4f, "
+                "\"median_cycles\": %.3f, \"ops_per_sec\": %.1f",
+                r->ops_per_run, r->median_ns, r->p99_ns, r->min_ns, r->mean_ns,
+                r->median_cycles, r->ops_per_sec);
+        if (r->rate_unit) {
+            fprintf(out, ", \"rate_per_sec\": %.1f, \"rate_unit\": ", r->rate);
+            bench_json_string(out, r->rate_unit);
+        }
+        fprintf(out, "}%s\n", i + 1 < s->count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+// Write the JSON report, if --json was given
+static inline void bench_finish(const bench_suite *s) {
+    if (!s->json_path) return;
+    if (strcmp(s->json_path, "-") == 0) {
+        bench_write_json(s, stdout);
+        return;
+    }
+    FILE *out = fopen(s->json_path, "w");
+    if (!out) {
+        fprintf(stderr, "bench: can't write %s\n", s->json_path);
+        return;
+    }
+    bench_write_json(s, out);
+    fclose(out);
+    if (!s->quiet) printf("\nJSON report written to %s\n", s->json_path);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // BENCH_H
@@ -0,0 +1,288 @@
+/*
+ * binfmt.h - Bulk Binary Text Formatter
+ * Turns whole buffers of 8/16/32/64-bit words into '0'/'1' text.
+ *
+ * printBinary() in 2_binary_ops.c calls printf once per bit. That is fine
+ * for one number, but far too slow for a whole packet header or register
+ * dump. This header converts 8 bytes at a time and picks the fastest
+ * kernel the CPU supports (AVX2, SSE2 or plain C) when the program runs.
+ *
+ * Header-only: just #include "binfmt.h" (works from C and C++).
+ *
+ *   binfmt_options opt = { 16, 4, '_', ' ' };
+ *   char out[256];
+ *   size_t len = binfmt_format(out, words, 3, &opt);
+ *   // "0000_0000_0000_0101 0000_0000_0000_0011 ..."
+ */
+
+#ifndef BINFMT_H
+#define BINFMT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BINFMT_X86 1
+#else
+#define BINFMT_X86 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 8-byte chunks converted per pass when separators are being added
+#define BINFMT_BATCH 32
+
+// Which conversion kernel is doing the work
+typedef enum {
+    BINFMT_SCALAR = 0,
+    BINFMT_SSE2 = 1,
+    BINFMT_AVX2 = 2
+} binfmt_kernel;
+
+// How the text should look
+typedef struct {
+    int width;       // bits per word: 8, 16, 32 or 64
+    int group;       // put group_sep every `group` bits inside a word (0 = never)
+    char group_sep;  // e.g. '_' or ' '
+    char word_sep;   // written between words (0 = nothing)
+} binfmt_options;
+
+// Pure C: spread the 8 bits of a byte into 8 ASCII digits, MSB first
+static inline uint64_t binfmt_byte_digits(unsigned b) {
+    uint64_t bits = ((b * 0x8040201008040201ULL) >> 7) & 0x0101010101010101ULL;
+    return bits | 0x3030303030303030ULL;  // 0x30 is '0'
+}
+
+// Little-endian words keep their most significant byte last in memory,
+// but we print it first. Flip the bytes of each word inside a 64-bit chunk.
+static inline uint64_t binfmt_display_order(uint64_t chunk, int width) {
+    switch (width) {
+    case 16:
+        return ((chunk & 0x00FF00FF00FF00FFULL) << 8) |
+               ((chunk >> 8) & 0x00FF00FF00FF00FFULL);
+    case 32: {
+        uint64_t swapped = __builtin_bswap64(chunk);
+        return (swapped << 32) | (swapped >> 32);
+    }
+    case 64:
+        return __builtin_bswap64(chunk);
+    default:
+        return chunk;
+    }
+}
+
+static inline void binfmt_chunk_scalar(char *dst, const uint8_t *src,
+                                       size_t chunks, int width) {
+    for (size_t c = 0; c < chunks; c++) {
+        uint64_t chunk;
+        memcpy(&chunk, src + c * 8, 8);
+        chunk = binfmt_display_order(chunk, width);
+        for (int i = 0; i < 8; i++) {
+            uint64_t digits = binfmt_byte_digits((unsigned)(chunk >> (8 * i)) & 0xFF);
+            memcpy(dst + c * 64 + i * 8, &digits, 8);
+        }
+    }
+}
+
+#if BINFMT_X86
+
+// SSE2 has no byte shuffle, so each byte is copied 8 times with the
+// unpack instructions, then tested against the masks 0x80, 0x40 ... 0x01.
+__attribute__((target("sse2")))
+static inline void binfmt_chunk_sse2(char *dst, const uint8_t *src,
+                                     size_t chunks, int width) {
+    const __m128i masks = _mm_set1_epi64x((long long)0x0102040810204080ULL);
+    const __m128i zero = _mm_set1_epi8('0');
+    for (size_t c = 0; c < chunks; c++) {
+        uint64_t chunk;
+        memcpy(&chunk, src + c * 8, 8);
+        chunk = binfmt_display_order(chunk, width);
+
+        __m128i v = _mm_loadl_epi64((const __m128i *)&chunk);
+        v = _mm_unpacklo_epi8(v, v);                    // b0 b0 b1 b1 ...
+        __m128i lo = _mm_unpacklo_epi16(v, v);          // b0 x4 ... b3 x4
+        __m128i hi = _mm_unpackhi_epi16(v, v);          // b4 x4 ... b7 x4
+        __m128i parts[4] = {
+            _mm_unpacklo_epi32(lo, lo), _mm_unpackhi_epi32(lo, lo),
+            _mm_unpacklo_epi32(hi, hi), _mm_unpackhi_epi32(hi, hi)
+        };
+        for (int i = 0; i < 4; i++) {
+            // bit set -> compare gives -1 -> '0' - (-1) = '1'
+            __m128i set = _mm_cmpeq_epi8(_mm_and_si128(parts[i], masks), masks);
+            _mm_storeu_si128((__m128i *)(dst + c * 64 + i * 16),
+                             _mm_sub_epi8(zero, set));
+        }
+    }
+}
+
+// AVX2 can shuffle bytes, so the byte order fix-up is folded into the
+// shuffle that copies each byte 8 times.
+__attribute__((target("avx2")))
+static inline void binfmt_chunk_avx2(char *dst, const uint8_t *src,
+                                     size_t chunks, int width) {
+    // Which input byte fills each 8-lane group: the first 4 printed
+    // bytes (lo) and the last 4 (hi), for 8/16/32/64-bit words
+    static const uint8_t order[4][2][4] = {
+        {{0, 1, 2, 3}, {4, 5, 6, 7}},
+        {{1, 0, 3, 2}, {5, 4, 7, 6}},
+        {{3, 2, 1, 0}, {7, 6, 5, 4}},
+        {{7, 6, 5, 4}, {3, 2, 1, 0}}
+    };
+    int w = width == 16 ? 1 : width == 32 ? 2 : width == 64 ? 3 : 0;
+    const __m256i spread = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+        2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    uint32_t lo_order, hi_order;
+    memcpy(&lo_order, order[w][0], 4);
+    memcpy(&hi_order, order[w][1], 4);
+    const __m256i shuf_lo = _mm256_shuffle_epi8(_mm256_set1_epi32((int)lo_order), spread);
+    const __m256i shuf_hi = _mm256_shuffle_epi8(_mm256_set1_epi32((int)hi_order), spread);
+    const __m256i masks = _mm256_set1_epi64x((long long)0x0102040810204080ULL);
+    const __m256i zero = _mm256_set1_epi8('0');
+
+    for (size_t c = 0; c < chunks; c++) {
+        long long chunk;
+        memcpy(&chunk, src + c * 8, 8);
+        __m256i v = _mm256_set1_epi64x(chunk);
+        __m256i lo = _mm256_shuffle_epi8(v, shuf_lo);
+        __m256i hi = _mm256_shuffle_epi8(v, shuf_hi);
+        lo = _mm256_sub_epi8(zero, _mm256_cmpeq_epi8(_mm256_and_si256(lo, masks), masks));
+        hi = _mm256_sub_epi8(zero, _mm256_cmpeq_epi8(_mm256_and_si256(hi, masks), masks));
+        _mm256_storeu_si256((__m256i *)(dst + c * 64), lo);
+        _mm256_storeu_si256((__m256i *)(dst + c * 64 + 32), hi);
+    }
+}
+
+#endif  // BINFMT_X86
+
+// Best kernel this CPU can run
+static inline binfmt_kernel binfmt_detect(void) {
+#if BINFMT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return BINFMT_AVX2;
+    if (__builtin_cpu_supports("sse2")) return BINFMT_SSE2;
+#endif
+    return BINFMT_SCALAR;
+}
+
+static inline const char *binfmt_kernel_name(binfmt_kernel k) {
+    switch (k) {
+    case BINFMT_AVX2: return "avx2";
+    case BINFMT_SSE2: return "sse2";
+    default:          return "scalar";
+    }
+}
+
+// Convert `chunks` blocks of 8 bytes (64 digits each) with kernel `k`
+static inline void binfmt_chunks(binfmt_kernel k, char *dst, const uint8_t *src,
+                                 size_t chunks, int width) {
+#if BINFMT_X86
+    if (k == BINFMT_AVX2) { binfmt_chunk_avx2(dst, src, chunks, width); return; }
+    if (k == BINFMT_SSE2) { binfmt_chunk_sse2(dst, src, chunks, width); return; }
+#endif
+    (void)k;
+    binfmt_chunk_scalar(dst, src, chunks, width);
+}
+
+// Number of characters binfmt_format() will write (no '\0' is added)
+static inline size_t binfmt_size(size_t count, const binfmt_options *opt) {
+    if (count == 0) return 0;
+    size_t per_word = (size_t)opt->width;
+    if (opt->group > 0 && opt->group < opt->width) {
+        per_word += (size_t)((opt->width - 1) / opt->group);
+    }
+    size_t seps = opt->word_sep ? count - 1 : 0;
+    return count * per_word + seps;
+}
+
+// Copy one word's digits to dst, adding the separators asked for
+static inline char *binfmt_emit_word(char *dst, const char *digits,
+                                     const binfmt_options *opt) {
+    int width = opt->width;
+    int group = opt->group;
+    if (group <= 0 || group >= width) {
+        // Fixed-size copies compile to plain loads and stores
+        switch (width) {
+        case 8:  memcpy(dst, digits, 8);  break;
+        case 16: memcpy(dst, digits, 16); break;
+        case 32: memcpy(dst, digits, 32); break;
+        default: memcpy(dst, digits, 64); break;
+        }
+        return dst + width;
+    }
+    // Groups are counted from the right, like 1_0000_0000
+    int first = width % group ? width % group : group;
+    memcpy(dst, digits, (size_t)first);
+    dst += first;
+    for (int i = first; i < width; i += group) {
+        *dst++ = opt->group_sep;
+        memcpy(dst, digits + i, (size_t)group);
+        dst += group;
+    }
+    return dst;
+}
+
+// Format with a chosen kernel (handy for benchmarks and testing)
+static inline size_t binfmt_format_with(binfmt_kernel k, char *dst, const void *src,
+                                        size_t count, const binfmt_options *opt) {
+    const uint8_t *in = (const uint8_t *)src;
+    int width = opt->width;
+    size_t word_bytes = (size_t)width / 8;
+    size_t total = count * word_bytes;
+    size_t chunks = total / 8;
+    int plain = (opt->group <= 0 || opt->group >= width) && !opt->word_sep;
+    char *out = dst;
+
+    if (plain) {
+        // No separators: digits go straight into the output
+        binfmt_chunks(k, out, in, chunks, width);
+        out += chunks * 64;
+    } else {
+        // Separators: convert a batch into scratch space, then spread it out
+        size_t words_per_chunk = 8 / word_bytes;
+        char block[BINFMT_BATCH * 64];
+        for (size_t c = 0; c < chunks; c += BINFMT_BATCH) {
+            size_t batch = chunks - c < BINFMT_BATCH ? chunks - c : BINFMT_BATCH;
+            binfmt_chunks(k, block, in + c * 8, batch, width);
+            for (size_t w = 0; w < batch * words_per_chunk; w++) {
+                if (out != dst && opt->word_sep) *out++ = opt->word_sep;
+                out = binfmt_emit_word(out, block + w * (size_t)width, opt);
+            }
+        }
+    }
+
+    // Leftover words (less than 8 bytes) go one at a time
+    for (size_t pos = chunks * 8; pos < total; pos += word_bytes) {
+        uint64_t chunk = 0;
+        memcpy(&chunk, in + pos, word_bytes);
+        chunk = binfmt_display_order(chunk, width);
+        char digits[64];
+        for (size_t i = 0; i < word_bytes; i++) {
+            uint64_t d = binfmt_byte_digits((unsigned)(chunk >> (8 * i)) & 0xFF);
+            memcpy(digits + i * 8, &d, 8);
+        }
+        if (out != dst && opt->word_sep) *out++ = opt->word_sep;
+        out = binfmt_emit_word(out, digits, opt);
+    }
+    return (size_t)(out - dst);
+}
+
+// Format `count` words from src into dst, using the fastest kernel.
+// dst must have room for binfmt_size(count, opt) characters.
+// Returns the number of characters written.
+static inline size_t binfmt_format(char *dst, const void *src, size_t count,
+                                   const binfmt_options *opt) {
+    static binfmt_kernel kernel = (binfmt_kernel)-1;
+    if (kernel == (binfmt_kernel)-1) kernel = binfmt_detect();
+    return binfmt_format_with(kernel, dst, src, count, opt);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // BINFMT_H
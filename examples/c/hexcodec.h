@@ -0,0 +1,340 @@
+/*
+ * hexcodec.h - Fast Hex Encode/Decode
+ * Turns bytes into hex text and back again, for buffers of any size.
+ *
+ * 2_binary_ops.c prints one color with printf("0x%06X"). That's perfect
+ * for one value, but a multi-megabyte blob needs something faster. This
+ * header handles 16 or 32 bytes per step with SSE2/AVX2 (chosen when the
+ * program runs) and checks every character when decoding.
+ *
+ * Header-only: just #include "hexcodec.h" (works from C and C++).
+ *
+ *   char text[2 * 3];
+ *   hex_encode(text, "\xFF\x64\x96", 3, 1);      // "FF6496"
+ *
+ *   uint8_t bytes[3];
+ *   size_t bad;
+ *   if (hex_decode(bytes, "ff6496", 6, &bad) != HEX_OK) ...
+ */
+
+#ifndef HEXCODEC_H
+#define HEXCODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HEX_X86 1
+#else
+#define HEX_X86 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Which kernel is doing the work
+typedef enum {
+    HEX_SCALAR = 0,
+    HEX_SSE2 = 1,
+    HEX_AVX2 = 2
+} hex_kernel;
+
+// What hex_decode() found
+typedef enum {
+    HEX_OK = 0,
+    HEX_ODD_LENGTH = 1,  // hex digits always come in pairs
+    HEX_BAD_CHAR = 2     // something that isn't 0-9, a-f or A-F
+} hex_status;
+
+static const char hex_lower_digits[] = "0123456789abcdef";
+static const char hex_upper_digits[] = "0123456789ABCDEF";
+
+// Value of every possible character as a hex digit (-1 = not a digit)
+static const int8_t hex_values[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+// Value of one hex digit, or -1 if it isn't one
+static inline int hex_digit_value(unsigned char c) {
+    return hex_values[c];
+}
+
+static inline void hex_encode_scalar(char *dst, const uint8_t *src, size_t len, int upper) {
+    const char *digits = upper ? hex_upper_digits : hex_lower_digits;
+    for (size_t i = 0; i < len; i++) {
+        dst[2 * i] = digits[src[i] >> 4];
+        dst[2 * i + 1] = digits[src[i] & 0x0F];
+    }
+}
+
+// Decodes pairs until it hits a bad character; returns its position or len
+static inline size_t hex_decode_scalar(uint8_t *dst, const char *src, size_t len) {
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        int hi = hex_digit_value((unsigned char)src[i]);
+        int lo = hex_digit_value((unsigned char)src[i + 1]);
+        if ((hi | lo) < 0) return hi < 0 ? i : i + 1;
+        dst[i / 2] = (uint8_t)(hi << 4 | lo);
+    }
+    return len;
+}
+
+#if HEX_X86
+
+// SSE2 has no table lookup, so nibbles become digits with a compare:
+// '0' + n, plus a jump up to the letters when n > 9.
+__attribute__((target("sse2")))
+static inline size_t hex_encode_sse2(char *dst, const uint8_t *src, size_t len, int upper) {
+    const __m128i low_mask = _mm_set1_epi8(0x0F);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i letters = _mm_set1_epi8((char)((upper ? 'A' : 'a') - '0' - 10));
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low_mask);
+        __m128i lo = _mm_and_si128(v, low_mask);
+        hi = _mm_add_epi8(_mm_add_epi8(hi, zero),
+                          _mm_and_si128(_mm_cmpgt_epi8(hi, nine), letters));
+        lo = _mm_add_epi8(_mm_add_epi8(lo, zero),
+                          _mm_and_si128(_mm_cmpgt_epi8(lo, nine), letters));
+        // Interleave so each byte's high digit comes first
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return i;
+}
+
+// Turn 16 hex characters into 16 nibble values, plus a mask of bad ones
+__attribute__((target("sse2")))
+static inline __m128i hex_nibbles_sse2(__m128i c, __m128i *bad) {
+    __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(digit, _mm_set1_epi8(-1)),
+                                     _mm_cmpgt_epi8(_mm_set1_epi8(10), digit));
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(letter, _mm_set1_epi8(-1)),
+                                      _mm_cmpgt_epi8(_mm_set1_epi8(6), letter));
+    *bad = _mm_or_si128(*bad, _mm_cmpeq_epi8(_mm_or_si128(is_digit, is_letter),
+                                             _mm_setzero_si128()));
+    return _mm_or_si128(_mm_and_si128(is_digit, digit),
+                        _mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+// Decodes 32 characters per step; stops before the first block with a
+// bad character so the scalar code can report exactly where it is
+__attribute__((target("sse2")))
+static inline size_t hex_decode_sse2(uint8_t *dst, const char *src, size_t len) {
+    const __m128i low_byte = _mm_set1_epi16(0x00FF);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m128i bad = _mm_setzero_si128();
+        __m128i a = hex_nibbles_sse2(_mm_loadu_si128((const __m128i *)(src + i)), &bad);
+        __m128i b = hex_nibbles_sse2(_mm_loadu_si128((const __m128i *)(src + i + 16)), &bad);
+        if (_mm_movemask_epi8(bad)) break;
+        // Pairs of nibbles (hi, lo) -> hi * 16 + lo
+        a = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(a, low_byte), 4), _mm_srli_epi16(a, 8));
+        b = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(b, low_byte), 4), _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i *)(dst + i / 2), _mm_packus_epi16(a, b));
+    }
+    return i;
+}
+
+// AVX2 looks nibbles up in a 16-entry table with one shuffle
+__attribute__((target("avx2")))
+static inline size_t hex_encode_avx2(char *dst, const uint8_t *src, size_t len, int upper) {
+    const char *digits = upper ? hex_upper_digits : hex_lower_digits;
+    const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)digits));
+    const __m256i low_mask = _mm256_set1_epi8(0x0F);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask));
+        __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low_mask));
+        __m256i first = _mm256_unpacklo_epi8(hi, lo);   // bytes 0-7 | 16-23
+        __m256i second = _mm256_unpackhi_epi8(hi, lo);  // bytes 8-15 | 24-31
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i hex_nibbles_avx2(__m256i c, __m256i *bad) {
+    __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+    *bad = _mm256_or_si256(*bad, _mm256_cmpeq_epi8(_mm256_or_si256(is_digit, is_letter),
+                                                   _mm256_setzero_si256()));
+    return _mm256_blendv_epi8(_mm256_add_epi8(letter, _mm256_set1_epi8(10)), digit, is_digit);
+}
+
+__attribute__((target("avx2")))
+static inline size_t hex_decode_avx2(uint8_t *dst, const char *src, size_t len) {
+    // maddubs multiplies each (hi, lo) pair by (16, 1) and adds them
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i bad = _mm256_setzero_si256();
+        __m256i a = hex_nibbles_avx2(_mm256_loadu_si256((const __m256i *)(src + i)), &bad);
+        __m256i b = hex_nibbles_avx2(_mm256_loadu_si256((const __m256i *)(src + i + 32)), &bad);
+        if (!_mm256_testz_si256(bad, bad)) break;
+        a = _mm256_maddubs_epi16(a, weights);
+        b = _mm256_maddubs_epi16(b, weights);
+        // packus works per 128-bit lane, so put the lanes back in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *)(dst + i / 2), packed);
+    }
+    return i;
+}
+
+#endif  // HEX_X86
+
+// Best kernel this CPU can run
+static inline hex_kernel hex_detect(void) {
+#if HEX_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return HEX_AVX2;
+    if (__builtin_cpu_supports("sse2")) return HEX_SSE2;
+#endif
+    return HEX_SCALAR;
+}
+
+static inline const char *hex_kernel_name(hex_kernel k) {
+    switch (k) {
+    case HEX_AVX2: return "avx2";
+    case HEX_SSE2: return "sse2";
+    default:       return "scalar";
+    }
+}
+
+static inline hex_kernel hex_best_kernel(void) {
+    static hex_kernel kernel = (hex_kernel)-1;
+    if (kernel == (hex_kernel)-1) kernel = hex_detect();
+    return kernel;
+}
+
+// Encode len bytes as 2 * len hex characters (no '\0' is added)
+static inline void hex_encode_with(hex_kernel k, char *dst, const void *src,
+                                   size_t len, int upper) {
+    const uint8_t *in = (const uint8_t *)src;
+    size_t done = 0;
+#if HEX_X86
+    if (k == HEX_AVX2) done = hex_encode_avx2(dst, in, len, upper);
+    else if (k == HEX_SSE2) done = hex_encode_sse2(dst, in, len, upper);
+#endif
+    (void)k;
+    hex_encode_scalar(dst + 2 * done, in + done, len - done, upper);
+}
+
+static inline void hex_encode(char *dst, const void *src, size_t len, int upper) {
+    hex_encode_with(hex_best_kernel(), dst, src, len, upper);
+}
+
+// Decode len hex characters (upper or lower case) into len / 2 bytes.
+// On HEX_BAD_CHAR, *bad_pos (if given) is the index of the first bad
+// character; on HEX_ODD_LENGTH it is len.
+static inline hex_status hex_decode_with(hex_kernel k, void *dst, const char *src,
+                                         size_t len, size_t *bad_pos) {
+    uint8_t *out = (uint8_t *)dst;
+    size_t done = 0;
+#if HEX_X86
+    if (k == HEX_AVX2) done = hex_decode_avx2(out, src, len);
+    else if (k == HEX_SSE2) done = hex_decode_sse2(out, src, len);
+#endif
+    (void)k;
+    size_t stop = done + hex_decode_scalar(out + done / 2, src + done, len - done);
+    if (stop < len) {
+        if (bad_pos) *bad_pos = stop;
+        return HEX_BAD_CHAR;
+    }
+    if (len % 2 != 0) {
+        // The pair loop never looked at the last character
+        int last_ok = hex_digit_value((unsigned char)src[len - 1]) >= 0;
+        if (bad_pos) *bad_pos = last_ok ? len : len - 1;
+        return last_ok ? HEX_ODD_LENGTH : HEX_BAD_CHAR;
+    }
+    return HEX_OK;
+}
+
+static inline hex_status hex_decode(void *dst, const char *src, size_t len, size_t *bad_pos) {
+    return hex_decode_with(hex_best_kernel(), dst, src, len, bad_pos);
+}
+
+// ----------------------------------------------------------------------
+// xxd-style dump:
+// 00000000: 4865 6c6c 6f2c 2077 6f72 6c64 210a       Hello, world!.
+// ----------------------------------------------------------------------
+
+#define HEX_DUMP_LINE 68  // characters in a full 16-byte line, with '\n'
+
+// Characters hex_dump() will write for len bytes (no '\0' is added)
+static inline size_t hex_dump_size(size_t len) {
+    size_t rest = len % 16;
+    return (len / 16) * HEX_DUMP_LINE + (rest ? HEX_DUMP_LINE - 16 + rest : 0);
+}
+
+// Write an xxd-style dump of src into dst. `offset` is the address shown
+// for the first byte. Returns the number of characters written.
+static inline size_t hex_dump(char *dst, const void *src, size_t len, uint64_t offset) {
+    const uint8_t *in = (const uint8_t *)src;
+    hex_kernel k = hex_best_kernel();
+    char *out = dst;
+    char hex[32 * 64];  // a batch of 64 lines, encoded in one go
+
+    for (size_t base = 0; base < len; base += 16 * 64) {
+        size_t batch = len - base < 16 * 64 ? len - base : 16 * 64;
+        hex_encode_with(k, hex, in + base, batch, 0);
+
+        for (size_t line = 0; line < batch; line += 16) {
+            size_t n = batch - line < 16 ? batch - line : 16;
+            uint64_t addr = offset + base + line;
+            for (int d = 7; d >= 0; d--) *out++ = hex_lower_digits[(addr >> (4 * d)) & 0xF];
+            *out++ = ':';
+
+            // Eight groups of four digits; missing bytes become spaces
+            const char *digits = hex + 2 * line;
+            for (size_t g = 0; g < 8; g++) {
+                *out++ = ' ';
+                if (2 * g + 2 <= n) {
+                    memcpy(out, digits + 4 * g, 4);
+                } else {
+                    memset(out, ' ', 4);
+                    if (2 * g < n) memcpy(out, digits + 4 * g, 2);
+                }
+                out += 4;
+            }
+            *out++ = ' ';
+            *out++ = ' ';
+            for (size_t i = 0; i < n; i++) {
+                uint8_t c = in[base + line + i];
+                *out++ = (c >= 0x20 && c < 0x7F) ? (char)c : '.';
+            }
+            *out++ = '\n';
+        }
+    }
+    return (size_t)(out - dst);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HEXCODEC_H
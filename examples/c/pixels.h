@@ -0,0 +1,412 @@
+/*
+ * pixels.h - Whole-Image Color Channel Conversion
+ * The "color manipulation" example from 2_binary_ops.c, for millions
+ * of pixels at once.
+ *
+ * 2_binary_ops.c takes one color apart with shifts and masks:
+ *     red = (color >> 16) & 0xFF;  green = (color >> 8) & 0xFF;  ...
+ * A 4K frame has 8 million colors. This header converts whole arrays
+ * of packed 0xAARRGGBB pixels into separate R, G, B and A arrays
+ * ("planes") and back, 16 or 32 pixels per step with SSSE3/AVX2
+ * byte shuffles (chosen when the program runs).
+ *
+ * Header-only: just #include "pixels.h" (works from C and C++).
+ *
+ *   uint32_t image[N];              // 0xAARRGGBB (or 0x00RRGGBB)
+ *   uint8_t r[N], g[N], b[N], a[N];
+ *   pixels_unpack(image, N, r, g, b, a);     // a may be NULL
+ *   pixels_pack(image, N, r, g, b, NULL);    // NULL: alpha byte = 0
+ *   pixels_premultiply(image, image, N);     // r = r * a / 255, ...
+ *   pixels_grayscale(gray, image, N);        // one brightness byte each
+ *
+ * Planes ("structure of arrays") are what SIMD code and most image
+ * formats want: all the reds next to each other, then all the greens.
+ */
+
+#ifndef PIXELS_H
+#define PIXELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PIXELS_X86 1
+#else
+#define PIXELS_X86 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Which kernel is doing the work
+typedef enum {
+    PIXELS_SCALAR = 0,
+    PIXELS_SSSE3 = 1,
+    PIXELS_AVX2 = 2
+} pixels_kernel;
+
+// Grayscale weights (ITU-R BT.601) in 1/256ths: they add up to 256,
+// so white stays exactly 255
+#define PIXELS_GRAY_R 77
+#define PIXELS_GRAY_G 150
+#define PIXELS_GRAY_B 29
+
+// x * a / 255, rounded to nearest, for any two bytes - without dividing
+static inline uint32_t pixels_mul255(uint32_t x, uint32_t a) {
+    uint32_t t = x * a + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// ----------------------------------------------------------------------
+// Scalar versions: exactly the shifts and masks from 2_binary_ops.c
+// ----------------------------------------------------------------------
+
+static inline void pixels_unpack_scalar(const uint32_t *src, size_t n, uint8_t *r,
+                                        uint8_t *g, uint8_t *b, uint8_t *a) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t color = src[i];
+        r[i] = (uint8_t)((color >> 16) & 0xFF);
+        g[i] = (uint8_t)((color >> 8) & 0xFF);
+        b[i] = (uint8_t)(color & 0xFF);
+        if (a) a[i] = (uint8_t)(color >> 24);
+    }
+}
+
+static inline void pixels_pack_scalar(uint32_t *dst, size_t n, const uint8_t *r,
+                                      const uint8_t *g, const uint8_t *b, const uint8_t *a) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t alpha = a ? a[i] : 0;
+        dst[i] = (alpha << 24) | ((uint32_t)r[i] << 16) | ((uint32_t)g[i] << 8) | b[i];
+    }
+}
+
+static inline void pixels_premultiply_scalar(uint32_t *dst, const uint32_t *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t color = src[i], alpha = color >> 24;
+        uint32_t red = pixels_mul255((color >> 16) & 0xFF, alpha);
+        uint32_t green = pixels_mul255((color >> 8) & 0xFF, alpha);
+        uint32_t blue = pixels_mul255(color & 0xFF, alpha);
+        dst[i] = (alpha << 24) | (red << 16) | (green << 8) | blue;
+    }
+}
+
+static inline void pixels_grayscale_scalar(uint8_t *dst, const uint32_t *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        uint32_t color = src[i];
+        dst[i] = (uint8_t)((PIXELS_GRAY_R * ((color >> 16) & 0xFF) +
+                            PIXELS_GRAY_G * ((color >> 8) & 0xFF) +
+                            PIXELS_GRAY_B * (color & 0xFF) + 128) >> 8);
+    }
+}
+
+#if PIXELS_X86
+
+// In memory a little-endian 0xAARRGGBB pixel is the bytes B, G, R, A.
+// This shuffle groups 4 pixels as BBBB GGGG RRRR AAAA.
+#define PIXELS_GROUP_CHANNELS 0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15
+
+// 16 pixels per step: 4 shuffles, then a 4x4 transpose of 32-bit groups
+__attribute__((target("ssse3")))
+static inline size_t pixels_unpack_ssse3(const uint32_t *src, size_t n, uint8_t *r,
+                                         uint8_t *g, uint8_t *b, uint8_t *a) {
+    const __m128i group = _mm_setr_epi8(PIXELS_GROUP_CHANNELS);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i *in = (const __m128i *)(src + i);
+        __m128i v0 = _mm_shuffle_epi8(_mm_loadu_si128(in + 0), group);
+        __m128i v1 = _mm_shuffle_epi8(_mm_loadu_si128(in + 1), group);
+        __m128i v2 = _mm_shuffle_epi8(_mm_loadu_si128(in + 2), group);
+        __m128i v3 = _mm_shuffle_epi8(_mm_loadu_si128(in + 3), group);
+        __m128i bg01 = _mm_unpacklo_epi32(v0, v1), ra01 = _mm_unpackhi_epi32(v0, v1);
+        __m128i bg23 = _mm_unpacklo_epi32(v2, v3), ra23 = _mm_unpackhi_epi32(v2, v3);
+        _mm_storeu_si128((__m128i *)(b + i), _mm_unpacklo_epi64(bg01, bg23));
+        _mm_storeu_si128((__m128i *)(g + i), _mm_unpackhi_epi64(bg01, bg23));
+        _mm_storeu_si128((__m128i *)(r + i), _mm_unpacklo_epi64(ra01, ra23));
+        if (a) _mm_storeu_si128((__m128i *)(a + i), _mm_unpackhi_epi64(ra01, ra23));
+    }
+    return i;
+}
+
+// Packing is the reverse: interleave B with G and R with A, then the pairs
+__attribute__((target("ssse3")))
+static inline size_t pixels_pack_ssse3(uint32_t *dst, size_t n, const uint8_t *r,
+                                       const uint8_t *g, const uint8_t *b, const uint8_t *a) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i vg = _mm_loadu_si128((const __m128i *)(g + i));
+        __m128i vr = _mm_loadu_si128((const __m128i *)(r + i));
+        __m128i va = a ? _mm_loadu_si128((const __m128i *)(a + i)) : _mm_setzero_si128();
+        __m128i bg_lo = _mm_unpacklo_epi8(vb, vg), bg_hi = _mm_unpackhi_epi8(vb, vg);
+        __m128i ra_lo = _mm_unpacklo_epi8(vr, va), ra_hi = _mm_unpackhi_epi8(vr, va);
+        __m128i *out = (__m128i *)(dst + i);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(bg_lo, ra_lo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bg_lo, ra_lo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(bg_hi, ra_hi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(bg_hi, ra_hi));
+    }
+    return i;
+}
+
+// Two pixels widened to 16 bits per channel: B G R A B G R A.
+// Each channel is multiplied by its pixel's alpha; alpha by 255.
+__attribute__((target("ssse3")))
+static inline __m128i pixels_premultiply16_ssse3(__m128i c) {
+    const __m128i alpha_spread = _mm_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1,
+                                               14, 15, 14, 15, 14, 15, -1, -1);
+    const __m128i keep_alpha = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+    __m128i alpha = _mm_or_si128(_mm_shuffle_epi8(c, alpha_spread), keep_alpha);
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(c, alpha), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("ssse3")))
+static inline size_t pixels_premultiply_ssse3(uint32_t *dst, const uint32_t *src, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = pixels_premultiply16_ssse3(_mm_unpacklo_epi8(v, zero));
+        __m128i hi = pixels_premultiply16_ssse3(_mm_unpackhi_epi8(v, zero));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+// Split each pixel into 16-bit (B, R) and (G, A) pairs, then one
+// multiply-add per pair gives 77*R + 150*G + 29*B as a 32-bit number
+__attribute__((target("ssse3")))
+static inline __m128i pixels_luma32_ssse3(__m128i v) {
+    const __m128i low_bytes = _mm_set1_epi32(0x00FF00FF);
+    const __m128i weights_br = _mm_set1_epi32((PIXELS_GRAY_R << 16) | PIXELS_GRAY_B);
+    const __m128i weights_ga = _mm_set1_epi32(PIXELS_GRAY_G);
+    __m128i br = _mm_and_si128(v, low_bytes);
+    __m128i ga = _mm_and_si128(_mm_srli_epi16(v, 8), low_bytes);
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(br, weights_br), _mm_madd_epi16(ga, weights_ga));
+    return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+}
+
+__attribute__((target("ssse3")))
+static inline size_t pixels_grayscale_ssse3(uint8_t *dst, const uint32_t *src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i *in = (const __m128i *)(src + i);
+        __m128i y0 = pixels_luma32_ssse3(_mm_loadu_si128(in + 0));
+        __m128i y1 = pixels_luma32_ssse3(_mm_loadu_si128(in + 1));
+        __m128i y2 = pixels_luma32_ssse3(_mm_loadu_si128(in + 2));
+        __m128i y3 = pixels_luma32_ssse3(_mm_loadu_si128(in + 3));
+        __m128i y = _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_packs_epi32(y2, y3));
+        _mm_storeu_si128((__m128i *)(dst + i), y);
+    }
+    return i;
+}
+
+// AVX2 shuffles stay inside each 128-bit half, so after grouping the
+// channels a cross-lane permute puts 8 pixels' worth of each channel
+// into one 64-bit quarter: [BBBBBBBB GGGGGGGG RRRRRRRR AAAAAAAA].
+__attribute__((target("avx2")))
+static inline size_t pixels_unpack_avx2(const uint32_t *src, size_t n, uint8_t *r,
+                                        uint8_t *g, uint8_t *b, uint8_t *a) {
+    const __m256i group = _mm256_setr_epi8(PIXELS_GROUP_CHANNELS, PIXELS_GROUP_CHANNELS);
+    const __m256i halves = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i *in = (const __m256i *)(src + i);
+        __m256i v[4];
+        for (int k = 0; k < 4; k++) {
+            v[k] = _mm256_shuffle_epi8(_mm256_loadu_si256(in + k), group);
+            v[k] = _mm256_permutevar8x32_epi32(v[k], halves);
+        }
+        // 4x4 transpose of 64-bit quarters
+        __m256i br01 = _mm256_unpacklo_epi64(v[0], v[1]), ga01 = _mm256_unpackhi_epi64(v[0], v[1]);
+        __m256i br23 = _mm256_unpacklo_epi64(v[2], v[3]), ga23 = _mm256_unpackhi_epi64(v[2], v[3]);
+        _mm256_storeu_si256((__m256i *)(b + i), _mm256_permute2x128_si256(br01, br23, 0x20));
+        _mm256_storeu_si256((__m256i *)(r + i), _mm256_permute2x128_si256(br01, br23, 0x31));
+        _mm256_storeu_si256((__m256i *)(g + i), _mm256_permute2x128_si256(ga01, ga23, 0x20));
+        if (a) _mm256_storeu_si256((__m256i *)(a + i), _mm256_permute2x128_si256(ga01, ga23, 0x31));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline size_t pixels_pack_avx2(uint32_t *dst, size_t n, const uint8_t *r,
+                                      const uint8_t *g, const uint8_t *b, const uint8_t *a) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i vg = _mm256_loadu_si256((const __m256i *)(g + i));
+        __m256i vr = _mm256_loadu_si256((const __m256i *)(r + i));
+        __m256i va = a ? _mm256_loadu_si256((const __m256i *)(a + i)) : _mm256_setzero_si256();
+        __m256i bg_lo = _mm256_unpacklo_epi8(vb, vg), bg_hi = _mm256_unpackhi_epi8(vb, vg);
+        __m256i ra_lo = _mm256_unpacklo_epi8(vr, va), ra_hi = _mm256_unpackhi_epi8(vr, va);
+        // Each half holds pixels from both 16-pixel halves of the input
+        __m256i p0 = _mm256_unpacklo_epi16(bg_lo, ra_lo);  // 0-3   | 16-19
+        __m256i p1 = _mm256_unpackhi_epi16(bg_lo, ra_lo);  // 4-7   | 20-23
+        __m256i p2 = _mm256_unpacklo_epi16(bg_hi, ra_hi);  // 8-11  | 24-27
+        __m256i p3 = _mm256_unpackhi_epi16(bg_hi, ra_hi);  // 12-15 | 28-31
+        __m256i *out = (__m256i *)(dst + i);
+        _mm256_storeu_si256(out + 0, _mm256_permute2x128_si256(p0, p1, 0x20));
+        _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(p2, p3, 0x20));
+        _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(p0, p1, 0x31));
+        _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(p2, p3, 0x31));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i pixels_premultiply16_avx2(__m256i c) {
+    const __m256i alpha_spread = _mm256_setr_epi8(6, 7, 6, 7, 6, 7, -1, -1,
+                                                  14, 15, 14, 15, 14, 15, -1, -1,
+                                                  6, 7, 6, 7, 6, 7, -1, -1,
+                                                  14, 15, 14, 15, 14, 15, -1, -1);
+    const __m256i keep_alpha = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255,
+                                                 0, 0, 0, 255, 0, 0, 0, 255);
+    __m256i alpha = _mm256_or_si256(_mm256_shuffle_epi8(c, alpha_spread), keep_alpha);
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(c, alpha), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+// Widening and narrowing both work per 128-bit half, so they cancel out
+__attribute__((target("avx2")))
+static inline size_t pixels_premultiply_avx2(uint32_t *dst, const uint32_t *src, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i lo = pixels_premultiply16_avx2(_mm256_unpacklo_epi8(v, zero));
+        __m256i hi = pixels_premultiply16_avx2(_mm256_unpackhi_epi8(v, zero));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_packus_epi16(lo, hi));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i pixels_luma32_avx2(__m256i v) {
+    const __m256i low_bytes = _mm256_set1_epi32(0x00FF00FF);
+    const __m256i weights_br = _mm256_set1_epi32((PIXELS_GRAY_R << 16) | PIXELS_GRAY_B);
+    const __m256i weights_ga = _mm256_set1_epi32(PIXELS_GRAY_G);
+    __m256i br = _mm256_and_si256(v, low_bytes);
+    __m256i ga = _mm256_and_si256(_mm256_srli_epi16(v, 8), low_bytes);
+    __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(br, weights_br),
+                                   _mm256_madd_epi16(ga, weights_ga));
+    return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(128)), 8);
+}
+
+__attribute__((target("avx2")))
+static inline size_t pixels_grayscale_avx2(uint8_t *dst, const uint32_t *src, size_t n) {
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i *in = (const __m256i *)(src + i);
+        __m256i y0 = pixels_luma32_avx2(_mm256_loadu_si256(in + 0));
+        __m256i y1 = pixels_luma32_avx2(_mm256_loadu_si256(in + 1));
+        __m256i y2 = pixels_luma32_avx2(_mm256_loadu_si256(in + 2));
+        __m256i y3 = pixels_luma32_avx2(_mm256_loadu_si256(in + 3));
+        __m256i y = _mm256_packus_epi16(_mm256_packs_epi32(y0, y1), _mm256_packs_epi32(y2, y3));
+        // Packing interleaved the 128-bit halves; put the pixels back in order
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permutevar8x32_epi32(y, order));
+    }
+    return i;
+}
+
+#endif  // PIXELS_X86
+
+// Best kernel this CPU can run
+static inline pixels_kernel pixels_detect(void) {
+#if PIXELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return PIXELS_AVX2;
+    if (__builtin_cpu_supports("ssse3")) return PIXELS_SSSE3;
+#endif
+    return PIXELS_SCALAR;
+}
+
+static inline const char *pixels_kernel_name(pixels_kernel k) {
+    switch (k) {
+    case PIXELS_AVX2:  return "avx2";
+    case PIXELS_SSSE3: return "ssse3";
+    default:           return "scalar";
+    }
+}
+
+static inline pixels_kernel pixels_best_kernel(void) {
+    static pixels_kernel kernel = (pixels_kernel)-1;
+    if (kernel == (pixels_kernel)-1) kernel = pixels_detect();
+    return kernel;
+}
+
+// Split n packed pixels into planes. a may be NULL to skip alpha.
+static inline void pixels_unpack_with(pixels_kernel k, const uint32_t *src, size_t n,
+                                      uint8_t *r, uint8_t *g, uint8_t *b, uint8_t *a) {
+    size_t done = 0;
+#if PIXELS_X86
+    if (k == PIXELS_AVX2) done = pixels_unpack_avx2(src, n, r, g, b, a);
+    else if (k == PIXELS_SSSE3) done = pixels_unpack_ssse3(src, n, r, g, b, a);
+#endif
+    (void)k;
+    pixels_unpack_scalar(src + done, n - done, r + done, g + done, b + done, a ? a + done : NULL);
+}
+
+static inline void pixels_unpack(const uint32_t *src, size_t n, uint8_t *r,
+                                 uint8_t *g, uint8_t *b, uint8_t *a) {
+    pixels_unpack_with(pixels_best_kernel(), src, n, r, g, b, a);
+}
+
+// Join planes into n packed pixels. a may be NULL: alpha byte = 0,
+// which gives 0x00RRGGBB colors like the ones in 2_binary_ops.c.
+static inline void pixels_pack_with(pixels_kernel k, uint32_t *dst, size_t n, const uint8_t *r,
+                                    const uint8_t *g, const uint8_t *b, const uint8_t *a) {
+    size_t done = 0;
+#if PIXELS_X86
+    if (k == PIXELS_AVX2) done = pixels_pack_avx2(dst, n, r, g, b, a);
+    else if (k == PIXELS_SSSE3) done = pixels_pack_ssse3(dst, n, r, g, b, a);
+#endif
+    (void)k;
+    pixels_pack_scalar(dst + done, n - done, r + done, g + done, b + done, a ? a + done : NULL);
+}
+
+static inline void pixels_pack(uint32_t *dst, size_t n, const uint8_t *r,
+                               const uint8_t *g, const uint8_t *b, const uint8_t *a) {
+    pixels_pack_with(pixels_best_kernel(), dst, n, r, g, b, a);
+}
+
+// Multiply R, G and B by alpha / 255 (rounded), keeping alpha.
+// dst may be the same array as src.
+static inline void pixels_premultiply_with(pixels_kernel k, uint32_t *dst,
+                                           const uint32_t *src, size_t n) {
+    size_t done = 0;
+#if PIXELS_X86
+    if (k == PIXELS_AVX2) done = pixels_premultiply_avx2(dst, src, n);
+    else if (k == PIXELS_SSSE3) done = pixels_premultiply_ssse3(dst, src, n);
+#endif
+    (void)k;
+    pixels_premultiply_scalar(dst + done, src + done, n - done);
+}
+
+static inline void pixels_premultiply(uint32_t *dst, const uint32_t *src, size_t n) {
+    pixels_premultiply_with(pixels_best_kernel(), dst, src, n);
+}
+
+// One brightness byte per pixel: (77*R + 150*G + 29*B) / 256, rounded
+static inline void pixels_grayscale_with(pixels_kernel k, uint8_t *dst,
+                                         const uint32_t *src, size_t n) {
+    size_t done = 0;
+#if PIXELS_X86
+    if (k == PIXELS_AVX2) done = pixels_grayscale_avx2(dst, src, n);
+    else if (k == PIXELS_SSSE3) done = pixels_grayscale_ssse3(dst, src, n);
+#endif
+    (void)k;
+    pixels_grayscale_scalar(dst + done, src + done, n - done);
+}
+
+static inline void pixels_grayscale(uint8_t *dst, const uint32_t *src, size_t n) {
+    pixels_grayscale_with(pixels_best_kernel(), dst, src, n);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PIXELS_H
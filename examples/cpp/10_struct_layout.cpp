@@ -0,0 +1,227 @@
+/*
+ * Struct Layout and Cache Lines in C++
+ * Where does sizeof(struct) come from - and why does member order matter?
+ * Compile: g++ -O2 10_struct_layout.cpp -o struct_layout
+ * Run: ./struct_layout [--json] [--runs=N]
+ */
+
+#include <iostream>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include "struct_layout.hpp"
+#include "bench.hpp"
+using namespace std;
+
+// Members in the order someone might think of them
+struct Particle {
+    bool alive;
+    double x, y, z;
+    char kind;
+    double vx, vy, vz;
+    int id;
+    char label[6];
+    float mass;
+};
+
+// The same members, biggest alignment first
+struct PackedParticle {
+    double x, y, z;
+    double vx, vy, vz;
+    int id;
+    float mass;
+    bool alive;
+    char kind;
+    char label[6];
+};
+
+// "Struct of arrays": one array per member
+struct Particles {
+    vector<double> x, y, z, vx, vy, vz;
+    vector<int> id;
+    vector<float> mass;
+    vector<char> alive, kind;
+    vector<array<char, 6>> label;
+
+    explicit Particles(size_t n)
+        : x(n), y(n), z(n), vx(n), vy(n), vz(n), id(n), mass(n), alive(n), kind(n), label(n) {}
+};
+
+const size_t kCount = 1 << 20;  // about a million particles
+const double kStep = 0.01;
+
+template <typename P>
+void fill(P &p, size_t i) {
+    p.alive = i % 7 != 0;
+    p.x = double(i); p.y = double(i) * 0.5; p.z = -double(i);
+    p.vx = 1.0; p.vy = 2.0; p.vz = 3.0;
+    p.kind = char('a' + i % 4);
+    p.id = int(i);
+    p.label[0] = 'p';
+    p.mass = 1.5f;
+}
+
+template <typename P>
+double sumX(const vector<P> &ps) {
+    double sum = 0;
+    for (const P &p : ps) sum += p.x;
+    return sum;
+}
+
+template <typename P>
+void move(vector<P> &ps) {
+    for (P &p : ps) {
+        p.x += p.vx * kStep;
+        p.y += p.vy * kStep;
+        p.z += p.vz * kStep;
+    }
+}
+
+// Reads every member once
+template <typename P>
+double everything(const vector<P> &ps) {
+    double sum = 0;
+    for (const P &p : ps) {
+        if (!p.alive) continue;
+        sum += p.x + p.y + p.z + p.vx + p.vy + p.vz + p.mass + p.id + p.kind + p.label[0];
+    }
+    return sum;
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "struct_layout", argc, argv);
+
+    StructLayout particle = StructLayout::of<Particle>("Particle")
+        .LAYOUT_FIELD(Particle, alive)
+        .LAYOUT_FIELD(Particle, x).LAYOUT_FIELD(Particle, y).LAYOUT_FIELD(Particle, z)
+        .LAYOUT_FIELD(Particle, kind)
+        .LAYOUT_FIELD(Particle, vx).LAYOUT_FIELD(Particle, vy).LAYOUT_FIELD(Particle, vz)
+        .LAYOUT_FIELD(Particle, id)
+        .LAYOUT_FIELD(Particle, label)
+        .LAYOUT_FIELD(Particle, mass);
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "STRUCT LAYOUT AND CACHE LINES IN C++\n";
+        cout << "==================================================\n";
+
+        cout << "\n1. A small struct with a hole in it:\n";
+        struct Pixel { char tag; int color; };
+        StructLayout pixel = StructLayout::of<Pixel>("Pixel")
+            .field("tag", &Pixel::tag)
+            .field("color", &Pixel::color);
+        pixel.print(cout);
+        cout << "   (color must start at a multiple of 4, so 3 bytes go unused)\n";
+
+        cout << "\n2. A particle, members in \"natural\" order:\n";
+        particle.print(cout);
+        cout << "\n";
+        particle.printSuggestion(cout);
+        cout << "   sizeof(PackedParticle) = " << sizeof(PackedParticle) << " - matches!\n";
+
+        cout << "\n   Below, " << kCount << " particles are stored three ways:\n";
+        cout << "   array of Particle (" << sizeof(Particle) << " B each), array of PackedParticle ("
+             << sizeof(PackedParticle) << " B each),\n";
+        cout << "   and one array per member (\"struct of arrays\").\n";
+    }
+
+    vector<Particle> aos(kCount);
+    vector<PackedParticle> packed(kCount);
+    Particles soa(kCount);
+    for (size_t i = 0; i < kCount; i++) {
+        fill(aos[i], i);
+        fill(packed[i], i);
+        soa.alive[i] = aos[i].alive;
+        soa.x[i] = aos[i].x; soa.y[i] = aos[i].y; soa.z[i] = aos[i].z;
+        soa.vx[i] = aos[i].vx; soa.vy[i] = aos[i].vy; soa.vz[i] = aos[i].vz;
+        soa.kind[i] = aos[i].kind;
+        soa.id[i] = aos[i].id;
+        soa.label[i][0] = aos[i].label[0];
+        soa.mass[i] = aos[i].mass;
+    }
+
+    // Reading one double per particle: how much of each cache line is used?
+    bench_section(&suite, "3. Sum of x only (8 useful bytes per particle):");
+    benchRun(suite, "array of Particle", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) doNotOptimize(sumX(aos));
+    });
+    bench_rate(&suite, kCount, "particle");
+    benchRun(suite, "array of PackedParticle", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) doNotOptimize(sumX(packed));
+    });
+    bench_rate(&suite, kCount, "particle");
+    benchRun(suite, "struct of arrays", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            double sum = 0;
+            for (double x : soa.x) sum += x;
+            doNotOptimize(sum);
+        }
+    });
+    bench_rate(&suite, kCount, "particle");
+    bench_compare(&suite, "array of Particle", "struct of arrays");
+    if (!suite.quiet) {
+        cout << "   Cache lines read: " << kCount * sizeof(Particle) / 64 << " vs. "
+             << kCount * sizeof(PackedParticle) / 64 << " vs. " << kCount * sizeof(double) / 64 << "\n";
+    }
+
+    bench_section(&suite, "4. Move: x += vx * dt for x, y, z (48 useful bytes):");
+    benchRun(suite, "array of Particle", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) { move(aos); doNotOptimize(aos.data()); }
+    });
+    bench_rate(&suite, kCount, "particle");
+    benchRun(suite, "array of PackedParticle", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) { move(packed); doNotOptimize(packed.data()); }
+    });
+    bench_rate(&suite, kCount, "particle");
+    benchRun(suite, "struct of arrays", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            for (size_t i = 0; i < kCount; i++) {
+                soa.x[i] += soa.vx[i] * kStep;
+                soa.y[i] += soa.vy[i] * kStep;
+                soa.z[i] += soa.vz[i] * kStep;
+            }
+            doNotOptimize(soa.x.data());
+        }
+    });
+    bench_rate(&suite, kCount, "particle");
+    bench_compare(&suite, "array of Particle", "struct of arrays");
+
+    bench_section(&suite, "5. Every member of every live particle:");
+    benchRun(suite, "array of Particle", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) doNotOptimize(everything(aos));
+    });
+    bench_rate(&suite, kCount, "particle");
+    benchRun(suite, "array of PackedParticle", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) doNotOptimize(everything(packed));
+    });
+    bench_rate(&suite, kCount, "particle");
+    benchRun(suite, "struct of arrays", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            double sum = 0;
+            for (size_t i = 0; i < kCount; i++) {
+                if (!soa.alive[i]) continue;
+                sum += soa.x[i] + soa.y[i] + soa.z[i] + soa.vx[i] + soa.vy[i] + soa.vz[i] +
+                       soa.mass[i] + soa.id[i] + soa.kind[i] + soa.label[i][0];
+            }
+            doNotOptimize(sum);
+        }
+    });
+    bench_rate(&suite, kCount, "particle");
+    bench_compare(&suite, "array of Particle", "array of PackedParticle");
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * Memory moves in 64-byte cache lines, not single members.\n";
+        cout << "   * Reading one member of a big struct drags the rest along;\n";
+        cout << "     one array per member only loads what you use.\n";
+        cout << "   * Biggest members first removes padding for free.\n";
+        cout << "   * Separate arrays also let the compiler use SIMD, so even\n";
+        cout << "     section 5 (every member) comes out ahead.\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
@@ -0,0 +1,512 @@
+/*
+ * How Fast Is Each Data Type? (C++)
+ * 1_data_types.cpp shows how BIG each type is - this shows how FAST.
+ * Compile: g++ -O2 11_type_speed.cpp -o type_speed
+ * Run: ./type_speed [--json] [--runs=N]
+ *
+ * Every kernel (sum, multiply-add, divide, min/max, dot product) runs
+ * over arrays of short, int, long, long long, float, double and
+ * unsigned, built three ways in the same program:
+ *
+ *   scalar  vectorizing turned off: one element per instruction
+ *   auto    the compiler is allowed to vectorize (like -O3 -mavx2)
+ *   simd    written by hand with 256-bit vectors (GCC vector types)
+ *
+ * "auto" is only fast if the compiler actually vectorized the loop. The
+ * program asks its own machine code (through objdump) whether each auto
+ * kernel uses ymm registers, rather than guessing from the speed. By hand:
+ *   objdump -d -C type_speed | grep -A40 ' sumAuto<float>('
+ * or see the compiler's reasons, one line per kernel and build, with
+ *   g++ -O2 -fopt-info-vec-optimized -fopt-info-vec-missed 11_type_speed.cpp
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <unistd.h>
+#include "bench.hpp"
+using namespace std;
+
+const size_t kCount = 16384;  // fits in L2, so we time math, not memory
+
+#define SCALAR __attribute__((noinline, optimize("no-tree-vectorize")))
+#define AUTO __attribute__((noinline, target("avx2"), optimize("O3")))
+#define SIMD __attribute__((noinline, target("avx2")))
+#define SIMD_HELPER __attribute__((always_inline, target("avx2"))) inline
+
+// ==================================================
+// The kernels, written the plain way, twice: once as "scalar" and once
+// as "auto". Two copies of the same source rather than one macro, so
+// each loop has its own line in the compiler's -fopt-info-vec remarks.
+// ==================================================
+
+template <typename T>
+SCALAR T sumScalar(const T *a, size_t n) {
+    T s = 0;
+    for (size_t i = 0; i < n; i++) s += a[i];
+    return s;
+}
+
+template <typename T>
+AUTO T sumAuto(const T *a, size_t n) {
+    T s = 0;
+    for (size_t i = 0; i < n; i++) s += a[i];
+    return s;
+}
+
+template <typename T>
+SCALAR void mulAddScalar(T *out, const T *a, const T *b, const T *c, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = a[i] * b[i] + c[i];
+}
+
+template <typename T>
+AUTO void mulAddAuto(T *out, const T *a, const T *b, const T *c, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = a[i] * b[i] + c[i];
+}
+
+template <typename T>
+SCALAR void divideScalar(T *out, const T *a, const T *b, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = a[i] / b[i];
+}
+
+template <typename T>
+AUTO void divideAuto(T *out, const T *a, const T *b, size_t n) {
+    for (size_t i = 0; i < n; i++) out[i] = a[i] / b[i];
+}
+
+template <typename T>
+SCALAR T minMaxScalar(const T *a, size_t n) {
+    T lo = a[0], hi = a[0];
+    for (size_t i = 0; i < n; i++) {
+        lo = a[i] < lo ? a[i] : lo;
+        hi = a[i] > hi ? a[i] : hi;
+    }
+    return hi - lo;
+}
+
+template <typename T>
+AUTO T minMaxAuto(const T *a, size_t n) {
+    T lo = a[0], hi = a[0];
+    for (size_t i = 0; i < n; i++) {
+        lo = a[i] < lo ? a[i] : lo;
+        hi = a[i] > hi ? a[i] : hi;
+    }
+    return hi - lo;
+}
+
+template <typename T>
+SCALAR T dotScalar(const T *a, const T *b, size_t n) {
+    T s = 0;
+    for (size_t i = 0; i < n; i++) s += a[i] * b[i];
+    return s;
+}
+
+template <typename T>
+AUTO T dotAuto(const T *a, const T *b, size_t n) {
+    T s = 0;
+    for (size_t i = 0; i < n; i++) s += a[i] * b[i];
+    return s;
+}
+
+// ==================================================
+// The same kernels with explicit 256-bit vectors.
+// GCC's vector types work for any element type: a Vec<short> holds
+// 16 shorts, a Vec<double> 4 doubles, and + - * / < work lane by lane.
+// ==================================================
+
+template <typename T>
+struct Simd {
+    typedef T Vec __attribute__((vector_size(32)));
+    static const size_t kLanes = 32 / sizeof(T);
+};
+
+template <typename V>
+SIMD_HELPER V load(const void *p) {
+    V v;
+    memcpy(&v, p, sizeof(v));  // unaligned load
+    return v;
+}
+
+template <typename V>
+SIMD_HELPER void store(void *p, V v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+template <typename T, typename V>
+SIMD_HELPER T addLanes(V v) {
+    T s = 0;
+    for (size_t k = 0; k < Simd<T>::kLanes; k++) s += v[k];
+    return s;
+}
+
+// Sums keep two vectors going, so one add doesn't wait on the last.
+// Floating-point sums are added in a different order than the plain
+// loop, so the last digits can differ - that's why the compiler
+// won't do this on its own without -ffast-math.
+template <typename T>
+SIMD T sumSimd(const T *a, size_t n) {
+    typedef typename Simd<T>::Vec V;
+    const size_t L = Simd<T>::kLanes;
+    V s0 = {}, s1 = {};
+    size_t i = 0;
+    for (; i + 2 * L <= n; i += 2 * L) {
+        s0 += load<V>(a + i);
+        s1 += load<V>(a + i + L);
+    }
+    T s = addLanes<T>(s0 + s1);
+    for (; i < n; i++) s += a[i];
+    return s;
+}
+
+template <typename T>
+SIMD void mulAddSimd(T *out, const T *a, const T *b, const T *c, size_t n) {
+    typedef typename Simd<T>::Vec V;
+    const size_t L = Simd<T>::kLanes;
+    size_t i = 0;
+    for (; i + L <= n; i += L) store(out + i, load<V>(a + i) * load<V>(b + i) + load<V>(c + i));
+    for (; i < n; i++) out[i] = a[i] * b[i] + c[i];
+}
+
+// x86 has no integer divide for vectors: for ints this becomes one
+// scalar divide per lane, and only float/double really speed up
+template <typename T>
+SIMD void divideSimd(T *out, const T *a, const T *b, size_t n) {
+    typedef typename Simd<T>::Vec V;
+    const size_t L = Simd<T>::kLanes;
+    size_t i = 0;
+    for (; i + L <= n; i += L) store(out + i, load<V>(a + i) / load<V>(b + i));
+    for (; i < n; i++) out[i] = a[i] / b[i];
+}
+
+template <typename T>
+SIMD T minMaxSimd(const T *a, size_t n) {
+    typedef typename Simd<T>::Vec V;
+    const size_t L = Simd<T>::kLanes;
+    T lo = a[0], hi = a[0];
+    size_t i = 0;
+    if (n >= L) {
+        V vlo = load<V>(a), vhi = vlo;
+        for (i = L; i + L <= n; i += L) {
+            V v = load<V>(a + i);
+            vlo = v < vlo ? v : vlo;
+            vhi = v > vhi ? v : vhi;
+        }
+        for (size_t k = 0; k < L; k++) {
+            lo = vlo[k] < lo ? vlo[k] : lo;
+            hi = vhi[k] > hi ? vhi[k] : hi;
+        }
+    }
+    for (; i < n; i++) {
+        lo = a[i] < lo ? a[i] : lo;
+        hi = a[i] > hi ? a[i] : hi;
+    }
+    return hi - lo;
+}
+
+template <typename T>
+SIMD T dotSimd(const T *a, const T *b, size_t n) {
+    typedef typename Simd<T>::Vec V;
+    const size_t L = Simd<T>::kLanes;
+    V s0 = {}, s1 = {};
+    size_t i = 0;
+    for (; i + 2 * L <= n; i += 2 * L) {
+        s0 += load<V>(a + i) * load<V>(b + i);
+        s1 += load<V>(a + i + L) * load<V>(b + i + L);
+    }
+    T s = addLanes<T>(s0 + s1);
+    for (; i < n; i++) s += a[i] * b[i];
+    return s;
+}
+
+// ==================================================
+// Running one type through every kernel
+// ==================================================
+
+const char *kKernels[] = {"sum", "multiply-add", "divide", "min/max", "dot product"};
+const int kKernelCount = 5;
+const char *kBuilds[] = {"scalar", "auto", "simd"};
+
+const char *kAutoFunctions[] = {"sumAuto", "mulAddAuto", "divideAuto", "minMaxAuto", "dotAuto"};
+
+// elements/sec for [kernel][build], the best of every round so far
+struct TypeRow {
+    string type;
+    double rate[5][3] = {};
+    int result[5][3];  // its entry in suite.results, once measured
+    bool agree = true;
+};
+
+template <typename T>
+bool close(T x, T y) {
+    if (x == y) return true;
+    double scale = fabs(double(x)) + fabs(double(y));
+    return fabs(double(x) - double(y)) <= 1e-3 * scale;  // float sums reorder
+}
+
+// Every type runs over the same memory, so none of them is timed on
+// luckier pages or cache sets than another
+alignas(64) static unsigned char g_arrays[4][kCount * sizeof(uint64_t)];
+
+// One kernel, every build, for one type. Each keeps its best round; the
+// types take turns at each kernel, so a slow stretch of the machine hits
+// all of them alike instead of just one
+template <typename T>
+void measureKernel(bench_suite &suite, TypeRow &row, bool has_avx2, bool first_round, int k) {
+    // Small values (-3..3, never 0 as a divisor) so nothing overflows
+    mt19937 rng(7);
+    static_assert(sizeof(T) <= sizeof(uint64_t), "g_arrays holds kCount of the largest type");
+    T *a = reinterpret_cast<T *>(g_arrays[0]), *b = reinterpret_cast<T *>(g_arrays[1]);
+    T *c = reinterpret_cast<T *>(g_arrays[2]), *out = reinterpret_cast<T *>(g_arrays[3]);
+    for (size_t i = 0; i < kCount; i++) {
+        int sign = T(-1) < T(0) && (rng() & 1) ? -1 : 1;
+        a[i] = T(sign * int(rng() % 4));
+        b[i] = T(sign * int(1 + rng() % 3));
+        c[i] = T(rng() % 4);
+    }
+
+    if (has_avx2 && first_round && k == 0) {
+        vector<T> other(kCount);
+        row.agree = row.agree && close(sumScalar(a, kCount), sumAuto(a, kCount)) &&
+                    close(sumScalar(a, kCount), sumSimd(a, kCount)) &&
+                    close(dotScalar(a, b, kCount), dotSimd(a, b, kCount)) &&
+                    minMaxScalar(a, kCount) == minMaxSimd(a, kCount);
+        mulAddScalar(out, a, b, c, kCount);
+        mulAddSimd(other.data(), a, b, c, kCount);
+        row.agree = row.agree && equal(out, out + kCount, other.begin());
+        divideScalar(out, a, b, kCount);
+        divideSimd(other.data(), a, b, kCount);
+        row.agree = row.agree && equal(out, out + kCount, other.begin());
+    }
+
+    const T *pa = a, *pb = b, *pc = c;
+    T *po = out;
+    for (int build = 0; build < (has_avx2 ? 3 : 1); build++) {
+        string name = row.type + " " + kKernels[k] + " (" + kBuilds[build] + ")";
+        auto run = [&](size_t iterations) {
+            for (size_t it = 0; it < iterations; it++) {
+                switch (k * 3 + build) {
+                case 0: doNotOptimize(sumScalar(pa, kCount)); break;
+                case 1: doNotOptimize(sumAuto(pa, kCount)); break;
+                case 2: doNotOptimize(sumSimd(pa, kCount)); break;
+                case 3: mulAddScalar(po, pa, pb, pc, kCount); break;
+                case 4: mulAddAuto(po, pa, pb, pc, kCount); break;
+                case 5: mulAddSimd(po, pa, pb, pc, kCount); break;
+                case 6: divideScalar(po, pa, pb, kCount); break;
+                case 7: divideAuto(po, pa, pb, kCount); break;
+                case 8: divideSimd(po, pa, pb, kCount); break;
+                case 9: doNotOptimize(minMaxScalar(pa, kCount)); break;
+                case 10: doNotOptimize(minMaxAuto(pa, kCount)); break;
+                case 11: doNotOptimize(minMaxSimd(pa, kCount)); break;
+                case 12: doNotOptimize(dotScalar(pa, pb, kCount)); break;
+                case 13: doNotOptimize(dotAuto(pa, pb, kCount)); break;
+                default: doNotOptimize(dotSimd(pa, pb, kCount)); break;
+                }
+                doNotOptimize(po);
+            }
+        };
+        benchRun(suite, name.c_str(), run);
+        bench_rate(&suite, double(kCount), "elem");
+        // Later rounds replace the first one's entry only if their
+        // fastest run beat it: noise only ever makes code slower
+        bench_result &latest = suite.results[suite.count - 1];
+        if (first_round) {
+            row.result[k][build] = suite.count - 1;
+        } else {
+            bench_result &kept = suite.results[row.result[k][build]];
+            if (latest.min_ns < kept.min_ns) kept = latest;
+            suite.count--;
+        }
+        row.rate[k][build] = double(kCount) * 1e9 / suite.results[row.result[k][build]].min_ns;
+    }
+}
+
+// Which "auto" kernels the compiler vectorized, read from the machine code
+// it produced: a loop on 256-bit vectors uses %ymm registers. `ok` is false
+// without objdump; g++ -fopt-info-vec tells the same at build time.
+struct Vectorized {
+    bool ok = false;
+    set<string> kernels;  // e.g. "sumAuto<int>"
+
+    bool has(int kernel, const string &type) const {
+        return kernels.count(string(kAutoFunctions[kernel]) + "<" + (type == "unsigned" ? "unsigned int" : type) +
+                             ">") != 0;
+    }
+};
+
+static Vectorized readVectorized() {
+    Vectorized found;
+    // Our own path: in the shell popen starts, /proc/self/exe is the shell
+    char self[4096];
+    const ssize_t self_length = readlink("/proc/self/exe", self, sizeof self - 1);
+    if (self_length <= 0) return found;
+    self[self_length] = '\0';
+    const string command = "objdump -d -C --no-show-raw-insn '" + string(self) + "' 2>/dev/null";
+    FILE *pipe = popen(command.c_str(), "r");
+    if (!pipe) return found;
+    char line[1024];
+    string current;  // the auto kernel whose code is being read, if any
+    while (fgets(line, sizeof line, pipe)) {
+        const size_t length = strlen(line);
+        const char *open = strchr(line, '<');
+        if (open && length >= 3 && strcmp(line + length - 3, ">:\n") == 0) {
+            // "0000000000005cf0 <long dotAuto<long>(long const*, ...) [clone .constprop.0]>:"
+            const string name(open + 1);
+            const size_t at = name.find("Auto<"), end = name.find(">(", at);
+            const size_t start = name.rfind(' ', at) + 1;  // after the return type
+            current = at != string::npos && end != string::npos ? name.substr(start, end + 1 - start) : "";
+            found.ok = true;
+        } else if (!current.empty() && strstr(line, "%ymm")) {
+            found.kernels.insert(current);
+        }
+    }
+    pclose(pipe);
+    return found;
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "type_speed", argc, argv);
+
+    __builtin_cpu_init();
+    bool has_avx2 = __builtin_cpu_supports("avx2");
+    bool text = !suite.quiet;
+
+    if (text) {
+        cout << "==================================================\n";
+        cout << "HOW FAST IS EACH DATA TYPE?\n";
+        cout << "==================================================\n";
+        cout << "\nEach kernel runs over " << kCount << " elements; numbers are\n";
+        cout << "billions of elements per second (higher is better).\n";
+        if (!has_avx2) cout << "This CPU has no AVX2: only the scalar builds run.\n";
+        cout << "Measuring";
+        cout.flush();
+    }
+
+    // The table is printed at the end, so hide the per-run lines. The
+    // runs are shared out over many short rounds: on a busy or throttled
+    // machine a slow spell lasts about a second, longer than all the runs
+    // of one kernel together, so only spreading them out gets past it
+    suite.quiet = 1;
+    const int kRunsPerRound = 2, runs = suite.runs, warmup_runs = suite.warmup_runs;
+    const int rounds = max(1, (runs + kRunsPerRound - 1) / kRunsPerRound);
+    suite.runs = min(runs, kRunsPerRound);
+    vector<TypeRow> rows(7);
+    const char *types[] = {"short", "int", "long", "long long", "float", "double", "unsigned"};
+    for (size_t i = 0; i < rows.size(); i++) rows[i].type = types[i];
+    for (int round = 0; round < rounds; round++) {
+        if (round == 1) suite.warmup_runs = min(warmup_runs, 1);  // caches and clocks are warm by now
+        for (int k = 0; k < kKernelCount; k++) {
+            measureKernel<short>(suite, rows[0], has_avx2, round == 0, k);
+            measureKernel<int>(suite, rows[1], has_avx2, round == 0, k);
+            measureKernel<long>(suite, rows[2], has_avx2, round == 0, k);
+            measureKernel<long long>(suite, rows[3], has_avx2, round == 0, k);
+            measureKernel<float>(suite, rows[4], has_avx2, round == 0, k);
+            measureKernel<double>(suite, rows[5], has_avx2, round == 0, k);
+            measureKernel<unsigned>(suite, rows[6], has_avx2, round == 0, k);
+        }
+        if (text) { cout << "."; cout.flush(); }
+    }
+    suite.runs = runs;
+    suite.warmup_runs = warmup_runs;
+    suite.quiet = !text;
+    const Vectorized vectorized = has_avx2 ? readVectorized() : Vectorized();
+
+    if (text) {
+        cout << "\n";
+        for (int k = 0; k < kKernelCount; k++) {
+            cout << "\n" << k + 1 << ". " << kKernels[k] << ":\n";
+            cout << "   type         scalar      auto      simd   auto/scalar   auto vectorized\n";
+            for (const TypeRow &row : rows) {
+                const double *r = row.rate[k];
+                cout << "   " << left << setw(10) << row.type << right << fixed << setprecision(2)
+                     << setw(9) << r[0] / 1e9;
+                if (has_avx2) {
+                    cout << setw(10) << r[1] / 1e9 << setw(10) << r[2] / 1e9 << setw(13) << r[1] / r[0] << "x"
+                         << setw(17) << (!vectorized.ok ? "?" : vectorized.has(k, row.type) ? "yes" : "no");
+                }
+                cout << "\n";
+            }
+        }
+        bool agree = true;
+        for (const TypeRow &row : rows) agree = agree && row.agree;
+        cout << "\nAll three builds give the same answers: " << (agree ? "yes" : "NO!") << "\n";
+        if (has_avx2) {
+            cout << "\"auto vectorized\" is read from the compiled code (objdump), not\n";
+            cout << "guessed from the speed: "
+                 << (vectorized.ok ? "yes means 256-bit registers do some of the work.\n"
+                                   : "objdump was not found, so it is unknown.\n");
+        }
+
+        // The lessons below are read off the table above, not written in advance
+        auto rate = [&](const char *type, int kernel, int build) {
+            for (const TypeRow &row : rows)
+                if (row.type == type) return row.rate[kernel][build];
+            return 0.0;
+        };
+        enum { kSum, kMulAdd, kDivide, kMinMax, kDot };
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << setprecision(1);
+        if (has_avx2) {
+            cout << "   * Smaller types fit more lanes in a vector (short 16,\n";
+            cout << "     double 4): the simd sum of shorts ran "
+                 << rate("short", kSum, 2) / rate("double", kSum, 2) << "x as many\n";
+            cout << "     elements per second as the one of doubles.\n";
+            const double int_sum = rate("int", kSum, 1) / rate("int", kSum, 0);
+            const double float_sum = rate("float", kSum, 1) / rate("float", kSum, 0);
+            const double double_sum = rate("double", kSum, 1) / rate("double", kSum, 0);
+            cout << "   * auto vs scalar sum: int " << int_sum << "x, float " << float_sum << "x, double "
+                 << double_sum << "x.\n";
+            if (!vectorized.ok) {
+                cout << "     (without objdump, which sums were vectorized is unknown)\n";
+            } else if (vectorized.has(kSum, "int") && !vectorized.has(kSum, "float") &&
+                       !vectorized.has(kSum, "double")) {
+                cout << "     The compiler vectorized the int sum but kept the\n";
+                cout << "     float/double adds in order: reordering them changes\n";
+                cout << "     the rounding.\n";
+            } else {
+                cout << "     The compiler vectorized the sum of int "
+                     << (vectorized.has(kSum, "int") ? "(yes)" : "(no)") << ", float "
+                     << (vectorized.has(kSum, "float") ? "(yes)" : "(no)") << " and double "
+                     << (vectorized.has(kSum, "double") ? "(yes)" : "(no)") << ".\n";
+            }
+            const double int_div = rate("int", kDivide, 2) / rate("int", kDivide, 0);
+            const double double_div = rate("double", kDivide, 2) / rate("double", kDivide, 0);
+            cout << "   * Divide, simd vs scalar: int " << int_div << "x, double " << double_div << "x.\n";
+            if (int_div < 1.5 && double_div >= 1.5) cout << "     x86 has vector division for floating point only.\n";
+        }
+        if (sizeof(long) == sizeof(long long)) {
+            // The same size, so the same instructions: any gap is noise
+            double gap = 0;
+            int worst = 0;
+            for (int k = 0; k < kKernelCount; k++) {
+                for (int build = 0; build < (has_avx2 ? 3 : 1); build++) {
+                    const double a = rate("long", k, build), b = rate("long long", k, build);
+                    const double g = fabs(a - b) / max(a, b);
+                    if (g > gap) {
+                        gap = g;
+                        worst = k;
+                    }
+                }
+            }
+            cout << "   * long and long long are both " << sizeof(long) << " bytes here, so they\n";
+            cout << "     compile to the same code; the largest gap between\n";
+            cout << "     them was " << gap * 100 << "% (" << kKernels[worst] << "): that much\n";
+            cout << "     comes from noise and code placement, not the type.\n";
+        } else {
+            cout << "   * long is " << sizeof(long) << " bytes and long long " << sizeof(long long)
+                 << " here: compare their rows above.\n";
+        }
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
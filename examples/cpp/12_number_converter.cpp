@@ -0,0 +1,280 @@
+/*
+ * A Fast Number Converter (C++)
+ * NumberConverter.jsx converts one number at a time - this converts
+ * millions, from a file or a pipe, between bases 2, 8, 10 and 16.
+ * Compile: g++ -O2 -pthread 12_number_converter.cpp -o number_converter
+ * Run: ./number_converter --from=10 --to=16 numbers.txt > hex.txt
+ *      seq 1 1000000 | ./number_converter --to=2
+ *      ./number_converter --bench [--count=N] [--json] [--runs=N]
+ *
+ * Options: --from=B and --to=B (2, 8, 10 or 16; default 10 -> 16),
+ *          --prefix (write 0b/0o/0x), --upper (A-F),
+ *          --threads=N (default: one per core).
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "number_stream.hpp"
+#include "bench.hpp"
+using namespace std;
+
+// ==================================================
+// Benchmark: the same conversion, written three ways
+// ==================================================
+
+// The way the other examples print: a stream per value, endl per line
+void streamWithEndl(const string &input, ostream &out) {
+    istringstream in(input);
+    uint64_t n;
+    while (in >> n) out << hex << n << endl;
+}
+
+// Same, but '\n' instead of endl: no flush, so the stream buffers
+void streamWithNewline(const string &input, ostream &out) {
+    istringstream in(input);
+    uint64_t n;
+    while (in >> n) out << hex << n << '\n';
+    out.flush();
+}
+
+// Every base to every base and back, and the threaded converter against
+// the plain stream version (through a temporary file)
+bool selfTest() {
+    mt19937_64 rng(7);
+    const int bases[] = {2, 8, 10, 16};
+    char text[80];
+    for (int i = 0; i < 20000; i++) {
+        uint64_t v = i < 2 ? (i ? ~0ull : 0) : rng() >> (rng() % 64);
+        for (int from : bases) {
+            size_t len = numconv::formatNumber(text, v, from, i % 2);
+            uint64_t back = 0;
+            if (numconv::parseNumber(text, text + len, from, back) != numconv::Status::Ok || back != v) return false;
+        }
+    }
+    uint64_t v;
+    if (numconv::parseNumber("18446744073709551616", "18446744073709551616" + 20, 10, v) != numconv::Status::Overflow) return false;
+    if (numconv::parseNumber("12a", "12a" + 3, 10, v) != numconv::Status::BadDigit) return false;
+
+    string input;
+    for (int i = 0; i < 50000; i++) input += to_string(rng() >> (rng() % 64)) + (i % 5 ? " " : "\n");
+    ostringstream expected;
+    streamWithNewline(input, expected);
+    FILE *tmp = tmpfile();
+    if (!tmp) return false;
+    numconv::Options opt;
+    numconv::Converter conv(opt, 3, 4096);
+    bool ok = conv.convertMemory(input.data(), input.size(), fileno(tmp)).numbers == 50000;
+    string got(expected.str().size() + 1, '\0');
+    ok = ok && pread(fileno(tmp), &got[0], got.size(), 0) == ssize_t(expected.str().size());
+    got.pop_back();
+    fclose(tmp);
+    return ok && got == expected.str();
+}
+
+void usage() {
+    fprintf(stderr,
+            "usage: number_converter [--from=B] [--to=B] [--prefix] [--upper] [--threads=N] [FILE]\n"
+            "       number_converter --bench [--count=N] [--json] [--runs=N]\n"
+            "B is 2, 8, 10 or 16. Without FILE (or with -), reads stdin.\n");
+}
+
+static const unsigned long long kMaxThreads = 256;
+
+// The whole of `text` as a number from 1 to `max`: no sign, no junk
+bool parseCount(const char *text, unsigned long long max, unsigned long long &value) {
+    char *end;
+    errno = 0;
+    value = strtoull(text, &end, 10);
+    return isdigit((unsigned char)*text) && !*end && errno != ERANGE && value >= 1 && value <= max;
+}
+
+int runBenchmark(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "number_converter", argc, argv);
+    size_t count = 200000;
+    for (int i = 1; i < argc; i++) {
+        unsigned long long value;
+        if (strncmp(argv[i], "--count=", 8) != 0) continue;
+        if (!parseCount(argv[i] + 8, 100000000, value)) {
+            usage();
+            return 2;
+        }
+        count = size_t(value);
+    }
+
+    // Numbers of every length, as decimal text
+    mt19937_64 rng(42);
+    string input;
+    for (size_t i = 0; i < count; i++) {
+        input += to_string(rng() >> (rng() % 64));
+        input += '\n';
+    }
+
+    // Output goes to /dev/null: we time the converting and the system
+    // calls, not the terminal
+    ofstream null_stream("/dev/null");
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (!null_stream || null_fd < 0) {
+        fprintf(stderr, "can't open /dev/null\n");
+        return 1;
+    }
+
+    numconv::Options opt;
+    opt.from = 10;
+    opt.to = 16;
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "A FAST NUMBER CONVERTER\n";
+        cout << "==================================================\n";
+        cout << "\nConverting " << count << " decimal numbers to hex (" << input.size() / 1024
+             << " KB of text), output to /dev/null.\n";
+        cout << "Checking all bases, and the threaded converter against streams: "
+             << (selfTest() ? "all correct!" : "MISMATCH!") << "\n";
+        cout << "Time below is per whole batch.\n";
+    } else if (!selfTest()) {
+        return 1;
+    }
+
+    bench_section(&suite, "1. One number per line:");
+    benchRun(suite, "istream >> / cout << endl", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) streamWithEndl(input, null_stream);
+    });
+    bench_rate(&suite, double(count), "number");
+    benchRun(suite, "istream >> / cout << '\\n'", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) streamWithNewline(input, null_stream);
+    });
+    bench_rate(&suite, double(count), "number");
+
+    unsigned cores = thread::hardware_concurrency();
+    unsigned max_threads = cores > 1 ? cores : 2;
+    string buffered;
+    for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+        // Small blocks, so even this input is split between the threads
+        numconv::Converter conv(opt, threads, input.size() / threads + 1);
+        string name = "buffered, " + to_string(threads) + " thread" + (threads == 1 ? "" : "s");
+        benchRun(suite, name.c_str(), [&](size_t n) {
+            for (size_t k = 0; k < n; k++) conv.convertMemory(input.data(), input.size(), null_fd);
+        });
+        bench_rate(&suite, double(count), "number");
+        if (threads == 1) buffered = name;
+    }
+    bench_compare(&suite, "istream >> / cout << endl", buffered.c_str());
+    bench_compare(&suite, "istream >> / cout << '\\n'", buffered.c_str());
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * endl = '\\n' + flush: one write() system call per line.\n";
+        cout << "   * Parsing and formatting by hand into one big buffer skips\n";
+        cout << "     the stream machinery (locale, formatting flags, sentries).\n";
+        cout << "   * More threads help once there are cores to run them (this\n";
+        cout << "     machine has " << cores << ").\n";
+    }
+
+    close(null_fd);
+    bench_finish(&suite);
+    return 0;
+}
+
+// ==================================================
+// The command-line tool
+// ==================================================
+
+bool parseBase(const char *text, int &base) {
+    unsigned long long value;
+    if (!parseCount(text, 16, value)) return false;
+    base = int(value);
+    return base == 2 || base == 8 || base == 10 || base == 16;
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) return runBenchmark(argc, argv);
+    }
+
+    numconv::Options opt;
+    unsigned threads = thread::hardware_concurrency();
+    const char *path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--from=", 7) == 0) {
+            if (!parseBase(arg + 7, opt.from)) { usage(); return 2; }
+        } else if (strncmp(arg, "--to=", 5) == 0) {
+            if (!parseBase(arg + 5, opt.to)) { usage(); return 2; }
+        } else if (strcmp(arg, "--prefix") == 0) {
+            opt.prefix = true;
+        } else if (strcmp(arg, "--upper") == 0) {
+            opt.upper = true;
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            // More threads than this only add chunks waiting for the writer
+            unsigned long long value;
+            if (!parseCount(arg + 10, ~0ull, value)) {
+                usage();
+                return 2;
+            }
+            threads = unsigned(min<unsigned long long>(value, kMaxThreads));
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            usage();
+            return 2;
+        } else {
+            path = arg;
+        }
+    }
+    if (threads == 0) threads = 1;
+
+    numconv::Converter conv(opt, threads);
+    numconv::Result result;
+    if (!path || strcmp(path, "-") == 0) {
+        result = conv.convertFd(STDIN_FILENO, STDOUT_FILENO);
+    } else {
+        int fd = open(path, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            perror(path);
+            return 1;
+        }
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            // A regular file: map it and let the threads read it in place
+            void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                perror("mmap");
+                return 1;
+            }
+            madvise(data, size_t(st.st_size), MADV_SEQUENTIAL);
+            result = conv.convertMemory(static_cast<const char *>(data), size_t(st.st_size), STDOUT_FILENO);
+            munmap(data, size_t(st.st_size));
+        } else {
+            result = conv.convertFd(fd, STDOUT_FILENO);
+        }
+        close(fd);
+    }
+
+    if (!result.ok()) {
+        if (result.status == numconv::Status::WriteFailed) {
+            perror("write");
+        } else if (result.status == numconv::Status::ReadFailed) {
+            perror("read");
+        } else {
+            fprintf(stderr, "number_converter: '%s' at byte %llu: %s\n", result.error.c_str(),
+                    static_cast<unsigned long long>(result.error_offset), numconv::statusText(result.status));
+        }
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ * UTF-8 in C++
+ * What is inside "Zoë 東京 😀" - and how fast can we check and decode it?
+ * Compile: g++ -O2 14_utf8.cpp -o utf8
+ * Run: ./utf8 [--mb=N] [--json] [--runs=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include "utf8.hpp"
+#include "bench.hpp"
+using namespace std;
+
+// The textbook decoder: one byte per step through a small state machine.
+// Returns the number of code points, or SIZE_MAX if the text is invalid.
+template <bool kWrite>
+size_t byteByByte(const char *data, size_t len, char32_t *out) {
+    size_t written = 0;
+    int need = 0;
+    char32_t value = 0, min = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t b = uint8_t(data[i]);
+        if (need == 0) {
+            if (b < 0x80) {
+                if (kWrite) out[written] = b;
+                written++;
+                continue;
+            }
+            if ((b & 0xE0) == 0xC0) { need = 1; value = b & 0x1F; min = 0x80; }
+            else if ((b & 0xF0) == 0xE0) { need = 2; value = b & 0x0F; min = 0x800; }
+            else if ((b & 0xF8) == 0xF0) { need = 3; value = b & 0x07; min = 0x10000; }
+            else return SIZE_MAX;
+        } else {
+            if ((b & 0xC0) != 0x80) return SIZE_MAX;
+            value = (value << 6) | (b & 0x3F);
+            if (--need == 0) {
+                if (value < min || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF)) return SIZE_MAX;
+                if (kWrite) out[written] = value;
+                written++;
+            }
+        }
+    }
+    return need == 0 ? written : SIZE_MAX;
+}
+
+// Encode one code point (for building test text)
+void append(string &text, char32_t cp) {
+    if (cp < 0x80) {
+        text += char(cp);
+    } else if (cp < 0x800) {
+        text += char(0xC0 | (cp >> 6));
+        text += char(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        text += char(0xE0 | (cp >> 12));
+        text += char(0x80 | ((cp >> 6) & 0x3F));
+        text += char(0x80 | (cp & 0x3F));
+    } else {
+        text += char(0xF0 | (cp >> 18));
+        text += char(0x80 | ((cp >> 12) & 0x3F));
+        text += char(0x80 | ((cp >> 6) & 0x3F));
+        text += char(0x80 | (cp & 0x3F));
+    }
+}
+
+char32_t randomCodePoint(mt19937_64 &rng) {
+    static const char32_t limits[] = {0x80, 0x800, 0x10000, 0x110000};
+    char32_t cp;
+    do {
+        cp = char32_t(rng() % limits[rng() % 4]);
+    } while (cp >= 0xD800 && cp <= 0xDFFF);
+    return cp;
+}
+
+// Both kernels must agree with each other (error and position), with the
+// byte-by-byte decoder (valid or not), and with the code points we encoded
+bool check(const string &text, const vector<char32_t> *expected) {
+    const char *data = text.data();
+    size_t len = text.size();
+    vector<char32_t> wide(len + 1), wide_best(len + 1), wide_simple(len + 1);
+    vector<char16_t> narrow(len + 1), narrow_best(len + 1);
+    utf8::Kernel best = utf8::bestKernel();
+
+    utf8::Result scalar = utf8::validateWith(utf8::Kernel::Scalar, data, len);
+    utf8::Result fast = utf8::validateWith(best, data, len);
+    if (scalar.error != fast.error || scalar.position != fast.position) return false;
+    bool simple_ok = byteByByte<true>(data, len, wide_simple.data()) != SIZE_MAX;
+    if (simple_ok != scalar.ok()) return false;
+    if (utf8::asciiLengthWith(utf8::Kernel::Scalar, data, len) != utf8::asciiLengthWith(best, data, len)) return false;
+
+    utf8::Result a = utf8::toUtf32With(utf8::Kernel::Scalar, data, len, wide.data());
+    utf8::Result b = utf8::toUtf32With(best, data, len, wide_best.data());
+    utf8::Result c = utf8::toUtf16With(utf8::Kernel::Scalar, data, len, narrow.data());
+    utf8::Result d = utf8::toUtf16With(best, data, len, narrow_best.data());
+    for (const utf8::Result *r : {&a, &b, &c, &d}) {
+        if (r->error != scalar.error || r->position != scalar.position) return false;
+    }
+    if (a.written != b.written || c.written != d.written) return false;
+    if (!equal(wide.begin(), wide.begin() + a.written, wide_best.begin())) return false;
+    if (!equal(narrow.begin(), narrow.begin() + c.written, narrow_best.begin())) return false;
+    if (expected && (a.written != expected->size() || !equal(expected->begin(), expected->end(), wide.begin()))) return false;
+    return true;
+}
+
+bool selfTest() {
+    mt19937_64 rng(5);
+    // Random text, sometimes with a few bytes broken
+    for (int round = 0; round < 20000; round++) {
+        string text;
+        vector<char32_t> cps;
+        size_t count = rng() % 120;
+        bool ascii_run = rng() % 2;
+        for (size_t i = 0; i < count; i++) {
+            char32_t cp = ascii_run && rng() % 8 ? char32_t(32 + rng() % 95) : randomCodePoint(rng);
+            cps.push_back(cp);
+            append(text, cp);
+        }
+        if (round % 3 == 0 || text.empty()) {
+            if (!check(text, &cps)) return false;
+        } else {
+            for (uint64_t breaks = 1 + rng() % 3; breaks > 0; breaks--) text[rng() % text.size()] = char(rng());
+            if (rng() % 4 == 0) text.resize(rng() % text.size());
+            if (!check(text, nullptr)) return false;
+        }
+    }
+    // Known bad (and almost bad) sequences, at every spot around the
+    // 32- and 64-byte block edges
+    const char *cases[] = {"\xC0\x80", "\xC1\xBF", "\xC2\x80", "\xE0\x9F\xBF", "\xE0\xA0\x80", "\xED\x9F\xBF",
+                           "\xED\xA0\x80", "\xEF\xBF\xBF", "\xF0\x8F\xBF\xBF", "\xF0\x90\x80\x80",
+                           "\xF4\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xF8", "\xFF", "\x80",
+                           "\xC3", "\xE2\x82", "\xF0\x9F\x98", "\xC3\xA9\xA9", "\xE2\x82\xAC\x80"};
+    for (const char *bad : cases) {
+        for (size_t before = 0; before < 140; before++) {
+            for (size_t after : {0, 1, 5, 40}) {
+                string text = string(before, 'a') + bad + string(after, 'b');
+                if (!check(text, nullptr)) return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Sample text: mostly English, or a mix of scripts
+string makeCorpus(size_t bytes, bool multilingual) {
+    static const char *english[] = {"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "and",
+                                    "runs", "through", "a", "field", "of", "numbers", "bits", "bytes"};
+    static const char *accented[] = {"café", "naïve", "Zoë", "résumé", "—", "“quoted”", "Ångström"};
+    static const char *world[] = {"Καλημέρα", "κόσμε", "Привет", "мир", "東京", "日本語", "中文字符", "こんにちは",
+                                  "مرحبا", "नमस्ते", "안녕하세요", "😀", "🚀", "naïve", "hello", "world", "ñandú"};
+    mt19937_64 rng(multilingual ? 2 : 1);
+    string text;
+    while (text.size() < bytes) {
+        if (multilingual) text += world[rng() % (sizeof(world) / sizeof(world[0]))];
+        else if (rng() % 50 == 0) text += accented[rng() % (sizeof(accented) / sizeof(accented[0]))];
+        else text += english[rng() % (sizeof(english) / sizeof(english[0]))];
+        text += rng() % 12 == 0 ? ".\n" : " ";
+    }
+    // Cut at a character boundary
+    size_t end = bytes;
+    while (end > 0 && (uint8_t(text[end]) & 0xC0) == 0x80) end--;
+    text.resize(end);
+    return text;
+}
+
+void showBreakdown(const string &text) {
+    vector<utf8::CodePoint> cps;
+    utf8::codePoints(text.data(), text.size(), cps);
+    cout << "   \"" << text << "\" is " << text.size() << " bytes but " << cps.size() << " characters:\n\n";
+    cout << "   char  code point  bytes  bits (marker|payload)                    payload = value\n";
+    for (const utf8::CodePoint &cp : cps) {
+        char code[16];
+        snprintf(code, sizeof(code), "U+%04X", unsigned(cp.value));
+        string bits = utf8::byteBits(text.data(), cp);
+        // CJK and emoji take two columns on the terminal; show a space as "sp"
+        string shown = cp.value == ' ' ? "sp" : text.substr(cp.offset, size_t(cp.length));
+        int columns = cp.value == ' ' || cp.length >= 3 ? 2 : 1;
+        cout << "   " << shown << string(size_t(6 - columns), ' ') << left << setw(12) << code << setw(7)
+             << cp.length << setw(41) << bits << utf8::payloadBits(cp) << right << "\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "utf8", argc, argv);
+    size_t mb = 4;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--mb=", 5) == 0) mb = strtoull(argv[i] + 5, nullptr, 10);
+    }
+    if (mb == 0) mb = 1;
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "UTF-8 IN C++\n";
+        cout << "==================================================\n";
+        cout << "\n1. One byte is not one character:\n";
+        showBreakdown("Zoë 東京 😀");
+        cout << "\n   Checking the kernels against each other and a byte-by-byte decoder: "
+             << (selfTest() ? "all correct!" : "MISMATCH!") << "\n";
+        cout << "   Best kernel on this CPU: " << utf8::kernelName(utf8::bestKernel()) << "\n";
+        string bad = "Zo\xC3";
+        utf8::Result r = utf8::validate(bad.data(), bad.size());
+        cout << "   \"Zo\\xC3\": " << utf8::errorText(r.error) << " at byte " << r.position << "\n";
+    } else if (!selfTest()) {
+        return 1;
+    }
+
+    vector<char32_t> wide(mb << 20);
+    vector<char16_t> narrow(mb << 20);
+    int section = 2;
+    for (bool multilingual : {false, true}) {
+        string text = makeCorpus(mb << 20, multilingual);
+        size_t ascii = 0;
+        for (char c : text) ascii += (uint8_t(c) & 0x80) == 0;
+        string title = to_string(section++) + (multilingual ? ". Mixed scripts" : ". Mostly English") + " (" +
+                       to_string(mb) + " MB, " + to_string(100 * ascii / text.size()) + "% ASCII bytes):";
+        bench_section(&suite, title.c_str());
+        const char *data = text.data();
+        size_t len = text.size();
+
+        benchRun(suite, "validate: byte by byte", [&](size_t n) {
+            for (size_t k = 0; k < n; k++) doNotOptimize(byteByByte<false>(data, len, nullptr));
+        });
+        bench_rate(&suite, double(len), "B");
+        for (utf8::Kernel kernel : {utf8::Kernel::Scalar, utf8::bestKernel()}) {
+            string name = string("validate: ") + utf8::kernelName(kernel);
+            benchRun(suite, name.c_str(), [&](size_t n) {
+                for (size_t k = 0; k < n; k++) doNotOptimize(utf8::validateWith(kernel, data, len).position);
+            });
+            bench_rate(&suite, double(len), "B");
+            if (kernel == utf8::bestKernel()) break;
+        }
+        bench_compare(&suite, "validate: byte by byte",
+                      (string("validate: ") + utf8::kernelName(utf8::bestKernel())).c_str());
+
+        benchRun(suite, "UTF-32: byte by byte", [&](size_t n) {
+            for (size_t k = 0; k < n; k++) doNotOptimize(byteByByte<true>(data, len, wide.data()));
+        });
+        bench_rate(&suite, double(len), "B");
+        for (utf8::Kernel kernel : {utf8::Kernel::Scalar, utf8::bestKernel()}) {
+            string name = string("UTF-32: ") + utf8::kernelName(kernel);
+            benchRun(suite, name.c_str(), [&](size_t n) {
+                for (size_t k = 0; k < n; k++) doNotOptimize(utf8::toUtf32With(kernel, data, len, wide.data()).written);
+            });
+            bench_rate(&suite, double(len), "B");
+            if (kernel == utf8::bestKernel()) break;
+        }
+        for (utf8::Kernel kernel : {utf8::Kernel::Scalar, utf8::bestKernel()}) {
+            string name = string("UTF-16: ") + utf8::kernelName(kernel);
+            benchRun(suite, name.c_str(), [&](size_t n) {
+                for (size_t k = 0; k < n; k++) doNotOptimize(utf8::toUtf16With(kernel, data, len, narrow.data()).written);
+            });
+            bench_rate(&suite, double(len), "B");
+            if (kernel == utf8::bestKernel()) break;
+        }
+        bench_compare(&suite, "UTF-32: byte by byte",
+                      (string("UTF-32: ") + utf8::kernelName(utf8::bestKernel())).c_str());
+    }
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * UTF-8 characters are 1-4 bytes; the first byte says how many.\n";
+        cout << "   * Checking is a handful of table lookups per 32 bytes, whatever\n";
+        cout << "     the language - so the vector check wins most on mixed scripts.\n";
+        cout << "   * Plain ASCII is valid UTF-8: one test per 64 bytes skips it.\n";
+        cout << "   * Decoding non-ASCII one character at a time stays the slow\n";
+        cout << "     part; ASCII runs are widened 32 bytes at once.\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
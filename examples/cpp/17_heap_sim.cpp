@@ -0,0 +1,332 @@
+/*
+ * Simulating malloc: Five Ways to Place a Block
+ * First-fit, best-fit, segregated lists, buddy and slab on the same traces.
+ * Compile: g++ -O2 17_heap_sim.cpp -o heap_sim
+ * Run: ./heap_sim [--trace=FILE] [--snapshot=PREFIX] [--save-trace=FILE]
+ *                 [--ops=N] [--heap-mb=N] [--json] [--runs=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <memory>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "heap_sim.hpp"
+#include "bench.hpp"
+using namespace std;
+using namespace heapsim;
+
+struct Random {
+    uint64_t state;
+    explicit Random(uint64_t seed) : state(seed) {}
+    uint64_t next() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return state >> 33;
+    }
+    uint64_t below(uint64_t n) { return next() % n; }
+};
+
+// Blocks in use must not overlap, every address is 16-byte aligned, the
+// counters match what we asked for, and once all is freed the coalescing
+// and buddy heaps are one big hole again
+bool checkPolicy(const string &policy) {
+    unique_ptr<Heap> heap = makeHeap(policy, 16 << 20);
+    Random rng(42);
+    vector<pair<uint64_t, uint64_t>> live;  // address, size
+    uint64_t requested = 0;
+    for (int i = 0; i < 20000; i++) {
+        if (live.empty() || rng.below(3) != 0) {
+            uint64_t size = rng.below(8) == 0 ? 1 + rng.below(20000) : 1 + rng.below(600);
+            uint64_t address = heap->allocate(size);
+            if (address == kNoAddress || address % 16) return false;
+            live.emplace_back(address, size);
+            requested += size;
+        } else {
+            size_t k = size_t(rng.below(live.size()));
+            if (!heap->release(live[k].first)) return false;
+            requested -= live[k].second;
+            live[k] = live.back();
+            live.pop_back();
+        }
+        if (heap->counters().requested != requested) return false;
+        if (i % 5000 == 4999) {
+            vector<Span> spans;
+            heap->walk([&](const Span &span) { spans.push_back(span); });
+            sort(spans.begin(), spans.end(), [](const Span &a, const Span &b) { return a.address < b.address; });
+            for (size_t j = 1; j < spans.size(); j++) {
+                if (spans[j - 1].address + spans[j - 1].size > spans[j].address) return false;
+            }
+        }
+    }
+    if (heap->release(live.empty() ? 0 : live[0].first + 1)) return false;  // not a block
+    for (auto &block : live) heap->release(block.first);
+    if (heap->release(live[0].first)) return false;  // freed twice
+    HeapStats s = heap->stats();
+    if (s.requested != 0 || s.allocated != 0 || s.top != 0) return false;
+    size_t spans = 0;
+    heap->walk([&](const Span &) { spans++; });
+    return policy == "slab" || spans == 1;
+}
+
+bool selfTest() {
+    for (const string &policy : policyNames()) {
+        if (!checkPolicy(policy)) return false;
+    }
+    Trace trace = parseTrace("# a comment\na 1 100\nrealloc 1 200  # grow\n\nf 0x1\na 2 0\n");
+    Trace bad = parseTrace("a 1 100\nx 1\n");
+    return trace.ok() && trace.ops.size() == 4 && trace.blocks == 2 && trace.ops[1].kind == Op::Realloc &&
+           trace.ops[1].size == 200 && trace.ops[2].block == 0 && !bad.ok() && bad.error_line == 2;
+}
+
+// The first bytes of the heap, 16 per character: a letter per block, '.' free
+void drawHeap(const Heap &heap, const map<uint64_t, char> &letters, int width) {
+    string line(size_t(width), ' ');
+    heap.walk([&](const Span &span) {
+        char c = '.';
+        if (span.used) {
+            auto it = letters.lower_bound(span.address);
+            c = it != letters.end() && it->first < span.address + span.size ? it->second : '#';
+        }
+        for (uint64_t a = span.address / 16; a < (span.address + span.size + 15) / 16 && a < uint64_t(width); a++) {
+            line[a] = c;
+        }
+    });
+    cout << "   " << left << setw(11) << heap.name() << right << line << "\n";
+}
+
+// ==================================================
+// Synthetic workloads
+// ==================================================
+
+// Mostly small objects that live a short while (a server handling requests)
+Trace shortLived(size_t ops, uint64_t seed) {
+    Random rng(seed);
+    Trace trace;
+    vector<uint32_t> live;
+    uint32_t next = 0;
+    while (trace.ops.size() < ops) {
+        if (live.size() < 20000 && (live.size() < 1000 || rng.below(2) == 0)) {
+            uint64_t pick = rng.below(100);
+            uint64_t size = pick < 70 ? 16 + rng.below(112) : pick < 95 ? 128 + rng.below(896) : 1024 + rng.below(15360);
+            trace.alloc(next, size);
+            live.push_back(next++);
+        } else {
+            size_t k = size_t(rng.below(live.size()));
+            trace.free(live[k]);
+            live[k] = live.back();
+            live.pop_back();
+        }
+    }
+    return trace;
+}
+
+// Build 50000 objects, free 90% of them, repeat: the survivors are
+// scattered through the heap and pin it down
+Trace phases(size_t ops, uint64_t seed) {
+    Random rng(seed);
+    Trace trace;
+    vector<uint32_t> batch;
+    uint32_t next = 0;
+    while (trace.ops.size() < ops) {
+        for (int i = 0; i < 50000 && trace.ops.size() < ops; i++) {
+            trace.alloc(next, 16 + rng.below(2032));
+            batch.push_back(next++);
+        }
+        for (uint32_t block : batch) {
+            if (trace.ops.size() >= ops) break;
+            if (rng.below(10) != 0) trace.free(block);
+        }
+        batch.clear();
+    }
+    return trace;
+}
+
+// Small objects mixed with buffers that grow by doubling (like vectors)
+// from 64 bytes up to 1 MB, then go away
+Trace growing(size_t ops, uint64_t seed) {
+    Random rng(seed);
+    Trace trace;
+    vector<uint32_t> small;
+    vector<pair<uint32_t, uint64_t>> buffers;  // id, size
+    uint32_t next = 0;
+    while (trace.ops.size() < ops) {
+        uint64_t pick = rng.below(100);
+        if (pick < 45) {
+            trace.alloc(next, 16 + rng.below(240));
+            small.push_back(next++);
+        } else if (pick < 85 && !small.empty()) {
+            size_t k = size_t(rng.below(small.size()));
+            trace.free(small[k]);
+            small[k] = small.back();
+            small.pop_back();
+        } else if (buffers.size() < 64 && pick < 90) {
+            trace.alloc(next, 64);
+            buffers.emplace_back(next++, 64);
+        } else if (!buffers.empty()) {
+            size_t k = size_t(rng.below(buffers.size()));
+            if (buffers[k].second >= (uint64_t(1) << (10 + rng.below(11)))) {
+                trace.free(buffers[k].first);
+                buffers[k] = buffers.back();
+                buffers.pop_back();
+            } else {
+                buffers[k].second *= 2;
+                trace.realloc(buffers[k].first, buffers[k].second);
+            }
+        }
+    }
+    return trace;
+}
+
+struct Workload {
+    string name;
+    string key;
+    Trace trace;
+};
+
+// Replay a whole trace on each policy and print what it did to the heap
+void compareOnTrace(bench_suite &suite, const Workload &w, uint64_t capacity, const char *snapshot) {
+    if (!suite.quiet) {
+        cout << "\n   " << w.name << " (" << w.trace.ops.size() << " calls):\n";
+        cout << "   policy       heap needed  utilization  internal  external  failed   replay\n";
+    }
+    for (const string &policy : policyNames()) {
+        unique_ptr<Heap> heap = makeHeap(policy, capacity);
+        Replayer replayer(*heap, w.trace);
+        uint64_t t0 = bench_now_ns();
+        replayer.run();
+        double seconds = double(bench_now_ns() - t0) / 1e9;
+        HeapStats s = heap->stats();
+        if (!suite.quiet) {
+            cout << "   " << left << setw(11) << policy << right << fixed << setprecision(1) << setw(10)
+                 << double(s.peak_top) / (1 << 20) << " MB" << setw(12) << s.utilization() * 100 << "%" << setw(9)
+                 << s.internalFragmentation() * 100 << "%" << setw(9) << s.externalFragmentation() * 100 << "%"
+                 << setw(8) << s.failures << setw(7) << setprecision(2) << seconds << " s\n";
+            cout.unsetf(ios::floatfield);
+        }
+        bench_info_number(&suite, ("utilization_" + w.key + "_" + policy).c_str(), s.utilization());
+        if (snapshot) {
+            string path = string(snapshot) + "-" + policy + ".json";
+            ofstream out(path);
+            writeSnapshot(out, *heap);
+            if (!suite.quiet && !out) cout << "   (could NOT write " << path << ")\n";
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "heap_sim", argc, argv);
+    const char *trace_path = nullptr, *snapshot = nullptr, *save_path = nullptr;
+    size_t ops = 1000000;
+    uint64_t capacity = uint64_t(1) << 30;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--trace=", 8) == 0) trace_path = argv[i] + 8;
+        else if (strncmp(argv[i], "--snapshot=", 11) == 0) snapshot = argv[i] + 11;
+        else if (strncmp(argv[i], "--save-trace=", 13) == 0) save_path = argv[i] + 13;
+        else if (strncmp(argv[i], "--ops=", 6) == 0) ops = size_t(max(1000ll, atoll(argv[i] + 6)));
+        else if (strncmp(argv[i], "--heap-mb=", 10) == 0) capacity = uint64_t(max(1ll, atoll(argv[i] + 10))) << 20;
+    }
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "SIMULATING MALLOC: FIVE WAYS TO PLACE A BLOCK\n";
+        cout << "==================================================\n";
+        cout << "\nChecking every policy (20000 random calls, overlaps, coalescing, traces): "
+             << (selfTest() ? "all correct!" : "MISMATCH!") << "\n";
+
+        // Eight 100-byte blocks, free every other one, then ask for 40 and 300 bytes
+        cout << "\n1. malloc(100) x 8 (A-H), free B, D, F, then malloc(40) = I, malloc(300) = J:\n";
+        cout << "   (16 bytes per character, '.' = free)\n";
+        for (const string &policy : policyNames()) {
+            unique_ptr<Heap> heap = makeHeap(policy, 1 << 20);
+            map<uint64_t, char> letters;
+            uint64_t blocks[8];
+            for (int i = 0; i < 8; i++) letters[blocks[i] = heap->allocate(100)] = char('A' + i);
+            for (int i = 1; i < 7; i += 2) {
+                heap->release(blocks[i]);
+                letters.erase(blocks[i]);
+            }
+            letters[heap->allocate(40)] = 'I';
+            letters[heap->allocate(300)] = 'J';
+            drawHeap(*heap, letters, 96);
+        }
+        cout << "   (first- and best-fit put I in B's hole; the segregated list hands out\n";
+        cout << "    the newest hole, F's; buddy rounds 100 up to 128; slab puts I and J\n";
+        cout << "    in slabs of 48- and 320-byte objects, further up)\n";
+    } else if (!selfTest()) {
+        return 1;
+    }
+
+    vector<Workload> workloads;
+    if (trace_path) {
+        Trace trace = loadTrace(trace_path);
+        if (!trace.ok()) {
+            cerr << trace_path << ":" << trace.error_line << ": " << trace.error << "\n";
+            return 1;
+        }
+        workloads.push_back({trace_path, "trace", std::move(trace)});
+    } else {
+        workloads.push_back({"Short-lived small objects", "short", shortLived(ops, 1)});
+        workloads.push_back({"Build 50000, keep 10%, repeat", "phases", phases(ops, 2)});
+        workloads.push_back({"Small objects + doubling buffers", "growing", growing(ops, 3)});
+    }
+    if (save_path) {
+        ofstream out(save_path);
+        saveTrace(out, workloads[0].trace);
+    }
+
+    if (!suite.quiet) {
+        cout << "\n2. Replaying traces (" << (capacity >> 20) << " MB address space):\n";
+        cout << "   heap needed = highest address used; utilization = most live data / that;\n";
+        cout << "   internal = headers + rounding; external = free space outside the largest hole\n";
+    }
+    for (size_t i = 0; i < workloads.size(); i++) {
+        // Snapshots of the last trace: the end of the "growing" one, or yours
+        compareOnTrace(suite, workloads[i], capacity, i + 1 == workloads.size() ? snapshot : nullptr);
+    }
+    if (snapshot && !suite.quiet) cout << "\n   Snapshots written to " << snapshot << "-<policy>.json\n";
+
+    // Calls per second: the trace is replayed again from the start on a
+    // new heap whenever it runs out
+    const Trace &trace = workloads[0].trace;
+    bench_section(&suite, "3. Replay speed (one call = one malloc, realloc or free):");
+    for (const string &policy : policyNames()) {
+        unique_ptr<Heap> heap = makeHeap(policy, capacity);
+        unique_ptr<Replayer> replayer = make_unique<Replayer>(*heap, trace);
+        benchRun(suite, policy.c_str(), [&](size_t n) {
+            while (n) {
+                size_t before = replayer->position();
+                replayer->step(n);
+                n -= replayer->position() - before;
+                if (replayer->done()) {
+                    replayer.reset();
+                    heap = makeHeap(policy, capacity);
+                    replayer = make_unique<Replayer>(*heap, trace);
+                }
+            }
+        });
+    }
+    bench_compare(&suite, "first-fit", "segregated");
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * A bump pointer never reuses memory; a real heap must pick a\n";
+        cout << "     hole - and which hole decides how much memory is wasted.\n";
+        cout << "   * Merging free neighbours (coalescing) turns small holes back\n";
+        cout << "     into big ones; boundary tags find the neighbours in O(1).\n";
+        cout << "   * Buddy blocks merge with one XOR but round up to powers of two;\n";
+        cout << "     slabs have no headers but keep memory for each size.\n";
+        cout << "   * There is no best policy: replay YOUR program's trace.\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
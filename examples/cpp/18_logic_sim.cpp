@@ -0,0 +1,385 @@
+/*
+ * Simulating Logic Gates 64 at a Time
+ * One AND instruction, 64 (or 256) truth-table rows: bit-parallel simulation.
+ * Compile: g++ -O2 18_logic_sim.cpp -o logic_sim
+ * Run: ./logic_sim [--netlist=FILE] [--max-gates=N] [--json] [--runs=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <bitset>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "logic_sim.hpp"
+#include "bench.hpp"
+using namespace std;
+using namespace logicsim;
+
+const char *kFullAdder =
+    "# full adder\n"
+    "INPUT(a) INPUT(b) INPUT(cin)\n"
+    "OUTPUT(sum) OUTPUT(cout)\n"
+    "sum  = XOR(a, b, cin)\n"
+    "cout = OR(ab, ct)\n"
+    "ab   = AND(a, b)\n"
+    "ct   = AND(cin, x)\n"
+    "x    = XOR(a, b)\n";
+
+struct Random {
+    uint64_t state;
+    explicit Random(uint64_t seed) : state(seed) {}
+    uint64_t next() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return state >> 33;
+    }
+    uint64_t below(uint64_t n) { return next() % n; }
+};
+
+// Bit `vector` of output o after a pass
+static bool outputBit(const Simulator &sim, const uint64_t *out, size_t o, uint64_t vector) {
+    return out[o * size_t(sim.words()) + vector / 64] >> (vector % 64) & 1;
+}
+
+// The slow way, for checking: one gate, one input set at a time (like
+// LogicGates.jsx), going over the gates until nothing changes
+vector<bool> evalOne(const Netlist &net, const vector<bool> &inputs) {
+    vector<int> value(net.names.size(), -1);
+    for (size_t i = 0; i < net.inputs.size(); i++) value[net.inputs[i]] = inputs[i];
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const Gate &g : net.gates) {
+            if (value[g.output] >= 0) continue;
+            bool ready = true;
+            for (uint32_t s : g.inputs) ready = ready && value[s] >= 0;
+            if (!ready) continue;
+            bool a = value[g.inputs[0]];
+            for (size_t i = 1; i < g.inputs.size(); i++) {
+                bool b = value[g.inputs[i]];
+                switch (g.type) {
+                case GateType::And: case GateType::Nand: a = a && b; break;
+                case GateType::Or:  case GateType::Nor:  a = a || b; break;
+                default:                                 a = a != b; break;
+                }
+            }
+            bool inverted = g.type == GateType::Nand || g.type == GateType::Nor || g.type == GateType::Xnor ||
+                            g.type == GateType::Not;
+            value[g.output] = a != inverted;
+            changed = true;
+        }
+    }
+    vector<bool> out;
+    for (uint32_t s : net.outputs) out.push_back(value[s] == 1);
+    return out;
+}
+
+// `gates` random gates over `inputs` inputs. Most gates read recent
+// signals (as in real circuits, nearby logic talks to nearby logic); the
+// signals nobody reads become the outputs.
+Netlist randomCircuit(size_t gates, size_t inputs, uint64_t seed) {
+    Random rng(seed);
+    Netlist net;
+    for (size_t i = 0; i < inputs; i++) net.addInput("i" + to_string(i));
+    vector<bool> read(inputs + gates, false);
+    auto pick = [&](size_t k) -> uint32_t {
+        size_t total = inputs + k;
+        size_t s = rng.below(8) != 0 && total > 64 ? total - 1 - rng.below(64) : rng.below(total);
+        read[s] = true;
+        return uint32_t(s);
+    };
+    for (size_t k = 0; k < gates; k++) {
+        GateType type = GateType(rng.below(7));
+        uint32_t out = net.signal("g" + to_string(k));
+        if (type == GateType::Not) net.addGate(type, out, {pick(k)});
+        else net.addGate(type, out, {pick(k), pick(k)});
+    }
+    for (size_t s = inputs; s < inputs + gates; s++) {
+        if (!read[s]) net.outputs.push_back(uint32_t(s));
+    }
+    return net;
+}
+
+// Two adders for a + b that must agree: ripple carry (one bit after the
+// other) and Kogge-Stone (carries in log2(bits) rounds), and a "miter"
+// that ORs together every place where their sums differ. `bug` breaks one
+// gate of the fast adder.
+Netlist adderMiter(int bits, bool bug) {
+    Netlist net;
+    auto name = [](const char *prefix, int i) { return string(prefix) + to_string(i); };
+    auto gate = [&](GateType type, const string &out, vector<string> in) {
+        vector<uint32_t> ids;
+        for (const string &s : in) ids.push_back(net.signal(s));
+        net.addGate(type, net.signal(out), ids);
+    };
+    for (int i = 0; i < bits; i++) net.addInput(name("a", i));
+    for (int i = 0; i < bits; i++) net.addInput(name("b", i));
+    // Ripple carry
+    for (int i = 0; i < bits; i++) {
+        string a = name("a", i), b = name("b", i), c = name("rc", i);
+        if (i == 0) {
+            gate(GateType::Xor, name("rs", i), {a, b});
+            gate(GateType::And, name("rc", i + 1), {a, b});
+            continue;
+        }
+        gate(GateType::Xor, name("rs", i), {a, b, c});
+        gate(GateType::And, name("rab", i), {a, b});
+        gate(GateType::And, name("rcx", i), {c, name("p0_", i)});
+        gate(GateType::Or, name("rc", i + 1), {name("rab", i), name("rcx", i)});
+    }
+    // Kogge-Stone: generate/propagate pairs combined over distance 1, 2, 4...
+    for (int i = 0; i < bits; i++) {
+        gate(GateType::And, name("g0_", i), {name("a", i), name("b", i)});
+        gate(GateType::Xor, name("p0_", i), {name("a", i), name("b", i)});
+    }
+    int round = 0;
+    for (int d = 1; d < bits; d *= 2, round++) {
+        string g = "g" + to_string(round) + "_", p = "p" + to_string(round) + "_";
+        string g2 = "g" + to_string(round + 1) + "_", p2 = "p" + to_string(round + 1) + "_";
+        for (int i = 0; i < bits; i++) {
+            if (i < d) {
+                gate(GateType::And, name(g2.c_str(), i), {name(g.c_str(), i)});
+                gate(GateType::And, name(p2.c_str(), i), {name(p.c_str(), i)});
+                continue;
+            }
+            gate(GateType::And, name("t", round * bits + i), {name(p.c_str(), i), name(g.c_str(), i - d)});
+            gate(GateType::Or, name(g2.c_str(), i), {name(g.c_str(), i), name("t", round * bits + i)});
+            gate(GateType::And, name(p2.c_str(), i), {name(p.c_str(), i), name(p.c_str(), i - d)});
+        }
+    }
+    string carry = "g" + to_string(round) + "_";
+    for (int i = 0; i < bits; i++) {
+        if (i == 0) gate(GateType::And, name("ks", i), {name("p0_", i)});
+        else gate(bug && i == bits - 2 ? GateType::Or : GateType::Xor, name("ks", i),
+                  {name("p0_", i), name(carry.c_str(), i - 1)});
+        gate(GateType::Xor, name("diff", i), {name("rs", i), name("ks", i)});
+    }
+    gate(GateType::Xor, "diffc", {name("rc", bits), name(carry.c_str(), bits - 1)});
+    vector<string> diffs = {"diffc"};
+    for (int i = 0; i < bits; i++) diffs.push_back(name("diff", i));
+    gate(GateType::Or, "differ", diffs);
+    net.addOutput("differ");
+    return net;
+}
+
+// Both kernels agree with one-at-a-time evaluation
+bool checkCircuit(const Netlist &net, uint64_t seed) {
+    Circuit circuit = Circuit::compile(net);
+    if (!circuit.ok()) return false;
+    for (Kernel kernel : {Kernel::Scalar, Kernel::Avx2}) {
+        Simulator sim(circuit, kernel);
+        bool ok = true;
+        sim.random(2, seed, [&](uint64_t, const uint64_t *in, const uint64_t *out) {
+            for (uint64_t v = 0; v < uint64_t(sim.vectors()) && ok; v += 7) {
+                vector<bool> inputs;
+                for (size_t i = 0; i < circuit.inputCount(); i++) inputs.push_back(outputBit(sim, in, i, v));
+                vector<bool> expect = evalOne(net, inputs);
+                for (size_t o = 0; o < expect.size(); o++) ok = ok && outputBit(sim, out, o, v) == expect[o];
+            }
+            return ok;
+        });
+        if (!ok) return false;
+    }
+    return true;
+}
+
+bool selfTest() {
+    // The full adder, every row: sum + 2*cout == a + b + cin
+    Circuit adder = Circuit::compile(Netlist::parse(kFullAdder));
+    if (!adder.ok()) return false;
+    for (Kernel kernel : {Kernel::Scalar, Kernel::Avx2}) {
+        Simulator sim(adder, kernel);
+        bool ok = true;
+        sim.exhaustive([&](uint64_t, const uint64_t *, const uint64_t *out) {
+            for (uint64_t v = 0; v < uint64_t(sim.vectors()); v++) {
+                int total = int(v & 1) + int(v >> 1 & 1) + int(v >> 2 & 1);
+                ok = ok && outputBit(sim, out, 0, v) + 2 * outputBit(sim, out, 1, v) == total;
+            }
+            return true;
+        });
+        if (!ok) return false;
+    }
+    if (!checkCircuit(randomCircuit(400, 12, 7), 11) || !checkCircuit(adderMiter(5, true), 13)) return false;
+
+    // Mistakes in the netlist are reported, not simulated
+    Circuit loop = Circuit::compile(Netlist::parse("INPUT(a)\nOUTPUT(y)\nx = AND(a, y)\ny = NOT(x)\n"));
+    Circuit undriven = Circuit::compile(Netlist::parse("INPUT(a)\nOUTPUT(y)\ny = OR(a, z)\n"));
+    Netlist typo = Netlist::parse("INPUT(a)\ny = AMD(a, a)\n");
+    return !loop.ok() && !undriven.ok() && !typo.ok() && typo.error_line == 2;
+}
+
+// Exhaustive equivalence check of the two adders: the miter must be 0
+// for every input. Prints the first a, b where it isn't.
+void checkAdders(bench_suite &suite, int bits, bool bug) {
+    Circuit miter = Circuit::compile(adderMiter(bits, bug));
+    Simulator sim(miter);
+    uint64_t failing = ~uint64_t(0);
+    uint64_t t0 = bench_now_ns();
+    uint64_t passes = sim.exhaustive([&](uint64_t first, const uint64_t *, const uint64_t *out) {
+        for (int w = 0; w < sim.words(); w++) {
+            if (out[w]) {
+                failing = first + 64 * uint64_t(w) + uint64_t(__builtin_ctzll(out[w]));
+                return false;
+            }
+        }
+        return true;
+    });
+    double ms = double(bench_now_ns() - t0) / 1e6;
+    if (suite.quiet) return;
+    uint64_t tried = min(passes * uint64_t(sim.vectors()), uint64_t(1) << (2 * bits));
+    cout << "   " << (bug ? "with one OR where an XOR belongs: " : "as designed: ") << miter.gateCount()
+         << " gates, " << tried << " of " << (uint64_t(1) << (2 * bits)) << " input pairs in " << fixed
+         << setprecision(1) << ms << " ms\n";
+    cout.unsetf(ios::floatfield);
+    if (failing == ~uint64_t(0)) {
+        cout << "   -> the adders agree on every input\n";
+    } else {
+        uint64_t mask = (uint64_t(1) << bits) - 1;
+        cout << "   -> they differ for a = " << (failing & mask) << ", b = " << (failing >> bits) << "\n";
+    }
+}
+
+// One input set per pass, one byte per wire: the loop LogicGates.jsx runs
+void runOneAtATime(const Circuit &circuit, uint8_t *v) {
+    for (const Instr &g : circuit.instructions()) {
+        uint8_t a = v[g.a], b = v[g.b];
+        switch (g.op) {
+        case GateType::And:  v[g.out] = a & b; break;
+        case GateType::Or:   v[g.out] = a | b; break;
+        case GateType::Xor:  v[g.out] = a ^ b; break;
+        case GateType::Nand: v[g.out] = !(a & b); break;
+        case GateType::Nor:  v[g.out] = !(a | b); break;
+        case GateType::Xnor: v[g.out] = !(a ^ b); break;
+        case GateType::Not:  v[g.out] = !a; break;
+        }
+    }
+}
+
+// Gate evaluations per second: one vector, 64 and 256 per pass
+void benchCircuit(bench_suite &suite, const Circuit &circuit, const string &section, const string &label) {
+    string title = section + " " + to_string(circuit.gateCount()) + " gates, " + to_string(circuit.levels()) +
+                   " levels, " + to_string(circuit.slots()) + " wires stored:";
+    bench_section(&suite, title.c_str());
+    double gates = double(circuit.gateCount());
+    vector<uint8_t> bytes(circuit.slots(), 0);
+    Random rng(5);
+    string name = label + ", 1 vector";
+    benchRun(suite, name.c_str(), [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            for (size_t i = 0; i < circuit.inputCount(); i++) bytes[i] = uint8_t(rng.next() & 1);
+            runOneAtATime(circuit, bytes.data());
+            doNotOptimize(bytes[circuit.outputSlots().empty() ? 0 : circuit.outputSlots()[0]]);
+        }
+    });
+    bench_rate(&suite, gates, "gate");
+    for (Kernel kernel : {Kernel::Scalar, Kernel::Avx2}) {
+        Simulator sim(circuit, kernel);
+        if (kernel == Kernel::Avx2 && sim.kernel() != Kernel::Avx2) break;
+        vector<uint64_t> in(circuit.inputCount() * size_t(sim.words())), out(circuit.outputCount() * size_t(sim.words()));
+        for (uint64_t &word : in) word = rng.next() << 32 ^ rng.next();
+        name = label + ", " + to_string(sim.vectors()) + " vectors";
+        benchRun(suite, name.c_str(), [&](size_t n) {
+            for (size_t k = 0; k < n; k++) {
+                in[0] ^= k;
+                sim.run(in.data(), out.data());
+                doNotOptimize(out);
+            }
+        });
+        bench_rate(&suite, gates * sim.vectors(), "gate");
+        const bench_result *one = bench_find(&suite, (label + ", 1 vector").c_str());
+        const bench_result *many = bench_find(&suite, name.c_str());
+        if (!suite.quiet && one && many && one->rate > 0) {
+            cout << "   -> " << fixed << setprecision(0) << many->rate / one->rate
+                 << "x the gates per second of one vector at a time\n";
+            cout.unsetf(ios::floatfield);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "logic_sim", argc, argv);
+    const char *netlist_path = nullptr;
+    size_t max_gates = 1000000;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--netlist=", 10) == 0) netlist_path = argv[i] + 10;
+        else if (strncmp(argv[i], "--max-gates=", 12) == 0) max_gates = size_t(max(10ll, atoll(argv[i] + 12)));
+    }
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "SIMULATING LOGIC GATES 64 AT A TIME\n";
+        cout << "==================================================\n";
+        cout << "\nChecking the simulator (full adder, random circuits vs. one gate at a time, loops): "
+             << (selfTest() ? "all correct!" : "MISMATCH!") << "\n";
+
+        // Every row of a truth table in one pass: input i is bit i of the row number
+        Circuit adder = Circuit::compile(Netlist::parse(kFullAdder));
+        Simulator sim(adder, Kernel::Scalar);
+        cout << "\n1. A full adder, all 8 input rows in ONE pass of 64-bit words:\n";
+        sim.exhaustive([&](uint64_t, const uint64_t *in, const uint64_t *out) {
+            cout << "   a   = " << bitset<8>(in[0]) << "   (bit j = row j; each word repeats every 8 bits)\n";
+            cout << "   b   = " << bitset<8>(in[1]) << "\n";
+            cout << "   cin = " << bitset<8>(in[2]) << "\n";
+            cout << "   sum = " << bitset<8>(out[0]) << "   = a XOR b XOR cin, for all 8 rows at once\n";
+            cout << "   cout= " << bitset<8>(out[1]) << "\n";
+            return true;
+        });
+        cout << "   (" << adder.gateCount() << " two-input steps in " << adder.levels() << " levels; kernel: "
+             << Simulator(adder).kernelName() << ", " << Simulator(adder).vectors() << " rows per pass)\n";
+
+        cout << "\n2. Do two 12-bit adders (ripple carry, Kogge-Stone) always agree?\n";
+    } else if (!selfTest()) {
+        return 1;
+    }
+    checkAdders(suite, 12, false);
+    checkAdders(suite, 12, true);
+
+    if (netlist_path) {
+        ifstream in(netlist_path);
+        stringstream text;
+        text << in.rdbuf();
+        Netlist net = Netlist::parse(text.str());
+        Circuit circuit = Circuit::compile(net);
+        if (!in || !circuit.ok()) {
+            cerr << netlist_path << ": " << (in ? circuit.error() : "can't read it") << "\n";
+            return 1;
+        }
+        if (!suite.quiet && circuit.inputCount() <= 32) {
+            Simulator sim(circuit);
+            uint64_t t0 = bench_now_ns();
+            uint64_t passes = sim.exhaustive([](uint64_t, const uint64_t *, const uint64_t *) { return true; });
+            cout << "\n   " << netlist_path << ": all " << (uint64_t(1) << circuit.inputCount())
+                 << " input vectors in " << passes << (passes == 1 ? " pass, " : " passes, ") << double(bench_now_ns() - t0) / 1e6 << " ms\n";
+        }
+        benchCircuit(suite, circuit, string(netlist_path) + ":", "netlist");
+    }
+
+    // Random circuits from 10 to a million gates
+    int section = 3;
+    for (size_t gates = 10; gates <= max_gates; gates *= 10) {
+        Circuit circuit = Circuit::compile(randomCircuit(gates, 32, gates));
+        benchCircuit(suite, circuit, to_string(section++) + ". Random circuit,", to_string(gates) + " gates");
+    }
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * One AND instruction is 64 gates evaluated at once - one bit\n";
+        cout << "     per input set. AVX2 makes it 256.\n";
+        cout << "   * Sorting gates once (by dependency, then by type) turns the\n";
+        cout << "     netlist into a flat list of steps with no decisions left.\n";
+        cout << "   * Reusing a wire's storage after its last reader: a million-gate\n";
+        cout << "     circuit needs only a sixth as many words of storage.\n";
+        cout << "   * Exhaustive simulation proves small circuits equal - 16 million\n";
+        cout << "     input pairs take milliseconds.\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
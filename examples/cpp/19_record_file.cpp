@@ -0,0 +1,460 @@
+/*
+ * Binary Record Files vs. Text
+ * 100 million records of int, char, float, double, bool, short and long:
+ * written and read back as text, and as a memory-mapped binary file.
+ * Compile: g++ -O2 19_record_file.cpp -o record_file
+ * Run: ./record_file [--records=N] [--dir=PATH] [--json] [--runs=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <sys/stat.h>
+#include "record_file.hpp"
+#include "bench.hpp"
+using namespace std;
+using namespace recfile;
+
+// The variables of 1_data_types.cpp, plus a short and a long, ordered
+// largest first so the only padding is at the end (see 10_struct_layout.cpp)
+struct Person {
+    double pi;
+    int64_t large;  // long
+    float height;
+    int32_t age;
+    int16_t small;  // short
+    char initial;
+    bool is_student;
+};
+
+static Schema personSchema() {
+    return Schema::of<Person>()
+        .field("pi", &Person::pi)
+        .field("large", &Person::large)
+        .field("height", &Person::height)
+        .field("age", &Person::age)
+        .field("small", &Person::small)
+        .field("initial", &Person::initial)
+        .field("is_student", &Person::is_student);
+}
+
+// Record number i, the same every time: no need to keep them to check them
+static Person makePerson(uint64_t i) {
+    uint64_t h = (i + 1) * 0x9E3779B97F4A7C15ull;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    Person p;
+    p.pi = 3.14159 + double(h >> 11) * 0x1p-53;  // all 53 bits used
+    p.large = int64_t(h);
+    p.height = 4.0f + float(h >> 40) * 0x1p-24f * 3.0f;
+    p.age = int32_t(5 + (h >> 8) % 90);
+    p.small = int16_t(h >> 24);
+    p.initial = char('A' + (h >> 40) % 26);
+    p.is_student = (h >> 3) & 1;
+    return p;
+}
+
+// Sums of every field: equal only if every value came back the same
+struct Totals {
+    uint64_t ints = 0;
+    double reals = 0;
+    uint64_t count = 0;
+
+    void add(const Person &p) {
+        ints += uint64_t(p.large) + uint64_t(p.age) + uint64_t(p.small) + uint64_t(p.initial) + p.is_student;
+        reals += p.pi + double(p.height);
+        count++;
+    }
+    bool operator==(const Totals &o) const { return ints == o.ints && reals == o.reals && count == o.count; }
+};
+
+static Totals expectedTotals(uint64_t n) {
+    Totals t;
+    for (uint64_t i = 0; i < n; i++) t.add(makePerson(i));
+    return t;
+}
+
+// ----------------------------------------------------------------------
+// The text way, as the other examples print
+// ----------------------------------------------------------------------
+
+static bool writeText(const string &path, uint64_t n, bool flush_each_line) {
+    ofstream out(path);
+    for (uint64_t i = 0; i < n; i++) {
+        Person p = makePerson(i);
+        out << p.age << ' ' << p.initial << ' ' << p.height << ' ' << p.pi << ' ' << p.is_student << ' ' << p.small
+            << ' ' << p.large;
+        if (flush_each_line) {
+            out << endl;
+        } else {
+            out << '\n';
+        }
+    }
+    return bool(out);
+}
+
+static Totals readText(const string &path) {
+    ifstream in(path);
+    Totals t;
+    Person p{};
+    while (in >> p.age >> p.initial >> p.height >> p.pi >> p.is_student >> p.small >> p.large) t.add(p);
+    return t;
+}
+
+// ----------------------------------------------------------------------
+// The binary way
+// ----------------------------------------------------------------------
+
+static string writeRecords(const string &path, uint64_t n, Layout layout, ByteOrder order) {
+    WriteOptions options;
+    options.layout = layout;
+    options.order = order;
+    options.expected_records = n;
+    Writer out(path, personSchema(), options);
+    vector<Person> chunk(65536);
+    for (uint64_t i = 0; i < n && out.ok(); i += chunk.size()) {
+        size_t m = size_t(min<uint64_t>(chunk.size(), n - i));
+        for (size_t k = 0; k < m; k++) chunk[k] = makePerson(i + k);
+        out.append(chunk.data(), m);
+    }
+    out.finish();
+    return out.error();
+}
+
+// Every field through a view: works for any layout and byte order
+static Totals readViews(const Reader &in) {
+    FieldView<double> pi = in.field<double>("pi");
+    FieldView<int64_t> large = in.field<int64_t>("large");
+    FieldView<float> height = in.field<float>("height");
+    FieldView<int32_t> age = in.field<int32_t>("age");
+    FieldView<int16_t> small = in.field<int16_t>("small");
+    FieldView<char> initial = in.field<char>("initial");
+    FieldView<bool> is_student = in.field<bool>("is_student");
+    Totals t;
+    if (!pi.ok() || !large.ok() || !height.ok() || !age.ok() || !small.ok() || !initial.ok() || !is_student.ok()) {
+        return t;
+    }
+    for (uint64_t i = 0; i < in.size(); i++) {
+        Person p;
+        p.pi = pi[i];
+        p.large = large[i];
+        p.height = height[i];
+        p.age = age[i];
+        p.small = small[i];
+        p.initial = initial[i];
+        p.is_student = is_student[i];
+        t.add(p);
+    }
+    return t;
+}
+
+// Every field of a Rows file as a plain array of Person
+static Totals readStructs(const Reader &in) {
+    Totals t;
+    const Person *rows = in.rows<Person>();
+    if (!rows) return t;
+    for (uint64_t i = 0; i < in.size(); i++) t.add(rows[i]);
+    return t;
+}
+
+static double sumHeights(const FieldView<float> &height) {
+    double sum = 0;
+    if (const float *column = height.data()) {
+        for (uint64_t i = 0; i < height.size(); i++) sum += double(column[i]);
+    } else {
+        for (uint64_t i = 0; i < height.size(); i++) sum += double(height[i]);
+    }
+    return sum;
+}
+
+static uint64_t fileSize(const string &path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? uint64_t(st.st_size) : 0;
+}
+
+// Every layout and byte order must give back exactly what went in, and
+// broken files must be refused
+bool selfTest(const string &dir) {
+    const uint64_t n = 5000;
+    const string path = dir + "/record_file_test.rec";
+    const Layout layouts[] = {Layout::Rows, Layout::Columns};
+    const ByteOrder orders[] = {ByteOrder::Little, ByteOrder::Big};
+    bool good = true;
+    for (Layout layout : layouts) {
+        for (ByteOrder order : orders) {
+            // Without expected_records the writer starts small and grows
+            Writer out(path, personSchema(), WriteOptions{layout, order, 0});
+            for (uint64_t i = 0; i < n; i++) {
+                Person p = makePerson(i);
+                out.append(&p);
+            }
+            if (!out.finish()) return false;
+            Reader in(path);
+            if (!in.ok() || in.size() != n || in.layout() != layout || in.order() != order) return false;
+            FieldView<double> pi = in.field<double>("pi");
+            FieldView<int16_t> small = in.field<int16_t>("small");
+            for (uint64_t i = 0; i < n; i++) {
+                Person p = makePerson(i);
+                double value = pi[i];
+                good = good && memcmp(&value, &p.pi, 8) == 0 && small[i] == p.small;
+            }
+            good = good && readViews(in) == expectedTotals(n);
+            bool plain = layout == Layout::Rows && order == nativeOrder();
+            good = good && (in.rows<Person>() != nullptr) == plain;
+            good = good && (in.field<float>("height").data() != nullptr) == (layout == Layout::Columns && order == nativeOrder());
+            good = good && !in.field<float>("pi").ok() && !in.field<int32_t>("nobody").ok();
+        }
+    }
+
+    // A schema built field by field lays out like a C struct
+    Schema s = Schema().add("initial", Type::Char).add("age", Type::Int).add("small", Type::Short);
+    good = good && s.fields()[1].offset == 4 && s.fields()[2].offset == 8 && s.recordSize() == 12 && s.check().empty();
+    good = good && !Schema().add("initial", Type::Char).add("initial", Type::Int).check().empty();
+
+    // An unfinished file, and one cut short, are refused
+    {
+        Writer out(path, personSchema());
+        Person p = makePerson(0);
+        out.append(&p);
+        Reader in(path);
+        good = good && !in.ok();
+    }
+    good = good && writeRecords(path, 1000, Layout::Columns, nativeOrder()).empty();
+    good = good && truncate(path.c_str(), off_t(fileSize(path) - 100)) == 0;
+    good = good && !Reader(path).ok();
+    remove(path.c_str());
+    return good;
+}
+
+// One timed pass over something big (far too slow to repeat 51 times)
+template <typename Work>
+double timeOnce(Work work) {
+    uint64_t t0 = bench_now_ns();
+    work();
+    return double(bench_now_ns() - t0) / 1e9;
+}
+
+struct Row {
+    string name;
+    uint64_t bytes;
+    double write_s, read_s, field_s;  // field_s < 0: not possible
+    bool exact;
+};
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "record_file", argc, argv);
+    uint64_t records = 100000000;
+    string dir = ".";
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--records=", 10) == 0) records = max<uint64_t>(strtoull(argv[i] + 10, nullptr, 10), 1);
+        if (strncmp(argv[i], "--dir=", 6) == 0) dir = argv[i] + 6;
+    }
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "BINARY RECORD FILES VS. TEXT\n";
+        cout << "==================================================\n";
+        cout << "\nChecking rows/columns, little/big endian and broken files: "
+             << (selfTest(dir) ? "all correct!" : "MISMATCH!") << "\n";
+    } else if (!selfTest(dir)) {
+        return 1;
+    }
+
+    const Schema schema = personSchema();
+    if (!suite.quiet) {
+        Person p = makePerson(0);
+        ostringstream line;
+        line << p.age << ' ' << p.initial << ' ' << p.height << ' ' << p.pi << ' ' << p.is_student << ' ' << p.small
+             << ' ' << p.large;
+        cout << "\n1. One record:\n";
+        cout << "   as text:   \"" << line.str() << "\" (" << line.str().size() + 1 << " bytes)\n";
+        cout << "   as binary: " << schema.recordSize() << " bytes, always. The schema in the file header:\n\n";
+        cout << "   field        type     offset  size\n";
+        for (const Field &f : schema.fields()) {
+            cout << "   " << left << setw(12) << f.name << " " << setw(8) << typeName(f.type) << right << setw(7)
+                 << f.offset << setw(6) << typeSize(f.type) << "\n";
+        }
+        cout << "\n   Text keeps 6 significant digits: height " << setprecision(9) << p.height << " is written as "
+             << setprecision(6) << p.height << ",\n   pi " << setprecision(17) << p.pi << " as " << setprecision(6)
+             << p.pi << ".\n";
+        cout << "\n   The struct a Rows file can be read into (Schema::cppStruct):\n\n";
+        istringstream code(schema.cppStruct("Person"));
+        for (string text; getline(code, text);) cout << "   " << text << "\n";
+    }
+
+    // 2. The whole job, once each: write n records, read them all back, and
+    // read only the heights. Each file is deleted before the next is made.
+    const uint64_t sample = min<uint64_t>(records, 1000000);
+    if (!suite.quiet) {
+        cout << "\n2. Writing and reading " << records << " records (one run each, files in " << dir << "):\n";
+        cout.flush();
+    }
+    const Totals expected = expectedTotals(records);
+    double making = timeOnce([&] {
+        Totals t = expectedTotals(records);
+        doNotOptimize(t.ints);
+    });
+    vector<Row> rows;
+    string failure;
+
+    // cout << endl style: one write() per line. Timed on a sample, scaled up.
+    {
+        string path = dir + "/records_endl.txt";
+        double w = timeOnce([&] { writeText(path, sample, true); }) * double(records) / double(sample);
+        remove(path.c_str());
+        rows.push_back({"text, << endl", 0, w, -1, -1, false});
+    }
+    {
+        string path = dir + "/records.txt";
+        bool written = false;
+        Totals got;
+        double w = timeOnce([&] { written = writeText(path, records, false); });
+        uint64_t bytes = fileSize(path);
+        double r = timeOnce([&] { got = readText(path); });
+        remove(path.c_str());
+        if (!written || got.count != records) failure = "the text file could not be written or read back";
+        rows.push_back({"text, '\\n'", bytes, w, r, -1, got == expected});
+    }
+    const Layout layouts[] = {Layout::Rows, Layout::Columns};
+    for (Layout layout : layouts) {
+        string path = dir + (layout == Layout::Rows ? "/records.rows" : "/records.cols");
+        string error;
+        Totals got;
+        double sum = 0;
+        double w = timeOnce([&] { error = writeRecords(path, records, layout, nativeOrder()); });
+        uint64_t bytes = fileSize(path);
+        Reader in(path);
+        if (!error.empty() || !in.ok()) {
+            failure = error.empty() ? in.error() : error;
+            remove(path.c_str());
+            break;
+        }
+        double r = timeOnce([&] { got = layout == Layout::Rows ? readStructs(in) : readViews(in); });
+        double f = timeOnce([&] { sum = sumHeights(in.field<float>("height")); });
+        doNotOptimize(sum);
+        remove(path.c_str());
+        rows.push_back({layout == Layout::Rows ? "binary rows" : "binary columns", bytes, w, r, f, got == expected});
+    }
+
+    if (!failure.empty()) {
+        cerr << "record_file: " << failure << "\n";
+        return 1;
+    }
+    if (!suite.quiet) {
+        cout << "\n   format           file size      write       read   one field   values\n";
+        for (const Row &row : rows) {
+            cout << "   " << left << setw(15) << row.name << right << fixed << setprecision(0);
+            if (row.bytes) {
+                cout << setw(8) << double(row.bytes) / 1e6 << " MB";
+            } else {
+                cout << setw(11) << "-";
+            }
+            cout << setprecision(2) << setw(9) << row.write_s << " s";
+            if (row.read_s >= 0) {
+                cout << setw(8) << row.read_s << " s";
+            } else {
+                cout << setw(10) << "-";
+            }
+            if (row.field_s >= 0) {
+                cout << setw(10) << row.field_s << " s";
+            } else {
+                cout << setw(12) << "-";
+            }
+            cout << "   " << (row.read_s < 0 ? "" : row.exact ? "exact" : "ROUNDED") << "\n";
+            cout.unsetf(ios::floatfield);
+        }
+        cout << "\n   (<< endl was timed on " << sample << " records and scaled up. Making the records\n"
+             << "   takes " << fixed << setprecision(2) << making << " s of every write. Files just written are usually\n"
+             << "   still in the page cache, so reads run at memory speed, not disk speed.)\n";
+        cout.unsetf(ios::floatfield);
+        const Row &text = rows[1];
+        const Row &binary = rows[2];
+        cout << "\n   Binary rows vs. text: " << setprecision(3) << text.write_s / binary.write_s
+             << "x faster to write, " << text.read_s / binary.read_s << "x faster to read, "
+             << double(text.bytes) / double(binary.bytes) << "x smaller.\n";
+    }
+    const char *keys[] = {"endl", "text", "rows", "columns"};
+    for (size_t i = 0; i < rows.size(); i++) {
+        bench_info_number(&suite, (string("write_s_") + keys[i]).c_str(), rows[i].write_s);
+        if (rows[i].read_s >= 0) bench_info_number(&suite, (string("read_s_") + keys[i]).c_str(), rows[i].read_s);
+        if (rows[i].field_s >= 0) bench_info_number(&suite, (string("field_s_") + keys[i]).c_str(), rows[i].field_s);
+        if (rows[i].bytes) bench_info_number(&suite, (string("bytes_") + keys[i]).c_str(), double(rows[i].bytes));
+    }
+    bench_info_number(&suite, "records", double(records));
+
+    // 3. Per-record costs on a file that fits in the caches
+    const uint64_t small_n = 1000000;
+    bench_section(&suite, "3. Sum one float field of 1M records (file in memory):");
+    {
+        string rows_path = dir + "/records_small.rows", cols_path = dir + "/records_small.cols";
+        string swapped_path = dir + "/records_small_swapped.cols";
+        ByteOrder other = nativeOrder() == ByteOrder::Little ? ByteOrder::Big : ByteOrder::Little;
+        writeRecords(rows_path, small_n, Layout::Rows, nativeOrder());
+        writeRecords(cols_path, small_n, Layout::Columns, nativeOrder());
+        writeRecords(swapped_path, small_n, Layout::Columns, other);
+        {
+            Reader by_row(rows_path), by_column(cols_path), swapped(swapped_path);
+            FieldView<float> row_view = by_row.field<float>("height");
+            FieldView<float> column_view = by_column.field<float>("height");
+            FieldView<float> swapped_view = swapped.field<float>("height");
+            const float *column = column_view.data();
+            benchRun(suite, "rows, a float per 32 bytes", [&](size_t n) {
+                for (size_t k = 0; k < n; k++) doNotOptimize(sumHeights(row_view));
+            });
+            bench_rate(&suite, double(small_n), "floats");
+            benchRun(suite, "columns, view[i]", [&](size_t n) {
+                for (size_t k = 0; k < n; k++) {
+                    double sum = 0;
+                    for (uint64_t i = 0; i < small_n; i++) sum += double(column_view[i]);
+                    doNotOptimize(sum);
+                }
+            });
+            bench_rate(&suite, double(small_n), "floats");
+            benchRun(suite, "columns, plain array", [&](size_t n) {
+                for (size_t k = 0; k < n; k++) {
+                    const float *values = column;
+                    hideValue(values);
+                    double sum = 0;
+                    for (uint64_t i = 0; i < small_n; i++) sum += double(values[i]);
+                    doNotOptimize(sum);
+                }
+            });
+            bench_rate(&suite, double(small_n), "floats");
+            benchRun(suite, "columns, other byte order", [&](size_t n) {
+                for (size_t k = 0; k < n; k++) doNotOptimize(sumHeights(swapped_view));
+            });
+            bench_rate(&suite, double(small_n), "floats");
+            bench_compare(&suite, "rows, a float per 32 bytes", "columns, plain array");
+            bench_compare(&suite, "columns, other byte order", "columns, plain array");
+        }
+        remove(rows_path.c_str());
+        remove(cols_path.c_str());
+        remove(swapped_path.c_str());
+    }
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * Text costs twice: numbers become characters on the way out\n";
+        cout << "     and are parsed again on the way in - and << rounds floats.\n";
+        cout << "   * A binary file of fixed-size fields can be used where it lies:\n";
+        cout << "     mmap it and the records are already an array.\n";
+        cout << "   * Say the byte order in the header; swapping bytes on read is\n";
+        cout << "     cheap, guessing wrong is not.\n";
+        cout << "   * Columns beat rows when you need only some of the fields.\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
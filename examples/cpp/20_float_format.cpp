@@ -0,0 +1,273 @@
+/*
+ * Printing float and double: Exact AND Short
+ * The fewest digits that read back as the same number, vs. printf and to_chars.
+ * Compile: g++ -O2 -std=c++17 20_float_format.cpp -o float_format
+ * Run: ./float_format [--exhaustive] [--json] [--runs=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <charconv>
+#include <limits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include "float_format.hpp"
+#include "bench.hpp"
+using namespace std;
+
+template <typename T>
+static string shortest(T value, floatfmt::Style style = floatfmt::Style::Shortest) {
+    char buf[floatfmt::kMaxDoubleChars];
+    floatfmt::Result r = floatfmt::format(buf, buf + sizeof buf, value, style);
+    return string(buf, r.ptr);
+}
+
+template <typename T>
+static T fromBits(uint64_t bits) {
+    T value;
+    memcpy(&value, &bits, sizeof(T));
+    return value;
+}
+
+// Same text as std::to_chars (which is also shortest), and it reads back
+// as the very same bits
+template <typename T>
+static bool agrees(T value) {
+    char ours[floatfmt::kMaxDoubleChars], theirs[64];
+    char *end = floatfmt::format(ours, ours + sizeof ours, value).ptr;
+    char *their_end = to_chars(theirs, theirs + sizeof theirs, value).ptr;
+    if (end - ours != their_end - theirs || memcmp(ours, theirs, size_t(end - ours)) != 0) return false;
+    if (std::isnan(value)) return true;
+    T back;
+    if (from_chars(ours, end, back).ec != errc()) return false;
+    return memcmp(&back, &value, sizeof(T)) == 0;
+}
+
+// Values whose shortest text is a few digits, like prices: 12.34, 0.5, 1999.99
+static double priceLike(uint64_t r) { return double(r % 1000000) / 100.0; }
+
+static uint64_t checkedFloats = 0, checkedDoubles = 0;
+
+bool selfTest(bool exhaustive) {
+    struct Case {
+        double value;
+        const char *text;
+    };
+    const Case doubles[] = {{0.1, "0.1"},
+                            {3.14159, "3.14159"},
+                            {1.0 / 3, "0.3333333333333333"},
+                            {100, "100"},
+                            {123456, "123456"},
+                            {0.001, "0.001"},
+                            {1e-7, "1e-07"},
+                            {1e22, "1e+22"},
+                            {1e23, "1e+23"},
+                            {9007199254740993.0, "9007199254740992"},
+                            {5e-324, "5e-324"},
+                            {2.2250738585072014e-308, "2.2250738585072014e-308"},
+                            {numeric_limits<double>::max(), "1.7976931348623157e+308"},
+                            {-0.0, "-0"},
+                            {-numeric_limits<double>::infinity(), "-inf"}};
+    for (const Case &c : doubles) {
+        if (shortest(c.value) != c.text) return false;
+    }
+    if (shortest(5.2f) != "5.2" || shortest(1e-45f) != "1e-45" || shortest(16777216.0f) != "16777216" ||
+        shortest(numeric_limits<float>::max()) != "3.4028235e+38" || shortest(nanf("")) != "nan") {
+        return false;
+    }
+    if (shortest(0.1, floatfmt::Style::Scientific) != "1e-01" || shortest(0.0, floatfmt::Style::Scientific) != "0e+00" ||
+        shortest(123.5, floatfmt::Style::Scientific) != "1.235e+02") {
+        return false;
+    }
+
+    // Too small a buffer: nothing counts, like std::to_chars
+    char small[4];
+    if (floatfmt::format(small, small + 4, 0.125).ec != errc::value_too_large ||
+        floatfmt::format(small, small + 4, 0.25).ptr != small + 4) {
+        return false;
+    }
+
+    // The fields, and the exact value they stand for
+    floatfmt::Parts p = floatfmt::breakdown(-2.5f);
+    if (!p.negative || p.biased_exponent != 128 || p.fraction != 0x200000 || p.kind != floatfmt::Kind::Normal ||
+        ldexp(double(p.significand), p.exponent) != 2.5) {
+        return false;
+    }
+    p = floatfmt::breakdown(5e-324);
+    if (p.kind != floatfmt::Kind::Subnormal || p.significand != 1 || p.exponent != -1074) return false;
+    floatfmt::Decimal d = floatfmt::toDecimal(3.14159f);
+    if (d.digits != 314159 || d.exponent != -5 || d.negative) return false;
+
+    // Doubles: random bit patterns (every exponent) and short decimals
+    uint64_t state = 42;
+    for (int i = 0; i < 1000000; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        uint64_t r = state ^ (state >> 29);
+        if (!agrees(fromBits<double>(r)) || !agrees(priceLike(r)) || !agrees(double(r >> 11))) return false;
+        checkedDoubles += 3;
+    }
+
+    // Floats: every one of the 2^32 bit patterns, or every 251st
+    const uint64_t step = exhaustive ? 1 : 251;
+    for (uint64_t bits = 0; bits < (uint64_t(1) << 32); bits += step) {
+        if (!agrees(fromBits<float>(bits))) return false;
+        checkedFloats++;
+    }
+
+    // Batch mode writes the same text, one value per line
+    vector<double> values{0.1, -2.5, 1e100, 42};
+    vector<char> out(values.size() * (floatfmt::kMaxDoubleChars + 1));
+    size_t bytes = floatfmt::formatAll(values.data(), values.size(), out.data());
+    return string(out.data(), bytes) == "0.1\n-2.5\n1e+100\n42\n";
+}
+
+// Print the fields of one value and how each way of printing shows it
+template <typename T>
+static void explain(const char *name, T value) {
+    const bool is_float = sizeof(T) == 4;
+    floatfmt::Parts p = floatfmt::breakdown(value);
+    string exponent, fraction;
+    for (int b = p.exponent_bits - 1; b >= 0; b--) exponent += char('0' + ((p.biased_exponent >> b) & 1));
+    for (int b = p.fraction_bits - 1; b >= 0; b--) fraction += char('0' + ((p.fraction >> b) & 1));
+    char precise[64];
+    snprintf(precise, sizeof precise, is_float ? "%.9g" : "%.17g", double(value));
+    ostringstream stream;
+    stream << value;
+
+    cout << "\n   " << name << " (" << (is_float ? "float" : "double") << ")\n";
+    cout << "     sign " << p.negative << " | exponent " << exponent << " (" << p.biased_exponent << ") | fraction "
+         << fraction << "\n";
+    cout << "     " << floatfmt::kindName(p.kind);
+    if (p.kind == floatfmt::Kind::Normal || p.kind == floatfmt::Kind::Subnormal) {
+        cout << ": exactly " << p.significand << " * 2^" << p.exponent;
+    }
+    cout << "\n     cout: " << left << setw(14) << stream.str() << (is_float ? "%.9g: " : "%.17g: ") << setw(25)
+         << precise << "shortest: " << shortest(value) << right << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "float_format", argc, argv);
+    bool exhaustive = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--exhaustive") == 0) exhaustive = true;
+    }
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "PRINTING FLOAT AND DOUBLE: EXACT AND SHORT\n";
+        cout << "==================================================\n";
+        cout << "\nChecking against std::to_chars, and reading every result back"
+             << (exhaustive ? " (all 2^32 floats - about 10 minutes)" : "") << ": ";
+        cout.flush();
+        bool ok = selfTest(exhaustive);
+        cout << (ok ? "all correct!" : "MISMATCH!") << "\n";
+        cout << "   " << checkedDoubles << " doubles and " << checkedFloats << " floats"
+             << (exhaustive ? " (every float there is)" : " (--exhaustive tries every float)") << "\n";
+    } else if (!selfTest(exhaustive)) {
+        return 1;
+    }
+
+    // 1_data_types.cpp's height and pi, and some harder cases
+    if (!suite.quiet) {
+        cout << "\n1. What is stored, and what gets printed:\n";
+        explain("height = 5.2f", 5.2f);
+        explain("pi = 3.14159", 3.14159);
+        explain("0.1", 0.1);
+        explain("1.0 / 3", 1.0 / 3);
+        explain("1e-45f", 1e-45f);
+        explain("-0.0", -0.0);
+        cout << "\n   cout rounds to 6 digits (most values come back different);\n";
+        cout << "   %.17g always comes back right, with noise digits; shortest does both.\n";
+    }
+
+    // Test values: random bits (every exponent, 17 digits), prices (few
+    // digits), and random floats
+    const size_t kValues = 4096;
+    vector<double> random_doubles(kValues), prices(kValues);
+    vector<float> random_floats(kValues);
+    uint64_t state = 7;
+    for (size_t i = 0; i < kValues; i++) {
+        uint64_t r;
+        do {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            r = state ^ (state >> 31);
+        } while (!std::isfinite(fromBits<double>(r)) || !std::isfinite(fromBits<float>(r >> 32)));
+        random_doubles[i] = fromBits<double>(r);
+        prices[i] = priceLike(r);
+        random_floats[i] = fromBits<float>(r >> 32);
+    }
+    char buf[64];
+
+    auto compareAll = [&](const char *title, auto &values, const char *printf_format) {
+        using T = typename std::decay<decltype(values[0])>::type;
+        bench_section(&suite, title);
+        string with_printf = string("snprintf(\"") + printf_format + "\")";
+        benchRun(suite, with_printf.c_str(), [&](size_t n) {
+            for (size_t k = 0; k < n; k++) {
+                doNotOptimize(snprintf(buf, sizeof buf, printf_format, double(values[k & (kValues - 1)])));
+            }
+        });
+        benchRun(suite, "std::to_chars", [&](size_t n) {
+            for (size_t k = 0; k < n; k++) doNotOptimize(to_chars(buf, buf + sizeof buf, values[k & (kValues - 1)]).ptr);
+        });
+        benchRun(suite, "floatfmt::format", [&](size_t n) {
+            for (size_t k = 0; k < n; k++) {
+                doNotOptimize(floatfmt::format(buf, buf + sizeof buf, T(values[k & (kValues - 1)])).ptr);
+            }
+        });
+        bench_compare(&suite, with_printf.c_str(), "floatfmt::format");
+        bench_compare(&suite, "std::to_chars", "floatfmt::format");
+    };
+    compareAll("2. One double, random bits (17 digits, any exponent):", random_doubles, "%.17g");
+    compareAll("3. One double, prices like 1999.99 (few digits):", prices, "%.17g");
+    compareAll("4. One float, random bits (9 digits):", random_floats, "%.9g");
+
+    // Batch mode: a million doubles into one buffer, one per line
+    const size_t kBatch = 1 << 20;
+    vector<double> batch(kBatch);
+    for (size_t i = 0; i < kBatch; i++) batch[i] = random_doubles[i & (kValues - 1)] * double(i + 1);
+    vector<char> out(kBatch * (floatfmt::kMaxDoubleChars + 1));
+    size_t bytes = floatfmt::formatAll(batch.data(), kBatch, out.data());
+    bench_section(&suite, "5. Batch: 1M doubles to text, one per line:");
+    benchRun(suite, "to_chars + '\\n' loop", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            char *p = out.data();
+            for (double v : batch) {
+                p = to_chars(p, p + floatfmt::kMaxDoubleChars, v).ptr;
+                *p++ = '\n';
+            }
+            doNotOptimize(p);
+        }
+    });
+    bench_rate(&suite, double(kBatch), "values");
+    benchRun(suite, "floatfmt::formatAll", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) doNotOptimize(floatfmt::formatAll(batch.data(), kBatch, out.data()));
+    });
+    bench_rate(&suite, double(kBatch), "values");
+    bench_rate(&suite, double(bytes), "B");
+    bench_compare(&suite, "to_chars + '\\n' loop", "floatfmt::formatAll");
+    bench_info_number(&suite, "batch_bytes_per_value", double(bytes) / double(kBatch));
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * A float is sign, exponent and fraction: 5.2f really is\n";
+        cout << "     5.19999980926513671875. Printing means choosing digits.\n";
+        cout << "   * The right choice is the SHORTEST text that reads back as\n";
+        cout << "     the same bits - never lossy, never noisy.\n";
+        cout << "   * One 128-bit multiply finds it: no big numbers, no loops,\n";
+        cout << "     and no guessing a precision like %.10f.\n";
+        cout << "   * printf also parses its format string and handles locales\n";
+        cout << "     on every call; to_chars-style functions skip all that.\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
@@ -0,0 +1,248 @@
+/*
+ * How Fast Is Your Disk, Really?
+ * Sequential and random reads and writes with read(), mmap, O_DIRECT and io_uring.
+ * Compile: g++ -O2 21_storage_io.cpp -o storage_io
+ * Run: ./storage_io [--dir=PATH] [--size=MB] [--seconds=S] [--tmpfs=PATH] [--json]
+ *      ./storage_io --backend=read|mmap|io_uring [--direct] [--write] [--random] [--block=N] [--qd=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include "storage_io.hpp"
+#include "bench.hpp"
+using namespace std;
+using namespace storio;
+
+static Job makeJob(Backend backend, bool direct, Op op, Pattern pattern, size_t block, unsigned depth) {
+    Job job;
+    job.backend = backend;
+    job.direct = direct;
+    job.op = op;
+    job.pattern = pattern;
+    job.block_size = block;
+    job.queue_depth = depth;
+    return job;
+}
+
+static bool skipped(const Result &r) {
+    return r.error.find("O_DIRECT is not supported") != string::npos || r.error.find("io_uring_setup") == 0;
+}
+
+static string uringStatus = "io_uring works";
+static string directStatus = "O_DIRECT works";
+
+// Every backend must read exactly the bytes in the file, and write bytes
+// that read back right; O_DIRECT and io_uring may be unavailable here
+bool selfTest(const string &dir) {
+    const string path = dir + "/storage_io_check.dat";
+    const uint64_t size = 1 << 20;
+    bool good = true;
+    const Backend backends[] = {Backend::Read, Backend::Mmap, Backend::Uring};
+    for (Backend backend : backends) {
+        for (bool direct : {false, true}) {
+            if (direct && backend == Backend::Mmap) continue;
+            // Writes: an all-zero file, filled block by block with the pattern
+            if (!createFile(path, 0).empty() || truncate(path.c_str(), off_t(size)) != 0) return false;
+            Job write = makeJob(backend, direct, Op::Write, Pattern::Sequential, 16384, 8);
+            write.verify = true;
+            write.max_seconds = 10;
+            Result w = run(path, write);
+            if (skipped(w)) {
+                (direct ? directStatus : uringStatus) = w.error;
+                continue;
+            }
+            good = good && w.ok() && w.requests == size / 16384;
+
+            // Reads: the whole file in order, then random blocks, all checked
+            for (Pattern pattern : {Pattern::Sequential, Pattern::Random}) {
+                Job read = makeJob(backend, direct, Op::Read, pattern, pattern == Pattern::Random ? 4096 : 65536, 4);
+                read.verify = true;
+                read.max_seconds = 10;
+                Result r = run(path, read);
+                good = good && r.ok() && r.bytes == size && r.latency_ns.size() == r.requests &&
+                       r.percentileUs(0.5) <= r.percentileUs(0.99);
+            }
+        }
+    }
+    // Bad requests are reported, not crashed on
+    Job odd = makeJob(Backend::Read, false, Op::Read, Pattern::Sequential, 1000, 1);
+    Job plain = makeJob(Backend::Read, false, Op::Read, Pattern::Sequential, 4096, 1);
+    good = good && !run(path, odd).ok() && !run(dir + "/no/such/file", plain).ok();
+    remove(path.c_str());
+    return good;
+}
+
+static string sizeText(size_t bytes) {
+    return bytes >= (1 << 20) ? to_string(bytes >> 20) + " MB" : to_string(bytes >> 10) + " KB";
+}
+
+// Run a list of jobs on one file and print a row for each
+struct Table {
+    bench_suite &suite;
+    const string &path;
+    double seconds;
+    const char *key;  // JSON name prefix
+
+    void header(const char *title) const {
+        if (suite.quiet) return;
+        cout << "\n" << title << "\n";
+        cout << "   method                block  depth      MB/s       IOPS    p50 us    p99 us  p99.9 us\n";
+    }
+
+    Result row(Job job, bool warm = false) const {
+        job.max_seconds = seconds;
+        job.drop_cache = !warm;
+        Result r = run(path, job);
+        string name = jobName(job) + (warm ? " (cached)" : "");
+        if (!suite.quiet) {
+            cout << "   " << left << setw(20) << name << right << setw(8) << sizeText(job.block_size);
+            if (!r.ok()) {
+                cout << "   -- " << r.error << "\n";
+                return r;
+            }
+            cout << setw(7) << job.queue_depth << fixed << setprecision(0) << setw(10) << r.mbPerSec() << setw(11)
+                 << r.iops() << setprecision(1) << setw(10) << r.percentileUs(0.5) << setw(10)
+                 << r.percentileUs(0.99) << setw(10) << r.percentileUs(0.999) << "\n";
+            cout.unsetf(ios::floatfield);
+        }
+        if (r.ok()) {
+            string metric = string(key) + "_" + name;
+            for (char &c : metric) {
+                if (!isalnum((unsigned char)c)) c = '_';
+            }
+            bool random = job.pattern == Pattern::Random;
+            bench_info_number(&suite, (metric + (random ? "_iops" : "_mbps")).c_str(),
+                              random ? r.iops() : r.mbPerSec());
+        }
+        return r;
+    }
+};
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "storage_io", argc, argv);
+    string dir = ".", tmpfs = "/dev/shm";
+    uint64_t size_mb = 512;
+    double seconds = 2;
+    // One custom job instead of the tour
+    const char *backend = nullptr;
+    bool direct = false, write = false, random = false;
+    size_t block = 0;
+    unsigned depth = 1;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--dir=", 6) == 0) dir = argv[i] + 6;
+        if (strncmp(argv[i], "--tmpfs=", 8) == 0) tmpfs = argv[i] + 8;
+        if (strncmp(argv[i], "--size=", 7) == 0) size_mb = max<uint64_t>(strtoull(argv[i] + 7, nullptr, 10), 16);
+        if (strncmp(argv[i], "--seconds=", 10) == 0) seconds = max(atof(argv[i] + 10), 0.05);
+        if (strncmp(argv[i], "--backend=", 10) == 0) backend = argv[i] + 10;
+        if (strcmp(argv[i], "--direct") == 0) direct = true;
+        if (strcmp(argv[i], "--write") == 0) write = true;
+        if (strcmp(argv[i], "--random") == 0) random = true;
+        if (strncmp(argv[i], "--block=", 8) == 0) block = size_t(strtoull(argv[i] + 8, nullptr, 10));
+        if (strncmp(argv[i], "--qd=", 5) == 0) depth = unsigned(max(atoi(argv[i] + 5), 1));
+    }
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "HOW FAST IS YOUR DISK, REALLY?\n";
+        cout << "==================================================\n";
+        cout << "\nChecking every backend reads and writes the right bytes: "
+             << (selfTest(dir) ? "all correct!" : "MISMATCH!") << "\n";
+        cout << "   (" << uringStatus << "; " << directStatus << " in " << dir << ")\n";
+    } else if (!selfTest(dir)) {
+        return 1;
+    }
+
+    const string path = dir + "/storage_io_test.dat";
+    if (!suite.quiet) {
+        cout << "\nWriting a " << size_mb << " MB test file " << path << "...\n";
+        cout.flush();
+    }
+    string error = createFile(path, size_mb << 20);
+    if (!error.empty()) {
+        cerr << "storage_io: " << error << "\n";
+        return 1;
+    }
+
+    Table disk{suite, path, seconds, "disk"};
+    if (backend) {
+        Backend b = strcmp(backend, "mmap") == 0 ? Backend::Mmap
+                    : strcmp(backend, "io_uring") == 0 ? Backend::Uring
+                                                       : Backend::Read;
+        Pattern pattern = random ? Pattern::Random : Pattern::Sequential;
+        size_t bs = block ? block : random ? 4096 : 1 << 20;
+        disk.header("Your job (cold cache):");
+        disk.row(makeJob(b, direct, write ? Op::Write : Op::Read, pattern, bs, depth));
+    } else {
+        const size_t kBig = 1 << 20, kSmall = 4096;
+        const Op R = Op::Read, W = Op::Write;
+        const Pattern S = Pattern::Sequential, X = Pattern::Random;
+        disk.header("1. Sequential read, 1 MB blocks (page cache emptied first):");
+        disk.row(makeJob(Backend::Read, false, R, S, kBig, 1));
+        disk.row(makeJob(Backend::Read, false, R, S, kBig, 1), true);
+        disk.row(makeJob(Backend::Mmap, false, R, S, kBig, 1));
+        disk.row(makeJob(Backend::Read, true, R, S, kBig, 1));
+        disk.row(makeJob(Backend::Uring, true, R, S, kBig, 4));
+
+        disk.header("2. Random read, 4 KB blocks:");
+        disk.row(makeJob(Backend::Read, false, R, X, kSmall, 1));
+        disk.row(makeJob(Backend::Mmap, false, R, X, kSmall, 1));
+        disk.row(makeJob(Backend::Read, true, R, X, kSmall, 1));
+        for (unsigned qd : {1u, 4u, 16u, 64u}) disk.row(makeJob(Backend::Uring, true, R, X, kSmall, qd));
+
+        disk.header("3. Sequential write, 1 MB blocks (fsync/msync at the end, timed):");
+        disk.row(makeJob(Backend::Read, false, W, S, kBig, 1));
+        disk.row(makeJob(Backend::Mmap, false, W, S, kBig, 1));
+        disk.row(makeJob(Backend::Read, true, W, S, kBig, 1));
+        disk.row(makeJob(Backend::Uring, true, W, S, kBig, 4));
+
+        disk.header("4. Random write, 4 KB blocks:");
+        disk.row(makeJob(Backend::Read, false, W, X, kSmall, 1));
+        disk.row(makeJob(Backend::Read, true, W, X, kSmall, 1));
+        disk.row(makeJob(Backend::Uring, true, W, X, kSmall, 32));
+
+        // The same reads from RAM: what the software costs without a device
+        if (!tmpfs.empty()) {
+            const string ram_path = tmpfs + "/storage_io_test.dat";
+            uint64_t ram_mb = min<uint64_t>(size_mb, 256);
+            if (createFile(ram_path, ram_mb << 20).empty()) {
+                Table ram{suite, ram_path, seconds, "tmpfs"};
+                string title = "5. The same reads on tmpfs (" + tmpfs + ", RAM, " + to_string(ram_mb) + " MB):";
+                ram.header(title.c_str());
+                ram.row(makeJob(Backend::Read, false, R, S, kBig, 1));
+                ram.row(makeJob(Backend::Mmap, false, R, S, kBig, 1));
+                ram.row(makeJob(Backend::Read, true, R, S, kBig, 1));
+                ram.row(makeJob(Backend::Read, false, R, X, kSmall, 1));
+                ram.row(makeJob(Backend::Uring, false, R, X, kSmall, 16));
+            } else if (!suite.quiet) {
+                cout << "\n5. (no tmpfs at " << tmpfs << ": skipped)\n";
+            }
+            remove(ram_path.c_str());
+        }
+    }
+    remove(path.c_str());
+    bench_info_number(&suite, "file_mb", double(size_mb));
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * The page cache hides the disk: the second read of a file\n";
+        cout << "     is a memory copy. Empty it before measuring a device.\n";
+        cout << "   * Big sequential requests reach the device's MB/s; small\n";
+        cout << "     random ones are limited by latency (IOPS).\n";
+        cout << "   * One request at a time leaves a fast SSD idle: queue depth\n";
+        cout << "     (io_uring) multiplies random IOPS, at higher latency each.\n";
+        cout << "   * Writes are not on the disk until fsync returns - time it.\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
@@ -0,0 +1,381 @@
+/*
+ * A Request's Round Trip Over 127.0.0.1
+ * An epoll TCP/UDP server and a load generator: requests/sec and latency percentiles.
+ * Compile: g++ -O2 -pthread 22_loopback.cpp -o loopback
+ * Run: ./loopback [--seconds=S] [--json]
+ *      ./loopback --serve [--port=N] [--udp] [--reactors=N] [--pin]
+ *      ./loopback --connect=PORT [--udp] [--connections=N] [--depth=N] [--threads=N]
+ *                 [--size=N] [--reply=N] [--no-batch]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include "loopback.hpp"
+#include "bench.hpp"
+using namespace std;
+using namespace loopback;
+
+static ServerConfig serverConfig(Protocol protocol, unsigned reactors = 1, unsigned batch = 32) {
+    ServerConfig config;
+    config.protocol = protocol;
+    config.reactors = reactors;
+    config.batch = batch;
+    return config;
+}
+
+static LoadConfig loadConfig(const Server &server, Protocol protocol, unsigned connections, unsigned depth,
+                             size_t size) {
+    LoadConfig load;
+    load.protocol = protocol;
+    load.port = server.port();
+    load.connections = connections;
+    load.depth = depth;
+    load.request_bytes = size;
+    return load;
+}
+
+// Blocking helpers for hand-made requests
+static bool sendAll(int fd, const void *data, size_t size) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    while (size > 0) {
+        ssize_t n = ::send(fd, p, size, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+static bool recvAll(int fd, void *data, size_t size) {
+    uint8_t *p = static_cast<uint8_t *>(data);
+    while (size > 0) {
+        ssize_t n = ::recv(fd, p, size, 0);
+        if (n <= 0) return false;
+        p += n;
+        size -= size_t(n);
+    }
+    return true;
+}
+
+static int connectTo(uint16_t port) {
+    sockaddr_in addr;
+    detail::address("127.0.0.1", port, addr);
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Requests cut into pieces, or run together, still get whole answers
+static bool splitRequests(uint16_t port) {
+    int fd = connectTo(port);
+    if (fd < 0) return false;
+    vector<uint8_t> two;
+    for (uint64_t id : {7, 8}) {
+        Header h = {5, id == 7 ? kEcho : 3, id};
+        const uint8_t *p = reinterpret_cast<const uint8_t *>(&h);
+        two.insert(two.end(), p, p + sizeof h);
+        for (size_t i = 0; i < 5; i++) two.push_back(requestByte(id, i));
+    }
+    bool good = true;
+    // Byte by byte first, then both in one piece
+    for (int round = 0; round < 2 && good; round++) {
+        if (round == 0) {
+            for (uint8_t byte : two) {
+                good = good && sendAll(fd, &byte, 1);
+                this_thread::sleep_for(chrono::microseconds(50));
+            }
+        } else {
+            good = good && sendAll(fd, two.data(), two.size());
+        }
+        Header echo, fixed;
+        uint8_t echoed[5], body[3];
+        good = good && recvAll(fd, &echo, sizeof echo) && recvAll(fd, echoed, 5) && recvAll(fd, &fixed, sizeof fixed) &&
+               recvAll(fd, body, 3);
+        good = good && echo.id == 7 && echo.length == 5 && fixed.id == 8 && fixed.length == 3;
+        for (size_t i = 0; i < 5 && good; i++) good = echoed[i] == requestByte(7, i);
+        for (size_t i = 0; i < 3 && good; i++) good = body[i] == replyByte(i);
+    }
+    // A message too long to accept closes the connection
+    Header huge = {uint32_t(kMaxTcpPayload + 1), kEcho, 9};
+    uint8_t byte;
+    good = good && sendAll(fd, &huge, sizeof huge) && ::recv(fd, &byte, 1, 0) == 0;
+    ::close(fd);
+    return good;
+}
+
+static bool loadWorks(const LoadResult &r) {
+    return r.ok() && r.requests > 0 && r.lost == 0 && r.latency_ns.size() == r.requests &&
+           r.percentileUs(0.5) <= r.percentileUs(0.999);
+}
+
+// Every reply is checked byte for byte: echoes and fixed replies, TCP and
+// UDP, one reactor or two, batched or not, small messages and large ones
+bool selfTest() {
+    bool good = true;
+    for (Protocol protocol : {Protocol::Tcp, Protocol::Udp}) {
+        for (unsigned reactors : {1u, 2u}) {
+            Server server;
+            if (!server.start(serverConfig(protocol, reactors, reactors == 1 ? 1 : 32)).empty()) return false;
+            LoadConfig echo = loadConfig(server, protocol, 3, 4, 100);
+            echo.seconds = 0.1;
+            echo.verify = true;
+            echo.threads = reactors;
+            LoadResult r = runLoad(echo);
+            good = good && loadWorks(r);
+            // Every request was answered exactly once
+            good = good && (protocol == Protocol::Udp || server.requests() == r.requests);
+
+            LoadConfig fixed = echo;
+            fixed.reply = Reply::Fixed;
+            fixed.request_bytes = 0;
+            fixed.reply_bytes = 3000;
+            fixed.batch_calls = false;
+            good = good && loadWorks(runLoad(fixed));
+        }
+    }
+    // Large TCP messages: the sockets fill up, and the rest waits its turn
+    Server tcp;
+    if (!tcp.start(serverConfig(Protocol::Tcp)).empty()) return false;
+    LoadConfig big = loadConfig(tcp, Protocol::Tcp, 2, 3, 300000);
+    big.seconds = 0.1;
+    big.verify = true;
+    good = good && loadWorks(runLoad(big));
+    good = good && splitRequests(tcp.port());
+
+    // Bad requests are reported, not crashed on
+    LoadConfig too_big = loadConfig(tcp, Protocol::Udp, 1, 1, kMaxUdpPayload + 1);
+    good = good && !runLoad(too_big).ok();
+    uint16_t closed = tcp.port();
+    tcp.stop();
+    LoadConfig nobody = big;
+    nobody.port = closed;
+    good = good && !runLoad(nobody).ok();
+    return good;
+}
+
+static string sizeText(size_t bytes) {
+    return bytes >= (1 << 20) ? to_string(bytes >> 20) + " MB"
+           : bytes >= 1024    ? to_string(bytes >> 10) + " KB"
+                              : to_string(bytes) + " B";
+}
+
+// Run load configurations against a server and print a row for each
+struct Table {
+    bench_suite &suite;
+    double seconds;
+
+    void header(const char *title) const {
+        if (suite.quiet) return;
+        cout << "\n" << title << "\n";
+        cout << "   test                       conns depth     req/s      MB/s   p50 us   p99 us p99.9 us\n";
+    }
+
+    LoadResult row(const char *name, const char *key, LoadConfig load) const {
+        load.seconds = seconds;
+        LoadResult r = runLoad(load);
+        if (!suite.quiet) {
+            cout << "   " << left << setw(26) << name << right << setw(6) << load.connections << setw(6)
+                 << load.depth;
+            if (!r.ok()) {
+                cout << "   -- " << r.error << "\n";
+                return r;
+            }
+            cout << fixed << setprecision(0) << setw(10) << r.requestsPerSec() << setprecision(1) << setw(10)
+                 << r.mbPerSec() << setw(9) << r.percentileUs(0.5) << setw(9) << r.percentileUs(0.99) << setw(9)
+                 << r.percentileUs(0.999);
+            cout.unsetf(ios::floatfield);
+            if (r.lost) cout << "  (" << r.lost << " lost)";
+            cout << "\n";
+        }
+        if (r.ok()) bench_info_number(&suite, (string(key) + "_req_per_sec").c_str(), r.requestsPerSec());
+        return r;
+    }
+};
+
+// --serve: answer until Ctrl-C
+static int serve(const ServerConfig &config) {
+    // Block the signals in every thread, then wait for one here
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    Server server;
+    string error = server.start(config);
+    if (!error.empty()) {
+        cerr << "loopback: " << error << "\n";
+        return 1;
+    }
+    cout << "Serving " << (config.protocol == Protocol::Tcp ? "TCP" : "UDP") << " on " << config.host << ":"
+         << server.port() << " with " << config.reactors << " reactor(s); Ctrl-C stops" << endl;
+    int signal = 0;
+    sigwait(&signals, &signal);
+    cout << "\nAnswered " << server.requests() << " requests\n";
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "loopback", argc, argv);
+    double seconds = 1;
+    // One server or one client instead of the tour
+    bool serving = false;
+    ServerConfig custom_server;
+    LoadConfig custom_load;
+    bool connecting = false;
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--seconds=", 10) == 0) seconds = max(atof(arg + 10), 0.05);
+        if (strcmp(arg, "--serve") == 0) serving = true;
+        if (strncmp(arg, "--port=", 7) == 0) custom_server.port = uint16_t(atoi(arg + 7));
+        if (strcmp(arg, "--udp") == 0) custom_server.protocol = custom_load.protocol = Protocol::Udp;
+        if (strncmp(arg, "--reactors=", 11) == 0) custom_server.reactors = unsigned(max(atoi(arg + 11), 1));
+        if (strcmp(arg, "--pin") == 0) custom_server.pin = true;
+        if (strncmp(arg, "--connect=", 10) == 0) {
+            connecting = true;
+            custom_load.port = uint16_t(atoi(arg + 10));
+        }
+        if (strncmp(arg, "--connections=", 14) == 0) custom_load.connections = unsigned(max(atoi(arg + 14), 1));
+        if (strncmp(arg, "--depth=", 8) == 0) custom_load.depth = unsigned(max(atoi(arg + 8), 1));
+        if (strncmp(arg, "--threads=", 10) == 0) custom_load.threads = unsigned(max(atoi(arg + 10), 1));
+        if (strncmp(arg, "--size=", 7) == 0) custom_load.request_bytes = size_t(strtoull(arg + 7, nullptr, 10));
+        if (strncmp(arg, "--reply=", 8) == 0) {
+            custom_load.reply = Reply::Fixed;
+            custom_load.reply_bytes = size_t(strtoull(arg + 8, nullptr, 10));
+        }
+        if (strcmp(arg, "--no-batch") == 0) custom_server.batch = 1, custom_load.batch_calls = false;
+    }
+    if (serving) return serve(custom_server);
+
+    const unsigned cores = max(1u, thread::hardware_concurrency());
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "A REQUEST'S ROUND TRIP OVER 127.0.0.1\n";
+        cout << "==================================================\n";
+        cout << "\nChecking every reply, TCP and UDP, one and two reactors: "
+             << (selfTest() ? "all correct!" : "MISMATCH!") << "\n";
+        cout << "   (client and server share this machine's " << cores << " core(s))\n";
+    } else if (!selfTest()) {
+        return 1;
+    }
+
+    Table table{suite, seconds};
+    if (connecting) {
+        table.header("Your load:");
+        table.row(custom_load.protocol == Protocol::Tcp ? "TCP" : "UDP", "custom", custom_load);
+        bench_finish(&suite);
+        return 0;
+    }
+
+    const Protocol TCP = Protocol::Tcp, UDP = Protocol::Udp;
+    Server tcp, udp, udp_single;
+    string error = tcp.start(serverConfig(TCP));
+    if (error.empty()) error = udp.start(serverConfig(UDP, 1, 32));
+    if (error.empty()) error = udp_single.start(serverConfig(UDP, 1, 1));
+    if (!error.empty()) {
+        cerr << "loopback: " << error << "\n";
+        return 1;
+    }
+
+    table.header("1. Ping-pong: one 64-byte request, wait for the echo, repeat:");
+    table.row("TCP", "tcp_ping_pong", loadConfig(tcp, TCP, 1, 1, 64));
+    table.row("UDP", "udp_ping_pong", loadConfig(udp, UDP, 1, 1, 64));
+
+    table.header("2. More connections (TCP, 64 B, one request in flight on each):");
+    table.row("TCP", "tcp_conns_1", loadConfig(tcp, TCP, 1, 1, 64));
+    table.row("TCP", "tcp_conns_8", loadConfig(tcp, TCP, 8, 1, 64));
+    table.row("TCP", "tcp_conns_64", loadConfig(tcp, TCP, 64, 1, 64));
+
+    table.header("3. Pipelining: requests in flight on ONE TCP connection:");
+    for (unsigned depth : {1u, 4u, 16u, 64u}) {
+        string key = "tcp_depth_" + to_string(depth);
+        table.row("TCP", key.c_str(), loadConfig(tcp, TCP, 1, depth, 64));
+    }
+
+    table.header("4. Message size (TCP, 4 in flight):");
+    for (size_t size : {size_t(64), size_t(4096), size_t(65536)}) {
+        string name = "echo " + sizeText(size), key = "tcp_echo_" + to_string(size);
+        table.row(name.c_str(), key.c_str(), loadConfig(tcp, TCP, 1, 4, size));
+    }
+    LoadConfig download = loadConfig(tcp, TCP, 1, 4, 64);
+    download.reply = Reply::Fixed;
+    download.reply_bytes = 1 << 20;
+    table.row("64 B asks for 1 MB", "tcp_fixed_1mb", download);
+    if (!suite.quiet) cout << "   (a reply is a header plus a pointer into memory: one sendmsg, no copy)\n";
+
+    table.header("5. UDP, 4 sockets x 32 datagrams: a system call each vs recvmmsg/sendmmsg:");
+    LoadConfig single = loadConfig(udp_single, UDP, 4, 32, 64);
+    single.batch_calls = false;
+    LoadResult one_each = table.row("one datagram per call", "udp_single_calls", single);
+    LoadResult batched = table.row("32 datagrams per call", "udp_batched_calls", loadConfig(udp, UDP, 4, 32, 64));
+
+    // One event loop per core, each with its own socket on the port
+    const unsigned reactors = max(cores, 2u);
+    string title = "6. Reactors (SO_REUSEPORT), 32 TCP connections x 4 in flight, " + to_string(cores) + " core(s):";
+    table.header(title.c_str());
+    for (unsigned n : {1u, reactors}) {
+        Server server;
+        ServerConfig config = serverConfig(TCP, n);
+        config.pin = n > 1;
+        error = server.start(config);
+        if (!error.empty()) {
+            if (!suite.quiet) cout << "   -- " << error << "\n";
+            continue;
+        }
+        LoadConfig load = loadConfig(server, TCP, 32, 4, 64);
+        load.threads = max(1u, cores / 2);
+        string name = to_string(n) + (n == 1 ? " reactor" : " reactors"), key = "tcp_reactors_" + to_string(n);
+        table.row(name.c_str(), key.c_str(), load);
+        if (!suite.quiet && n > 1) {
+            cout << "   connections per reactor:";
+            for (uint64_t c : server.connectionsPerReactor()) cout << " " << c;
+            cout << "\n";
+        }
+    }
+    if (!suite.quiet && cores == 1) cout << "   (one core: the loops take turns, so more of them cannot help)\n";
+    bench_info_number(&suite, "cores", double(cores));
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * Even with no wire, a round trip costs microseconds: system\n";
+        cout << "     calls, the network stack and waking the other side.\n";
+        cout << "   * Waiting for each answer wastes that time. Keep requests in\n";
+        cout << "     flight (more connections, or pipelining) to multiply req/s.\n";
+        // From section 5: batching only wins when the calls were the cost
+        if (one_each.ok() && batched.ok() && one_each.requestsPerSec() > 0) {
+            const double gain = batched.requestsPerSec() / one_each.requestsPerSec();
+            cout << fixed << setprecision(2);
+            if (gain >= 1.1) {
+                cout << "   * Fewer system calls won here: recvmmsg/sendmmsg answered " << gain << "x\n";
+                cout << "     as many datagrams per second as one call each.\n";
+            } else if (gain > 0.9) {
+                cout << "   * recvmmsg/sendmmsg made little difference here (" << gain << "x): the\n";
+                cout << "     time went to the network stack, not to entering the kernel.\n";
+            } else {
+                cout << "   * One call per datagram was faster here (batching ran at " << gain << "x):\n";
+                cout << "     fewer system calls only help when the calls are the cost.\n";
+            }
+            cout.unsetf(ios::floatfield);
+        }
+        cout << "   * Throughput grows with load until the CPU is full; after\n";
+        cout << "     that, more load only adds queueing to the tail (p99.9).\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
@@ -0,0 +1,361 @@
+/*
+ * Rank and Select: Counting Bits Without Counting
+ * How many 1s come before bit i, and where is the k-th 1 - in billions of bits.
+ * Compile: g++ -O2 23_rank_select.cpp -o rank_select
+ * Run: ./rank_select [--bits=N] [--dir=PATH] [--json] [--runs=N]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include "rank_select.hpp"
+#include "bench.hpp"
+using namespace std;
+using namespace succinct;
+
+#if RANK_SELECT_X86
+#define POPCNT_TARGET __attribute__((target("popcnt")))
+#else
+#define POPCNT_TARGET
+#endif
+
+// ==================================================
+// The plain way: count from the start every time
+// ==================================================
+
+POPCNT_TARGET uint64_t scanRank(const uint64_t *words, uint64_t i) {
+    uint64_t r = 0;
+    for (uint64_t w = 0; w < i / 64; w++) r += uint64_t(__builtin_popcountll(words[w]));
+    if (i % 64) r += uint64_t(__builtin_popcountll(words[i / 64] & ((uint64_t(1) << (i % 64)) - 1)));
+    return r;
+}
+
+POPCNT_TARGET uint64_t scanSelect(const uint64_t *words, uint64_t word_count, uint64_t k) {
+    for (uint64_t w = 0; w < word_count; w++) {
+        uint64_t c = uint64_t(__builtin_popcountll(words[w]));
+        if (k < c) return w * 64 + selectInWordLoop(words[w], unsigned(k));
+        k -= c;
+    }
+    return BitVector::npos;
+}
+
+// The in-word steps on their own, with POPCNT like inside select1
+POPCNT_TARGET unsigned inWordLoop(uint64_t word, unsigned r) { return selectInWordLoop(word, r); }
+POPCNT_TARGET unsigned inWordBroadword(uint64_t word, unsigned r) { return selectInWordBroadword(word, r); }
+
+// Random bits as a stream of words: each word is the AND of `ands` random
+// words, so 1 bit in 2^ands is set
+static BitVector randomBits(uint64_t bits, unsigned ands, uint64_t seed) {
+    mt19937_64 rng(seed);
+    Builder b;
+    b.reserve(bits);
+    for (uint64_t at = 0; at < bits; at += 64) {
+        uint64_t word = rng();
+        for (unsigned j = 1; j < ands; j++) word &= rng();
+        b.pushWord(word, unsigned(min<uint64_t>(64, bits - at)));
+    }
+    return b.finish();
+}
+
+// Every rank and every select against counting one bit at a time
+static bool matchesNaive(const BitVector &v, const vector<bool> &bits) {
+    if (v.size() != bits.size()) return false;
+    uint64_t ones = 0;
+    for (uint64_t i = 0; i <= bits.size(); i++) {
+        if (v.rank1(i) != ones || v.rank0(i) != i - ones) return false;
+        if (i == bits.size()) break;
+        if (v[i] != bits[i]) return false;
+        if (bits[i]) {
+            if (v.select1(ones) != i || v.select1NoPdep(ones) != i) return false;
+            ones++;
+        }
+    }
+    return v.ones() == ones && v.select1(ones) == BitVector::npos;
+}
+
+// Every size around a word, sub-block and block edge, at several
+// densities; bits pushed one at a time and in odd-sized pieces; a file
+// round trip; and the 2^32-bit boundary where the counts change level
+bool selfTest(const string &dir) {
+    mt19937_64 rng(7);
+    for (uint64_t size : {0, 1, 63, 64, 65, 511, 512, 513, 2047, 2048, 2049, 6000, 40000, 300000}) {
+        for (double density : {0.0, 0.001, 0.1, 0.5, 0.97, 1.0}) {
+            vector<bool> bits(size);
+            Builder one, pieces;
+            for (uint64_t i = 0; i < size; i++) {
+                bits[i] = double(rng() % 1000000) < density * 1000000;
+                one.push(bits[i]);
+            }
+            for (uint64_t i = 0; i < size;) {
+                unsigned count = unsigned(min<uint64_t>(rng() % 65, size - i));
+                uint64_t word = rng();  // bits above `count` must be ignored
+                for (unsigned j = 0; j < count; j++) {
+                    word = (word & ~(uint64_t(1) << j)) | (uint64_t(bits[i + j]) << j);
+                }
+                pieces.pushWord(word, count);
+                i += count;
+            }
+            if (!matchesNaive(one.finish(), bits) || !matchesNaive(pieces.finish(), bits)) return false;
+        }
+    }
+
+    // Saved and mapped, the answers stay the same
+    BitVector v = randomBits(1000000, 2, 5);
+    const string path = dir + "/rank_select_check.rs";
+    BitVector m;
+    if (!v.save(path).empty() || !m.open(path).empty() || !m.mapped()) return false;
+    for (uint64_t i = 0; i <= v.size(); i += 997) {
+        if (m.rank1(i) != v.rank1(i)) return false;
+    }
+    for (uint64_t k = 0; k < v.ones(); k += 331) {
+        if (m.select1(k) != v.select1(k)) return false;
+    }
+    BitVector none = randomBits(0, 2, 5);  // an empty one has empty parts
+    if (!none.save(path).empty() || !m.open(path).empty() || m.size() != 0 || m.rank1(0) != 0) return false;
+    if (!v.save(path).empty()) return false;
+    m = BitVector();
+    FILE *f = fopen(path.c_str(), "r+b");  // a damaged header is refused
+    bool damaged = f && fputc('X', f) != EOF;
+    if (f) fclose(f);
+    bool refused = damaged && !m.open(path).empty() && !m.open(dir + "/no/such/file").empty();
+    remove(path.c_str());
+    if (!refused) return false;
+
+    // Past 2^32 bits: a few 1s on each side of the boundary
+    Builder big;
+    const uint64_t boundary = kL0Bits;
+    const uint64_t marks[] = {5, boundary - 70, boundary - 1, boundary, boundary + 1, boundary + 3000};
+    uint64_t next = 0;
+    for (uint64_t at = 0; at < boundary + 4096; at += 64) {
+        uint64_t word = 0;
+        while (next < 6 && marks[next] < at + 64) word |= uint64_t(1) << (marks[next++] - at);
+        big.pushWord(word);
+    }
+    BitVector huge = big.finish();
+    for (uint64_t k = 0; k < 6; k++) {
+        if (huge.select1(k) != marks[k] || huge.rank1(marks[k]) != k || huge.rank1(marks[k] + 1) != k + 1) {
+            return false;
+        }
+    }
+    return huge.rank1(huge.size()) == 6 && huge.select1(6) == BitVector::npos;
+}
+
+static string sizeText(uint64_t bits) {
+    return bits >= (uint64_t(1) << 30) ? to_string(bits >> 30) + "G"
+           : bits >= (1 << 20)         ? to_string(bits >> 20) + "M"
+                                       : to_string(bits >> 10) + "K";
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "rank_select", argc, argv);
+    uint64_t bits = uint64_t(1) << 32;
+    string dir = ".";
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--bits=", 7) == 0) bits = max<uint64_t>(strtoull(argv[i] + 7, nullptr, 10), 1 << 20);
+        if (strncmp(argv[i], "--dir=", 6) == 0) dir = argv[i] + 6;
+    }
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "RANK AND SELECT: COUNTING BITS WITHOUT COUNTING\n";
+        cout << "==================================================\n";
+
+        cout << "\n1. The two questions, on 16 bits:\n";
+        const char *text = "0110100011010010";  // bit 0 first
+        Builder b;
+        for (const char *c = text; *c; c++) b.push(*c == '1');
+        BitVector small = b.finish();
+        cout << "   bits        " << text << "\n";
+        cout << "   rank1(8)  = " << small.rank1(8) << "   (1s in bits 0..7)\n";
+        cout << "   select1(4) = " << small.select1(4) << "  (the 5th 1 is bit " << small.select1(4) << ")\n";
+        cout << "   rank1(select1(k)) = k, always\n";
+
+        cout << "\n2. Checking every rank and select against counting bit by bit: "
+             << (selfTest(dir) ? "all correct!" : "MISMATCH!") << "\n";
+        cout << "   (sizes 0 to 300000 and past 2^32; densities 0 to 1; a saved file)\n";
+        cout << "   POPCNT " << (cpu().popcnt ? "yes" : "no") << ", PDEP (BMI2) " << (cpu().bmi2 ? "yes" : "no")
+             << " on this CPU\n";
+    } else if (!selfTest(dir)) {
+        return 1;
+    }
+
+    // ---- Building, and what the directory costs ----
+    if (!suite.quiet) {
+        cout << "\n3. Building from a stream of " << sizeText(bits) << " bits, and the size of the directory:\n";
+        cout << "   bits set     build time      bits MB   directory MB   overhead\n";
+    }
+    BitVector half, sparse;
+    for (unsigned ands : {1u, 7u}) {
+        uint64_t t0 = bench_now_ns();
+        BitVector v = randomBits(bits, ands, 11);
+        double seconds = double(bench_now_ns() - t0) / 1e9;
+        double overhead = 100.0 * double(v.indexBytes()) / double(v.bitBytes());
+        if (!suite.quiet) {
+            cout << "   " << left << setw(8) << (ands == 1 ? "1 in 2" : "1 in 128") << right << fixed << setprecision(2) << setw(14) << seconds
+                 << " s" << setw(13) << v.bitBytes() / 1e6 << setw(15) << v.indexBytes() / 1e6 << setw(10)
+                 << overhead << "%\n";
+            cout.unsetf(ios::floatfield);
+        }
+        bench_info_number(&suite, ands == 1 ? "overhead_pct_dense" : "overhead_pct_sparse", overhead);
+        (ands == 1 ? half : sparse) = move(v);
+    }
+    if (!suite.quiet) cout << "   (build time includes making the random bits)\n";
+
+    // Random queries, each one depending on the answer before, so this
+    // is the time one query takes (its latency), cache misses and all
+    const size_t kQueries = 1 << 16;
+    mt19937_64 rng(3);
+    auto positions = [&](uint64_t limit) {
+        vector<uint64_t> p(kQueries);
+        for (uint64_t &x : p) x = rng() % limit;
+        return p;
+    };
+    size_t next = 0;  // runs continue down the list, so none repeats the last one's (cached) queries
+
+    bench_section(&suite, "4. rank1(i) at random i:");
+    const uint64_t kSmall = 1 << 20, kMedium = 1 << 24;
+    BitVector small = randomBits(kSmall, 1, 12), medium = randomBits(kMedium, 1, 13);
+    vector<uint64_t> in_small = positions(kSmall - 1), in_medium = positions(kMedium - 1);
+    vector<uint64_t> in_half = positions(half.size() - 1);
+    auto rankRun = [&](const char *name, const BitVector &v, const vector<uint64_t> &at) {
+        benchRun(suite, name, [&](size_t n) {
+            uint64_t last = 0;
+            for (size_t k = 0; k < n; k++) last = v.rank1(at[next++ % kQueries] ^ (last & 1));
+            doNotOptimize(last);
+        });
+    };
+    benchRun(suite, "scan, 1M bits", [&](size_t n) {
+        uint64_t last = 0;
+        for (size_t k = 0; k < n; k++) last = scanRank(small.words(), in_small[next++ % kQueries] ^ (last & 1));
+        doNotOptimize(last);
+    });
+    benchRun(suite, "scan, 16M bits", [&](size_t n) {
+        uint64_t last = 0;
+        for (size_t k = 0; k < n; k++) last = scanRank(medium.words(), in_medium[next++ % kQueries] ^ (last & 1));
+        doNotOptimize(last);
+    });
+    rankRun("rank1, 1M bits", small, in_small);
+    rankRun("rank1, 16M bits", medium, in_medium);
+    string big_rank = "rank1, " + sizeText(bits) + " bits";
+    rankRun(big_rank.c_str(), half, in_half);
+    bench_compare(&suite, "scan, 16M bits", "rank1, 16M bits");
+
+    bench_section(&suite, "5. select1(k) at random k:");
+    vector<uint64_t> k_small = positions(small.ones() - 1), k_medium = positions(medium.ones() - 1);
+    vector<uint64_t> k_half = positions(half.ones() - 1), k_sparse = positions(sparse.ones() - 1);
+    auto selectRun = [&](const char *name, const BitVector &v, const vector<uint64_t> &at, bool pdep) {
+        benchRun(suite, name, [&](size_t n) {
+            uint64_t last = 0;
+            for (size_t k = 0; k < n; k++) {
+                uint64_t i = at[next++ % kQueries] ^ (last & 1);
+                last = pdep ? v.select1(i) : v.select1NoPdep(i);
+            }
+            doNotOptimize(last);
+        });
+    };
+    benchRun(suite, "scan, 1M bits", [&](size_t n) {
+        uint64_t last = 0;
+        for (size_t k = 0; k < n; k++) {
+            last = scanSelect(small.words(), small.wordCount(), k_small[next++ % kQueries] ^ (last & 1));
+        }
+        doNotOptimize(last);
+    });
+    selectRun("select1, 1M bits", small, k_small, true);
+    selectRun("select1, 16M bits", medium, k_medium, true);
+    string big_select = "select1, " + sizeText(bits) + " bits";
+    string big_nopdep = "select1 no PDEP, " + sizeText(bits);
+    string big_sparse = "select1, " + sizeText(bits) + ", 1 in 128";
+    selectRun(big_select.c_str(), half, k_half, true);
+    selectRun(big_nopdep.c_str(), half, k_half, false);
+    selectRun(big_sparse.c_str(), sparse, k_sparse, true);
+    bench_compare(&suite, "scan, 1M bits", "select1, 1M bits");
+
+    bench_section(&suite, "6. Inside one word: the position of its r-th 1:");
+    vector<uint64_t> words(4096);
+    vector<unsigned> ranks(4096);
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] = rng() | 1;
+        ranks[i] = unsigned(rng() % uint64_t(__builtin_popcountll(words[i])));
+    }
+    auto inWordRun = [&](const char *name, unsigned (*select)(uint64_t, unsigned)) {
+        benchRun(suite, name, [&](size_t n) {
+            unsigned last = 0;
+            for (size_t k = 0; k < n; k++, next++) {
+                last = select(words[next % 4096], ranks[next % 4096] & ~(last & 64));
+            }
+            doNotOptimize(last);
+        });
+    };
+    inWordRun("clear the lowest 1, r times", inWordLoop);
+    inWordRun("broadword (popcount halves)", inWordBroadword);
+#if RANK_SELECT_X86
+    if (cpu().bmi2) {
+        inWordRun("PDEP + TZCNT", selectInWordPdep);
+        bench_compare(&suite, "clear the lowest 1, r times", "PDEP + TZCNT");
+    }
+#endif
+
+    // ---- Saving, and opening with mmap ----
+    if (!suite.quiet) {
+        cout << "\n7. Save " << sizeText(bits) << " bits to " << dir << ", then open with mmap:\n";
+        cout.flush();
+    }
+    const string path = dir + "/rank_select_test.rs";
+    uint64_t t0 = bench_now_ns();
+    string error = half.save(path);
+    uint64_t t1 = bench_now_ns();
+    BitVector opened;
+    if (error.empty()) error = opened.open(path);
+    uint64_t t2 = bench_now_ns();
+    if (!error.empty()) {
+        if (!suite.quiet) cout << "   -- " << error << "\n";
+    } else {
+        // The first queries fault pages in; the same ones again are warm
+        uint64_t sum = 0;
+        uint64_t t3 = bench_now_ns();
+        for (size_t k = 0; k < 1000; k++) sum += opened.rank1(in_half[k]);
+        uint64_t t4 = bench_now_ns();
+        for (size_t k = 0; k < 1000; k++) sum -= opened.rank1(in_half[k]);
+        uint64_t t5 = bench_now_ns();
+        doNotOptimize(sum);
+        if (!suite.quiet) {
+            cout << fixed << setprecision(1);
+            cout << "   save:                      " << setw(10) << double(t1 - t0) / 1e6 << " ms   ("
+                 << (half.bitBytes() + half.indexBytes()) / 1000000 << " MB)\n";
+            cout << "   open (mmap, nothing read): " << setw(10) << double(t2 - t1) / 1e3 << " us\n";
+            cout << "   first 1000 rank1 calls:    " << setw(10) << double(t4 - t3) / 1e3 << " us\n";
+            cout << "   the same 1000 again:       " << setw(10) << double(t5 - t4) / 1e3 << " us\n";
+            cout.unsetf(ios::floatfield);
+        }
+        bench_info_number(&suite, "open_us", double(t2 - t1) / 1e3);
+    }
+    remove(path.c_str());
+    bench_info_number(&suite, "bits", double(bits));
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * Counting 1s from the start costs time in proportion to i;\n";
+        cout << "     a 3% directory of running counts makes rank one lookup.\n";
+        cout << "   * select reuses the same counts: a sample to start near, a\n";
+        cout << "     short search, then one word.\n";
+        cout << "   * PDEP finds the r-th 1 of a word in one instruction.\n";
+        cout << "   * On billions of bits, the cost is the cache misses: a few\n";
+        cout << "     memory reads per query, whatever the size. Sparse bits\n";
+        cout << "     spread select's search over more blocks.\n";
+        cout << "   * The bits and the directory are plain arrays, so a file\n";
+        cout << "     is ready to query the moment it is mapped.\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
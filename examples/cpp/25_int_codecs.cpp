@@ -0,0 +1,359 @@
+/*
+ * Integer Compression: Varint, Zigzag, Frame of Reference and Delta
+ * How many bytes each codec needs for common kinds of numbers, and how
+ * fast they come back, next to a plain array of 32-bit ints.
+ * Compile: g++ -O2 25_int_codecs.cpp -o int_codecs
+ * Run: ./int_codecs [--json] [--runs=N] [--values=N] [--dir=/usr]
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include "int_codec.hpp"
+#include "bench.hpp"
+using namespace std;
+using namespace intcodec;
+
+enum class Codec { Varint, For, Delta };
+
+static const char *codecName(Codec c) {
+    return c == Codec::Varint ? "varint" : c == Codec::For ? "frame of reference" : "delta + FOR";
+}
+
+static size_t maxBytes(Codec c, size_t n) { return c == Codec::Varint ? maxVarintBytes(n) : maxPackedBytes(n); }
+
+static size_t encode(Codec c, Kernel k, const vector<uint32_t> &values, uint8_t *out) {
+    if (c == Codec::Varint) return encodeVarintsWith(k, values.data(), values.size(), out);
+    if (c == Codec::For) return packForWith(k, values.data(), values.size(), out);
+    return packDeltaWith(k, values.data(), values.size(), out);
+}
+
+static const uint8_t *decode(Codec c, Kernel k, const uint8_t *in, const uint8_t *end, uint32_t *out, size_t n) {
+    if (c == Codec::Varint) return decodeVarintsWith(k, in, end, out, n);
+    if (c == Codec::For) return unpackForWith(k, in, end, out, n);
+    return unpackDeltaWith(k, in, end, out, n);
+}
+
+// Every codec, with every kernel, gives back exactly what went in, and
+// the kernels agree byte for byte on the encoding
+static bool roundTrips(const vector<uint32_t> &values) {
+    const size_t n = values.size();
+    for (Codec c : {Codec::Varint, Codec::For, Codec::Delta}) {
+        vector<uint8_t> scalar(maxBytes(c, n) + 16), fast(maxBytes(c, n) + 16);
+        size_t used = encode(c, Kernel::Scalar, values, scalar.data());
+        if (encode(c, bestKernel(), values, fast.data()) != used || !equal(scalar.begin(), scalar.end(), fast.begin())) {
+            return false;
+        }
+        for (Kernel k : {Kernel::Scalar, bestKernel()}) {
+            vector<uint32_t> back(n + 1, 0xDEADBEEF);
+            if (decode(c, k, scalar.data(), scalar.data() + used, back.data(), n) != scalar.data() + used) return false;
+            if (!equal(values.begin(), values.end(), back.begin()) || back[n] != 0xDEADBEEF) return false;
+            if (n > 0 && decode(c, k, scalar.data(), scalar.data() + used - 1, back.data(), n) != nullptr) return false;
+        }
+    }
+    return true;
+}
+
+bool selfTest() {
+    bool ok = zigzagEncode(int32_t(0)) == 0 && zigzagEncode(int32_t(-1)) == 1 && zigzagEncode(int32_t(1)) == 2 &&
+              zigzagEncode(INT32_MIN) == 0xFFFFFFFFu && zigzagDecode(uint32_t(5)) == -3 &&
+              zigzagDecode(zigzagEncode(INT64_MIN)) == INT64_MIN;
+
+    // Single varints: known bytes, the largest value, and bad input
+    uint8_t buf[16];
+    uint64_t v = 0;
+    ok = ok && putVarint(buf, 300) - buf == 2 && buf[0] == 0xAC && buf[1] == 0x02;
+    ok = ok && putVarint(buf, UINT64_MAX) - buf == 10 && varintLength(UINT64_MAX) == 10;
+    ok = ok && getVarint(buf, buf + 10, v) == buf + 10 && v == UINT64_MAX;
+    ok = ok && getVarint(buf, buf + 9, v) == nullptr;  // cut short
+    buf[9] = 0x02;
+    ok = ok && getVarint(buf, buf + 10, v) == nullptr;  // 65 bits
+    memset(buf, 0x80, sizeof buf);
+    ok = ok && getVarint(buf, buf + 16, v) == nullptr;  // never ends
+    uint32_t small;
+    ok = ok && putVarint(buf, uint64_t(1) << 32) && decodeVarints(buf, buf + 5, &small, 1) == nullptr;
+
+    // Every bit width, many lengths, sorted and not
+    mt19937 rng(9);
+    for (size_t n : {0, 1, 15, 16, 17, 127, 128, 129, 300, 1000, 5000}) {
+        for (int bits = 0; bits <= 32 && ok; bits++) {
+            vector<uint32_t> values(n);
+            const uint32_t base = uint32_t(rng());
+            for (uint32_t &x : values) x = base + uint32_t(rng() & detail::lowMask(bits));
+            ok = ok && roundTrips(values);
+            sort(values.begin(), values.end());
+            ok = ok && roundTrips(values);
+        }
+        // Varints of every length, mixed
+        vector<uint32_t> mixed(n);
+        for (uint32_t &x : mixed) x = uint32_t(rng()) >> (rng() % 32);
+        ok = ok && roundTrips(mixed);
+    }
+    return ok;
+}
+
+// ==================================================
+// Test data
+// ==================================================
+
+struct Dataset {
+    string name;
+    vector<uint32_t> values;
+};
+
+static vector<Dataset> syntheticData(size_t n) {
+    mt19937 rng(1);
+    vector<Dataset> all;
+    auto make = [&](const char *name, auto next) {
+        Dataset d{name, vector<uint32_t>(n)};
+        for (uint32_t &x : d.values) x = next();
+        all.push_back(move(d));
+    };
+    uniform_int_distribution<uint32_t> percent(0, 99);
+    geometric_distribution<uint32_t> counts(0.05);
+    normal_distribution<double> noise(0, 50);
+    make("small (0-99)", [&] { return percent(rng); });
+    make("counts (geometric, mean 20)", [&] { return counts(rng); });
+    make("signed noise (zigzag)", [&] { return zigzagEncode(int32_t(lround(noise(rng)))); });
+    uint32_t id = 0, second = 1700000000;
+    make("sorted ids (gaps ~8)", [&] { return id += 1 + rng() % 15; });
+    make("timestamps (sorted seconds)", [&] { return second += rng() % 4 == 0; });
+    make("random 32-bit", [&] { return uint32_t(rng()); });
+    return all;
+}
+
+// Real numbers from this machine: file sizes, and where every line of
+// those files starts (a sorted "posting list", as in a search index)
+static vector<Dataset> realData(const string &dir, size_t n) {
+    Dataset sizes{"file sizes under " + dir, {}}, lines{"line starts in those files", {}};
+    error_code ec;
+    filesystem::recursive_directory_iterator it(dir, filesystem::directory_options::skip_permission_denied, ec);
+    uint64_t offset = 0;
+    vector<char> text;
+    for (; !ec && it != filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if (sizes.values.size() >= n) break;
+        if (!it->is_regular_file(ec) || it->is_symlink(ec)) continue;
+        uint64_t size = it->file_size(ec);
+        if (ec || size > 0xFFFFFFFFu) continue;
+        sizes.values.push_back(uint32_t(size));
+        if (lines.values.size() >= n || offset + size > 0xFFFFFFFFu || size > (1 << 20)) continue;
+        ifstream file(it->path(), ios::binary);
+        text.resize(size);
+        if (!file.read(text.data(), streamsize(size))) continue;
+        for (size_t i = 0; i < size && lines.values.size() < n; i++) {
+            if (text[i] == '\n') lines.values.push_back(uint32_t(offset + i + 1));
+        }
+        offset += size;
+    }
+    vector<Dataset> all;
+    if (sizes.values.size() >= kBlock) all.push_back(move(sizes));
+    if (lines.values.size() >= kBlock) all.push_back(move(lines));
+    return all;
+}
+
+// ==================================================
+// Measuring
+// ==================================================
+
+// Median time of `runs` calls
+template <typename Work>
+static double medianSeconds(int runs, Work work) {
+    vector<double> times;
+    for (int r = 0; r < runs; r++) {
+        uint64_t t0 = bench_now_ns();
+        work();
+        times.push_back(double(bench_now_ns() - t0) / 1e9);
+    }
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+struct Table {
+    bench_suite &suite;
+    int runs;
+
+    void header(const string &title, size_t n, double copy_gbs) const {
+        if (suite.quiet) return;
+        cout << "\n   " << title << " (" << n << " values; memcpy of the raw array: " << fixed << setprecision(1)
+             << copy_gbs << " GB/s)\n";
+        cout.unsetf(ios::floatfield);
+        cout << "   codec               bytes/value   ratio   encode GB/s   decode GB/s: scalar   "
+             << kernelName(bestKernel()) << "\n";
+    }
+
+    // GB/s are of raw 32-bit values, in or out
+    void row(Codec c, const vector<uint32_t> &values, const string &key) const {
+        const size_t n = values.size();
+        vector<uint8_t> bytes(maxBytes(c, n) + 16);
+        vector<uint32_t> back(n);
+        size_t used = 0;
+        double encode_s = medianSeconds(runs, [&] { used = encode(c, bestKernel(), values, bytes.data()); });
+        double decode_s[2];
+        Kernel kernels[2] = {Kernel::Scalar, bestKernel()};
+        for (int k = 0; k < 2; k++) {
+            decode_s[k] = medianSeconds(runs, [&] {
+                if (!decode(c, kernels[k], bytes.data(), bytes.data() + used, back.data(), n)) abort();
+                doNotOptimize(back.data());
+            });
+        }
+        if (back != values) abort();
+        const double raw_gb = 4.0 * double(n) / 1e9, ratio = 4.0 * double(n) / double(used);
+        if (!suite.quiet) {
+            cout << "   " << left << setw(20) << codecName(c) << right << fixed << setprecision(2) << setw(12)
+                 << double(used) / double(n) << setprecision(1) << setw(8) << ratio << setw(14) << raw_gb / encode_s
+                 << setw(22) << raw_gb / decode_s[0] << setw(9) << raw_gb / decode_s[1] << "\n";
+            cout.unsetf(ios::floatfield);
+        }
+        bench_info_number(&suite, (key + "_ratio").c_str(), ratio);
+    }
+};
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "int_codecs", argc, argv);
+    size_t n = 1 << 22;
+    string dir = "/usr";
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--values=", 9) == 0) {
+            // At least one block; at most 2^28 (1 GB for each of the value arrays)
+            const char *text = argv[i] + 9;
+            char *end;
+            errno = 0;
+            const unsigned long long values = strtoull(text, &end, 10);
+            if (!isdigit((unsigned char)*text) || *end || errno == ERANGE || values < kBlock || values > (1ull << 28)) {
+                cerr << "Usage: " << argv[0] << " [--values=N]  (N from " << kBlock << " to " << (1ull << 28) << ")\n";
+                return 2;
+            }
+            n = size_t(values);
+        }
+        if (strncmp(argv[i], "--dir=", 6) == 0) dir = argv[i] + 6;
+    }
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "INTEGER COMPRESSION: ONLY THE BITS A NUMBER NEEDS\n";
+        cout << "==================================================\n";
+
+        cout << "\n1. The same numbers, as bytes:\n";
+        cout << "   value          int32 bytes     varint bytes\n";
+        for (uint32_t value : {5u, 300u, 70000u, 4000000000u}) {
+            uint8_t buf[10];
+            uint8_t *end = putVarint(buf, value);
+            cout << "   " << left << setw(15) << value;
+            char hex[8];
+            for (int b = 0; b < 4; b++) {
+                snprintf(hex, sizeof hex, "%02X ", (value >> (8 * b)) & 0xFF);
+                cout << hex;
+            }
+            cout << "    ";
+            for (uint8_t *p = buf; p < end; p++) {
+                snprintf(hex, sizeof hex, "%02X ", *p);
+                cout << hex;
+            }
+            cout << right << "\n";
+        }
+        cout << "   (little-endian; a varint byte with its top bit set means \"more follow\")\n";
+        cout << "   zigzag: -1 -> " << zigzagEncode(int32_t(-1)) << ", 1 -> " << zigzagEncode(int32_t(1))
+             << ", -64 -> " << zigzagEncode(int32_t(-64)) << " (1 varint byte, not 5)\n";
+
+        cout << "\n2. Checking every codec, bit width and kernel by encoding and decoding: "
+             << (selfTest() ? "all correct!" : "MISMATCH!") << "\n";
+        cout << "   Best kernel on this CPU: " << kernelName(bestKernel()) << "\n";
+    } else if (!selfTest()) {
+        return 1;
+    }
+
+    // ---- Size and speed on whole arrays ----
+    const int runs = max(suite.runs, 3);
+    Table table{suite, runs};
+    vector<Dataset> data = syntheticData(n);
+    vector<Dataset> real = realData(dir, n);
+    if (!suite.quiet) {
+        cout << "\n3. Synthetic data (ratio = 4-byte ints / encoded bytes; GB/s of 4-byte ints):\n";
+    }
+    size_t shown = 0;
+    for (vector<Dataset> *set : {&data, &real}) {
+        if (set == &real && !suite.quiet) {
+            cout << "\n4. Real data from " << dir << (real.empty() ? ": (nothing readable there)" : ":") << "\n";
+        }
+        for (const Dataset &d : *set) {
+            vector<uint32_t> copy(d.values.size());
+            double copy_s = medianSeconds(runs, [&] {
+                memcpy(copy.data(), d.values.data(), 4 * d.values.size());
+                doNotOptimize(copy.data());
+            });
+            table.header(d.name, d.values.size(), 4.0 * double(d.values.size()) / 1e9 / copy_s);
+            const string key = "data" + to_string(shown++);
+            table.row(Codec::Varint, d.values, key + "_varint");
+            table.row(Codec::For, d.values, key + "_for");
+            table.row(Codec::Delta, d.values, key + "_delta");
+        }
+    }
+
+    // ---- Decoding values that stay in cache ----
+    const size_t kCached = min<size_t>(16 * 1024, n);  // 64 KB of ints
+    auto firstValues = [&](const Dataset &d) { return vector<uint32_t>(d.values.begin(), d.values.begin() + kCached); };
+    vector<uint32_t> counts = firstValues(data[1]), ids = firstValues(data[3]), back(kCached);
+    bench_section(&suite, "5. Decode 16K values, all in cache (per call):");
+    benchRun(suite, "memcpy the raw ints", [&](size_t iters) {
+        for (size_t k = 0; k < iters; k++) {
+            memcpy(back.data(), ids.data(), 4 * kCached);
+            doNotOptimize(back.data());
+        }
+    });
+    for (Codec c : {Codec::Varint, Codec::For, Codec::Delta}) {
+        const vector<uint32_t> &values = c == Codec::Delta ? ids : counts;
+        vector<uint8_t> bytes(maxBytes(c, kCached) + 16);
+        size_t used = encode(c, Kernel::Scalar, values, bytes.data());
+        string names[2];
+        for (Kernel k : {Kernel::Scalar, bestKernel()}) {
+            string &name = names[k == Kernel::Scalar ? 0 : 1];
+            name = string(c == Codec::Varint ? "varint" : c == Codec::For ? "FOR" : "delta + FOR") +
+                   (c == Codec::Delta ? " (ids), " : " (counts), ") + kernelName(k);
+            benchRun(suite, name.c_str(), [&](size_t iters) {
+                for (size_t i = 0; i < iters; i++) {
+                    const uint8_t *in = bytes.data();
+                    hideValue(in);
+                    doNotOptimize(decode(c, k, in, in + used, back.data(), kCached));
+                }
+            });
+            if (k == bestKernel()) break;
+        }
+        if (bestKernel() != Kernel::Scalar) bench_compare(&suite, names[0].c_str(), names[1].c_str());
+    }
+    bench_info_number(&suite, "values", double(n));
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * Small numbers in 4-byte ints waste most of every int;\n";
+        cout << "     a varint spends one byte below 128, two below 16384.\n";
+        cout << "   * Negative numbers need zigzag first, or every -1 is a\n";
+        cout << "     5-byte varint.\n";
+        cout << "   * Frame of reference packs a block in exactly the bits\n";
+        cout << "     its range needs, and four values decode per SSE\n";
+        cout << "     instruction, because nothing depends on the last byte.\n";
+        cout << "   * Sorted data: store the gaps. Ids and timestamps shrink\n";
+        cout << "     to a few bits each; random 32-bit values never shrink.\n";
+        cout << "   * Varints decode one byte at a time unless SIMD lines them\n";
+        cout << "     up; past 4 bytes (big or random values) they lose to\n";
+        cout << "     the raw array in both size and speed.\n";
+        cout << "   * From memory, packed blocks decode about as fast as\n";
+        cout << "     memcpy copies the raw array, while reading a fraction of\n";
+        cout << "     the bytes; in cache, memcpy is still several times faster.\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * Fast Binary Formatting in C++
+ * Replace one bitset<8> per value with one call per buffer!
+ * Compile: g++ -O2 4_binary_format.cpp -o binary_format
+ * Run: ./binary_format [megabytes]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <bitset>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include "../c/binfmt.h"
+using namespace std;
+
+// Time a piece of work and return seconds (best of `runs`)
+template <typename Work>
+double timeBest(int runs, Work work) {
+    double best = 1e9;
+    for (int run = 0; run < runs; run++) {
+        auto start = chrono::steady_clock::now();
+        work();
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+        if (took.count() < best) best = took.count();
+    }
+    return best;
+}
+
+static const size_t kMaxMegabytes = 256;  // 2 GB of text
+
+int main(int argc, char *argv[]) {
+    size_t megabytes = 8;
+    if (argc > 1) {
+        // At most kMaxMegabytes: the text is 8 bytes for every input byte
+        char *end;
+        errno = 0;
+        megabytes = strtoul(argv[1], &end, 10);
+        if (!isdigit((unsigned char)argv[1][0]) || *end || errno == ERANGE || megabytes == 0 || megabytes > kMaxMegabytes) {
+            fprintf(stderr, "Usage: %s [megabytes]  (1 to %zu)\n", argv[0], kMaxMegabytes);
+            return 1;
+        }
+    }
+
+    cout << "==================================================\n";
+    cout << "FAST BINARY FORMATTING IN C++\n";
+    cout << "==================================================\n";
+
+    // The text_style flags from 2_binary_ops.cpp, as a tiny "register dump"
+    cout << "\n1. A whole register dump in one call:\n";
+    vector<uint8_t> styles = {0, 1, 3, 2};
+    binfmt_options opt = {8, 4, '_', ' '};
+    string text(binfmt_size(styles.size(), &opt), '\0');
+    binfmt_format(&text[0], styles.data(), styles.size(), &opt);
+    cout << "   styles: " << text << "\n";
+
+    vector<uint64_t> regs = {0xFF6496, 0x8000000000000001ULL};
+    binfmt_options reg_opt = {64, 16, ' ', '\n'};
+    text.assign(binfmt_size(regs.size(), &reg_opt), '\0');
+    binfmt_format(&text[0], regs.data(), regs.size(), &reg_opt);
+    cout << "   registers:\n" << text << "\n";
+
+    cout << "\n==================================================\n";
+    cout << "SPEED TEST (" << megabytes << " MB of bytes -> text)\n";
+    cout << "==================================================\n\n";
+
+    size_t size = megabytes * 1024 * 1024;
+    vector<uint8_t> input(size);
+    mt19937 rng(42);
+    for (auto &b : input) b = static_cast<uint8_t>(rng());
+
+    // One temporary bitset<8> per byte, streamed like 2_binary_ops.cpp does
+    ofstream sink("/dev/null");
+    double bitset_time = timeBest(3, [&] {
+        for (uint8_t b : input) sink << bitset<8>(b) << ' ';
+    });
+    double bitset_rate = size / bitset_time / 1e6;
+    printf("   %-24s %9.1f MB/s of input\n", "ostream << bitset<8>", bitset_rate);
+
+    // Same text, built with binfmt into one buffer. Only the formatting is
+    // timed; the buffer is written once afterwards.
+    binfmt_options dump = {8, 0, 0, ' '};
+    binfmt_options digits = {8, 0, 0, 0};
+    string out(binfmt_size(size, &dump), '\0');
+    binfmt_kernel best = binfmt_detect();
+    bool same = true;
+    string reference;
+    printf("\n   %-24s %12s %14s\n", "", "digits only", "with spaces");
+    for (int k = 0; k <= static_cast<int>(best); k++) {
+        auto kernel = static_cast<binfmt_kernel>(k);
+        // Digits only is the kernel alone; the spaces are added by one
+        // copy loop that every kernel shares
+        double digits_time = timeBest(5, [&] { binfmt_format_with(kernel, &out[0], input.data(), size, &digits); });
+        double t = timeBest(5, [&] { binfmt_format_with(kernel, &out[0], input.data(), size, &dump); });
+        if (k == 0) reference = out;
+        else same = same && out == reference;
+        double rate = size / t / 1e6;
+        printf("   binfmt %-17s %7.1f MB/s %9.1f MB/s (%.0fx bitset)\n", binfmt_kernel_name(kernel),
+               size / digits_time / 1e6, rate, rate / bitset_rate);
+    }
+    sink.write(out.data(), static_cast<streamsize>(out.size()));  // written once, not timed
+
+    // And make sure it matches what bitset prints
+    ostringstream check;
+    for (size_t i = 0; i < 4096 && i < size; i++) {
+        if (i) check << ' ';
+        check << bitset<8>(input[i]);
+    }
+    same = same && reference.compare(0, check.str().size(), check.str()) == 0;
+    cout << "\n   Output matches bitset<8>? " << (same ? "Yes!" : "NO") << "\n";
+
+    cout << "\n==================================================\n";
+    cout << "Format the whole buffer, then write it once! 🎉\n";
+    cout << "==================================================\n";
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+/*
+ * Fast Hex in C++
+ * How fast can bytes become hex text (and back)?
+ * Compile: g++ -O2 5_hex_codec.cpp -o hex_codec
+ * Run: ./hex_codec [megabytes]
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include "../c/hexcodec.h"
+using namespace std;
+
+template <typename Work>
+double timeBest(int runs, Work work) {
+    double best = 1e9;
+    for (int run = 0; run < runs; run++) {
+        auto start = chrono::steady_clock::now();
+        work();
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+        if (took.count() < best) best = took.count();
+    }
+    return best;
+}
+
+void report(const char *name, size_t bytes, double seconds, double baseline) {
+    double rate = bytes / seconds / 1e6;
+    printf("   %-26s %9.1f MB/s", name, rate);
+    if (baseline > 0) printf("  (%.0fx)", rate / baseline);
+    printf("\n");
+}
+
+// Every kernel must agree with printf, decode its own output, and point
+// at exactly the right character when the input is bad
+bool selfTest() {
+    mt19937 rng(7);
+    hex_kernel best = hex_detect();
+    for (size_t len = 0; len < 300; len += 1 + len / 8) {
+        vector<uint8_t> bytes(len);
+        for (auto &b : bytes) b = static_cast<uint8_t>(rng());
+        string expected;
+        char pair[3];
+        for (uint8_t b : bytes) {
+            snprintf(pair, sizeof(pair), "%02X", b);
+            expected += pair;
+        }
+
+        for (int k = 0; k <= static_cast<int>(best); k++) {
+            auto kernel = static_cast<hex_kernel>(k);
+            string text(2 * len, '\0');
+            hex_encode_with(kernel, &text[0], bytes.data(), len, 1);
+            if (text != expected) return false;
+
+            // Mixed case must decode too
+            for (size_t i = 0; i < text.size(); i += 3) text[i] = static_cast<char>(tolower(text[i]));
+            vector<uint8_t> back(len);
+            if (hex_decode_with(kernel, back.data(), text.data(), text.size(), nullptr) != HEX_OK ||
+                back != bytes) return false;
+
+            if (len > 0) {
+                size_t where = rng() % text.size();
+                text[where] = "gZ /\x80"[rng() % 5];
+                size_t bad = 0;
+                if (hex_decode_with(kernel, back.data(), text.data(), text.size(), &bad) != HEX_BAD_CHAR ||
+                    bad != where) return false;
+                if (hex_decode_with(kernel, back.data(), expected.data(), expected.size() - 1, &bad) != HEX_ODD_LENGTH)
+                    return false;
+            }
+        }
+    }
+    return true;
+}
+
+static const size_t kMaxMegabytes = 1024;  // 4 GB of buffers
+
+int main(int argc, char *argv[]) {
+    size_t megabytes = 16;
+    if (argc > 1) {
+        // At most kMaxMegabytes: the buffers hold 4 bytes for every input byte
+        char *end;
+        errno = 0;
+        megabytes = strtoul(argv[1], &end, 10);
+        if (!isdigit((unsigned char)argv[1][0]) || *end || errno == ERANGE || megabytes == 0 || megabytes > kMaxMegabytes) {
+            fprintf(stderr, "Usage: %s [megabytes]  (1 to %zu)\n", argv[0], kMaxMegabytes);
+            return 1;
+        }
+    }
+
+    cout << "==================================================\n";
+    cout << "FAST HEX IN C++\n";
+    cout << "==================================================\n";
+
+    unsigned int color = 0xFF6496;
+    cout << "\n1. The old way, one value at a time:\n";
+    cout << "   Color: 0x" << hex << color << dec << "\n";
+
+    cout << "\n2. Checking every kernel (encode, decode, errors):\n";
+    bool ok = selfTest();
+    cout << "   " << (ok ? "All kernels agree with printf!" : "Kernels DISAGREE!") << "\n";
+    cout << "   Best kernel here: " << hex_kernel_name(hex_detect()) << "\n";
+
+    cout << "\n==================================================\n";
+    cout << "ENCODE SPEED (" << megabytes << " MB of bytes -> hex)\n";
+    cout << "==================================================\n\n";
+
+    size_t size = megabytes * 1024 * 1024;
+    size_t slow_size = min<size_t>(size, 1 << 20);  // the slow ways get 1 MB
+    vector<uint8_t> input(size);
+    mt19937 rng(42);
+    for (auto &b : input) b = static_cast<uint8_t>(rng());
+    string text(2 * size, '\0');
+
+    double t = timeBest(3, [&] {
+        char *out = &text[0];
+        for (size_t i = 0; i < slow_size; i++) out += sprintf(out, "%02x", input[i]);
+    });
+    double printf_rate = slow_size / t / 1e6;
+    report("sprintf(\"%02x\") per byte", slow_size, t, 0);
+
+    t = timeBest(3, [&] {
+        ostringstream out;
+        out << hex << setfill('0');
+        for (size_t i = 0; i < slow_size; i++) out << setw(2) << static_cast<int>(input[i]);
+    });
+    report("ostream << hex per byte", slow_size, t, 0);
+
+    for (int k = 0; k <= static_cast<int>(hex_detect()); k++) {
+        auto kernel = static_cast<hex_kernel>(k);
+        t = timeBest(5, [&] { hex_encode_with(kernel, &text[0], input.data(), size, 0); });
+        string name = string("hex_encode ") + hex_kernel_name(kernel);
+        report(name.c_str(), size, t, printf_rate);
+    }
+
+    cout << "\n==================================================\n";
+    cout << "DECODE SPEED (hex -> bytes, with checking)\n";
+    cout << "==================================================\n\n";
+
+    vector<uint8_t> output(size);
+    t = timeBest(3, [&] {
+        char pair[3] = {0, 0, 0};
+        for (size_t i = 0; i < slow_size; i++) {
+            pair[0] = text[2 * i];
+            pair[1] = text[2 * i + 1];
+            output[i] = static_cast<uint8_t>(strtoul(pair, nullptr, 16));
+        }
+    });
+    double strtoul_rate = slow_size / t / 1e6;
+    report("strtoul per pair", slow_size, t, 0);
+
+    t = timeBest(3, [&] {
+        for (size_t i = 0; i < slow_size; i++) {
+            istringstream in(text.substr(2 * i, 2));
+            int value = 0;
+            in >> hex >> value;
+            output[i] = static_cast<uint8_t>(value);
+        }
+    });
+    report("istream >> hex per pair", slow_size, t, 0);
+
+    for (int k = 0; k <= static_cast<int>(hex_detect()); k++) {
+        auto kernel = static_cast<hex_kernel>(k);
+        hex_status status = HEX_OK;
+        t = timeBest(5, [&] {
+            status = hex_decode_with(kernel, output.data(), text.data(), text.size(), nullptr);
+        });
+        ok = ok && status == HEX_OK && output == input;
+        string name = string("hex_decode ") + hex_kernel_name(kernel);
+        report(name.c_str(), size, t, strtoul_rate);
+    }
+
+    cout << "\n==================================================\n";
+    cout << "Whole buffers beat one value at a time! ⚡\n";
+    cout << "==================================================\n";
+
+    return ok ? 0 : 1;
+}
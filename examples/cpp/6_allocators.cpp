@@ -0,0 +1,249 @@
+/*
+ * Custom Allocators in C++
+ * Is the heap really "slower"? Measure new/delete against arenas and pools!
+ * Compile: g++ -O2 -pthread 6_allocators.cpp -o allocators
+ * Run: ./allocators [objects]
+ */
+
+#include <iostream>
+#include <vector>
+#include <list>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <memory_resource>
+#include "arena.hpp"
+using namespace std;
+
+// A typical small, short-lived object (32 bytes)
+struct Particle {
+    double x, y, z;
+    int id;
+};
+
+template <typename Work>
+double timeBest(int runs, Work work) {
+    double best = 1e9;
+    for (int run = 0; run < runs; run++) {
+        auto start = chrono::steady_clock::now();
+        work();
+        chrono::duration<double> took = chrono::steady_clock::now() - start;
+        if (took.count() < best) best = took.count();
+    }
+    return best;
+}
+
+void report(const char *name, size_t ops, double seconds, double baseline) {
+    printf("   %-24s %8.1f M ops/s", name, ops / seconds / 1e6);
+    if (baseline > 0) printf("  (%.1fx new/delete)", baseline / seconds);
+    printf("\n");
+}
+
+// Keep the compiler from deciding the objects are never used
+volatile int sink;
+
+// ---- Pattern 1: allocate N objects, then free them all ----
+
+void batchNew(vector<Particle *> &list) {
+    for (size_t i = 0; i < list.size(); i++) list[i] = new Particle{0, 0, 0, int(i)};
+    for (Particle *p : list) { sink = p->id; delete p; }
+}
+
+void batchMalloc(vector<Particle *> &list) {
+    for (size_t i = 0; i < list.size(); i++) {
+        list[i] = static_cast<Particle *>(malloc(sizeof(Particle)));
+        list[i]->id = int(i);
+    }
+    for (Particle *p : list) { sink = p->id; free(p); }
+}
+
+void batchPool(vector<Particle *> &list, pool &p) {
+    for (size_t i = 0; i < list.size(); i++) {
+        list[i] = new (pool_alloc(&p)) Particle{0, 0, 0, int(i)};
+    }
+    for (Particle *obj : list) { sink = obj->id; pool_free(&p, obj); }
+}
+
+void batchArena(vector<Particle *> &list, arena &a) {
+    for (size_t i = 0; i < list.size(); i++) {
+        list[i] = new (arena_alloc(&a, sizeof(Particle), alignof(Particle))) Particle{0, 0, 0, int(i)};
+    }
+    for (Particle *obj : list) sink = obj->id;
+    arena_reset(&a);
+}
+
+// ---- Pattern 2: churn - a live set where random objects die and are replaced ----
+
+template <typename Alloc, typename Free>
+void churn(size_t steps, size_t live, Alloc alloc, Free release) {
+    vector<Particle *> slots(live);
+    for (auto &s : slots) s = alloc();
+    mt19937 rng(1);
+    for (size_t i = 0; i < steps; i++) {
+        size_t victim = rng() % live;
+        release(slots[victim]);
+        slots[victim] = alloc();
+        slots[victim]->id = int(i);
+    }
+    for (auto s : slots) release(s);
+}
+
+// ---- Pattern 4: many threads, each doing pattern 1 ----
+
+template <typename Work>
+double threaded(int threads, Work work) {
+    return timeBest(3, [&] {
+        vector<thread> pool;
+        for (int t = 0; t < threads; t++) pool.emplace_back(work);
+        for (auto &th : pool) th.join();
+    });
+}
+
+static const size_t kMaxObjects = 100000000;
+
+int main(int argc, char *argv[]) {
+    size_t count = 1000000;
+    if (argc > 1) {
+        // At most kMaxObjects: each particle numbers itself with an int, and
+        // the pointers alone are 800 MB
+        char *end;
+        errno = 0;
+        count = strtoul(argv[1], &end, 10);
+        if (!isdigit((unsigned char)argv[1][0]) || *end || errno == ERANGE || count == 0 || count > kMaxObjects) {
+            fprintf(stderr, "Usage: %s [objects]  (1 to %zu)\n", argv[0], kMaxObjects);
+            return 1;
+        }
+    }
+
+    cout << "==================================================\n";
+    cout << "CUSTOM ALLOCATORS IN C++\n";
+    cout << "==================================================\n";
+
+    cout << "\n1. STL containers on an arena:\n";
+    {
+        ArenaResource arena_res;
+        pmr::vector<int> numbers(&arena_res);
+        for (int i = 1; i <= 5; i++) numbers.push_back(i * 10);
+        cout << "   pmr::vector<int> holds " << numbers.size()
+             << " numbers, arena reserved " << arena_res.bytesReserved() << " bytes\n";
+
+        vector<int, ArenaAllocator<int>> plain{ArenaAllocator<int>(arena_res)};
+        plain.assign({1, 2, 3});
+        cout << "   vector<int, ArenaAllocator<int>> works too: " << plain[0] << plain[1] << plain[2] << "\n";
+    }
+
+    cout << "\n==================================================\n";
+    cout << "PATTERN 1: ALLOCATE " << count << ", THEN FREE ALL\n";
+    cout << "==================================================\n\n";
+
+    vector<Particle *> objects(count);
+    pool particle_pool;
+    pool_init(&particle_pool, sizeof(Particle), 4096);
+    arena particle_arena;
+    arena_init(&particle_arena, 1 << 20);
+
+    size_t ops = 2 * count;
+    double base = timeBest(5, [&] { batchNew(objects); });
+    report("new / delete", ops, base, 0);
+    report("malloc / free", ops, timeBest(5, [&] { batchMalloc(objects); }), base);
+    report("pool_alloc / pool_free", ops, timeBest(5, [&] { batchPool(objects, particle_pool); }), base);
+    report("arena_alloc / reset", ops, timeBest(5, [&] { batchArena(objects, particle_arena); }), base);
+
+    cout << "\n==================================================\n";
+    cout << "PATTERN 2: CHURN (4096 live, " << count << " replaced)\n";
+    cout << "==================================================\n\n";
+
+    base = timeBest(3, [&] {
+        churn(count, 4096, [] { return new Particle(); }, [](Particle *p) { delete p; });
+    });
+    report("new / delete", ops, base, 0);
+    report("malloc / free", ops, timeBest(3, [&] {
+        churn(count, 4096, [] { return static_cast<Particle *>(malloc(sizeof(Particle))); },
+              [](Particle *p) { free(p); });
+    }), base);
+    report("pool_alloc / pool_free", ops, timeBest(3, [&] {
+        churn(count, 4096, [&] { return static_cast<Particle *>(pool_alloc(&particle_pool)); },
+              [&](Particle *p) { pool_free(&particle_pool, p); });
+    }), base);
+
+    cout << "\n==================================================\n";
+    cout << "PATTERN 3: NODE CONTAINERS (list and map)\n";
+    cout << "==================================================\n\n";
+
+    size_t nodes = count / 4;
+    base = timeBest(3, [&] {
+        list<int> l;
+        map<int, int> m;
+        for (size_t i = 0; i < nodes; i++) { l.push_back(int(i)); m[int(i)] = int(i); }
+        sink = int(l.size() + m.size());
+    });
+    report("std::list + std::map", 2 * nodes, base, 0);
+
+    report("pmr + PoolResource(48)", 2 * nodes, timeBest(3, [&] {
+        PoolResource node_pool(48);  // big enough for both node types
+        pmr::list<int> l(&node_pool);
+        pmr::map<int, int> m(&node_pool);
+        for (size_t i = 0; i < nodes; i++) { l.push_back(int(i)); m[int(i)] = int(i); }
+        sink = int(l.size() + m.size());
+    }), base);
+    report("pmr + ArenaResource", 2 * nodes, timeBest(3, [&] {
+        ArenaResource node_arena(1 << 20);
+        pmr::list<int> l(&node_arena);
+        pmr::map<int, int> m(&node_arena);
+        for (size_t i = 0; i < nodes; i++) { l.push_back(int(i)); m[int(i)] = int(i); }
+        sink = int(l.size() + m.size());
+    }), base);
+
+    cout << "\n==================================================\n";
+    cout << "PATTERN 4: THREADS (each allocates " << count / 4 << ", then frees)\n";
+    cout << "==================================================\n";
+
+    unsigned cores = thread::hardware_concurrency();
+    int max_threads = cores > 1 ? int(cores) : 2;
+    size_t per_thread = count / 4;
+    vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+    for (int threads : thread_counts) {
+        printf("\n   %d thread%s:\n", threads, threads == 1 ? "" : "s");
+        size_t total = 2 * per_thread * threads;
+        base = threaded(threads, [&] {
+            vector<Particle *> mine(per_thread);
+            batchNew(mine);
+        });
+        report("new / delete", total, base, 0);
+        report("malloc / free", total, threaded(threads, [&] {
+            vector<Particle *> mine(per_thread);
+            batchMalloc(mine);
+        }), base);
+        // Each thread gets its own pool or arena: no locks needed
+        report("pool per thread", total, threaded(threads, [&] {
+            vector<Particle *> mine(per_thread);
+            pool p;
+            pool_init(&p, sizeof(Particle), 4096);
+            batchPool(mine, p);
+            pool_destroy(&p);
+        }), base);
+        report("arena per thread", total, threaded(threads, [&] {
+            vector<Particle *> mine(per_thread);
+            arena a;
+            arena_init(&a, 1 << 20);
+            batchArena(mine, a);
+            arena_destroy(&a);
+        }), base);
+    }
+
+    pool_destroy(&particle_pool);
+    arena_destroy(&particle_arena);
+
+    cout << "\n==================================================\n";
+    cout << "The heap is only slow if you use it one object at a time! 💪\n";
+    cout << "==================================================\n";
+
+    return 0;
+}
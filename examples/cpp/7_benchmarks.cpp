@@ -0,0 +1,147 @@
+/*
+ * Measuring Speed in C++
+ * Stack vs heap, shifts vs multiplies - with real numbers!
+ * Compile: g++ -O2 7_benchmarks.cpp -o benchmarks
+ * Run: ./benchmarks              (text table)
+ *      ./benchmarks --json       (JSON report on stdout)
+ */
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <array>
+#include <random>
+#include <cstdint>
+#include "bench.hpp"
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "cpp_examples", argc, argv);
+
+    vector<int> values(4096);
+    mt19937 rng(42);
+    for (int &v : values) v = static_cast<int>(rng());
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "MEASURING SPEED IN C++\n";
+        cout << "==================================================\n";
+        cout << "\n" << suite.runs << " runs each (after " << suite.warmup_runs
+             << " warmup runs), time per operation.\n";
+    }
+
+    // From 3_memory.cpp: "STACK: Fast, automatic, limited / HEAP: Slower"
+    bench_section(&suite, "1. STACK vs HEAP:");
+    benchRun(suite, "stack int", [](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            int value = static_cast<int>(i);
+            doNotOptimize(&value);
+        }
+    });
+    benchRun(suite, "new int / delete", [](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            int *value = new int(static_cast<int>(i));
+            doNotOptimize(value);
+            delete value;
+        }
+    });
+    benchRun(suite, "make_unique<int>", [](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            auto value = make_unique<int>(static_cast<int>(i));
+            doNotOptimize(value.get());
+        }
+    });
+    benchRun(suite, "stack array<int, 5>", [](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            array<int, 5> numbers{};
+            numbers[0] = static_cast<int>(i);
+            doNotOptimize(numbers.data());
+        }
+    });
+    benchRun(suite, "new int[5] / delete[]", [](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            int *numbers = new int[5];
+            numbers[0] = static_cast<int>(i);
+            doNotOptimize(numbers);
+            delete[] numbers;
+        }
+    });
+    benchRun(suite, "vector<int>(5)", [](size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            vector<int> numbers(5);
+            numbers[0] = static_cast<int>(i);
+            doNotOptimize(numbers.data());
+        }
+    });
+    bench_compare(&suite, "new int / delete", "stack int");
+    bench_compare(&suite, "vector<int>(5)", "stack array<int, 5>");
+
+    // From 2_binary_ops.cpp: "Multiply by 2^n" / "Divide by 2^n"
+    bench_section(&suite, "2. SHIFT vs MULTIPLY/DIVIDE (64-bit, latency):");
+    benchRun(suite, "x << 2", [](size_t n) {
+        uint64_t x = 1;
+        for (size_t i = 0; i < n; i++) { x = (x << 2) ^ i; hideValue(x); }
+        doNotOptimize(x);
+    });
+    benchRun(suite, "x * 4", [](size_t n) {
+        uint64_t x = 1;
+        for (size_t i = 0; i < n; i++) { x = (x * 4) ^ i; hideValue(x); }
+        doNotOptimize(x);
+    });
+    benchRun(suite, "x * four (unknown)", [](size_t n) {
+        uint64_t x = 1, four = 4;
+        hideValue(four);
+        for (size_t i = 0; i < n; i++) { x = (x * four) ^ i; hideValue(x); }
+        doNotOptimize(x);
+    });
+    benchRun(suite, "x >> 1", [](size_t n) {
+        int64_t x = INT64_C(1) << 62;
+        for (size_t i = 0; i < n; i++) { x = (x >> 1) | (INT64_C(1) << 62); hideValue(x); }
+        doNotOptimize(x);
+    });
+    benchRun(suite, "x / 2 (signed)", [](size_t n) {
+        int64_t x = INT64_C(1) << 62;
+        for (size_t i = 0; i < n; i++) { x = (x / 2) | (INT64_C(1) << 62); hideValue(x); }
+        doNotOptimize(x);
+    });
+    benchRun(suite, "x / two (unknown)", [](size_t n) {
+        int64_t x = INT64_C(1) << 62, two = 2;
+        hideValue(two);
+        for (size_t i = 0; i < n; i++) { x = (x / two) | (INT64_C(1) << 62); hideValue(x); }
+        doNotOptimize(x);
+    });
+    bench_compare(&suite, "x * four (unknown)", "x << 2");
+    bench_compare(&suite, "x / two (unknown)", "x >> 1");
+
+    // From 2_binary_ops.cpp: "Check if number is even"
+    bench_section(&suite, "3. EVEN TEST: & 1 vs % 2 (throughput):");
+    const int *data = values.data();
+    benchRun(suite, "(n & 1) == 0", [data](size_t n) {
+        size_t even = 0;
+        for (size_t i = 0; i < n; i++) even += (data[i & 4095] & 1) == 0;
+        doNotOptimize(even);
+    });
+    benchRun(suite, "n % 2 == 0", [data](size_t n) {
+        size_t even = 0;
+        for (size_t i = 0; i < n; i++) even += data[i & 4095] % 2 == 0;
+        doNotOptimize(even);
+    });
+    benchRun(suite, "n % two == 0 (unknown)", [data](size_t n) {
+        size_t even = 0;
+        int two = 2;
+        hideValue(two);
+        for (size_t i = 0; i < n; i++) even += data[i & 4095] % two == 0;
+        doNotOptimize(even);
+    });
+    bench_compare(&suite, "n % two == 0 (unknown)", "(n & 1) == 0");
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "Measure first, then believe it! 📏\n";
+        cout << "==================================================\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * Big Bitsets in C++
+ * bitset<8> is great for one byte - what about a million bits?
+ * Compile: g++ -O2 8_dynamic_bitset.cpp -o dynamic_bitset
+ * Run: ./dynamic_bitset [--json] [--runs=N]
+ */
+
+#include <iostream>
+#include <bitset>
+#include <vector>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include "dynamic_bitset.hpp"
+#include "bench.hpp"
+using namespace std;
+
+const size_t kBits = 1 << 20;  // about a million bits (128 KB)
+
+// Compare every operation against vector<bool>, one bit at a time
+bool selfTest() {
+    mt19937_64 rng(3);
+    for (size_t size : {1, 63, 64, 65, 200, 1000, 4099}) {
+        vector<bool> ra(size), rb(size);
+        DynamicBitset a(size), b(size);
+        for (size_t i = 0; i < size; i++) {
+            bool x = rng() % 3 == 0, y = rng() % 2 == 0;
+            ra[i] = x; rb[i] = y;
+            a.set(i, x); b.set(i, y);
+        }
+        auto same = [&](const DynamicBitset &d, const vector<bool> &r) {
+            if (d.size() != r.size()) return false;
+            for (size_t i = 0; i < r.size(); i++) if (d[i] != r[i]) return false;
+            return d.count() == static_cast<size_t>(count(r.begin(), r.end(), true));
+        };
+        vector<bool> r(size);
+        for (size_t i = 0; i < size; i++) r[i] = ra[i] && rb[i];
+        if (!same(a & b, r)) return false;
+        for (size_t i = 0; i < size; i++) r[i] = ra[i] || rb[i];
+        if (!same(a | b, r)) return false;
+        for (size_t i = 0; i < size; i++) r[i] = ra[i] != rb[i];
+        if (!same(a ^ b, r)) return false;
+        for (size_t i = 0; i < size; i++) r[i] = ra[i] && !rb[i];
+        if (!same(andNot(a, b), r)) return false;
+        for (size_t i = 0; i < size; i++) r[i] = !ra[i];
+        if (!same(~a, r)) return false;
+
+        for (size_t shift : {size_t(0), size_t(1), size_t(63), size_t(64), size_t(130), size}) {
+            for (size_t i = 0; i < size; i++) r[i] = i >= shift && ra[i - shift];
+            if (!same(a << shift, r)) return false;
+            for (size_t i = 0; i < size; i++) r[i] = i + shift < size && ra[i + shift];
+            if (!same(a >> shift, r)) return false;
+        }
+
+        // findFirst/findNext and the iterator must visit the same bits
+        vector<size_t> expected, walked, found;
+        for (size_t i = 0; i < size; i++) if (ra[i]) expected.push_back(i);
+        for (size_t i : a.setBits()) walked.push_back(i);
+        for (size_t i = a.findFirst(); i != DynamicBitset::npos; i = a.findNext(i)) found.push_back(i);
+        if (walked != expected || found != expected) return false;
+    }
+    return DynamicBitset(string("10110")).toString() == "10110";
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "dynamic_bitset", argc, argv);
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "BIG BITSETS IN C++\n";
+        cout << "==================================================\n";
+
+        cout << "\n1. Size picked while the program runs:\n";
+        DynamicBitset style(8);
+        style.set(0).set(1);          // FLAG_BOLD | FLAG_ITALIC
+        style.reset(0);               // remove bold
+        cout << "   style = " << style.toString() << " (" << style.count() << " bit on)\n";
+
+        cout << "\n2. Checking every operation against vector<bool>: "
+             << (selfTest() ? "all correct!" : "MISMATCH!") << "\n";
+        cout << "   Kernels on this CPU: " << DynamicBitset::kernelName() << "\n";
+        cout << "\n   Each operation below works on " << kBits << " bits.\n";
+    } else if (!selfTest()) {
+        return 1;
+    }
+
+    // Same random bits in every container
+    mt19937_64 rng(42);
+    DynamicBitset a(kBits), b(kBits);
+    vector<bool> va(kBits), vb(kBits);
+    auto sa = make_unique<bitset<kBits>>(), sb = make_unique<bitset<kBits>>();
+    for (size_t i = 0; i < kBits; i++) {
+        bool x = rng() & 1, y = rng() % 8 == 0;
+        a.set(i, x); b.set(i, y);
+        va[i] = x; vb[i] = y;
+        (*sa)[i] = x; (*sb)[i] = y;
+    }
+    DynamicBitset out(kBits);
+    size_t words = a.wordCount();
+
+    bench_section(&suite, "3. AND of two bitsets (a &= b):");
+    benchRun(suite, "vector<bool> loop", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            for (size_t i = 0; i < kBits; i++) va[i] = va[i] && vb[i];
+            doNotOptimize(va.size());
+        }
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "std::bitset &=", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) { *sa &= *sb; doNotOptimize(sa.get()); }
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "DynamicBitset scalar", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            bitset_kernels::combineScalar(out.data(), a.data(), b.data(), words, bitset_kernels::Op::And);
+            doNotOptimize(out.data());
+        }
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "DynamicBitset &=", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) { out &= b; doNotOptimize(out.data()); }
+    });
+    bench_rate(&suite, kBits, "bit");
+    bench_compare(&suite, "vector<bool> loop", "DynamicBitset &=");
+
+    bench_section(&suite, "4. XOR, NOT and shift (new bitset each time):");
+    benchRun(suite, "a ^ b", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) { DynamicBitset r = a ^ b; doNotOptimize(r.data()); }
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "~a", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) { DynamicBitset r = ~a; doNotOptimize(r.data()); }
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "a << 3", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) { DynamicBitset r = a << 3; doNotOptimize(r.data()); }
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "std::bitset << 3", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) { *sb = *sa << 3; doNotOptimize(sb.get()); }
+    });
+    bench_rate(&suite, kBits, "bit");
+
+    bench_section(&suite, "5. Population count (how many 1s?):");
+    benchRun(suite, "count(vector<bool>)", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) doNotOptimize(count(va.begin(), va.end(), true));
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "std::bitset count()", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) doNotOptimize(sa->count());
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "popcount scalar", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) doNotOptimize(bitset_kernels::popcountScalar(a.data(), words));
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "DynamicBitset count()", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) doNotOptimize(a.count());
+    });
+    bench_rate(&suite, kBits, "bit");
+    bench_compare(&suite, "count(vector<bool>)", "DynamicBitset count()");
+
+    bench_section(&suite, "6. Visiting every set bit (1 in 8 bits is set):");
+    benchRun(suite, "vector<bool> test each", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            size_t sum = 0;
+            for (size_t i = 0; i < kBits; i++) if (vb[i]) sum += i;
+            doNotOptimize(sum);
+        }
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "std::bitset test each", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            size_t sum = 0;
+            for (size_t i = 0; i < kBits; i++) if ((*sb)[i]) sum += i;
+            doNotOptimize(sum);
+        }
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "findFirst/findNext", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            size_t sum = 0;
+            for (size_t i = b.findFirst(); i != DynamicBitset::npos; i = b.findNext(i)) sum += i;
+            doNotOptimize(sum);
+        }
+    });
+    bench_rate(&suite, kBits, "bit");
+    benchRun(suite, "forEachSetBit", [&](size_t n) {
+        for (size_t k = 0; k < n; k++) {
+            size_t sum = 0;
+            b.forEachSetBit([&](size_t i) { sum += i; });
+            doNotOptimize(sum);
+        }
+    });
+    bench_rate(&suite, kBits, "bit");
+    bench_compare(&suite, "vector<bool> test each", "forEachSetBit");
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "64 bits per step beats 1 bit per step! 🧮\n";
+        cout << "==================================================\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
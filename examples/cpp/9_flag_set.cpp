@@ -0,0 +1,193 @@
+/*
+ * Flags Shared Between Threads
+ * "text_style |= FLAG_BOLD" with many threads - mutex or atomic?
+ * Compile: g++ -O2 -pthread 9_flag_set.cpp -o flag_set
+ * Run: ./flag_set [--json] [--runs=N]
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <cstdint>
+#include "flag_set.hpp"
+#include "bench.hpp"
+using namespace std;
+
+enum class Style : uint8_t {
+    Bold = 1,       // 00000001
+    Italic = 2,     // 00000010
+    Underline = 4,  // 00000100
+};
+
+// Bits for a connection that many worker threads look at
+enum class State : uint32_t {
+    Open = 1 << 0,
+    Dirty = 1 << 1,
+    Closing = 1 << 2,
+    Locked = 1 << 3,
+    // bits 8 and up: one per worker thread in the benchmark
+};
+
+State workerBit(int worker) {
+    return static_cast<State>(1u << (8 + worker % 24));
+}
+
+// Start `threads` threads, each running work(worker, iterations / threads)
+template <typename Work>
+void runThreads(int threads, size_t iterations, Work work) {
+    size_t each = iterations / threads + 1;
+    vector<thread> pool;
+    for (int t = 0; t < threads; t++) pool.emplace_back(work, t, each);
+    for (auto &th : pool) th.join();
+}
+
+// Many threads use trySet/clear as a tiny lock around a plain counter,
+// and each turns on its own bit once. Nothing may get lost.
+bool selfTest(int threads) {
+    AtomicFlagSet<State> state;
+    long counter = 0;
+    const size_t per_thread = 20000;
+    runThreads(threads, per_thread * threads, [&](int worker, size_t) {
+        for (size_t i = 0; i < per_thread; i++) {
+            while (!state.trySet(State::Locked, memory_order_acquire, memory_order_relaxed)) {
+                this_thread::yield();
+            }
+            counter++;  // safe: only the thread that set Locked gets here
+            state.clear(State::Locked, memory_order_release);
+        }
+        state.set(workerBit(worker), memory_order_relaxed);
+    });
+    FlagSet<State> all;
+    for (int t = 0; t < threads; t++) all.set(workerBit(t));
+    if (counter != long(per_thread * threads) || state.load() != all) return false;
+
+    // compareExchange reports the real value when it fails
+    FlagSet<State> expected = State::Open;
+    if (state.compareExchange(expected, State::Dirty) || expected != all) return false;
+    if (!state.compareExchange(expected, State::Dirty) || state.load() != State::Dirty) return false;
+
+    // update() sets and clears at once; testAndSet reports the old bit
+    state.update({State::Open, State::Closing}, State::Dirty);
+    return state.load() == FlagSet<State>({State::Open, State::Closing}) &&
+           state.testAndSet(State::Closing) && !state.testAndSet(State::Locked);
+}
+
+int main(int argc, char *argv[]) {
+    bench_suite suite;
+    bench_init(&suite, "flag_set", argc, argv);
+
+    unsigned cores = thread::hardware_concurrency();
+    int max_threads = cores > 1 ? int(cores) : 2;
+    vector<int> thread_counts;
+    for (int threads = 1; threads < max_threads; threads *= 2) thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+
+    if (!suite.quiet) {
+        cout << "==================================================\n";
+        cout << "FLAGS SHARED BETWEEN THREADS\n";
+        cout << "==================================================\n";
+
+        cout << "\n1. The same flags as 2_binary_ops.cpp, with types:\n";
+        FlagSet<Style> style;
+        cout << "   Starting style: " << style.toString() << "\n";
+        style.set(Style::Bold);
+        cout << "   Add bold:       " << style.toString() << "\n";
+        style.set(Style::Italic);
+        cout << "   Add italic:     " << style.toString() << "\n";
+        style.clear(Style::Bold);
+        cout << "   Remove bold:    " << style.toString() << "\n";
+        cout << "   Is italic on? " << (style.test(Style::Italic) ? "Yes" : "No") << "\n";
+        cout << "   (style.set(State::Dirty) would not compile - wrong enum!)\n";
+
+        AtomicFlagSet<State> state;
+        cout << "\n2. The atomic version ("
+             << (state.isLockFree() ? "lock-free on this CPU" : "NOT lock-free here") << "):\n";
+        state.set(State::Open);
+        bool first = state.trySet(State::Closing);
+        bool second = state.trySet(State::Closing);
+        cout << "   trySet(Closing) twice: " << (first ? "won" : "lost") << ", then "
+             << (second ? "won" : "lost") << "\n";
+        cout << "   Checking with " << max(max_threads, 4) << " threads: "
+             << (selfTest(max(max_threads, 4)) ? "nothing lost!" : "MISMATCH!") << "\n";
+
+        cout << "\n   Below, every thread turns its own flag on and off again,\n";
+        cout << "   all in the SAME shared word. Time per on/off pair, all threads\n";
+        cout << "   together (" << cores << " core" << (cores == 1 ? "" : "s") << " on this machine).\n";
+    } else if (!selfTest(max(max_threads, 4))) {
+        return 1;
+    }
+
+    int section = 3;
+    for (int threads : thread_counts) {
+        string title = to_string(section++) + ". " + to_string(threads) +
+                       " thread" + (threads == 1 ? "" : "s") + ":";
+        bench_section(&suite, title.c_str());
+        string suffix = " x" + to_string(threads);
+
+        mutex lock;
+        uint32_t plain = 0;
+        string mutex_name = "mutex + int" + suffix;
+        benchRun(suite, mutex_name.c_str(), [&](size_t n) {
+            runThreads(threads, n, [&](int worker, size_t count) {
+                uint32_t bit = static_cast<uint32_t>(workerBit(worker));
+                for (size_t i = 0; i < count; i++) {
+                    { lock_guard<mutex> guard(lock); plain |= bit; }
+                    { lock_guard<mutex> guard(lock); plain &= ~bit; }
+                }
+            });
+            doNotOptimize(plain);
+        });
+
+        AtomicFlagSet<State> state;
+        string seq_name = "atomic seq_cst" + suffix;
+        benchRun(suite, seq_name.c_str(), [&](size_t n) {
+            runThreads(threads, n, [&](int worker, size_t count) {
+                State bit = workerBit(worker);
+                for (size_t i = 0; i < count; i++) {
+                    state.set(bit);
+                    state.clear(bit);
+                }
+            });
+        });
+
+        string relaxed_name = "atomic relaxed" + suffix;
+        benchRun(suite, relaxed_name.c_str(), [&](size_t n) {
+            runThreads(threads, n, [&](int worker, size_t count) {
+                State bit = workerBit(worker);
+                for (size_t i = 0; i < count; i++) {
+                    state.set(bit, memory_order_relaxed);
+                    state.clear(bit, memory_order_relaxed);
+                }
+            });
+        });
+
+        // A compare-exchange loop retries whenever another thread got in first
+        string cas_name = "update() CAS loop" + suffix;
+        benchRun(suite, cas_name.c_str(), [&](size_t n) {
+            runThreads(threads, n, [&](int worker, size_t count) {
+                State bit = workerBit(worker);
+                for (size_t i = 0; i < count; i++) {
+                    state.update(bit, {}, memory_order_acq_rel);
+                    state.update({}, bit, memory_order_acq_rel);
+                }
+            });
+        });
+        bench_compare(&suite, mutex_name.c_str(), seq_name.c_str());
+    }
+
+    if (!suite.quiet) {
+        cout << "\n==================================================\n";
+        cout << "WHAT DID WE LEARN?\n";
+        cout << "==================================================\n";
+        cout << "   * One atomic OR/AND beats lock + change + unlock.\n";
+        cout << "   * Each core still has to own the cache line to change it,\n";
+        cout << "     so more threads on ONE word never go faster.\n";
+        cout << "   * On x86 every atomic read-modify-write is a full barrier,\n";
+        cout << "     so relaxed and seq_cst cost about the same here.\n";
+    }
+
+    bench_finish(&suite);
+    return 0;
+}
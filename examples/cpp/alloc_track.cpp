@@ -0,0 +1,684 @@
+/*
+ * alloc_track.cpp - The Allocation Tracker Behind alloc_track.h
+ * Link it into a program, or build it as a shared library for LD_PRELOAD
+ * (see alloc_track.h). Needs glibc: the real allocator is reached through
+ * __libc_malloc and friends, which avoids the dlsym(RTLD_NEXT) trick and
+ * its "dlsym itself calls malloc" problem.
+ *
+ * The fast path of every malloc/free is a few plain adds to the calling
+ * thread's own thread-local state. Everything else is kept off that path:
+ *
+ *   - A block's footprint is read from glibc's chunk header, the word just
+ *     before the block: malloc has just written it, free reads it anyway.
+ *     (Later, the block might already be freed and its memory gone.)
+ *   - Counting is batched: an allocation only appends its size to the
+ *     thread's batch. Every 32 allocations (or frees) the batch goes into
+ *     the size-class histogram and the counters other threads can read.
+ *   - Live and peak bytes: each thread collects its change in live bytes
+ *     and adds it to one shared atomic only when it passes +-64 KB.
+ *   - Sampling: each thread counts down the bytes it allocates; at zero
+ *     the allocation's call stack goes into a locked table and the count
+ *     restarts at about 2 MB. A free looks in a 4 KB bitmap first, so
+ *     only the (rare) sampled blocks ever take the lock.
+ *   - The first allocation or free in a thread flushes its (empty) batch,
+ *     which claims a block of counters. When the thread ends they are added
+ *     to the block kept for finished threads, and the block is reused.
+ */
+
+#include "alloc_track.h"
+
+#include <atomic>
+#include <new>
+#include <cerrno>
+#include <cstddef>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *p);
+}
+
+#define TRACK_INLINE __attribute__((always_inline)) inline
+#define TRACK_EXPORT extern "C" __attribute__((visibility("default")))
+
+namespace {
+
+const int kMaxThreads = 256;           // the last block of counters is shared
+const int kShared = kMaxThreads - 1;
+const int64_t kFlushBytes = 64 << 10;  // live-byte change a thread keeps to itself
+const uint32_t kBatch = 32;            // allocations (or frees) a thread batches
+const int kFrames = 16;                // deepest call stack kept per sample
+const int kSkipFrames = 2;             // recordSample and malloc/new themselves
+const size_t kSampleSlots = 4096;      // power of two; filled to 3/4 at most
+const size_t kFilterBits = 32768;      // 4 KB: small enough to stay in L1
+const int64_t kIdleCountdown = int64_t(64) << 20;  // re-check when sampling is off
+
+struct alignas(64) ThreadStats {
+    uint64_t class_count[ALLOC_TRACK_CLASSES];  // their sum is the allocations
+    uint64_t new_calls, frees;
+    long tid;  // 0 for a free block, -1 for the shared one
+};
+
+// The fast path's counters share the first cache line; sizes fills up behind
+struct alignas(64) ThreadState {
+    ThreadStats *stats;    // null until the thread's first flush
+    int64_t until_sample;  // bytes left before the next sampled allocation
+    int64_t pending;       // change in live bytes not yet added to g_live
+    uint32_t allocs;       // sizes[0..allocs) are not in stats yet
+    uint32_t frees, new_calls;  // nor are these
+    uint32_t limit;        // flush when allocs or frees reach it (0 before the first)
+    bool shared;           // stats is shared: every call is flushed, with atomic adds
+    bool in_hook;          // inside the tracker: calls pass straight through
+    uint64_t rng;
+    size_t sizes[kBatch];  // requested sizes, for the size-class histogram
+};
+
+struct Sample {
+    void *ptr;
+    size_t size, footprint, weight;
+    long tid;
+    bool is_new;
+    int depth;
+    void *frames[kFrames];
+};
+
+// g_stats[kShared] holds finished threads, and running ones beyond kShared
+ThreadStats g_stats[kMaxThreads];
+std::atomic<int> g_thread_count{0};  // every thread that ever allocated
+std::atomic<int> g_used_slots{0};    // g_stats[0..g_used_slots) have been handed out
+int g_free_slots[kMaxThreads], g_free_count = 0;
+std::atomic_flag g_slot_lock = ATOMIC_FLAG_INIT;
+pthread_key_t g_exit_key;
+pthread_once_t g_exit_key_once = PTHREAD_ONCE_INIT;
+std::atomic<bool> g_enabled{true};
+// Away from g_enabled, which every call reads
+alignas(64) std::atomic<int64_t> g_live{0}, g_peak{0};
+std::atomic<size_t> g_interval{ALLOC_TRACK_DEFAULT_INTERVAL};
+
+Sample g_samples[kSampleSlots];
+// A bit per group of addresses that has a sampled block; g_filter_count
+// (under the lock) says how many, so a bit can be cleared again
+std::atomic<uint64_t> g_filter[kFilterBits / 64];
+uint32_t g_filter_count[kFilterBits];
+std::atomic_flag g_sample_lock = ATOMIC_FLAG_INIT;
+size_t g_sample_count = 0, g_dropped = 0;
+
+const char *g_json_path = nullptr;
+volatile sig_atomic_t g_dump_requested = 0;
+
+__thread ThreadState t_state __attribute__((tls_model("initial-exec")));
+
+// glibc stores the chunk size (header included) in the word before the
+// block; the low 3 bits are flags
+TRACK_INLINE size_t footprint(void *p) {
+    return static_cast<size_t *>(p)[-1] & ~size_t(7);
+}
+
+template <typename T>
+TRACK_INLINE T readCounter(const T &counter) {
+    return __atomic_load_n(&counter, __ATOMIC_RELAXED);
+}
+
+// A thread's own counters only need a plain add (stored whole, for readers
+// on other threads)
+template <typename T>
+TRACK_INLINE T add(T &counter, T value) {
+    T sum = counter + value;
+    __atomic_store_n(&counter, sum, __ATOMIC_RELAXED);
+    return sum;
+}
+
+void addLive(int64_t change) {
+    int64_t live = g_live.fetch_add(change, std::memory_order_relaxed) + change;
+    int64_t peak = g_peak.load(std::memory_order_relaxed);
+    while (live > peak && !g_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+uint64_t allocationsOf(const ThreadStats &s) {
+    uint64_t sum = 0;
+    for (int k = 0; k < ALLOC_TRACK_CLASSES; k++) sum += readCounter(s.class_count[k]);
+    return sum;
+}
+
+size_t sampleHome(const void *p) {
+    return size_t((uintptr_t(p) >> 4) * 0x9E3779B97F4A7C15ull >> 52) & (kSampleSlots - 1);
+}
+
+TRACK_INLINE size_t filterBit(const void *p) {
+    return size_t(uintptr_t(p) >> 4) & (kFilterBits - 1);  // blocks are 16-byte aligned
+}
+
+// Both under the sample lock
+void filterAdd(const void *p) {
+    size_t bit = filterBit(p);
+    if (g_filter_count[bit]++ == 0) g_filter[bit / 64].fetch_or(uint64_t(1) << (bit % 64), std::memory_order_relaxed);
+}
+
+void filterRemove(const void *p) {
+    size_t bit = filterBit(p);
+    if (--g_filter_count[bit] == 0) g_filter[bit / 64].fetch_and(~(uint64_t(1) << (bit % 64)), std::memory_order_relaxed);
+}
+
+void lockSamples() {
+    while (g_sample_lock.test_and_set(std::memory_order_acquire)) __builtin_ia32_pause();
+}
+
+void unlockSamples() { g_sample_lock.clear(std::memory_order_release); }
+
+// Linear probing with backward-shift deletion: no tombstones pile up
+void eraseSampleAt(size_t hole) {
+    size_t mask = kSampleSlots - 1;
+    for (size_t j = (hole + 1) & mask; g_samples[j].ptr; j = (j + 1) & mask) {
+        size_t home = sampleHome(g_samples[j].ptr);
+        // Move j into the hole unless its home lies cyclically in (hole, j]
+        bool stays = hole < j ? (home > hole && home <= j) : (home > hole || home <= j);
+        if (!stays) {
+            g_samples[hole] = g_samples[j];
+            hole = j;
+        }
+    }
+    g_samples[hole].ptr = nullptr;
+    g_sample_count--;
+}
+
+// Called only when the filter says p may be sampled
+__attribute__((noinline, cold)) void forgetSample(void *p) {
+    lockSamples();
+    for (size_t i = sampleHome(p); g_samples[i].ptr; i = (i + 1) & (kSampleSlots - 1)) {
+        if (g_samples[i].ptr == p) {
+            eraseSampleAt(i);
+            filterRemove(p);
+            break;
+        }
+    }
+    unlockSamples();
+}
+
+TRACK_INLINE void forgetBlock(void *p) {
+    size_t bit = filterBit(p);
+    uint64_t word = g_filter[bit / 64].load(std::memory_order_relaxed);
+    if (__builtin_expect((word >> (bit % 64)) & 1, 0)) forgetSample(p);
+}
+
+void lockSlots() {
+    while (g_slot_lock.test_and_set(std::memory_order_acquire)) __builtin_ia32_pause();
+}
+
+void unlockSlots() { g_slot_lock.clear(std::memory_order_release); }
+
+void flushBatch(ThreadState &t, bool all);
+
+// Thread exit: fold the thread's counters into the shared block and free its
+// own. Anything it frees after this (other TLS destructors) counts as shared.
+void retireThread(void *slot) {
+    ThreadState &t = t_state;
+    ThreadStats &own = *static_cast<ThreadStats *>(slot), &shared = g_stats[kShared];
+    bool was_in_hook = t.in_hook;
+    t.in_hook = true;
+    flushBatch(t, true);
+    uint64_t *from = own.class_count, *to = shared.class_count;
+    for (size_t i = 0; i < offsetof(ThreadStats, tid) / sizeof(uint64_t); i++) {
+        __atomic_fetch_add(&to[i], readCounter(from[i]), __ATOMIC_RELAXED);
+        __atomic_store_n(&from[i], uint64_t(0), __ATOMIC_RELAXED);
+    }
+    shared.tid = -1;
+    own.tid = 0;
+    lockSlots();
+    g_free_slots[g_free_count++] = int(&own - g_stats);
+    unlockSlots();
+    t.stats = &shared;
+    t.shared = true;
+    t.limit = 1;
+    t.in_hook = was_in_hook;
+}
+
+void createExitKey() { pthread_key_create(&g_exit_key, retireThread); }
+
+void claimStats(ThreadState &t) {
+    g_thread_count.fetch_add(1, std::memory_order_relaxed);
+    long tid = syscall(SYS_gettid);
+    int index = kShared;
+    lockSlots();
+    if (g_free_count > 0) index = g_free_slots[--g_free_count];
+    else if (g_used_slots.load(std::memory_order_relaxed) < kShared) index = g_used_slots.fetch_add(1);
+    unlockSlots();
+    t.stats = &g_stats[index];
+    t.shared = index == kShared;
+    t.limit = t.shared ? 1 : kBatch;
+    t.stats->tid = t.shared ? -1 : tid;
+    if (!t.shared) {
+        pthread_once(&g_exit_key_once, createExitKey);
+        pthread_setspecific(g_exit_key, t.stats);
+    }
+    t.rng = uint64_t(tid) * 0x9E3779B97F4A7C15ull | 1;
+}
+
+// Move the batch into the thread's counters, and its change in live bytes
+// to g_live once that passes +-64 KB (`all`: whatever it is)
+__attribute__((noinline)) void flushBatch(ThreadState &t, bool all) {
+    if (!t.stats) {
+        bool was_in_hook = t.in_hook;
+        t.in_hook = true;
+        claimStats(t);
+        t.in_hook = was_in_hook;
+    }
+    ThreadStats &s = *t.stats;
+    if (t.shared) {
+        for (uint32_t i = 0; i < t.allocs; i++) {
+            __atomic_fetch_add(&s.class_count[alloc_track_class(t.sizes[i])], 1, __ATOMIC_RELAXED);
+        }
+        __atomic_fetch_add(&s.frees, t.frees, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&s.new_calls, t.new_calls, __ATOMIC_RELAXED);
+    } else {
+        for (uint32_t i = 0; i < t.allocs; i++) add<uint64_t>(s.class_count[alloc_track_class(t.sizes[i])], 1);
+        add<uint64_t>(s.frees, t.frees);
+        add<uint64_t>(s.new_calls, t.new_calls);
+    }
+    t.allocs = t.frees = t.new_calls = 0;
+    if (all || t.shared || t.pending > kFlushBytes || t.pending < -kFlushBytes) {
+        addLive(t.pending);
+        t.pending = 0;
+    }
+}
+
+// Sampled roughly every g_interval bytes: uniform in [interval/2, 3*interval/2)
+// so a program allocating in a fixed pattern doesn't always hit the same call
+int64_t nextCountdown(ThreadState &t) {
+    size_t interval = g_interval.load(std::memory_order_relaxed);
+    if (interval == 0) return kIdleCountdown;
+    t.rng ^= t.rng << 13;
+    t.rng ^= t.rng >> 7;
+    t.rng ^= t.rng << 17;
+    return int64_t(interval / 2 + t.rng % (interval | 1));
+}
+
+// The slow path: a thread's first allocation, or the countdown reached zero
+__attribute__((noinline, cold)) void recordSample(void *p, size_t size, bool is_new) {
+    ThreadState &t = t_state;
+    t.in_hook = true;
+    bool first = !t.stats;
+    if (first) claimStats(t);
+    int64_t overshoot = t.until_sample;
+    t.until_sample = nextCountdown(t) + overshoot;
+    size_t interval = g_interval.load(std::memory_order_relaxed);
+    if (!first && interval != 0) {
+        void *frames[kFrames + kSkipFrames];
+        int depth = backtrace(frames, kFrames + kSkipFrames) - kSkipFrames;
+        if (depth < 0) depth = 0;
+        lockSamples();
+        if (g_sample_count < kSampleSlots / 4 * 3) {
+            size_t i = sampleHome(p);
+            while (g_samples[i].ptr) i = (i + 1) & (kSampleSlots - 1);
+            Sample &s = g_samples[i];
+            s.ptr = p;
+            s.size = size;
+            s.footprint = footprint(p);
+            // One sample stands for about an interval's worth of allocations
+            s.weight = size > interval ? size : interval;
+            s.tid = t.stats->tid;
+            s.is_new = is_new;
+            s.depth = depth;
+            memcpy(s.frames, frames + kSkipFrames, sizeof(void *) * size_t(depth));
+            g_sample_count++;
+            filterAdd(p);
+        } else {
+            g_dropped++;
+        }
+        unlockSamples();
+    }
+    t.in_hook = false;
+    if (g_dump_requested && g_json_path) {
+        g_dump_requested = 0;
+        alloc_track_write_json(g_json_path);
+    }
+}
+
+TRACK_INLINE bool tracking(const ThreadState &t) {
+    return g_enabled.load(std::memory_order_relaxed) && !t.in_hook;
+}
+
+// Count a block the real allocator just returned (p may be null)
+TRACK_INLINE void noteAlloc(void *p, size_t size, bool is_new) {
+    ThreadState &t = t_state;
+    if (!p || !tracking(t)) return;
+    t.until_sample -= int64_t(size);
+    if (__builtin_expect(t.until_sample <= 0, 0)) recordSample(p, size, is_new);
+    t.pending += int64_t(footprint(p));
+    t.sizes[t.allocs] = size;
+    t.new_calls += is_new;
+    if (__builtin_expect(++t.allocs >= t.limit || t.pending > kFlushBytes, 0)) flushBatch(t, false);
+}
+
+// Count a block about to go back to the real allocator
+TRACK_INLINE void noteFree(ThreadState &t, size_t bytes) {
+    t.pending -= int64_t(bytes);
+    if (__builtin_expect(++t.frees >= t.limit || t.pending < -kFlushBytes, 0)) flushBatch(t, false);
+}
+
+TRACK_INLINE void releaseBlock(void *p) {
+    ThreadState &t = t_state;
+    if (p && !t.in_hook) {
+        // Tracking on or off, before the real free: the address may be reused at once
+        forgetBlock(p);
+        if (g_enabled.load(std::memory_order_relaxed)) noteFree(t, footprint(p));
+    }
+    __libc_free(p);
+}
+
+TRACK_INLINE void *alignedBlock(size_t alignment, size_t size) {
+    void *p = __libc_memalign(alignment, size);
+    noteAlloc(p, size, false);
+    return p;
+}
+
+// operator new: retry through the new_handler, then throw
+TRACK_INLINE void *newBlock(size_t size, size_t alignment) {
+    for (;;) {
+        void *p = alignment ? __libc_memalign(alignment, size ? size : 1) : __libc_malloc(size ? size : 1);
+        if (p) {
+            noteAlloc(p, size, true);
+            return p;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+TRACK_INLINE void *newBlockNothrow(size_t size, size_t alignment) noexcept {
+    try {
+        return newBlock(size, alignment);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void jsonString(FILE *out, const char *text) {
+    fputc('"', out);
+    for (; *text; text++) {
+        unsigned char c = static_cast<unsigned char>(*text);
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+// "main+0x1f", "libfoo.so+0x2a40" or just the address
+void frameName(void *frame, char *buf, size_t size) {
+    Dl_info info;
+    // frame is a return address: look up the call just before it
+    if (!dladdr(static_cast<char *>(frame) - 1, &info) || (!info.dli_sname && !info.dli_fname)) {
+        snprintf(buf, size, "%p", frame);
+        return;
+    }
+    if (info.dli_sname) {
+        int status = -1;
+        char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        snprintf(buf, size, "%s+0x%lx", status == 0 ? demangled : info.dli_sname,
+                 static_cast<unsigned long>(static_cast<char *>(frame) - static_cast<char *>(info.dli_saddr)));
+        free(demangled);
+    } else {
+        const char *file = strrchr(info.dli_fname, '/');
+        snprintf(buf, size, "%s+0x%lx", file ? file + 1 : info.dli_fname,
+                 static_cast<unsigned long>(static_cast<char *>(frame) - static_cast<char *>(info.dli_fbase)));
+    }
+}
+
+void writeJson(FILE *out) {
+    alloc_track_stats st;
+    alloc_track_get_stats(&st);
+
+    // Copy the samples out, so other threads aren't kept waiting on the file
+    lockSamples();
+    size_t count = g_sample_count;
+    Sample *copy = static_cast<Sample *>(malloc(sizeof(Sample) * (count ? count : 1)));
+    size_t n = 0;
+    for (size_t i = 0; copy && i < kSampleSlots && n < count; i++) {
+        if (g_samples[i].ptr) copy[n++] = g_samples[i];
+    }
+    unlockSamples();
+
+    fprintf(out, "{\n  \"tracker\": \"alloc_track\",\n  \"pid\": %ld,\n", static_cast<long>(getpid()));
+    fprintf(out, "  \"totals\": {\"allocations\": %llu, \"frees\": %llu, \"new_calls\": %llu, ",
+            (unsigned long long)st.allocations, (unsigned long long)st.frees, (unsigned long long)st.new_calls);
+    fprintf(out, "\"live_bytes\": %llu, \"peak_bytes\": %llu, \"threads\": %d},\n", (unsigned long long)st.live_bytes,
+            (unsigned long long)st.peak_bytes, st.threads);
+
+    fprintf(out, "  \"size_classes\": [");
+    bool comma = false;
+    for (int k = 0; k < ALLOC_TRACK_CLASSES; k++) {
+        if (!st.class_count[k]) continue;
+        unsigned long long lo = k ? 1ull << (k - 1) : 0, hi = k ? (1ull << k) - 1 : 0;
+        fprintf(out, "%s\n    {\"min\": %llu, ", comma ? "," : "", lo);
+        if (k == ALLOC_TRACK_CLASSES - 1) fprintf(out, "\"max\": null, ");
+        else fprintf(out, "\"max\": %llu, ", hi);
+        fprintf(out, "\"allocations\": %llu}", (unsigned long long)st.class_count[k]);
+        comma = true;
+    }
+    fprintf(out, "\n  ],\n  \"threads\": [");
+    // Running threads by id; -1 is every finished thread (and any beyond 255)
+    comma = false;
+    for (int i = 0; i < kMaxThreads; i++) {
+        const ThreadStats &s = g_stats[i];
+        if (!s.tid || (i < kShared && i >= g_used_slots.load(std::memory_order_relaxed))) continue;
+        fprintf(out, "%s\n    {\"id\": %ld, \"allocations\": %llu, \"frees\": %llu}", comma ? "," : "", s.tid,
+                (unsigned long long)allocationsOf(s), (unsigned long long)readCounter(s.frees));
+        comma = true;
+    }
+    fprintf(out, "\n  ],\n  \"sample_interval\": %zu,\n  \"live_samples\": %zu,\n  \"dropped_samples\": %llu,\n",
+            g_interval.load(std::memory_order_relaxed), n, (unsigned long long)st.dropped_samples);
+
+    // The blocks in MemoryVisualizer's shape: name, value, type, address, size
+    fprintf(out, "  \"variables\": [");
+    char name[512];
+    for (size_t i = 0; i < n; i++) {
+        const Sample &s = copy[i];
+        if (s.depth > 0) frameName(s.frames[0], name, sizeof(name));
+        else snprintf(name, sizeof(name), "?");
+        fprintf(out, "%s\n    {\"name\": ", i ? "," : "");
+        jsonString(out, name);
+        fprintf(out, ", \"value\": \"%zu bytes requested\", \"type\": \"%s\", \"address\": \"0x%llX\", ", s.size,
+                s.is_new ? "new" : "malloc", (unsigned long long)uintptr_t(s.ptr));
+        fprintf(out, "\"size\": %zu, \"represents_bytes\": %zu, \"thread\": %ld,\n     \"stack\": [", s.footprint,
+                s.weight, s.tid);
+        for (int f = 0; f < s.depth; f++) {
+            frameName(s.frames[f], name, sizeof(name));
+            if (f) fputs(", ", out);
+            jsonString(out, name);
+        }
+        fputs("]}", out);
+    }
+    fputs("\n  ]\n}\n", out);
+    free(copy);
+}
+
+void onSignal(int) { g_dump_requested = 1; }
+
+__attribute__((constructor)) void startTracker() {
+    ThreadState &t = t_state;
+    t.in_hook = true;
+    if (const char *interval = getenv("ALLOC_TRACK_SAMPLE")) {
+        g_interval.store(strtoull(interval, nullptr, 10), std::memory_order_relaxed);
+    }
+    // backtrace() loads libgcc on first use (and allocates): get that over with
+    void *frames[2];
+    backtrace(frames, 2);
+    g_json_path = getenv("ALLOC_TRACK_JSON");
+    if (g_json_path && *g_json_path) {
+        struct sigaction old;
+        // SIGUSR1 asks for a snapshot, unless the program uses it itself
+        if (sigaction(SIGUSR1, nullptr, &old) == 0 && old.sa_handler == SIG_DFL) signal(SIGUSR1, onSignal);
+    } else {
+        g_json_path = nullptr;
+    }
+    t.in_hook = false;
+}
+
+__attribute__((destructor)) void stopTracker() {
+    if (g_json_path) alloc_track_write_json(g_json_path);
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------
+// Public API
+// ----------------------------------------------------------------------
+
+TRACK_EXPORT void alloc_track_get_stats(alloc_track_stats *out) {
+    ThreadState &t = t_state;
+    if (t.stats) flushBatch(t, true);  // other threads' last few calls may not be in yet
+    memset(out, 0, sizeof(*out));
+    out->threads = g_thread_count.load(std::memory_order_relaxed);
+    int used = g_used_slots.load(std::memory_order_relaxed);
+    int64_t live = g_live.load(std::memory_order_relaxed);
+    for (int i = 0; i < kMaxThreads; i++) {
+        if (i >= used && i != kShared) continue;
+        const ThreadStats &s = g_stats[i];
+        out->frees += readCounter(s.frees);
+        out->new_calls += readCounter(s.new_calls);
+        for (int k = 0; k < ALLOC_TRACK_CLASSES; k++) {
+            out->class_count[k] += readCounter(s.class_count[k]);
+        }
+    }
+    for (int k = 0; k < ALLOC_TRACK_CLASSES; k++) out->allocations += out->class_count[k];
+    // Frees of blocks from before tracking started can outnumber the rest
+    out->live_bytes = live > 0 ? uint64_t(live) : 0;
+    int64_t peak = g_peak.load(std::memory_order_relaxed);
+    out->peak_bytes = uint64_t(peak > live ? peak : live > 0 ? live : 0);
+    lockSamples();
+    out->live_samples = g_sample_count;
+    out->dropped_samples = g_dropped;
+    unlockSamples();
+}
+
+TRACK_EXPORT int alloc_track_write_json(const char *path) {
+    ThreadState &t = t_state;
+    bool was_in_hook = t.in_hook;
+    t.in_hook = true;  // the tracker's own allocations aren't counted
+    bool to_stderr = strcmp(path, "-") == 0;
+    FILE *out = to_stderr ? stderr : fopen(path, "w");
+    int result = -1;
+    if (out) {
+        writeJson(out);
+        result = ferror(out) ? -1 : 0;
+        if (to_stderr) fflush(out);
+        else if (fclose(out) != 0) result = -1;
+    }
+    t.in_hook = was_in_hook;
+    return result;
+}
+
+TRACK_EXPORT void alloc_track_enable(int on) { g_enabled.store(on != 0, std::memory_order_relaxed); }
+
+TRACK_EXPORT void alloc_track_set_sample_interval(size_t bytes) {
+    g_interval.store(bytes, std::memory_order_relaxed);
+    // This thread starts counting down from the new interval now; the
+    // others after their next sample
+    ThreadState &t = t_state;
+    if (t.stats) t.until_sample = nextCountdown(t);
+}
+
+// ----------------------------------------------------------------------
+// The replaced C allocator
+// ----------------------------------------------------------------------
+
+TRACK_EXPORT void *malloc(size_t size) {
+    void *p = __libc_malloc(size);
+    noteAlloc(p, size, false);
+    return p;
+}
+
+TRACK_EXPORT void free(void *p) { releaseBlock(p); }
+
+TRACK_EXPORT void *calloc(size_t count, size_t size) {
+    void *p = __libc_calloc(count, size);
+    noteAlloc(p, count * size, false);  // p is null if count * size overflowed
+    return p;
+}
+
+TRACK_EXPORT void *realloc(void *old, size_t size) {
+    ThreadState &t = t_state;
+    if (old && !t.in_hook) forgetBlock(old);
+    if (!old || !tracking(t)) {
+        void *p = __libc_realloc(old, size);
+        if (!old) noteAlloc(p, size, false);
+        return p;
+    }
+    size_t old_bytes = footprint(old);
+    void *p = __libc_realloc(old, size);
+    if (!p && size) return nullptr;  // old is untouched (only its sample is lost)
+    noteFree(t, old_bytes);
+    noteAlloc(p, size, false);
+    return p;
+}
+
+TRACK_EXPORT void *reallocarray(void *old, size_t count, size_t size) {
+    size_t bytes;
+    if (__builtin_mul_overflow(count, size, &bytes)) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return realloc(old, bytes);
+}
+
+TRACK_EXPORT void *memalign(size_t alignment, size_t size) { return alignedBlock(alignment, size); }
+
+TRACK_EXPORT void *aligned_alloc(size_t alignment, size_t size) { return alignedBlock(alignment, size); }
+
+TRACK_EXPORT int posix_memalign(void **out, size_t alignment, size_t size) {
+    if (!alignment || alignment % sizeof(void *) || (alignment & (alignment - 1))) return EINVAL;
+    void *p = alignedBlock(alignment, size);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+TRACK_EXPORT void *valloc(size_t size) { return alignedBlock(size_t(sysconf(_SC_PAGESIZE)), size); }
+
+TRACK_EXPORT void *pvalloc(size_t size) {
+    size_t page = size_t(sysconf(_SC_PAGESIZE));
+    return alignedBlock(page, (size + page - 1) & ~(page - 1));
+}
+
+// ----------------------------------------------------------------------
+// The replaced operator new/delete (every form, so none slip past)
+// ----------------------------------------------------------------------
+
+void *operator new(size_t size) { return newBlock(size, 0); }
+void *operator new[](size_t size) { return newBlock(size, 0); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return newBlockNothrow(size, 0); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return newBlockNothrow(size, 0); }
+void *operator new(size_t size, std::align_val_t align) { return newBlock(size, size_t(align)); }
+void *operator new[](size_t size, std::align_val_t align) { return newBlock(size, size_t(align)); }
+void *operator new(size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return newBlockNothrow(size, size_t(align));
+}
+void *operator new[](size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+    return newBlockNothrow(size, size_t(align));
+}
+
+void operator delete(void *p) noexcept { releaseBlock(p); }
+void operator delete[](void *p) noexcept { releaseBlock(p); }
+void operator delete(void *p, size_t) noexcept { releaseBlock(p); }
+void operator delete[](void *p, size_t) noexcept { releaseBlock(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { releaseBlock(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { releaseBlock(p); }
+void operator delete(void *p, std::align_val_t) noexcept { releaseBlock(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { releaseBlock(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { releaseBlock(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { releaseBlock(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { releaseBlock(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { releaseBlock(p); }
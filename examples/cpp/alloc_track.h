@@ -0,0 +1,94 @@
+/*
+ * alloc_track.h - Count Every malloc and new, and See What Is Still Alive
+ * The "Always free what you malloc!" of 3_memory.c, checked by a program.
+ *
+ * alloc_track.cpp replaces malloc, calloc, realloc, free, the aligned
+ * allocators and every operator new/delete. Each call is counted in the
+ * calling thread's own counters (no lock, no shared cache line), in
+ * batches of 32 calls; 16_alloc_track measures what that costs against
+ * the same program untracked. About once per 2 MB allocated it
+ * also records the call stack of that allocation, while it stays alive.
+ *
+ * Use it without changing a program (glibc only):
+ *
+ *   g++ -O2 -shared -fPIC -pthread alloc_track.cpp -o liballoc_track.so
+ *   ALLOC_TRACK_JSON=heap.json LD_PRELOAD=./liballoc_track.so ./memory
+ *
+ * heap.json is written at exit, and after a SIGUSR1 (at the next sampled
+ * allocation).
+ * Or link it in and ask from the program itself:
+ *
+ *   // g++ -O2 -pthread main.cpp alloc_track.cpp
+ *   alloc_track_stats s;
+ *   alloc_track_get_stats(&s);
+ *   printf("%llu bytes still allocated\n", (unsigned long long)s.live_bytes);
+ *   alloc_track_write_json("heap.json");
+ *
+ * Environment: ALLOC_TRACK_JSON=file ("-" for stderr) writes a snapshot at
+ * exit; ALLOC_TRACK_SAMPLE=bytes sets the average distance between sampled
+ * allocations (0 turns sampling off). Names in the stacks come from dladdr,
+ * so link programs with -rdynamic to see their own functions.
+ *
+ * Byte counts are heap footprint: what malloc really set aside, including
+ * its 8-byte header and rounding (a 20-byte malloc uses 32).
+ */
+
+#ifndef ALLOC_TRACK_H
+#define ALLOC_TRACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size classes are powers of two: class k holds requests of 2^(k-1)..2^k-1
+// bytes (class 0 is malloc(0), the last one everything bigger)
+#define ALLOC_TRACK_CLASSES 40
+
+// Average bytes allocated between two sampled call stacks
+#define ALLOC_TRACK_DEFAULT_INTERVAL ((size_t)2 << 20)
+
+typedef struct {
+    uint64_t allocations;       // every successful malloc/calloc/realloc/new...
+    uint64_t frees;             // every free/delete of a non-NULL pointer
+    uint64_t new_calls;         // how many of the allocations were operator new
+    uint64_t live_bytes;        // footprint allocated and not yet freed
+    uint64_t peak_bytes;        // the most live_bytes has been (see below)
+    uint64_t class_count[ALLOC_TRACK_CLASSES];  // allocations per size class
+    uint64_t live_samples;      // sampled allocations that are still alive
+    uint64_t dropped_samples;   // samples lost because the table was full
+    int threads;                // threads that have allocated so far (ended ones too)
+} alloc_track_stats;
+
+// Add up every thread's counters. Threads hand in their counts every 32
+// calls and their change in live bytes in 64 KB steps, so while other
+// threads are allocating the counts may miss their last few calls, and
+// peak_bytes (live_bytes too) is exact to within 64 KB per thread.
+void alloc_track_get_stats(alloc_track_stats *out);
+
+// Write a live-heap snapshot as JSON ("-" means stderr). 0 on success.
+// "variables" lists the sampled live blocks as {name, value, type,
+// address, size} - the same fields MemoryVisualizer.jsx shows.
+int alloc_track_write_json(const char *path);
+
+// Turn counting on (the default) or off for all threads. Blocks should be
+// freed in the same mode they were allocated in, or live_bytes drifts.
+void alloc_track_enable(int on);
+
+// Average bytes between sampled allocations (0 = no sampling). Other
+// threads switch to it after their next sample.
+void alloc_track_set_sample_interval(size_t bytes);
+
+// Lowest-numbered size class that holds an allocation of `size` bytes
+static inline int alloc_track_class(size_t size) {
+    int k = size ? 64 - __builtin_clzll((unsigned long long)size) : 0;
+    return k < ALLOC_TRACK_CLASSES ? k : ALLOC_TRACK_CLASSES - 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ALLOC_TRACK_H
@@ -0,0 +1,130 @@
+/*
+ * arena.hpp - Arena and Pool Allocators for C++ Containers
+ * Wraps ../c/arena.h so STL containers can use it.
+ *
+ * std::pmr containers take a "memory resource" that decides where their
+ * memory comes from. Point one at an ArenaResource or PoolResource and
+ * the container stops calling new/delete for every element:
+ *
+ *   ArenaResource arena;
+ *   std::pmr::vector<int> numbers(&arena);
+ *
+ *   PoolResource pool(32);             // for nodes up to 32 bytes
+ *   std::pmr::list<int> items(&pool);
+ *
+ * Like the C versions, these don't lock: one per thread.
+ * Needs C++17 (the default for g++ 11 and newer).
+ */
+
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include "../c/arena.h"
+
+// Bump-pointer memory. Deallocating does nothing; reset() frees it all.
+class ArenaResource : public std::pmr::memory_resource {
+public:
+    explicit ArenaResource(std::size_t block_size = 64 * 1024) {
+        arena_init(&arena_, block_size);
+    }
+    ~ArenaResource() override { arena_destroy(&arena_); }
+
+    ArenaResource(const ArenaResource &) = delete;
+    ArenaResource &operator=(const ArenaResource &) = delete;
+
+    // Throw away everything (containers using it must be gone first!)
+    void reset() { arena_reset(&arena_); }
+    arena_mark mark() const { return arena_get_mark(&arena_); }
+    void rewind(arena_mark m) { arena_rewind(&arena_, m); }
+    std::size_t bytesReserved() const { return arena_bytes_reserved(&arena_); }
+
+private:
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        void *p = arena_alloc(&arena_, bytes, alignment);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+    arena arena_;
+};
+
+// Fixed-size blocks with a free list. Requests that don't fit a block
+// (too big, or aligned more than 16 bytes) go to the upstream resource.
+class PoolResource : public std::pmr::memory_resource {
+public:
+    explicit PoolResource(std::size_t object_size, std::size_t per_chunk = 1024,
+                          std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+        : upstream_(upstream) {
+        pool_init(&pool_, object_size, per_chunk);
+    }
+    ~PoolResource() override { pool_destroy(&pool_); }
+
+    PoolResource(const PoolResource &) = delete;
+    PoolResource &operator=(const PoolResource &) = delete;
+
+    std::size_t objectSize() const { return pool_.object_size; }
+
+private:
+    bool fits(std::size_t bytes, std::size_t alignment) const {
+        return bytes <= pool_.object_size && alignment <= ARENA_MAX_ALIGN &&
+               pool_.object_size % alignment == 0;
+    }
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+        if (!fits(bytes, alignment)) return upstream_->allocate(bytes, alignment);
+        void *p = pool_alloc(&pool_);
+        if (!p) throw std::bad_alloc();
+        return p;
+    }
+    void do_deallocate(void *p, std::size_t bytes, std::size_t alignment) override {
+        if (fits(bytes, alignment)) pool_free(&pool_, p);
+        else upstream_->deallocate(p, bytes, alignment);
+    }
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+    pool pool_;
+    std::pmr::memory_resource *upstream_;
+};
+
+// A plain (non-virtual) allocator over an ArenaResource, for containers
+// that take an allocator type instead of a pmr resource:
+//   std::vector<int, ArenaAllocator<int>> v{ArenaAllocator<int>(arena)};
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(ArenaResource &resource) noexcept : resource_(&resource) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : resource_(other.resource()) {}
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(resource_->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *, std::size_t) noexcept {}
+
+    ArenaResource *resource() const noexcept { return resource_; }
+
+private:
+    ArenaResource *resource_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) noexcept {
+    return a.resource() == b.resource();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) noexcept {
+    return !(a == b);
+}
+
+#endif  // ARENA_HPP
@@ -0,0 +1,45 @@
+/*
+ * bench.hpp - C++ Helpers for the Benchmark Harness
+ * Lets ../c/bench.h time lambdas, and adds type-safe barriers.
+ *
+ *   bench_suite suite;
+ *   bench_init(&suite, "demo", argc, argv);
+ *   benchRun(suite, "vector push_back", [](size_t n) {
+ *       std::vector<int> v;
+ *       for (size_t i = 0; i < n; i++) v.push_back(int(i));
+ *       doNotOptimize(v.data());
+ *   });
+ *   bench_finish(&suite);
+ */
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include "../c/bench.h"
+
+// Pretend to read value, so the code that computed it must run
+template <typename T>
+inline void doNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Pretend value might have changed, so nothing is precomputed with it
+template <typename T>
+inline void hideValue(T &value) {
+    static_assert(std::is_scalar<T>::value, "hideValue works on numbers and pointers");
+    asm volatile("" : "+r"(value));
+}
+
+// Time a lambda (or anything callable) taking an iteration count
+template <typename Work>
+const bench_result *benchRun(bench_suite &suite, const char *name, Work &&work) {
+    using Callable = std::remove_reference_t<Work>;
+    auto trampoline = [](void *ctx, size_t iterations) {
+        (*static_cast<Callable *>(ctx))(iterations);
+    };
+    return bench_run(&suite, name, trampoline, const_cast<void *>(static_cast<const void *>(&work)));
+}
+
+#endif  // BENCH_HPP
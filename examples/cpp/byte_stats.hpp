@@ -0,0 +1,782 @@
+/*
+ * byte_stats.hpp - Byte and Bit Statistics for Files of Any Size, on Every Core
+ * ASCIIExplorer.jsx looks at the characters of one short string and
+ * 2_binary_ops.c at the bits of one int; this looks at all of a file.
+ *
+ * For every byte value: how often it appears (a histogram). From that
+ * alone follow the ASCII classes (letters, digits, control ...), the
+ * number of 1 bits (bit density) and the entropy: how many bits per byte
+ * a perfect compressor would need (0 = one value, 8 = random). Beside
+ * the histogram: the longest run of one repeated byte, and the longest
+ * runs of 0 bits and of 1 bits (bit 0 of each byte first).
+ *
+ *   bytestats::ScanResult r = bytestats::scanFile("big.bin");  // all cores
+ *   if (!r.ok()) puts(r.error.c_str());
+ *   r.stats.entropy(), r.stats.bitDensity(), r.stats.byteRun.longest.length
+ *   puts(bytestats::toJson(r.stats).c_str());
+ *
+ * How it goes parallel: the file is mapped (mmap) and cut into chunks.
+ * Each thread starts with its own stretch of chunks and takes them from
+ * the front; a thread that runs out steals the back half of another's
+ * stretch, so a few slow chunks (or a slow core) don't hold everyone up.
+ * Each thread counts into its own histogram - no shared counters, so no
+ * cache line bounces between cores - and the histograms are added up at
+ * the end. Runs can cross chunk edges, so each chunk keeps its first
+ * and last run too, and the chunks are joined in file order.
+ *
+ * Kernels (one chunk on one thread):
+ *   scalar  one histogram table, each byte compared with the one before
+ *   avx2    four tables in turn (so repeated bytes don't wait on their
+ *           own last increment); 32 bytes compared with their
+ *           neighbours at once, so runs and blocks of one value (zero
+ *           pages) cost one step instead of 32
+ * Bit runs are found a word at a time: a word of all 0s or all 1s
+ * extends the run, and a run inside a word is only measured exactly
+ * when a few shifts say it beats the longest so far.
+ */
+
+#ifndef BYTE_STATS_HPP
+#define BYTE_STATS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define BYTE_STATS_X86 1
+#else
+#define BYTE_STATS_X86 0
+#endif
+
+namespace bytestats {
+
+enum class Kernel { Scalar, Avx2 };
+
+inline const char *kernelName(Kernel k) {
+    return k == Kernel::Avx2 ? "avx2" : "scalar";
+}
+
+// Where a run starts (bytes, or bits for bit runs) and how long it is
+struct Run {
+    uint64_t length = 0;
+    uint64_t offset = 0;
+};
+
+// Longer wins; of two the same length, the first
+inline bool longer(const Run &a, const Run &b) {
+    return a.length > b.length || (a.length == b.length && a.length && a.offset < b.offset);
+}
+
+// Runs of one repeated byte in a stretch of bytes
+struct ByteRuns {
+    Run longest;
+    uint8_t value = 0;           // the byte repeated in the longest run
+    uint8_t first = 0, last = 0; // the stretch's first and last byte
+    uint64_t head = 0, tail = 0; // length of its first and last run
+};
+
+// Runs of one bit value (all 0s or all 1s)
+struct BitRuns {
+    Run longest;
+    uint64_t head = 0, tail = 0; // how many of the first / last bits have the value
+};
+
+// Everything about a stretch of bytes that depends on order
+struct Runs {
+    uint64_t bytes = 0;
+    ByteRuns byte;
+    BitRuns zeros, ones;
+
+    // `next` is the stretch that follows this one
+    void append(const Runs &next);
+};
+
+namespace detail {
+
+inline void appendBits(BitRuns &a, uint64_t a_bits, const BitRuns &b, uint64_t b_bits) {
+    Run joined{a.tail + b.head, a_bits - a.tail};
+    Run shifted{b.longest.length, b.longest.offset + a_bits};
+    if (longer(joined, a.longest)) a.longest = joined;
+    if (longer(shifted, a.longest)) a.longest = shifted;
+    uint64_t head = a.head == a_bits ? a_bits + b.head : a.head;
+    a.tail = b.tail == b_bits ? b_bits + a.tail : b.tail;
+    a.head = head;
+}
+
+}  // namespace detail
+
+inline void Runs::append(const Runs &next) {
+    if (next.bytes == 0) return;
+    if (bytes == 0) {
+        *this = next;
+        return;
+    }
+    const bool joins = byte.last == next.byte.first;
+    Run joined{joins ? byte.tail + next.byte.head : 0, bytes - byte.tail};
+    Run shifted{next.byte.longest.length, next.byte.longest.offset + bytes};
+    if (longer(joined, byte.longest)) {
+        byte.longest = joined;
+        byte.value = byte.last;
+    }
+    if (longer(shifted, byte.longest)) {
+        byte.longest = shifted;
+        byte.value = next.byte.value;
+    }
+    uint64_t head = joins && byte.head == bytes ? bytes + next.byte.head : byte.head;
+    byte.tail = joins && next.byte.tail == next.bytes ? next.bytes + byte.tail : next.byte.tail;
+    byte.head = head;
+    byte.last = next.byte.last;
+    detail::appendBits(zeros, 8 * bytes, next.zeros, 8 * next.bytes);
+    detail::appendBits(ones, 8 * bytes, next.ones, 8 * next.bytes);
+    bytes += next.bytes;
+}
+
+struct AsciiClasses {
+    uint64_t control = 0;      // 0x00-0x1F and 0x7F, except whitespace
+    uint64_t whitespace = 0;   // space, \t \n \v \f \r
+    uint64_t digits = 0;
+    uint64_t upper = 0;
+    uint64_t lower = 0;
+    uint64_t punctuation = 0;  // the rest of 0x21-0x7E
+    uint64_t high = 0;         // 0x80-0xFF: not ASCII (UTF-8 or binary)
+};
+
+struct Stats {
+    uint64_t bytes = 0;
+    uint64_t histogram[256] = {};
+    ByteRuns byteRun;
+    BitRuns zeroBits, oneBits;
+
+    uint64_t ones() const {
+        uint64_t total = 0;
+        for (int b = 0; b < 256; b++) total += histogram[b] * uint64_t(__builtin_popcount(unsigned(b)));
+        return total;
+    }
+
+    double bitDensity() const { return bytes ? double(ones()) / (8.0 * double(bytes)) : 0; }
+
+    // Shannon entropy in bits per byte
+    double entropy() const {
+        double h = 0;
+        for (uint64_t count : histogram) {
+            if (count == 0) continue;
+            double p = double(count) / double(bytes);
+            h -= p * std::log2(p);
+        }
+        return h;
+    }
+
+    AsciiClasses classes() const {
+        AsciiClasses c;
+        for (int b = 0; b < 256; b++) {
+            uint64_t n = histogram[b];
+            if (b >= 0x80) c.high += n;
+            else if (b == ' ' || (b >= '\t' && b <= '\r')) c.whitespace += n;
+            else if (b < 0x20 || b == 0x7F) c.control += n;
+            else if (b >= '0' && b <= '9') c.digits += n;
+            else if (b >= 'A' && b <= 'Z') c.upper += n;
+            else if (b >= 'a' && b <= 'z') c.lower += n;
+            else c.punctuation += n;
+        }
+        return c;
+    }
+};
+
+namespace detail {
+
+// ---- Bit runs, a 64-bit word at a time ----
+
+// Does x have k 1s in a row (k >= 1)? A few shift-ANDs, doubling each time
+inline bool hasRun(uint64_t x, uint64_t k) {
+    uint64_t have = 1;
+    for (; have * 2 <= k && x; have *= 2) x &= x >> have;
+    if (have < k) x &= x >> (k - have);
+    return x != 0;
+}
+
+// The longest run of 1s in x (x != 0), and where the first such run starts
+inline uint64_t longestOnes(uint64_t x, uint64_t &start) {
+    uint64_t length = 0, starts = x;
+    while (x) {
+        starts = x;
+        x &= x >> 1;
+        length++;
+    }
+    start = uint64_t(__builtin_ctzll(starts));
+    return length;
+}
+
+// Is some byte of x all 1s? (A zero byte of ~x, found the usual way.)
+inline bool hasFullByte(uint64_t x) {
+    const uint64_t y = ~x;
+    return ((y - 0x0101010101010101ull) & ~y & 0x8080808080808080ull) != 0;
+}
+
+// Plain scalars, so the compiler can keep a scan in registers
+struct BitRunScan {
+    uint64_t longest = 0, longest_at = 0;
+    uint64_t head = ~0ull;  // unset until the first run ends
+    uint64_t position = 0;  // bits seen so far
+    uint64_t current = 0;   // the run ending at `position`
+
+    // `x` has a 1 where the bit has our value; only the low `bits` count.
+    // `inner` false: the caller knows x has no run longer than `longest`.
+    void feed(uint64_t x, unsigned bits, bool inner = true) {
+        const uint64_t valid = bits == 64 ? ~0ull : (1ull << bits) - 1;
+        x &= valid;
+        if (x == valid) {
+            current += bits;
+            position += bits;
+            return;
+        }
+        const uint64_t others = ~x & valid;
+        const unsigned first = unsigned(__builtin_ctzll(others)), last = 63 - unsigned(__builtin_clzll(others));
+        endRun(current + first, position + first);
+        // Runs between the first and last other bit: only worth measuring
+        // if one could be longer than the longest so far. Past 14, a
+        // longer run covers a whole byte, so a word without a full byte
+        // is skipped after one subtraction.
+        if (inner && last > first + 1 && longest < last - first - 1 && (longest < 14 || hasFullByte(x))) {
+            Run r = innerRun(x, first, last, longest);
+            if (r.length > longest) {
+                longest = r.length;
+                longest_at = position + r.offset;
+            }
+        }
+        current = bits - 1 - last;
+        position += bits;
+    }
+
+    // The first longest run strictly between bits `first` and `last`, if
+    // longer than `longest` (else length 0). Rare, and out of line: inlined,
+    // it makes feed() too big to inline and the scan state goes back to
+    // memory on every word, 3x slower.
+    __attribute__((noinline)) static Run innerRun(uint64_t x, unsigned first, unsigned last, uint64_t longest) {
+        const uint64_t inner = x & (((1ull << last) - 1) & ~((2ull << first) - 1));
+        if (!inner || !hasRun(inner, longest + 1)) return Run{};
+        uint64_t start;
+        uint64_t length = longestOnes(inner, start);
+        return Run{length, start};
+    }
+
+    void endRun(uint64_t length, uint64_t end) {
+        if (head == ~0ull) head = length;
+        if (length > longest) {
+            longest = length;
+            longest_at = end - length;
+        }
+    }
+
+    BitRuns finish() {
+        endRun(current, position);
+        BitRuns runs;
+        runs.longest = {longest, longest_at};
+        runs.head = head;
+        runs.tail = current;
+        return runs;
+    }
+};
+
+inline uint64_t loadWord(const uint8_t *p) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    return w;
+}
+
+// Feed n bytes to both bit scans, 8 at a time
+inline void feedBits(const uint8_t *p, size_t n, BitRunScan &zeros_out, BitRunScan &ones_out) {
+    // Local copies: stores to the originals might change *p, as far as the
+    // compiler knows, so they would go to memory on every word
+    BitRunScan zeros = zeros_out, ones = ones_out;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w = loadWord(p + i);
+        zeros.feed(~w, 64);
+        ones.feed(w, 64);
+    }
+    if (i < n) {
+        uint64_t w = 0;
+        memcpy(&w, p + i, n - i);
+        unsigned bits = unsigned(8 * (n - i));
+        zeros.feed(~w, bits);
+        ones.feed(w, bits);
+    }
+    zeros_out = zeros;
+    ones_out = ones;
+}
+
+// ---- Byte runs ----
+
+struct ByteRunScan {
+    ByteRuns runs;
+    uint64_t current = 0;  // the run ending at `position`
+    uint64_t position = 0;
+    bool head_done = false;
+
+    void start(uint8_t first) {
+        runs.first = runs.last = first;
+        current = position = 1;
+    }
+
+    // The run of `value` that ends at `end`
+    void endRun(uint64_t length, uint64_t end, uint8_t value) {
+        if (!head_done) {
+            runs.head = length;
+            head_done = true;
+        }
+        if (length > runs.longest.length) {
+            runs.longest = {length, end - length};
+            runs.value = value;
+        }
+    }
+
+    ByteRuns finish(uint8_t last) {
+        runs.last = last;
+        endRun(current, position, last);
+        runs.tail = current;
+        return runs;
+    }
+};
+
+// ---- One chunk, plain loops ----
+
+inline void scanChunkScalar(const uint8_t *p, size_t n, uint64_t *histogram, Runs &out) {
+    out = Runs();
+    out.bytes = n;
+    if (n == 0) return;
+    uint32_t counts[256] = {};
+    ByteRunScan bytes;
+    bytes.start(p[0]);
+    counts[p[0]]++;
+    for (size_t i = 1; i < n; i++) {
+        counts[p[i]]++;
+        if (p[i] == p[i - 1]) {
+            bytes.current++;
+        } else {
+            bytes.endRun(bytes.current, i, p[i - 1]);
+            bytes.current = 1;
+        }
+    }
+    bytes.position = n;
+    out.byte = bytes.finish(p[n - 1]);
+    BitRunScan zeros, ones;
+    feedBits(p, n, zeros, ones);
+    out.zeros = zeros.finish();
+    out.ones = ones.finish();
+    for (int b = 0; b < 256; b++) histogram[b] += counts[b];
+}
+
+#if BYTE_STATS_X86
+
+// ---- AVX2: 32 bytes per step ----
+
+// hasRun() on four words at once: the lanes of the result are all 1s where
+// the lane of x has `length` 1s in a row (1 <= length <= 64)
+__attribute__((target("avx2"))) inline __m256i hasRun4(__m256i x, uint64_t length) {
+    uint64_t have = 1;
+    for (; have * 2 <= length; have *= 2) x = _mm256_and_si256(x, _mm256_srl_epi64(x, _mm_cvtsi64_si128(int64_t(have))));
+    if (have < length) x = _mm256_and_si256(x, _mm256_srl_epi64(x, _mm_cvtsi64_si128(int64_t(length - have))));
+    return _mm256_xor_si256(_mm256_cmpeq_epi64(x, _mm256_setzero_si256()), _mm256_set1_epi8(-1));
+}
+
+__attribute__((target("avx2,bmi,lzcnt"))) inline void scanChunkAvx2(const uint8_t *p, size_t n,
+                                                                     uint64_t *histogram, Runs &out) {
+    out = Runs();
+    out.bytes = n;
+    if (n == 0) return;
+    // Four tables, used in turn, so a repeated byte's increments don't
+    // each wait for the one before
+    uint32_t counts[4][256] = {};
+    ByteRunScan bytes;
+    BitRunScan zeros, ones;
+    bytes.runs.first = p[0];
+    // The first block compares p[0] with itself, which starts its run at 0
+    // (only read when there is a whole block, so only built then: p may
+    // hold fewer than 31 bytes)
+    uint8_t first_before[32];
+    if (n >= 32) {
+        first_before[0] = p[0];
+        memcpy(first_before + 1, p, 31);
+    }
+    const __m256i all = _mm256_set1_epi8(-1);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        const __m256i now = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+        const __m256i before = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(i ? p + i - 1 : first_before));
+        const uint32_t same = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(now, before)));
+        if (same == ~0u) {
+            // All 32 equal the byte before: one value, one run
+            counts[0][p[i]] += 32;
+            bytes.current += 32;
+        } else {
+            for (int w = 0; w < 4; w++) {
+                const uint64_t word = loadWord(p + i + 8 * w);
+                counts[0][word & 0xFF]++;
+                counts[1][(word >> 8) & 0xFF]++;
+                counts[2][(word >> 16) & 0xFF]++;
+                counts[3][(word >> 24) & 0xFF]++;
+                counts[0][(word >> 32) & 0xFF]++;
+                counts[1][(word >> 40) & 0xFF]++;
+                counts[2][(word >> 48) & 0xFF]++;
+                counts[3][word >> 56]++;
+            }
+            // A 0 in `same` starts a new run: the run going on ends at the
+            // first one, the runs between 0s are whole, the last goes on
+            const uint32_t starts = ~same;
+            const unsigned first = unsigned(_tzcnt_u32(starts)), last = 31 - unsigned(_lzcnt_u32(starts));
+            bytes.endRun(bytes.current + first, i + first, p[i + first - 1]);
+            if (last > first && bytes.runs.longest.length < last - first) {
+                // k 1s in a row here are a run of k + 1 equal bytes
+                const uint32_t inner = same & (((1u << last) - 1) & ~((2u << first) - 1));
+                if (inner && hasRun(inner, bytes.runs.longest.length)) {
+                    uint64_t start;
+                    uint64_t length = longestOnes(inner, start) + 1;
+                    Run r{length, i + start - 1};
+                    if (longer(r, bytes.runs.longest)) {
+                        bytes.runs.longest = r;
+                        bytes.runs.value = p[i + start];
+                    }
+                }
+            }
+            bytes.current = 32 - last;
+        }
+
+        // Bits: 32 bytes of all 0s or all 1s in one step
+        if (_mm256_testz_si256(now, now)) {
+            zeros.current += 256;
+            zeros.position += 256;
+            ones.feed(0, 64);
+            ones.position += 192;
+        } else if (_mm256_testc_si256(now, all)) {
+            ones.current += 256;
+            ones.position += 256;
+            zeros.feed(0, 64);
+            zeros.position += 192;
+        } else {
+            // Which words could hold a run longer than the longest so far,
+            // four at a time; only those get feed()'s exact, slower check
+            const __m256i z = hasRun4(_mm256_xor_si256(now, all), std::min<uint64_t>(zeros.longest + 1, 64));
+            const __m256i o = hasRun4(now, std::min<uint64_t>(ones.longest + 1, 64));
+            const unsigned maybe = unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(z)) |
+                                            _mm256_movemask_pd(_mm256_castsi256_pd(o)) << 4);
+            for (int w = 0; w < 4; w++) {
+                const uint64_t word = loadWord(p + i + 8 * w);
+                zeros.feed(~word, 64, maybe >> w & 1);
+                ones.feed(word, 64, maybe >> (w + 4) & 1);
+            }
+        }
+    }
+    for (size_t j = i; j < n; j++) {
+        counts[0][p[j]]++;
+        if (j == 0 || p[j] == p[j - 1]) {
+            bytes.current++;
+        } else {
+            bytes.endRun(bytes.current, j, p[j - 1]);
+            bytes.current = 1;
+        }
+    }
+    feedBits(p + i, n - i, zeros, ones);
+    bytes.position = n;
+    out.byte = bytes.finish(p[n - 1]);
+    out.zeros = zeros.finish();
+    out.ones = ones.finish();
+    for (int b = 0; b < 256; b++) histogram[b] += uint64_t(counts[0][b]) + counts[1][b] + counts[2][b] + counts[3][b];
+}
+
+#endif  // BYTE_STATS_X86
+
+}  // namespace detail
+
+// ---- Pick the best kernel once, when first used ----
+
+inline Kernel detectKernel() {
+#if BYTE_STATS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi")) return Kernel::Avx2;
+#endif
+    return Kernel::Scalar;
+}
+
+inline Kernel bestKernel() {
+    static const Kernel best = detectKernel();
+    return best;
+}
+
+// Count one chunk into `histogram` (256 entries, added to) and describe
+// its runs. Chunks under 4 GB (the tables count in 32 bits; scanBuffer
+// keeps its chunks to 2 GB).
+inline void scanChunkWith(Kernel k, const uint8_t *p, size_t n, uint64_t *histogram, Runs &runs) {
+#if BYTE_STATS_X86
+    if (k == Kernel::Avx2) return detail::scanChunkAvx2(p, n, histogram, runs);
+#else
+    (void)k;
+#endif
+    detail::scanChunkScalar(p, n, histogram, runs);
+}
+
+// ---- Work stealing over a list of tasks ----
+
+// Each thread owns a stretch [begin, end) of task numbers, both in one
+// 64-bit word so they change together. The owner takes from the front;
+// a thread with nothing left takes the back half of someone else's.
+class StealingQueues {
+public:
+    explicit StealingQueues(int threads) : slots_(size_t(threads)) {}
+
+    // Task numbers 0 .. tasks-1, cut into equal stretches, one per thread
+    void fill(uint32_t tasks) {
+        const size_t threads = slots_.size();
+        for (size_t t = 0; t < threads; t++) {
+            slots_[t].range.store(pack(uint32_t(tasks * t / threads), uint32_t(tasks * (t + 1) / threads)));
+            slots_[t].steals = 0;
+        }
+    }
+
+    // The next task for thread `self`; false when every stretch is empty
+    bool next(int self, uint32_t &task) {
+        if (pop(self, task)) return true;
+        const size_t threads = slots_.size();
+        for (size_t k = 1; k < threads; k++) {
+            if (steal(self, int((size_t(self) + k) % threads), task)) return true;
+        }
+        return false;
+    }
+
+    uint64_t steals(int thread) const { return slots_[size_t(thread)].steals; }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> range{0};
+        uint64_t steals = 0;  // written by the owner only
+    };
+
+    static uint64_t pack(uint32_t begin, uint32_t end) { return uint64_t(end) << 32 | begin; }
+
+    bool pop(int self, uint32_t &task) {
+        std::atomic<uint64_t> &range = slots_[size_t(self)].range;
+        uint64_t r = range.load(std::memory_order_acquire);
+        for (;;) {
+            const uint32_t begin = uint32_t(r), end = uint32_t(r >> 32);
+            if (begin >= end) return false;
+            if (range.compare_exchange_weak(r, pack(begin + 1, end), std::memory_order_acq_rel)) {
+                task = begin;
+                return true;
+            }
+        }
+    }
+
+    bool steal(int self, int victim, uint32_t &task) {
+        std::atomic<uint64_t> &range = slots_[size_t(victim)].range;
+        uint64_t r = range.load(std::memory_order_acquire);
+        for (;;) {
+            const uint32_t begin = uint32_t(r), end = uint32_t(r >> 32);
+            if (begin >= end) return false;
+            const uint32_t middle = begin + (end - begin) / 2;
+            if (range.compare_exchange_weak(r, pack(begin, middle), std::memory_order_acq_rel)) {
+                // [middle, end) is ours now: run the first, keep the rest
+                task = middle;
+                slots_[size_t(self)].range.store(pack(middle + 1, end), std::memory_order_release);
+                slots_[size_t(self)].steals++;
+                return true;
+            }
+        }
+    }
+
+    std::vector<Slot> slots_;
+};
+
+// ---- Scanning a buffer or a file ----
+
+struct ScanOptions {
+    int threads = 0;                     // 0: one per core
+    size_t chunk_bytes = size_t(8) << 20;
+    Kernel kernel = bestKernel();
+};
+
+struct ScanResult {
+    Stats stats;
+    std::string error;                   // "" on success
+    double seconds = 0;                  // scanning only (not opening)
+    int threads = 0;
+    std::vector<uint64_t> chunksPerThread, stealsPerThread;
+
+    bool ok() const { return error.empty(); }
+    double gbPerSec() const { return seconds > 0 ? double(stats.bytes) / seconds / 1e9 : 0; }
+};
+
+inline int defaultThreads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? int(n) : 1;
+}
+
+inline ScanResult scanBuffer(const uint8_t *data, size_t size, const ScanOptions &options = ScanOptions()) {
+    ScanResult result;
+    // At least 64 bytes, and under 4 GB so the 32-bit tables can't wrap
+    const size_t chunk = std::min<size_t>(std::max<size_t>(options.chunk_bytes, 64), size_t(1) << 31);
+    const size_t chunks = (size + chunk - 1) / chunk;
+    if (chunks > 0xFFFFFFFFu) {
+        result.error = "too many chunks: make them bigger";
+        return result;
+    }
+    const int threads = std::max(1, std::min(options.threads > 0 ? options.threads : defaultThreads(),
+                                             int(std::max<size_t>(chunks, 1))));
+    result.threads = threads;
+
+    // Histograms per thread, runs per chunk: nothing is written by two threads
+    struct alignas(64) Local {
+        uint64_t histogram[256] = {};
+        uint64_t chunks = 0;
+    };
+    std::vector<Local> locals(static_cast<size_t>(threads));
+    std::vector<Runs> runs(chunks);
+    StealingQueues queues(threads);
+    queues.fill(uint32_t(chunks));
+    auto work = [&](int self) {
+        Local &local = locals[size_t(self)];
+        uint32_t task;
+        while (queues.next(self, task)) {
+            const size_t begin = size_t(task) * chunk, length = std::min(chunk, size - begin);
+            scanChunkWith(options.kernel, data + begin, length, local.histogram, runs[task]);
+            local.chunks++;
+        }
+    };
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; t++) pool.emplace_back(work, t);
+    work(0);
+    for (std::thread &th : pool) th.join();
+
+    Stats &s = result.stats;
+    Runs all;
+    for (const Runs &r : runs) all.append(r);
+    for (int t = 0; t < threads; t++) {
+        for (int b = 0; b < 256; b++) s.histogram[b] += locals[size_t(t)].histogram[b];
+        result.chunksPerThread.push_back(locals[size_t(t)].chunks);
+        result.stealsPerThread.push_back(queues.steals(t));
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    s.bytes = size;
+    s.byteRun = all.byte;
+    s.zeroBits = all.zeros;
+    s.oneBits = all.ones;
+    return result;
+}
+
+// A read-only mapping of a whole file
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    // "" on success
+    std::string open(const std::string &path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return path + ": " + std::strerror(errno);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            std::string error = path + ": " + std::strerror(errno);
+            ::close(fd);
+            return error;
+        }
+        size_ = size_t(st.st_size);
+        if (size_ > 0) {
+            void *map = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                std::string error = std::string("mmap: ") + std::strerror(errno);
+                ::close(fd);
+                size_ = 0;
+                return error;
+            }
+            data_ = static_cast<const uint8_t *>(map);
+        }
+        ::close(fd);
+        return "";
+    }
+
+    void close() {
+        if (data_) ::munmap(const_cast<uint8_t *>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+};
+
+inline ScanResult scanFile(const std::string &path, const ScanOptions &options = ScanOptions()) {
+    MappedFile file;
+    std::string error = file.open(path);
+    if (!error.empty()) {
+        ScanResult r;
+        r.error = error;
+        return r;
+    }
+    return scanBuffer(file.data(), file.size(), options);
+}
+
+// ---- JSON ----
+
+inline std::string toJson(const Stats &s) {
+    char buf[256];
+    std::string out = "{\n";
+    auto field = [&](const char *key, const char *format, auto... values) {
+        out += "  \"";
+        out += key;
+        out += "\": ";
+        snprintf(buf, sizeof buf, format, values...);
+        out += buf;
+        out += ",\n";
+    };
+    auto run = [&](const char *key, const Run &r) {
+        field(key, "{\"length\": %llu, \"offset\": %llu}", (unsigned long long)r.length,
+              (unsigned long long)r.offset);
+    };
+    const AsciiClasses c = s.classes();
+    field("bytes", "%llu", (unsigned long long)s.bytes);
+    field("entropy_bits_per_byte", "%.6f", s.entropy());
+    field("ones", "%llu", (unsigned long long)s.ones());
+    field("bit_density", "%.6f", s.bitDensity());
+    field("ascii", "{\"control\": %llu, \"whitespace\": %llu, \"digits\": %llu, \"upper\": %llu, "
+                   "\"lower\": %llu, \"punctuation\": %llu, \"high\": %llu}",
+          (unsigned long long)c.control, (unsigned long long)c.whitespace, (unsigned long long)c.digits,
+          (unsigned long long)c.upper, (unsigned long long)c.lower, (unsigned long long)c.punctuation,
+          (unsigned long long)c.high);
+    field("longest_byte_run", "{\"value\": %u, \"length\": %llu, \"offset\": %llu}", unsigned(s.byteRun.value),
+          (unsigned long long)s.byteRun.longest.length, (unsigned long long)s.byteRun.longest.offset);
+    run("longest_zero_bits", s.zeroBits.longest);
+    run("longest_one_bits", s.oneBits.longest);
+    out += "  \"histogram\": [";
+    for (int b = 0; b < 256; b++) {
+        snprintf(buf, sizeof buf, "%s%llu", b ? (b % 16 ? ", " : ",\n    ") : "\n    ",
+                 (unsigned long long)s.histogram[b]);
+        out += buf;
+    }
+    out += "\n  ]\n}";
+    return out;
+}
+
+}  // namespace bytestats
+
+#endif  // BYTE_STATS_HPP
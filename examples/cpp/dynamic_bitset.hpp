@@ -0,0 +1,425 @@
+/*
+ * dynamic_bitset.hpp - A Bitset Whose Size Is Picked at Runtime
+ * Like std::bitset<8> from 2_binary_ops.cpp, but for millions of bits.
+ *
+ * std::bitset needs its size when you compile. DynamicBitset gets its
+ * size when the program runs, stores bits in 64-bit words, and does
+ * AND/OR/XOR/NOT a whole word (or 256 bits with AVX2) at a time.
+ *
+ *   DynamicBitset a(1000000), b(1000000);
+ *   a.set(5);
+ *   b.set(5).set(7);
+ *   a &= b;                          // in place
+ *   DynamicBitset c = a | b;         // new bitset
+ *   size_t ones = c.count();         // popcount
+ *   for (size_t bit : c.setBits()) { ... }   // 5, 7
+ *
+ * Bit i lives in word i / 64, at position i % 64 (bit 0 is the lowest).
+ * Unused bits in the last word are always kept at 0.
+ */
+
+#ifndef DYNAMIC_BITSET_HPP
+#define DYNAMIC_BITSET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define DYNAMIC_BITSET_X86 1
+#else
+#define DYNAMIC_BITSET_X86 0
+#endif
+
+namespace bitset_kernels {
+
+enum class Op { And, Or, Xor, AndNot };
+
+// ---- Plain C++: one 64-bit word at a time ----
+
+template <Op op>
+inline uint64_t apply(uint64_t a, uint64_t b) {
+    switch (op) {
+    case Op::And:    return a & b;
+    case Op::Or:     return a | b;
+    case Op::Xor:    return a ^ b;
+    default:         return a & ~b;
+    }
+}
+
+template <Op op>
+inline void combineScalarOp(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words) {
+    for (size_t i = 0; i < words; i++) dst[i] = apply<op>(a[i], b[i]);
+}
+
+// The switch sits outside the loop so each loop is as simple as possible
+inline void combineScalar(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words, Op op) {
+    switch (op) {
+    case Op::And:    combineScalarOp<Op::And>(dst, a, b, words); break;
+    case Op::Or:     combineScalarOp<Op::Or>(dst, a, b, words); break;
+    case Op::Xor:    combineScalarOp<Op::Xor>(dst, a, b, words); break;
+    case Op::AndNot: combineScalarOp<Op::AndNot>(dst, a, b, words); break;
+    }
+}
+
+inline void notScalar(uint64_t *dst, const uint64_t *a, size_t words) {
+    for (size_t i = 0; i < words; i++) dst[i] = ~a[i];
+}
+
+inline size_t popcountScalar(const uint64_t *a, size_t words) {
+    size_t total = 0;
+    for (size_t i = 0; i < words; i++) total += static_cast<size_t>(__builtin_popcountll(a[i]));
+    return total;
+}
+
+#if DYNAMIC_BITSET_X86
+
+// ---- AVX2: four words (256 bits) per instruction ----
+
+template <Op op>
+__attribute__((target("avx2")))
+inline void combineAvx2Op(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words) {
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        __m256i r;
+        switch (op) {
+        case Op::And:    r = _mm256_and_si256(x, y); break;
+        case Op::Or:     r = _mm256_or_si256(x, y); break;
+        case Op::Xor:    r = _mm256_xor_si256(x, y); break;
+        default:         r = _mm256_andnot_si256(y, x); break;  // x & ~y
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), r);
+    }
+    combineScalarOp<op>(dst + i, a + i, b + i, words - i);
+}
+
+inline void combineAvx2(uint64_t *dst, const uint64_t *a, const uint64_t *b, size_t words, Op op) {
+    switch (op) {
+    case Op::And:    combineAvx2Op<Op::And>(dst, a, b, words); break;
+    case Op::Or:     combineAvx2Op<Op::Or>(dst, a, b, words); break;
+    case Op::Xor:    combineAvx2Op<Op::Xor>(dst, a, b, words); break;
+    case Op::AndNot: combineAvx2Op<Op::AndNot>(dst, a, b, words); break;
+    }
+}
+
+__attribute__((target("avx2")))
+inline void notAvx2(uint64_t *dst, const uint64_t *a, size_t words) {
+    const __m256i ones = _mm256_set1_epi64x(-1);
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_xor_si256(x, ones));
+    }
+    notScalar(dst + i, a + i, words - i);
+}
+
+// The POPCNT instruction counts a word's bits in one step
+__attribute__((target("popcnt")))
+inline size_t popcountHardware(const uint64_t *a, size_t words) {
+    uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;  // four counters keep the CPU busy
+    size_t i = 0;
+    for (; i + 4 <= words; i += 4) {
+        c0 += static_cast<uint64_t>(_mm_popcnt_u64(a[i]));
+        c1 += static_cast<uint64_t>(_mm_popcnt_u64(a[i + 1]));
+        c2 += static_cast<uint64_t>(_mm_popcnt_u64(a[i + 2]));
+        c3 += static_cast<uint64_t>(_mm_popcnt_u64(a[i + 3]));
+    }
+    for (; i < words; i++) c0 += static_cast<uint64_t>(_mm_popcnt_u64(a[i]));
+    return static_cast<size_t>(c0 + c1 + c2 + c3);
+}
+
+// AVX2 has no popcount, so look up the count of each 4-bit nibble in a
+// 16-entry table with a shuffle, then add the bytes up with "sad".
+__attribute__((target("avx2,popcnt")))
+inline size_t popcountAvx2(const uint64_t *a, size_t words) {
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    __m256i total = _mm256_setzero_si256();
+    size_t i = 0;
+    while (i + 4 <= words) {
+        // Byte counters can hold up to 255, so add 8 bits * 31 blocks at most
+        __m256i bytes = _mm256_setzero_si256();
+        for (int block = 0; block < 31 && i + 4 <= words; block++, i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+            __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+            __m256i hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+            bytes = _mm256_add_epi8(bytes, _mm256_add_epi8(lo, hi));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(bytes, _mm256_setzero_si256()));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), total);
+    return static_cast<size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]) +
+           popcountHardware(a + i, words - i);
+}
+
+#endif  // DYNAMIC_BITSET_X86
+
+// ---- Pick the best kernels once, when first used ----
+
+struct Kernels {
+    void (*combine)(uint64_t *, const uint64_t *, const uint64_t *, size_t, Op);
+    void (*invert)(uint64_t *, const uint64_t *, size_t);
+    size_t (*popcount)(const uint64_t *, size_t);
+    const char *name;
+};
+
+inline Kernels detectKernels() {
+#if DYNAMIC_BITSET_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        return {combineAvx2, notAvx2, popcountAvx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("popcnt")) {
+        return {combineScalar, notScalar, popcountHardware, "popcnt"};
+    }
+#endif
+    return {combineScalar, notScalar, popcountScalar, "scalar"};
+}
+
+inline const Kernels &kernels() {
+    static const Kernels best = detectKernels();
+    return best;
+}
+
+}  // namespace bitset_kernels
+
+class DynamicBitset {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    static constexpr size_t kWordBits = 64;
+
+    DynamicBitset() = default;
+    explicit DynamicBitset(size_t bits, bool value = false)
+        : bits_(bits), words_(wordCount(bits), value ? ~uint64_t(0) : 0) {
+        clearUnusedBits();
+    }
+
+    // From text like "10110" (first character is the highest bit, like std::bitset)
+    explicit DynamicBitset(const std::string &text) : DynamicBitset(text.size()) {
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[text.size() - 1 - i] == '1') set(i);
+            else if (text[text.size() - 1 - i] != '0') throw std::invalid_argument("DynamicBitset: not a 0 or 1");
+        }
+    }
+
+    size_t size() const { return bits_; }
+    size_t wordCount() const { return words_.size(); }
+    uint64_t *data() { return words_.data(); }
+    const uint64_t *data() const { return words_.data(); }
+
+    void resize(size_t bits, bool value = false) {
+        size_t old_bits = bits_;
+        words_.resize(wordCount(bits), value ? ~uint64_t(0) : 0);
+        bits_ = bits;
+        if (value && bits > old_bits && old_bits % kWordBits) {
+            words_[old_bits / kWordBits] |= ~uint64_t(0) << (old_bits % kWordBits);
+        }
+        clearUnusedBits();
+    }
+
+    // ---- Single bits ----
+
+    bool test(size_t i) const { return (words_[i / kWordBits] >> (i % kWordBits)) & 1; }
+    bool operator[](size_t i) const { return test(i); }
+
+    DynamicBitset &set(size_t i, bool value = true) {
+        uint64_t mask = uint64_t(1) << (i % kWordBits);
+        if (value) words_[i / kWordBits] |= mask;
+        else words_[i / kWordBits] &= ~mask;
+        return *this;
+    }
+    DynamicBitset &reset(size_t i) { return set(i, false); }
+    DynamicBitset &flip(size_t i) {
+        words_[i / kWordBits] ^= uint64_t(1) << (i % kWordBits);
+        return *this;
+    }
+
+    // ---- All bits ----
+
+    DynamicBitset &set() {
+        for (auto &w : words_) w = ~uint64_t(0);
+        clearUnusedBits();
+        return *this;
+    }
+    DynamicBitset &reset() {
+        for (auto &w : words_) w = 0;
+        return *this;
+    }
+    // NOT, in place
+    DynamicBitset &flip() {
+        bitset_kernels::kernels().invert(words_.data(), words_.data(), words_.size());
+        clearUnusedBits();
+        return *this;
+    }
+
+    size_t count() const { return bitset_kernels::kernels().popcount(words_.data(), words_.size()); }
+    bool any() const {
+        for (uint64_t w : words_) if (w) return true;
+        return false;
+    }
+    bool none() const { return !any(); }
+    bool all() const { return count() == bits_; }
+
+    // ---- Logic between bitsets (sizes must match) ----
+
+    DynamicBitset &operator&=(const DynamicBitset &other) { return combine(other, bitset_kernels::Op::And); }
+    DynamicBitset &operator|=(const DynamicBitset &other) { return combine(other, bitset_kernels::Op::Or); }
+    DynamicBitset &operator^=(const DynamicBitset &other) { return combine(other, bitset_kernels::Op::Xor); }
+    // this & ~other: "remove every bit that is set in other"
+    DynamicBitset &andNot(const DynamicBitset &other) { return combine(other, bitset_kernels::Op::AndNot); }
+
+    friend DynamicBitset operator&(const DynamicBitset &a, const DynamicBitset &b) { return combined(a, b, bitset_kernels::Op::And); }
+    friend DynamicBitset operator|(const DynamicBitset &a, const DynamicBitset &b) { return combined(a, b, bitset_kernels::Op::Or); }
+    friend DynamicBitset operator^(const DynamicBitset &a, const DynamicBitset &b) { return combined(a, b, bitset_kernels::Op::Xor); }
+    friend DynamicBitset andNot(const DynamicBitset &a, const DynamicBitset &b) { return combined(a, b, bitset_kernels::Op::AndNot); }
+
+    DynamicBitset operator~() const {
+        DynamicBitset result(bits_);
+        bitset_kernels::kernels().invert(result.words_.data(), words_.data(), words_.size());
+        result.clearUnusedBits();
+        return result;
+    }
+
+    // ---- Shifts (toward higher bit numbers for <<, like std::bitset) ----
+
+    DynamicBitset &operator<<=(size_t n) {
+        if (n >= bits_) return reset();
+        size_t word_shift = n / kWordBits, bit_shift = n % kWordBits;
+        size_t count = words_.size();
+        for (size_t i = count; i-- > word_shift;) {
+            uint64_t w = words_[i - word_shift] << bit_shift;
+            if (bit_shift && i - word_shift > 0) w |= words_[i - word_shift - 1] >> (kWordBits - bit_shift);
+            words_[i] = w;
+        }
+        for (size_t i = 0; i < word_shift; i++) words_[i] = 0;
+        clearUnusedBits();
+        return *this;
+    }
+
+    DynamicBitset &operator>>=(size_t n) {
+        if (n >= bits_) return reset();
+        size_t word_shift = n / kWordBits, bit_shift = n % kWordBits;
+        size_t count = words_.size();
+        for (size_t i = 0; i + word_shift < count; i++) {
+            uint64_t w = words_[i + word_shift] >> bit_shift;
+            if (bit_shift && i + word_shift + 1 < count) w |= words_[i + word_shift + 1] << (kWordBits - bit_shift);
+            words_[i] = w;
+        }
+        for (size_t i = count - word_shift; i < count; i++) words_[i] = 0;
+        return *this;
+    }
+
+    DynamicBitset operator<<(size_t n) const { DynamicBitset r(*this); r <<= n; return r; }
+    DynamicBitset operator>>(size_t n) const { DynamicBitset r(*this); r >>= n; return r; }
+
+    bool operator==(const DynamicBitset &other) const { return bits_ == other.bits_ && words_ == other.words_; }
+    bool operator!=(const DynamicBitset &other) const { return !(*this == other); }
+
+    // ---- Finding set bits ----
+
+    size_t findFirst() const { return findFrom(0); }
+    // First set bit after position i
+    size_t findNext(size_t i) const { return i + 1 >= bits_ ? npos : findFrom(i + 1); }
+
+    // Walks the set bits in increasing order: for (size_t i : bits.setBits())
+    class SetBitIterator {
+    public:
+        SetBitIterator(const uint64_t *words, size_t count, size_t index)
+            : words_(words), count_(count), index_(index), current_(index < count ? words[index] : 0) {
+            skipEmpty();
+        }
+        size_t operator*() const { return index_ * kWordBits + static_cast<size_t>(__builtin_ctzll(current_)); }
+        SetBitIterator &operator++() {
+            current_ &= current_ - 1;  // clear the lowest set bit
+            skipEmpty();
+            return *this;
+        }
+        bool operator!=(const SetBitIterator &other) const {
+            return index_ != other.index_ || current_ != other.current_;
+        }
+
+    private:
+        void skipEmpty() {
+            while (current_ == 0 && index_ < count_) {
+                if (++index_ < count_) current_ = words_[index_];
+            }
+        }
+        const uint64_t *words_;
+        size_t count_;
+        size_t index_;
+        uint64_t current_;
+    };
+
+    struct SetBitRange {
+        const DynamicBitset *bits;
+        SetBitIterator begin() const { return {bits->words_.data(), bits->words_.size(), 0}; }
+        SetBitIterator end() const { return {bits->words_.data(), bits->words_.size(), bits->words_.size()}; }
+    };
+    SetBitRange setBits() const { return {this}; }
+
+    // Calls f(i) for every set bit i (a bit faster than the iterator)
+    template <typename F>
+    void forEachSetBit(F f) const {
+        for (size_t w = 0; w < words_.size(); w++) {
+            for (uint64_t word = words_[w]; word; word &= word - 1) {
+                f(w * kWordBits + static_cast<size_t>(__builtin_ctzll(word)));
+            }
+        }
+    }
+
+    // "10110" - highest bit first, like std::bitset::to_string()
+    std::string toString() const {
+        std::string text(bits_, '0');
+        forEachSetBit([&](size_t i) { text[bits_ - 1 - i] = '1'; });
+        return text;
+    }
+
+    static const char *kernelName() { return bitset_kernels::kernels().name; }
+
+private:
+    static size_t wordCount(size_t bits) { return (bits + kWordBits - 1) / kWordBits; }
+
+    void clearUnusedBits() {
+        if (bits_ % kWordBits) words_.back() &= (uint64_t(1) << (bits_ % kWordBits)) - 1;
+    }
+
+    void checkSize(const DynamicBitset &other) const {
+        if (other.bits_ != bits_) throw std::invalid_argument("DynamicBitset: sizes differ");
+    }
+
+    DynamicBitset &combine(const DynamicBitset &other, bitset_kernels::Op op) {
+        checkSize(other);
+        bitset_kernels::kernels().combine(words_.data(), words_.data(), other.words_.data(), words_.size(), op);
+        return *this;
+    }
+
+    static DynamicBitset combined(const DynamicBitset &a, const DynamicBitset &b, bitset_kernels::Op op) {
+        a.checkSize(b);
+        DynamicBitset result(a.bits_);
+        bitset_kernels::kernels().combine(result.words_.data(), a.words_.data(), b.words_.data(), a.words_.size(), op);
+        return result;
+    }
+
+    size_t findFrom(size_t i) const {
+        size_t w = i / kWordBits;
+        if (w >= words_.size()) return npos;
+        uint64_t word = words_[w] & (~uint64_t(0) << (i % kWordBits));
+        while (word == 0) {
+            if (++w >= words_.size()) return npos;
+            word = words_[w];
+        }
+        return w * kWordBits + static_cast<size_t>(__builtin_ctzll(word));
+    }
+
+    size_t bits_ = 0;
+    std::vector<uint64_t> words_;
+};
+
+#endif  // DYNAMIC_BITSET_HPP
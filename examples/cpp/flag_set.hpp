@@ -0,0 +1,189 @@
+/*
+ * flag_set.hpp - Typed Flags, With a Lock-Free Atomic Version
+ * The FLAG_BOLD / FLAG_ITALIC trick from 2_binary_ops.cpp, made safe.
+ *
+ * Plain ints let you mix up flags from different sets (style | color?).
+ * FlagSet<E> only takes values of one enum, and each enum value is a
+ * bit mask, just like the const ints in 2_binary_ops.cpp:
+ *
+ *   enum class Style : uint8_t { Bold = 1, Italic = 2, Underline = 4 };
+ *
+ *   FlagSet<Style> style;
+ *   style.set(Style::Bold);                     // text_style |= FLAG_BOLD
+ *   style.set({Style::Italic, Style::Underline});
+ *   style.clear(Style::Bold);                   // text_style &= ~FLAG_BOLD
+ *   bool italic = style.test(Style::Italic);
+ *
+ * When many threads change the same flags, "|=" is NOT safe: it is a
+ * load, an OR and a store, and two threads can overwrite each other.
+ * AtomicFlagSet<E> does each change in one atomic instruction, so no
+ * mutex is needed:
+ *
+ *   AtomicFlagSet<State> state;
+ *   state.set(State::Dirty);                    // lock or / fetch_or
+ *   if (state.trySet(State::Closing)) { ... }   // only one thread wins
+ *   state.update(State::Open, State::Opening);  // set one, clear another
+ *
+ * Every atomic method takes an optional std::memory_order. The default
+ * (seq_cst) is always correct; relaxed is fine for flags that guard no
+ * other data, acquire/release when a flag publishes or protects data.
+ */
+
+#ifndef FLAG_SET_HPP
+#define FLAG_SET_HPP
+
+#include <atomic>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+
+template <typename E>
+class FlagSet {
+    static_assert(std::is_enum<E>::value, "FlagSet needs an enum type");
+
+public:
+    // The enum's own integer type, as unsigned so ~ and >> behave
+    using Bits = std::make_unsigned_t<std::underlying_type_t<E>>;
+
+    constexpr FlagSet() = default;
+    constexpr FlagSet(E flag) : bits_(static_cast<Bits>(flag)) {}
+    constexpr FlagSet(std::initializer_list<E> flags) {
+        for (E flag : flags) bits_ |= static_cast<Bits>(flag);
+    }
+    static constexpr FlagSet fromBits(Bits bits) {
+        FlagSet f;
+        f.bits_ = bits;
+        return f;
+    }
+
+    constexpr Bits bits() const { return bits_; }
+
+    FlagSet &set(FlagSet f) { bits_ |= f.bits_; return *this; }
+    FlagSet &clear(FlagSet f) { bits_ &= static_cast<Bits>(~f.bits_); return *this; }
+    FlagSet &toggle(FlagSet f) { bits_ ^= f.bits_; return *this; }
+    FlagSet &reset() { bits_ = 0; return *this; }
+
+    // test: at least one of the flags is on. testAll: every one is on.
+    constexpr bool test(FlagSet f) const { return (bits_ & f.bits_) != 0; }
+    constexpr bool testAll(FlagSet f) const { return (bits_ & f.bits_) == f.bits_; }
+    constexpr bool any() const { return bits_ != 0; }
+    constexpr bool none() const { return bits_ == 0; }
+
+    friend constexpr FlagSet operator|(FlagSet a, FlagSet b) { return fromBits(a.bits_ | b.bits_); }
+    friend constexpr FlagSet operator&(FlagSet a, FlagSet b) { return fromBits(a.bits_ & b.bits_); }
+    friend constexpr FlagSet operator^(FlagSet a, FlagSet b) { return fromBits(a.bits_ ^ b.bits_); }
+    friend constexpr bool operator==(FlagSet a, FlagSet b) { return a.bits_ == b.bits_; }
+    friend constexpr bool operator!=(FlagSet a, FlagSet b) { return a.bits_ != b.bits_; }
+    FlagSet &operator|=(FlagSet f) { return set(f); }
+    FlagSet &operator&=(FlagSet f) { bits_ &= f.bits_; return *this; }
+    FlagSet &operator^=(FlagSet f) { return toggle(f); }
+
+    // Highest bit first, like bitset<8>(text_style) prints it
+    std::string toString() const {
+        std::string text(sizeof(Bits) * 8, '0');
+        for (size_t i = 0; i < text.size(); i++) {
+            if ((bits_ >> i) & 1) text[text.size() - 1 - i] = '1';
+        }
+        return text;
+    }
+
+private:
+    Bits bits_ = 0;
+};
+
+template <typename E>
+class AtomicFlagSet {
+public:
+    using Flags = FlagSet<E>;
+    using Bits = typename Flags::Bits;
+
+    constexpr AtomicFlagSet() = default;
+    constexpr AtomicFlagSet(Flags initial) : bits_(initial.bits()) {}
+
+    // Copying an atomic would not be atomic, so it is not allowed
+    AtomicFlagSet(const AtomicFlagSet &) = delete;
+    AtomicFlagSet &operator=(const AtomicFlagSet &) = delete;
+
+    Flags load(std::memory_order order = std::memory_order_seq_cst) const {
+        return Flags::fromBits(bits_.load(order));
+    }
+    void store(Flags f, std::memory_order order = std::memory_order_seq_cst) {
+        bits_.store(f.bits(), order);
+    }
+    Flags exchange(Flags f, std::memory_order order = std::memory_order_seq_cst) {
+        return Flags::fromBits(bits_.exchange(f.bits(), order));
+    }
+
+    // set/clear/toggle return the flags as they were just before
+    Flags set(Flags f, std::memory_order order = std::memory_order_seq_cst) {
+        return Flags::fromBits(bits_.fetch_or(f.bits(), order));
+    }
+    Flags clear(Flags f, std::memory_order order = std::memory_order_seq_cst) {
+        return Flags::fromBits(bits_.fetch_and(static_cast<Bits>(~f.bits()), order));
+    }
+    Flags toggle(Flags f, std::memory_order order = std::memory_order_seq_cst) {
+        return Flags::fromBits(bits_.fetch_xor(f.bits(), order));
+    }
+
+    bool test(Flags f, std::memory_order order = std::memory_order_seq_cst) const {
+        return load(order).test(f);
+    }
+    bool testAll(Flags f, std::memory_order order = std::memory_order_seq_cst) const {
+        return load(order).testAll(f);
+    }
+
+    // Turn the flags on; true if at least one of them was already on
+    bool testAndSet(Flags f, std::memory_order order = std::memory_order_seq_cst) {
+        return set(f, order).test(f);
+    }
+
+    // Turn ALL the flags on, but only if NONE of them is on yet.
+    // True if this call did it: with many threads, exactly one wins.
+    bool trySet(Flags f, std::memory_order success = std::memory_order_seq_cst,
+                std::memory_order failure = std::memory_order_seq_cst) {
+        Bits old = bits_.load(failure);
+        do {
+            if (old & f.bits()) return false;
+        } while (!bits_.compare_exchange_weak(old, static_cast<Bits>(old | f.bits()), success, failure));
+        return true;
+    }
+
+    // Set some flags and clear others in ONE atomic step (no other
+    // thread ever sees the half-done state). Returns the old flags.
+    Flags update(Flags on, Flags off, std::memory_order order = std::memory_order_seq_cst) {
+        Bits old = bits_.load(std::memory_order_relaxed);
+        Bits next;
+        do {
+            next = static_cast<Bits>((old & ~off.bits()) | on.bits());
+        } while (!bits_.compare_exchange_weak(old, next, order, std::memory_order_relaxed));
+        return Flags::fromBits(old);
+    }
+
+    // If the flags are exactly `expected`, replace them with `desired`.
+    // If not, `expected` is updated to what they really are.
+    bool compareExchange(Flags &expected, Flags desired,
+                         std::memory_order success = std::memory_order_seq_cst,
+                         std::memory_order failure = std::memory_order_seq_cst) {
+        Bits old = expected.bits();
+        bool ok = bits_.compare_exchange_strong(old, desired.bits(), success, failure);
+        expected = Flags::fromBits(old);
+        return ok;
+    }
+    // May fail even when the flags match: use it inside a retry loop
+    bool compareExchangeWeak(Flags &expected, Flags desired,
+                             std::memory_order success = std::memory_order_seq_cst,
+                             std::memory_order failure = std::memory_order_seq_cst) {
+        Bits old = expected.bits();
+        bool ok = bits_.compare_exchange_weak(old, desired.bits(), success, failure);
+        expected = Flags::fromBits(old);
+        return ok;
+    }
+
+    // True when the CPU has real atomic instructions for this size
+    bool isLockFree() const { return bits_.is_lock_free(); }
+
+private:
+    std::atomic<Bits> bits_{0};
+};
+
+#endif  // FLAG_SET_HPP
@@ -0,0 +1,532 @@
+/*
+ * float_format.hpp - The Shortest Text That Gives Back the Same float or double
+ * What 1_data_types.cpp's "pi = 3.14159" should have printed.
+ *
+ * cout shows 6 significant digits, so most values come back different
+ * when the text is read again; "%.17g" always comes back right but prints
+ * 0.10000000000000001 for 0.1. Between the two there is exactly one right
+ * answer: the SHORTEST decimal that reads back as the same bits.
+ *
+ * This header finds it with the Schubfach method (Raffaello Giulietti,
+ * 2020; a relative of Ryu and Grisu):
+ *   - the number is c * 2^q; every decimal in the half-way interval
+ *     around it reads back as the same number,
+ *   - one 128-bit multiply by a power of ten (64-bit for float) scales the
+ *     interval ends and the number itself to about 17 (9) digits,
+ *   - if a number with one digit fewer lies inside the interval it wins;
+ *     otherwise the closest number with all the digits does.
+ * No loops over digits, no big numbers, no allocation: the powers of ten
+ * come from a table that is built once, the first time it is needed.
+ *
+ *   char buf[floatfmt::kMaxDoubleChars];
+ *   floatfmt::Result r = floatfmt::format(buf, buf + sizeof buf, 0.1);
+ *   // r.ptr points past "0.1"; r.ec is std::errc::value_too_large if
+ *   // the buffer is too small (like std::to_chars, no '\0' is written)
+ *
+ *   floatfmt::Decimal d = floatfmt::toDecimal(3.14159f);  // 314159 * 10^-5
+ *   floatfmt::Parts p = floatfmt::breakdown(3.14159f);     // sign, exponent, fraction
+ *   size_t bytes = floatfmt::formatAll(values, n, out);    // one per line
+ *
+ * Style::Shortest writes what std::to_chars(first, last, value) writes:
+ * plain digits (100, 0.001) or scientific (1e+22) whichever is shorter.
+ * Style::Scientific always writes d.ddde+XX.
+ *
+ * Needs unsigned __int128 (g++ or clang++, 64-bit).
+ */
+
+#ifndef FLOAT_FORMAT_HPP
+#define FLOAT_FORMAT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+namespace floatfmt {
+
+// Same shape as std::to_chars_result
+struct Result {
+    char *ptr;
+    std::errc ec;
+};
+
+enum class Style { Shortest, Scientific };
+
+// Longest possible outputs, e.g. "-2.2250738585072014e-308" and "-1.17549435e-38"
+static const size_t kMaxDoubleChars = 24;
+static const size_t kMaxFloatChars = 15;
+
+// ---- The IEEE-754 fields ----
+
+enum class Kind { Zero, Subnormal, Normal, Infinity, NaN };
+
+inline const char *kindName(Kind k) {
+    switch (k) {
+    case Kind::Zero: return "zero";
+    case Kind::Subnormal: return "subnormal";
+    case Kind::Normal: return "normal";
+    case Kind::Infinity: return "infinity";
+    case Kind::NaN: return "NaN";
+    }
+    return "?";
+}
+
+// sign | exponent | fraction, as stored, and the exact value they mean:
+// significand * 2^exponent (for zero, subnormal and normal numbers)
+struct Parts {
+    bool negative;
+    uint32_t biased_exponent;  // the exponent field (8 or 11 bits)
+    uint64_t fraction;         // the fraction field (23 or 52 bits)
+    int exponent_bits;
+    int fraction_bits;
+    Kind kind;
+    uint64_t significand;  // fraction with the hidden leading 1 of normal numbers
+    int exponent;
+};
+
+template <typename T>
+inline Parts breakdown(T value) {
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "float or double");
+    const int fraction_bits = sizeof(T) == 4 ? 23 : 52;
+    const int exponent_bits = sizeof(T) == 4 ? 8 : 11;
+    const uint32_t max_exponent = (1u << exponent_bits) - 1;
+    const int bias = int(max_exponent >> 1) + fraction_bits;
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(T));
+    Parts p;
+    p.negative = (bits >> (fraction_bits + exponent_bits)) & 1;
+    p.biased_exponent = uint32_t(bits >> fraction_bits) & max_exponent;
+    p.fraction = bits & ((uint64_t(1) << fraction_bits) - 1);
+    p.exponent_bits = exponent_bits;
+    p.fraction_bits = fraction_bits;
+    p.significand = p.fraction;
+    p.exponent = 1 - bias;
+    if (p.biased_exponent == max_exponent) {
+        p.kind = p.fraction ? Kind::NaN : Kind::Infinity;
+        p.exponent = 0;
+    } else if (p.biased_exponent != 0) {
+        p.kind = Kind::Normal;
+        p.significand |= uint64_t(1) << fraction_bits;
+        p.exponent = int(p.biased_exponent) - bias;
+    } else {
+        p.kind = p.fraction ? Kind::Subnormal : Kind::Zero;
+    }
+    return p;
+}
+
+// ---- Powers of ten ----
+
+// floor(e * log2(10)), floor(e * log10(2)) and floor(log10(3/4 * 2^e)),
+// with fixed-point constants that are exact in the ranges used here
+inline int floorLog2Pow10(int e) { return (e * 1741647) >> 19; }
+inline int floorLog10Pow2(int e) { return (e * 1262611) >> 22; }
+inline int floorLog10ThreeQuartersPow2(int e) { return (e * 1262611 - 524031) >> 22; }
+
+// 10^e for every e a double needs (-292..324), scaled into [2^127, 2^128)
+// and rounded up unless exact; the float table holds the top 64 bits the
+// same way, for e in -31..45
+struct Pow10Table {
+    static const int kMinDouble = -292, kMaxDouble = 324;
+    static const int kMinFloat = -31, kMaxFloat = 45;
+    uint64_t hi[kMaxDouble - kMinDouble + 1];
+    uint64_t lo[kMaxDouble - kMinDouble + 1];
+    uint64_t f[kMaxFloat - kMinFloat + 1];
+
+    Pow10Table() {
+        // 10^e exactly, for e >= 0
+        std::vector<uint32_t> big{1};
+        for (int e = 0; e <= kMaxDouble; e++) {
+            store(big, e);
+            multiply(big, 10);
+        }
+        // 2^2048 / 10^m, truncated: the error stays far below the 128 bits kept
+        std::vector<uint32_t> frac(65, 0);
+        frac[64] = 1;
+        for (int m = 1; m <= -kMinDouble; m++) {
+            divide(frac, 10);
+            store(frac, -m, true);
+        }
+    }
+
+private:
+    static void multiply(std::vector<uint32_t> &n, uint32_t by) {
+        uint64_t carry = 0;
+        for (uint32_t &limb : n) {
+            uint64_t x = uint64_t(limb) * by + carry;
+            limb = uint32_t(x);
+            carry = x >> 32;
+        }
+        if (carry) n.push_back(uint32_t(carry));
+    }
+
+    static void divide(std::vector<uint32_t> &n, uint32_t by) {
+        uint64_t rest = 0;
+        for (size_t i = n.size(); i-- > 0;) {
+            uint64_t x = (rest << 32) | n[i];
+            n[i] = uint32_t(x / by);
+            rest = x % by;
+        }
+        while (n.size() > 1 && n.back() == 0) n.pop_back();
+    }
+
+    static bool bit(const std::vector<uint32_t> &n, long i) {
+        return i >= 0 && ((n[size_t(i) / 32] >> (i % 32)) & 1);
+    }
+
+    // The top `width` bits of n, plus one if any bit below them is set
+    // (always, for a truncated quotient)
+    static void top(const std::vector<uint32_t> &n, int width, bool inexact, uint64_t *out) {
+        long length = long(n.size()) * 32;
+        while (!bit(n, length - 1)) length--;
+        for (long i = 0; i < length - width; i++) inexact = inexact || bit(n, i);
+        uint64_t word[2] = {0, 0};
+        for (int i = 0; i < width; i++) {
+            if (bit(n, length - 1 - i)) word[i / 64] |= uint64_t(1) << (63 - i % 64);
+        }
+        out[0] = word[0];
+        out[1] = word[1];
+        if (inexact && ++out[width / 64 - 1] == 0 && width == 128) ++out[0];
+    }
+
+    void store(const std::vector<uint32_t> &n, int e, bool inexact = false) {
+        uint64_t window[2];
+        if (e >= kMinDouble) {
+            top(n, 128, inexact, window);
+            hi[e - kMinDouble] = window[0];
+            lo[e - kMinDouble] = window[1];
+        }
+        if (e >= kMinFloat && e <= kMaxFloat) {
+            top(n, 64, inexact, window);
+            f[e - kMinFloat] = window[0];
+        }
+    }
+};
+
+inline const Pow10Table &pow10Table() {
+    static const Pow10Table table;
+    return table;
+}
+
+// floor(g * cp / 2^128) for the 128-bit g, with the lowest bit set if
+// anything was cut off ("round to odd": the cut-off part stays visible)
+inline uint64_t roundToOdd(uint64_t g_hi, uint64_t g_lo, uint64_t cp) {
+    unsigned __int128 x = (unsigned __int128)g_lo * cp;
+    unsigned __int128 y = (unsigned __int128)g_hi * cp;
+    uint64_t y0 = uint64_t(y) + uint64_t(x >> 64);
+    uint64_t y1 = uint64_t(y >> 64) + (y0 < uint64_t(y));
+    return y1 | (y0 > 1);
+}
+
+inline uint32_t roundToOdd(uint64_t g, uint32_t cp) {
+    unsigned __int128 p = (unsigned __int128)g * cp;
+    uint32_t y1 = uint32_t(uint64_t(p >> 64));
+    uint32_t y0 = uint32_t(uint64_t(p) >> 32);
+    return y1 | (y0 > 1);
+}
+
+// ---- Binary to decimal ----
+
+// value = digits * 10^exponent, with no trailing zeros in digits
+struct Decimal {
+    uint64_t digits;
+    int exponent;
+    bool negative;
+};
+
+// Drop trailing zeros, 8, 4, 2 and 1 at a time (0.5 comes out of the
+// scaling as 5000000000000000 * 10^-16)
+inline Decimal trimmed(uint64_t digits, int exponent) {
+    if (digits == 0) return {0, 0, false};
+    while (digits % 100000000 == 0) {
+        digits /= 100000000;
+        exponent += 8;
+    }
+    for (int zeros = 4; zeros >= 1; zeros /= 2) {
+        const uint64_t pow10 = zeros == 4 ? 10000 : zeros == 2 ? 100 : 10;
+        if (digits % pow10 == 0) {
+            digits /= pow10;
+            exponent += zeros;
+        }
+    }
+    return {digits, exponent, false};
+}
+
+// The shortest decimal for a finite nonzero c * 2^q, given as its IEEE
+// fields. Bits/Cp are the integer types (uint64_t for double, uint32_t
+// for float); the scaled values are 4x the real ones, so the interval
+// ends at +-1/2 (or -1/4) unit are whole numbers.
+template <typename Bits, int kFractionBits, int kBias, typename Scale>
+inline Decimal shortest(Bits fraction, uint32_t biased, Scale scale) {
+    Bits c;
+    int q;
+    if (biased != 0) {
+        c = fraction | (Bits(1) << kFractionBits);
+        q = int(biased) - kBias;
+        // A small whole number is its own shortest form
+        if (q <= 0 && q > -kFractionBits - 1 && (c & ((Bits(1) << -q) - 1)) == 0) return trimmed(c >> -q, 0);
+    } else {
+        c = fraction;
+        q = 1 - kBias;
+    }
+    const bool even = (c & 1) == 0;
+    // At a power of two the number below is half as far away
+    const bool closer = fraction == 0 && biased > 1;
+    const Bits cbl = 4 * c - 2 + closer, cb = 4 * c, cbr = 4 * c + 2;
+    const int k = closer ? floorLog10ThreeQuartersPow2(q) : floorLog10Pow2(q);
+    const int h = q + floorLog2Pow10(-k) + 1;
+    const Bits vbl = scale(-k, Bits(cbl << h));
+    const Bits vb = scale(-k, Bits(cb << h));
+    const Bits vbr = scale(-k, Bits(cbr << h));
+    const Bits lower = vbl + !even;  // the interval includes its ends only for even c
+    const Bits upper = vbr - !even;
+
+    // One digit fewer, if exactly one of its two neighbours is inside
+    const Bits s = vb / 4;
+    if (s >= 10) {
+        const Bits sp = s / 10;
+        const bool up_inside = lower <= 40 * sp;
+        const bool wp_inside = 40 * sp + 40 <= upper;
+        if (up_inside != wp_inside) return trimmed(sp + wp_inside, k + 1);
+    }
+    // All the digits: the neighbour inside, or the closer one (ties to even)
+    const bool u_inside = lower <= 4 * s;
+    const bool w_inside = 4 * s + 4 <= upper;
+    if (u_inside != w_inside) return trimmed(s + w_inside, k);
+    const Bits mid = 4 * s + 2;
+    const bool round_up = vb > mid || (vb == mid && (s & 1) != 0);
+    return trimmed(s + round_up, k);
+}
+
+// Shortest decimal of a finite double (zero gives {0, 0})
+inline Decimal toDecimal(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, 8);
+    const uint64_t fraction = bits & ((uint64_t(1) << 52) - 1);
+    const uint32_t biased = uint32_t(bits >> 52) & 0x7FF;
+    Decimal d{0, 0, false};
+    if (fraction != 0 || biased != 0) {
+        const Pow10Table &table = pow10Table();
+        d = shortest<uint64_t, 52, 1075>(fraction, biased, [&](int e, uint64_t cp) {
+            return roundToOdd(table.hi[e - Pow10Table::kMinDouble], table.lo[e - Pow10Table::kMinDouble], cp);
+        });
+    }
+    d.negative = bits >> 63;
+    return d;
+}
+
+inline Decimal toDecimal(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    const uint32_t fraction = bits & ((1u << 23) - 1);
+    const uint32_t biased = (bits >> 23) & 0xFF;
+    Decimal d{0, 0, false};
+    if (fraction != 0 || biased != 0) {
+        const Pow10Table &table = pow10Table();
+        d = shortest<uint32_t, 23, 150>(fraction, biased, [&](int e, uint32_t cp) {
+            return roundToOdd(table.f[e - Pow10Table::kMinFloat], cp);
+        });
+    }
+    d.negative = bits >> 31;
+    return d;
+}
+
+// ---- Decimal to text ----
+
+static const char kDigitPairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+inline int digitCount(uint64_t n) {
+    static const uint64_t kPow10[20] = {1ull,
+                                        10ull,
+                                        100ull,
+                                        1000ull,
+                                        10000ull,
+                                        100000ull,
+                                        1000000ull,
+                                        10000000ull,
+                                        100000000ull,
+                                        1000000000ull,
+                                        10000000000ull,
+                                        100000000000ull,
+                                        1000000000000ull,
+                                        10000000000000ull,
+                                        100000000000000ull,
+                                        1000000000000000ull,
+                                        10000000000000000ull,
+                                        100000000000000000ull,
+                                        1000000000000000000ull,
+                                        10000000000000000000ull};
+    // log10 from log2 (1233/4096 ~ log10(2)), then one correction
+    int t = ((64 - __builtin_clzll(n | 1)) * 1233) >> 12;
+    return t + (t < 20 && n >= kPow10[t]);
+}
+
+// Exactly 8 digits of n < 10^8, leading zeros included: four pairs that
+// don't wait for each other
+inline void write8Digits(char *out, uint32_t n) {
+    const uint32_t high = n / 10000, low = n % 10000;
+    std::memcpy(out, kDigitPairs + (high / 100) * 2, 2);
+    std::memcpy(out + 2, kDigitPairs + (high % 100) * 2, 2);
+    std::memcpy(out + 4, kDigitPairs + (low / 100) * 2, 2);
+    std::memcpy(out + 6, kDigitPairs + (low % 100) * 2, 2);
+}
+
+// Write the digits of n so that the last one lands just before `end`
+inline void writeDigits(char *end, uint64_t n) {
+    while (n >= 100000000) {
+        end -= 8;
+        write8Digits(end, uint32_t(n % 100000000));
+        n /= 100000000;
+    }
+    while (n >= 100) {
+        end -= 2;
+        std::memcpy(end, kDigitPairs + (n % 100) * 2, 2);
+        n /= 100;
+    }
+    if (n >= 10) {
+        std::memcpy(end - 2, kDigitPairs + n * 2, 2);
+    } else {
+        end[-1] = char('0' + n);
+    }
+}
+
+// All the digits of a whole number below 10^38
+inline char *writeWhole(char *out, unsigned __int128 x) {
+    const uint64_t k1e19 = 10000000000000000000ull;
+    if (x < k1e19) {
+        const int n = digitCount(uint64_t(x));
+        writeDigits(out + n, uint64_t(x));
+        return out + n;
+    }
+    out = writeWhole(out, x / k1e19);
+    std::memset(out, '0', 19);
+    writeDigits(out + 19, uint64_t(x % k1e19));
+    return out + 19;
+}
+
+// The text of ±digits * 10^exponent, the shortest form of the number p;
+// out has room for the longest
+inline char *writeDecimal(char *out, const Decimal &d, const Parts &p, Style style) {
+    if (d.negative) *out++ = '-';
+    const int n = digitCount(d.digits);
+    const int sci_exponent = d.exponent + n - 1;
+    const int abs_exponent = sci_exponent < 0 ? -sci_exponent : sci_exponent;
+    const int exponent_digits = abs_exponent >= 100 ? 3 : 2;
+    const int sci_length = n + (n > 1) + 2 + exponent_digits;
+    int plain_length;
+    if (d.exponent >= 0) {
+        plain_length = n + d.exponent;  // 12300
+    } else if (n + d.exponent > 0) {
+        plain_length = n + 1;  // 12.3
+    } else {
+        plain_length = 2 - d.exponent;  // 0.00123
+    }
+
+    if (style == Style::Shortest && plain_length <= sci_length) {
+        if (d.exponent > 0) {
+            // Like printf("%.0f") and std::to_chars, a whole number is written
+            // exactly: 123456789012345680000 is 123456789012345677877
+            unsigned __int128 whole = p.significand;
+            whole = p.exponent >= 0 ? whole << p.exponent : whole >> -p.exponent;
+            return writeWhole(out, whole);
+        } else if (d.exponent == 0) {
+            writeDigits(out + n, d.digits);
+        } else if (n + d.exponent > 0) {
+            // Digits, then move the fraction digits one to the right
+            const int whole = n + d.exponent;
+            writeDigits(out + n, d.digits);
+            std::memmove(out + whole + 1, out + whole, size_t(-d.exponent));
+            out[whole] = '.';
+        } else {
+            const int zeros = -(n + d.exponent);
+            out[0] = '0';
+            out[1] = '.';
+            std::memset(out + 2, '0', size_t(zeros));
+            writeDigits(out + plain_length, d.digits);
+        }
+        return out + plain_length;
+    }
+
+    // d.ddde+XX: the first digit goes one place left, before the point
+    writeDigits(out + 1 + n, d.digits);
+    out[0] = out[1];
+    char *at = out + 1;
+    if (n > 1) {
+        *at = '.';
+        at += n;
+    }
+    *at++ = 'e';
+    *at++ = sci_exponent < 0 ? '-' : '+';
+    if (exponent_digits == 3) {
+        *at++ = char('0' + abs_exponent / 100);
+        std::memcpy(at, kDigitPairs + (abs_exponent % 100) * 2, 2);
+    } else {
+        std::memcpy(at, kDigitPairs + abs_exponent * 2, 2);
+    }
+    return at + 2;
+}
+
+template <typename T>
+inline Result formatAny(char *first, char *last, T value, Style style) {
+    const size_t kMaxChars = sizeof(T) == 4 ? kMaxFloatChars : kMaxDoubleChars;
+    char buf[kMaxDoubleChars];
+    char *end;
+    const Parts p = breakdown(value);
+    if (p.kind == Kind::NaN || p.kind == Kind::Infinity) {
+        end = buf;
+        if (p.negative) *end++ = '-';
+        std::memcpy(end, p.kind == Kind::NaN ? "nan" : "inf", 3);
+        end += 3;
+    } else if (p.kind == Kind::Zero) {
+        end = buf;
+        if (p.negative) *end++ = '-';
+        if (style == Style::Scientific) {
+            std::memcpy(end, "0e+00", 5);
+            end += 5;
+        } else {
+            *end++ = '0';
+        }
+    } else if (last - first >= std::ptrdiff_t(kMaxChars)) {
+        // Room for anything: write straight into the caller's buffer
+        return {writeDecimal(first, toDecimal(value), p, style), std::errc()};
+    } else {
+        end = writeDecimal(buf, toDecimal(value), p, style);
+    }
+    const size_t length = size_t(end - buf);
+    if (size_t(last - first) < length) return {last, std::errc::value_too_large};
+    std::memcpy(first, buf, length);
+    return {first + length, std::errc()};
+}
+
+inline Result format(char *first, char *last, double value, Style style = Style::Shortest) {
+    return formatAny(first, last, value, style);
+}
+
+inline Result format(char *first, char *last, float value, Style style = Style::Shortest) {
+    return formatAny(first, last, value, style);
+}
+
+// ---- Batch mode ----
+
+// Format n values, each followed by `separator`, into out, which must hold
+// n * (kMaxDoubleChars + 1) bytes (kMaxFloatChars + 1 for floats).
+// Returns the number of bytes written.
+template <typename T>
+inline size_t formatAll(const T *values, size_t n, char *out, char separator = '\n',
+                        Style style = Style::Shortest) {
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "float or double");
+    const size_t room = (sizeof(T) == 4 ? kMaxFloatChars : kMaxDoubleChars) + 1;
+    char *p = out;
+    for (size_t i = 0; i < n; i++) {
+        p = formatAny(p, p + room, values[i], style).ptr;
+        *p++ = separator;
+    }
+    return size_t(p - out);
+}
+
+}  // namespace floatfmt
+
+#endif
@@ -0,0 +1,839 @@
+/*
+ * heap_sim.hpp - Simulate a Heap: Where Would malloc Put Everything?
+ * MemoryVisualizer.jsx's bump pointer, replaced by real allocator policies.
+ *
+ * A Heap hands out addresses in a pretend address space [0, capacity)
+ * without touching any memory, so a recorded trace of millions of
+ * malloc/free calls replays in a second or two. Five policies:
+ *
+ *   FirstFitHeap    the free block with the lowest address that fits
+ *   BestFitHeap     the smallest free block that fits
+ *   SegregatedHeap  a free list per size class (like dlmalloc/glibc)
+ *   BuddyHeap       power-of-two blocks that merge with their "buddy"
+ *   SlabHeap        64 KB slabs of equal-size objects, pages for big ones
+ *
+ *   std::unique_ptr<heapsim::Heap> heap = heapsim::makeHeap("best-fit", 64 << 20);
+ *   uint64_t a = heap->allocate(100);      // an address, or kNoAddress if full
+ *   heap->release(a);
+ *   heapsim::HeapStats s = heap->stats();  // utilization, fragmentation...
+ *
+ *   heapsim::Trace trace = heapsim::loadTrace("app.trace");
+ *   heapsim::Replayer(*heap, trace).run();
+ *   heapsim::writeSnapshot(std::cout, *heap);  // JSON for the visualizer
+ *
+ * A trace is text, one call per line ("#" starts a comment):
+ *
+ *   a 7 100     malloc(100), remembered as block 7 (any number, or 0x...)
+ *   r 7 200     realloc block 7 to 200 bytes
+ *   f 7         free block 7
+ *
+ * The first three heaps put an 8-byte header in front of every block and
+ * round blocks to 16 bytes, like glibc, and merge a freed block with free
+ * neighbours at once ("coalescing"). The neighbours are found with
+ * boundary tags: the next block starts where this one ends, and a free
+ * block also records its start at its end, where the next block can find it.
+ */
+
+#ifndef HEAP_SIM_HPP
+#define HEAP_SIM_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace heapsim {
+
+constexpr uint64_t kNoAddress = ~uint64_t(0);
+
+inline int log2Floor(uint64_t v) { return 63 - __builtin_clzll(v); }
+inline int log2Ceil(uint64_t v) { return v <= 1 ? 0 : 64 - __builtin_clzll(v - 1); }
+inline uint64_t roundUp(uint64_t v, uint64_t align) { return (v + align - 1) / align * align; }
+
+// A block in use or a free hole
+struct Span {
+    uint64_t address;
+    uint64_t size;       // bytes it takes, header and rounding included
+    uint64_t requested;  // what the program asked for (0 when free)
+    bool used;
+};
+
+struct HeapStats {
+    // Kept up to date on every call
+    uint64_t allocations = 0;
+    uint64_t frees = 0;
+    uint64_t failures = 0;        // allocations that didn't fit anywhere
+    uint64_t requested = 0;       // bytes asked for by the blocks in use
+    uint64_t allocated = 0;       // bytes those blocks really take
+    uint64_t peak_requested = 0;
+    uint64_t peak_top = 0;        // highest address ever used: the heap this needed
+    // Found by walking the heap (stats() only)
+    uint64_t top = 0;             // end of the highest block in use now
+    uint64_t free_bytes = 0;      // free space below top
+    uint64_t largest_free = 0;    // the biggest free hole below top
+    uint64_t free_blocks = 0;     // free holes below top
+
+    // Most live data / heap it needed (1.0 = not a byte wasted)
+    double utilization() const { return peak_top ? double(peak_requested) / double(peak_top) : 1; }
+    // Share of the blocks in use that is headers and rounding
+    double internalFragmentation() const { return allocated ? 1 - double(requested) / double(allocated) : 0; }
+    // Share of the free space that is NOT in the largest hole: 0 when it is
+    // all in one piece, near 1 when it is scattered in small holes
+    double externalFragmentation() const {
+        return free_bytes ? 1 - double(largest_free) / double(free_bytes) : 0;
+    }
+};
+
+class Heap {
+public:
+    explicit Heap(uint64_t capacity) : capacity_(capacity) {}
+    virtual ~Heap() = default;
+
+    Heap(const Heap &) = delete;
+    Heap &operator=(const Heap &) = delete;
+
+    virtual const char *name() const = 0;
+    uint64_t capacity() const { return capacity_; }
+
+    // The address of `size` bytes (0 counts as 1), or kNoAddress if nothing fits
+    uint64_t allocate(uint64_t size) {
+        if (size == 0) size = 1;
+        uint64_t footprint = 0;
+        uint64_t address = doAllocate(size, footprint);
+        if (address == kNoAddress) {
+            stats_.failures++;
+            return kNoAddress;
+        }
+        stats_.allocations++;
+        stats_.requested += size;
+        stats_.allocated += footprint;
+        stats_.peak_requested = std::max(stats_.peak_requested, stats_.requested);
+        return address;
+    }
+
+    // False (and nothing changes) if `address` isn't a block in use
+    bool release(uint64_t address) {
+        uint64_t requested = 0, footprint = 0;
+        if (!doRelease(address, requested, footprint)) return false;
+        stats_.frees++;
+        stats_.requested -= requested;
+        stats_.allocated -= footprint;
+        return true;
+    }
+
+    // Every block in use and every free hole, in no particular order
+    virtual void walk(const std::function<void(const Span &)> &visit) const = 0;
+
+    // The counters alone: no walk, so cheap enough to call at every step
+    const HeapStats &counters() const { return stats_; }
+
+    HeapStats stats() const {
+        HeapStats s = stats_;
+        std::vector<Span> holes;
+        walk([&](const Span &span) {
+            if (span.used) s.top = std::max(s.top, span.address + span.size);
+            else holes.push_back(span);
+        });
+        for (const Span &hole : holes) {
+            if (hole.address >= s.top) continue;  // the untouched space above
+            s.free_bytes += hole.size;
+            s.largest_free = std::max(s.largest_free, hole.size);
+            s.free_blocks++;
+        }
+        return s;
+    }
+
+protected:
+    // Pick a place and return its address; `footprint` = bytes it takes
+    virtual uint64_t doAllocate(uint64_t size, uint64_t &footprint) = 0;
+    // Give a block back; report what allocate() counted for it
+    virtual bool doRelease(uint64_t address, uint64_t &requested, uint64_t &footprint) = 0;
+
+    void noteTop(uint64_t end) { stats_.peak_top = std::max(stats_.peak_top, end); }
+
+    uint64_t capacity_;
+    HeapStats stats_;
+};
+
+// ==================================================
+// Free lists with coalescing: subclasses only pick the hole
+// ==================================================
+
+class CoalescingHeap : public Heap {
+public:
+    // header: bookkeeping bytes in front of each block; align: blocks are a
+    // multiple of it, and the addresses handed out are aligned to it
+    CoalescingHeap(uint64_t capacity, uint64_t header, uint64_t align)
+        : Heap(capacity),
+          header_(header),
+          align_(align),
+          min_block_(roundUp(header + 16, align)),  // room for two free-list links
+          base_((align - header % align) % align) {}
+
+    uint64_t header() const { return header_; }
+
+    void walk(const std::function<void(const Span &)> &visit) const override {
+        for (const auto &entry : blocks_) {
+            const Block &b = entry.second;
+            visit(Span{entry.first, b.size, b.requested, b.used});
+        }
+    }
+
+protected:
+    struct Block {
+        uint64_t size;
+        uint64_t requested;   // 0 while free
+        uint64_t prev_free;   // free-list links; a real allocator keeps them
+        uint64_t next_free;   // inside the free block itself
+        bool used;
+    };
+
+    // Call once from the subclass constructor: the whole heap is one hole
+    void init() {
+        uint64_t size = (capacity_ - base_) / align_ * align_;
+        blocks_.reserve(1 << 16);
+        footers_.reserve(1 << 16);
+        addHole(base_, size);
+    }
+
+    // Start of a free block of at least `need` bytes, or kNoAddress
+    virtual uint64_t findFree(uint64_t need) = 0;
+    // Keep the subclass's index of free blocks in step
+    virtual void addFree(uint64_t start, Block &block) = 0;
+    virtual void removeFree(uint64_t start, Block &block) = 0;
+
+    Block &blockAt(uint64_t start) { return blocks_.find(start)->second; }
+
+    uint64_t doAllocate(uint64_t size, uint64_t &footprint) override {
+        uint64_t need = std::max(min_block_, roundUp(size + header_, align_));
+        if (need < size) return kNoAddress;  // overflowed: more than the address space
+        uint64_t start = findFree(need);
+        if (start == kNoAddress) return kNoAddress;
+        Block &b = blockAt(start);
+        removeFree(start, b);
+        footers_.erase(start + b.size);
+        uint64_t rest = b.size - need;
+        if (rest >= min_block_) b.size = need;  // split: the rest stays free
+        else rest = 0;                          // too small to be a block: take it all
+        b.used = true;
+        b.requested = size;
+        footprint = b.size;
+        noteTop(start + b.size);
+        if (rest) addHole(start + need, rest);  // (may rehash: b is not used after this)
+        return start + header_;
+    }
+
+    bool doRelease(uint64_t address, uint64_t &requested, uint64_t &footprint) override {
+        uint64_t start = address - header_;
+        auto it = blocks_.find(start);
+        if (it == blocks_.end() || !it->second.used) return false;
+        requested = it->second.requested;
+        footprint = it->second.size;
+        uint64_t size = footprint;
+
+        // The block after: it starts where this one ends
+        auto next = blocks_.find(start + size);
+        if (next != blocks_.end() && !next->second.used) {
+            removeFree(next->first, next->second);
+            footers_.erase(next->first + next->second.size);
+            size += next->second.size;
+            blocks_.erase(next);
+        }
+        // The block before: if it is free, its footer is right before us
+        auto footer = footers_.find(start);
+        if (footer != footers_.end()) {
+            uint64_t prev = footer->second;
+            footers_.erase(footer);
+            auto pit = blocks_.find(prev);
+            removeFree(prev, pit->second);
+            size += pit->second.size;
+            blocks_.erase(it);
+            it = pit;
+            start = prev;
+        }
+        it->second = Block{size, 0, kNoAddress, kNoAddress, false};
+        footers_.emplace(start + size, start);
+        addFree(start, it->second);
+        return true;
+    }
+
+    const uint64_t header_, align_, min_block_;
+    const uint64_t base_;  // the first block starts here, so start + header is aligned
+
+private:
+    void addHole(uint64_t start, uint64_t size) {
+        Block &b = blocks_[start];
+        b = Block{size, 0, kNoAddress, kNoAddress, false};
+        footers_.emplace(start + size, start);
+        addFree(start, b);
+    }
+
+    std::unordered_map<uint64_t, Block> blocks_;      // every block, by start (its "header")
+    std::unordered_map<uint64_t, uint64_t> footers_;  // free blocks: end -> start
+};
+
+// The lowest address that fits. Holes are kept by power-of-two class, in
+// address order: the first hole of every bigger class fits for sure, so
+// only the request's own class has to be searched.
+class FirstFitHeap : public CoalescingHeap {
+public:
+    explicit FirstFitHeap(uint64_t capacity, uint64_t header = 8, uint64_t align = 16)
+        : CoalescingHeap(capacity, header, align) {
+        init();
+    }
+    const char *name() const override { return "first-fit"; }
+
+protected:
+    uint64_t findFree(uint64_t need) override {
+        int c = log2Floor(need);
+        uint64_t best = kNoAddress;
+        for (uint64_t bigger = nonempty_ & ~((uint64_t(2) << c) - 1); bigger; bigger &= bigger - 1) {
+            best = std::min(best, by_class_[__builtin_ctzll(bigger)].begin()->first);
+        }
+        for (const auto &hole : by_class_[c]) {
+            if (hole.first >= best) break;
+            if (hole.second >= need) return hole.first;
+        }
+        return best;
+    }
+    void addFree(uint64_t start, Block &block) override {
+        int c = log2Floor(block.size);
+        by_class_[c].emplace(start, block.size);
+        nonempty_ |= uint64_t(1) << c;
+    }
+    void removeFree(uint64_t start, Block &block) override {
+        int c = log2Floor(block.size);
+        by_class_[c].erase(start);
+        if (by_class_[c].empty()) nonempty_ &= ~(uint64_t(1) << c);
+    }
+
+private:
+    std::map<uint64_t, uint64_t> by_class_[64];  // start -> size
+    uint64_t nonempty_ = 0;                      // bit c: by_class_[c] has holes
+};
+
+// The smallest hole that fits (the lowest address among equal sizes)
+class BestFitHeap : public CoalescingHeap {
+public:
+    explicit BestFitHeap(uint64_t capacity, uint64_t header = 8, uint64_t align = 16)
+        : CoalescingHeap(capacity, header, align) {
+        init();
+    }
+    const char *name() const override { return "best-fit"; }
+
+protected:
+    uint64_t findFree(uint64_t need) override {
+        auto it = holes_.lower_bound({need, 0});
+        return it == holes_.end() ? kNoAddress : it->second;
+    }
+    void addFree(uint64_t start, Block &block) override { holes_.emplace(block.size, start); }
+    void removeFree(uint64_t start, Block &block) override { holes_.erase({block.size, start}); }
+
+private:
+    std::set<std::pair<uint64_t, uint64_t>> holes_;  // (size, start)
+};
+
+// A free list per size class, newest hole first: one list per 16-byte size
+// up to 1 KB, then one per power of two. A small request takes the head of
+// its exact list; a big one looks at a few holes of its class, then takes
+// the head of the next non-empty class (anything there fits).
+class SegregatedHeap : public CoalescingHeap {
+public:
+    explicit SegregatedHeap(uint64_t capacity) : CoalescingHeap(capacity, 8, 16) {
+        std::fill(heads_, heads_ + kClasses, kNoAddress);
+        init();
+    }
+    const char *name() const override { return "segregated"; }
+
+protected:
+    static constexpr int kExact = 63;  // 32, 48, ... 1024 bytes
+    static constexpr int kClasses = 128;
+    static constexpr int kSearch = 32;  // holes looked at in a big request's own class
+
+    static int classOf(uint64_t size) {
+        return size <= 1024 ? int(size / 16) - 2 : std::min(kClasses - 1, kExact + log2Floor(size) - 10);
+    }
+
+    uint64_t findFree(uint64_t need) override {
+        int c = classOf(need);
+        if (c >= kExact) {
+            uint64_t start = heads_[c];
+            for (int i = 0; i < kSearch && start != kNoAddress; i++) {
+                const Block &b = blockAt(start);
+                if (b.size >= need) return start;
+                start = b.next_free;
+            }
+            c++;
+        }
+        // The first non-empty list from class c up
+        for (int w = c / 64; w < 2; w++) {
+            uint64_t bits = nonempty_[w];
+            if (w == c / 64) bits &= ~uint64_t(0) << (c % 64);
+            if (bits) return heads_[w * 64 + __builtin_ctzll(bits)];
+        }
+        return kNoAddress;
+    }
+    void addFree(uint64_t start, Block &block) override {
+        int c = classOf(block.size);
+        block.prev_free = kNoAddress;
+        block.next_free = heads_[c];
+        if (heads_[c] != kNoAddress) blockAt(heads_[c]).prev_free = start;
+        heads_[c] = start;
+        nonempty_[c / 64] |= uint64_t(1) << (c % 64);
+    }
+    void removeFree(uint64_t start, Block &block) override {
+        int c = classOf(block.size);
+        if (block.prev_free != kNoAddress) blockAt(block.prev_free).next_free = block.next_free;
+        else heads_[c] = block.next_free;
+        if (block.next_free != kNoAddress) blockAt(block.next_free).prev_free = block.prev_free;
+        if (heads_[c] == kNoAddress) nonempty_[c / 64] &= ~(uint64_t(1) << (c % 64));
+        (void)start;
+    }
+
+private:
+    uint64_t heads_[kClasses];
+    uint64_t nonempty_[2] = {0, 0};
+};
+
+// ==================================================
+// Buddy allocator
+// ==================================================
+
+// Every block is 2^k bytes at a multiple of 2^k. Splitting one gives two
+// "buddies" whose addresses differ only in bit k, so a freed block finds
+// its buddy with one XOR and merges back up while the buddy is free too.
+// The order of a block in use is kept in a side table (like Linux's struct
+// page), so there is no header - but a 65-byte request takes 128 bytes.
+class BuddyHeap : public Heap {
+public:
+    explicit BuddyHeap(uint64_t capacity, int min_order = 5)
+        : Heap(uint64_t(1) << log2Floor(capacity)), min_order_(min_order), max_order_(log2Floor(capacity)) {
+        live_.reserve(1 << 16);
+        addFree(max_order_, 0);
+    }
+    const char *name() const override { return "buddy"; }
+
+    void walk(const std::function<void(const Span &)> &visit) const override {
+        for (const auto &entry : live_) {
+            visit(Span{entry.first, uint64_t(1) << entry.second.order, entry.second.requested, true});
+        }
+        for (int k = min_order_; k <= max_order_; k++) {
+            for (uint64_t start : free_[k]) visit(Span{start, uint64_t(1) << k, 0, false});
+        }
+    }
+
+protected:
+    uint64_t doAllocate(uint64_t size, uint64_t &footprint) override {
+        int k = std::max(min_order_, log2Ceil(size));
+        if (k > max_order_) return kNoAddress;
+        uint64_t orders = nonempty_ & (~uint64_t(0) << k);
+        if (!orders) return kNoAddress;
+        int j = __builtin_ctzll(orders);
+        uint64_t start = *free_[j].begin();
+        removeFree(j, start);
+        while (j > k) {  // split, keeping the lower half
+            j--;
+            addFree(j, start + (uint64_t(1) << j));
+        }
+        live_.emplace(start, Live{size, k});
+        footprint = uint64_t(1) << k;
+        noteTop(start + footprint);
+        return start;
+    }
+
+    bool doRelease(uint64_t address, uint64_t &requested, uint64_t &footprint) override {
+        auto it = live_.find(address);
+        if (it == live_.end()) return false;
+        requested = it->second.requested;
+        int k = it->second.order;
+        footprint = uint64_t(1) << k;
+        live_.erase(it);
+        for (; k < max_order_; k++) {
+            uint64_t buddy = address ^ (uint64_t(1) << k);
+            if (!free_[k].count(buddy)) break;
+            removeFree(k, buddy);
+            address &= ~(uint64_t(1) << k);
+        }
+        addFree(k, address);
+        return true;
+    }
+
+private:
+    struct Live {
+        uint64_t requested;
+        int order;
+    };
+
+    void addFree(int k, uint64_t start) {
+        free_[k].insert(start);
+        nonempty_ |= uint64_t(1) << k;
+    }
+    void removeFree(int k, uint64_t start) {
+        free_[k].erase(start);
+        if (free_[k].empty()) nonempty_ &= ~(uint64_t(1) << k);
+    }
+
+    int min_order_, max_order_;
+    std::set<uint64_t> free_[64];  // free blocks of 2^k bytes, lowest address first
+    uint64_t nonempty_ = 0;
+    std::unordered_map<uint64_t, Live> live_;
+};
+
+// ==================================================
+// Slab allocator
+// ==================================================
+
+// Objects up to 2 KB are rounded to one of 24 sizes (4 per power of two)
+// and packed into 64 KB slabs holding only that size: no headers, no
+// splitting, and a freed slot is reused by the next object of its size.
+// Bigger objects, and the slabs themselves, come from a first-fit heap of
+// 4 KB pages.
+class SlabHeap : public Heap {
+public:
+    static constexpr uint64_t kSlabBytes = 64 * 1024;
+    static constexpr uint64_t kPage = 4096;
+    static constexpr uint64_t kMaxObject = 2048;
+
+    explicit SlabHeap(uint64_t capacity) : Heap(capacity), pages_(capacity, 0, kPage) {
+        static const uint32_t sizes[] = {16,  32,  48,  64,  80,  96,   112,  128,  160,  192,  224,  256,
+                                         320, 384, 448, 512, 640, 768,  896,  1024, 1280, 1536, 1792, 2048};
+        int c = 0;
+        for (uint64_t units = 0; units <= kMaxObject / 16; units++) {
+            while (sizes[c] < units * 16) c++;
+            class_of_[units] = uint8_t(c);
+        }
+        for (int i = 0; i < kClasses; i++) object_size_[i] = sizes[i];
+        objects_.reserve(1 << 16);
+    }
+    const char *name() const override { return "slab"; }
+
+    void walk(const std::function<void(const Span &)> &visit) const override {
+        for (const auto &entry : objects_) {
+            visit(Span{entry.first, entry.second.footprint, entry.second.requested, true});
+        }
+        for (const auto &entry : slabs_) {  // runs of free slots
+            const Slab &s = entry.second;
+            uint64_t size = object_size_[s.cls];
+            for (uint32_t i = 0; i < s.capacity;) {
+                if (s.isUsed(i)) { i++; continue; }
+                uint32_t j = i;
+                while (j < s.capacity && !s.isUsed(j)) j++;
+                visit(Span{s.address + i * size, (j - i) * size, 0, false});
+                i = j;
+            }
+        }
+        pages_.walk([&](const Span &span) {
+            if (!span.used) visit(span);
+        });
+    }
+
+protected:
+    static constexpr int kClasses = 24;
+
+    struct Slab {
+        uint64_t address;
+        int cls;
+        uint32_t capacity;             // objects that fit
+        uint32_t used = 0;
+        uint32_t hint = 0;             // no free slot in the words before this one
+        std::vector<uint64_t> bits;    // 1 = slot in use
+
+        bool isUsed(uint32_t i) const { return bits[i / 64] >> (i % 64) & 1; }
+    };
+
+    struct Object {
+        uint64_t requested;
+        uint64_t footprint;
+        uint64_t slab;  // kNoAddress: a big object straight from pages_
+    };
+
+    uint64_t doAllocate(uint64_t size, uint64_t &footprint) override {
+        if (size > kMaxObject) {
+            uint64_t address = pages_.allocate(size);
+            if (address == kNoAddress) return kNoAddress;
+            footprint = roundUp(size, kPage);
+            objects_.emplace(address, Object{size, footprint, kNoAddress});
+            noteTop(pages_.counters().peak_top);
+            return address;
+        }
+        int c = class_of_[(size + 15) / 16];
+        if (partial_[c].empty() && !newSlab(c)) return kNoAddress;
+        Slab &s = slabs_.find(*partial_[c].begin())->second;
+        uint32_t w = s.hint;
+        while (s.bits[w] == ~uint64_t(0)) w++;
+        uint32_t slot = w * 64 + uint32_t(__builtin_ctzll(~s.bits[w]));
+        s.bits[w] |= uint64_t(1) << (slot % 64);
+        s.hint = w;
+        if (++s.used == s.capacity) partial_[c].erase(s.address);
+        footprint = object_size_[c];
+        uint64_t address = s.address + slot * footprint;
+        objects_.emplace(address, Object{size, footprint, s.address});
+        return address;
+    }
+
+    bool doRelease(uint64_t address, uint64_t &requested, uint64_t &footprint) override {
+        auto it = objects_.find(address);
+        if (it == objects_.end()) return false;
+        requested = it->second.requested;
+        footprint = it->second.footprint;
+        uint64_t slab = it->second.slab;
+        objects_.erase(it);
+        if (slab == kNoAddress) return pages_.release(address);
+
+        auto sit = slabs_.find(slab);
+        Slab &s = sit->second;
+        uint32_t slot = uint32_t((address - slab) / footprint);
+        s.bits[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+        s.hint = std::min(s.hint, slot / 64);
+        s.used--;
+        partial_[s.cls].insert(slab);
+        // An empty slab goes back to the pages - unless it is the only one
+        // of its size left, which saves making a new one right away
+        if (s.used == 0 && partial_[s.cls].size() > 1) {
+            partial_[s.cls].erase(slab);
+            slabs_.erase(sit);
+            pages_.release(slab);
+        }
+        return true;
+    }
+
+private:
+    bool newSlab(int c) {
+        uint64_t address = pages_.allocate(kSlabBytes);
+        if (address == kNoAddress) return false;
+        noteTop(pages_.counters().peak_top);
+        Slab s;
+        s.address = address;
+        s.cls = c;
+        s.capacity = uint32_t(kSlabBytes / object_size_[c]);
+        s.bits.assign((s.capacity + 63) / 64, 0);
+        if (s.capacity % 64) s.bits.back() = ~uint64_t(0) << (s.capacity % 64);  // past the end: "used"
+        slabs_.emplace(address, std::move(s));
+        partial_[c].insert(address);
+        return true;
+    }
+
+    FirstFitHeap pages_;
+    uint8_t class_of_[kMaxObject / 16 + 1];
+    uint64_t object_size_[kClasses];
+    std::unordered_map<uint64_t, Slab> slabs_;
+    std::set<uint64_t> partial_[kClasses];  // slabs with a free slot, lowest address first
+    std::unordered_map<uint64_t, Object> objects_;
+};
+
+inline const std::vector<std::string> &policyNames() {
+    static const std::vector<std::string> names = {"first-fit", "best-fit", "segregated", "buddy", "slab"};
+    return names;
+}
+
+// One of policyNames(), or nullptr
+inline std::unique_ptr<Heap> makeHeap(const std::string &policy, uint64_t capacity) {
+    if (policy == "first-fit") return std::make_unique<FirstFitHeap>(capacity);
+    if (policy == "best-fit") return std::make_unique<BestFitHeap>(capacity);
+    if (policy == "segregated") return std::make_unique<SegregatedHeap>(capacity);
+    if (policy == "buddy") return std::make_unique<BuddyHeap>(capacity);
+    if (policy == "slab") return std::make_unique<SlabHeap>(capacity);
+    return nullptr;
+}
+
+// ==================================================
+// Traces
+// ==================================================
+
+struct Op {
+    enum Kind : uint8_t { Alloc, Free, Realloc };
+    Kind kind;
+    uint32_t block;  // the trace's block ids, renumbered 0, 1, 2...
+    uint64_t size;
+};
+
+struct Trace {
+    std::vector<Op> ops;
+    uint32_t blocks = 0;     // how many different ids
+    size_t error_line = 0;   // the first line that didn't parse (1-based; 0 = none)
+    std::string error;
+
+    bool ok() const { return error_line == 0 && error.empty(); }
+
+    // For building traces in code: ids are already 0, 1, 2...
+    void alloc(uint32_t block, uint64_t size) { add(Op::Alloc, block, size); }
+    void realloc(uint32_t block, uint64_t size) { add(Op::Realloc, block, size); }
+    void free(uint32_t block) { add(Op::Free, block, 0); }
+
+private:
+    void add(Op::Kind kind, uint32_t block, uint64_t size) {
+        ops.push_back(Op{kind, block, size});
+        blocks = std::max(blocks, block + 1);
+    }
+};
+
+// `text` must end with a '\0' (std::string's does)
+inline Trace parseTrace(const std::string &text) {
+    Trace trace;
+    std::unordered_map<uint64_t, uint32_t> ids;
+    const char *p = text.c_str();
+    for (size_t line = 1; *p; line++) {
+        while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+        char kind = *p;
+        if (kind == 'a' || kind == 'f' || kind == 'r') {
+            while (*p && *p != ' ' && *p != '\t') p++;  // "a" or "alloc", "f" or "free"...
+            char *end;
+            uint64_t id = strtoull(p, &end, 0);
+            uint64_t size = 0;
+            bool ok = end != p;
+            if (ok && kind != 'f') {
+                p = end;
+                size = strtoull(p, &end, 0);
+                ok = end != p;
+            }
+            if (!ok) {
+                trace.error_line = line;
+                trace.error = "expected \"a id size\", \"r id size\" or \"f id\"";
+                return trace;
+            }
+            uint32_t block = ids.emplace(id, uint32_t(ids.size())).first->second;
+            trace.ops.push_back(Op{kind == 'a' ? Op::Alloc : kind == 'f' ? Op::Free : Op::Realloc, block, size});
+            p = end;
+            while (*p == ' ' || *p == '\t' || *p == '\r') p++;
+        } else if (kind != '#' && kind != '\n' && kind != '\0') {
+            trace.error_line = line;
+            trace.error = "unknown operation";
+            return trace;
+        }
+        if (kind != '#' && *p && *p != '\n' && *p != '#') {
+            trace.error_line = line;
+            trace.error = "extra text at the end of the line";
+            return trace;
+        }
+        while (*p && *p != '\n') p++;
+        if (*p) p++;
+    }
+    trace.blocks = uint32_t(ids.size());
+    return trace;
+}
+
+inline Trace loadTrace(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        Trace trace;
+        trace.error = "can't open " + path;
+        return trace;
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    return parseTrace(text.str());
+}
+
+inline void saveTrace(std::ostream &out, const Trace &trace) {
+    for (const Op &op : trace.ops) {
+        if (op.kind == Op::Free) out << "f " << op.block << "\n";
+        else out << (op.kind == Op::Alloc ? "a " : "r ") << op.block << " " << op.size << "\n";
+    }
+}
+
+// Plays a trace against a heap, all at once or a few steps at a time
+// (to look at the heap in between). Like the real calls: realloc moves the
+// block (allocate, then free the old one) and keeps the old block if that
+// fails; freeing a block whose allocation failed does nothing.
+class Replayer {
+public:
+    Replayer(Heap &heap, const Trace &trace) : heap_(heap), trace_(trace), address_(trace.blocks, kNoAddress) {}
+
+    // Replay up to `count` more operations; false once the trace is done
+    bool step(size_t count) {
+        size_t end = std::min(trace_.ops.size(), position_ + std::min(count, trace_.ops.size()));
+        for (; position_ < end; position_++) {
+            const Op &op = trace_.ops[position_];
+            uint64_t &address = address_[op.block];
+            switch (op.kind) {
+            case Op::Alloc:
+                if (live(address)) bad_ops_++;  // the old block is leaked, as the program did
+                address = orFailed(heap_.allocate(op.size));
+                break;
+            case Op::Realloc: {
+                uint64_t moved = heap_.allocate(op.size);
+                if (moved == kNoAddress) break;
+                if (live(address)) heap_.release(address);
+                address = moved;
+                break;
+            }
+            case Op::Free:
+                if (live(address)) heap_.release(address);
+                else if (address != kFailed) bad_ops_++;
+                address = kNoAddress;
+                break;
+            }
+        }
+        return position_ < trace_.ops.size();
+    }
+    void run() { step(trace_.ops.size()); }
+
+    size_t position() const { return position_; }
+    bool done() const { return position_ == trace_.ops.size(); }
+    // Frees of blocks that aren't allocated, allocations of ids in use
+    uint64_t badOps() const { return bad_ops_; }
+
+private:
+    static constexpr uint64_t kFailed = kNoAddress - 1;
+    static bool live(uint64_t address) { return address < kFailed; }
+    static uint64_t orFailed(uint64_t address) { return address == kNoAddress ? kFailed : address; }
+
+    Heap &heap_;
+    const Trace &trace_;
+    std::vector<uint64_t> address_;  // per block id
+    size_t position_ = 0;
+    uint64_t bad_ops_ = 0;
+};
+
+// ==================================================
+// Snapshots
+// ==================================================
+
+// The heap as JSON: the stats, then every block and hole in address order
+// as {name, value, type, address, size} - the fields MemoryVisualizer.jsx
+// shows ("type" is "used" or "free"). Stops after max_spans entries.
+inline void writeSnapshot(std::ostream &out, const Heap &heap, size_t max_spans = 100000) {
+    std::vector<Span> spans;
+    heap.walk([&](const Span &span) { spans.push_back(span); });
+    std::sort(spans.begin(), spans.end(), [](const Span &a, const Span &b) { return a.address < b.address; });
+    HeapStats s = heap.stats();
+    out << "{\n  \"policy\": \"" << heap.name() << "\",\n  \"capacity\": " << heap.capacity() << ",\n";
+    out << "  \"stats\": {\"allocations\": " << s.allocations << ", \"frees\": " << s.frees
+        << ", \"failures\": " << s.failures << ", \"requested\": " << s.requested << ", \"allocated\": " << s.allocated
+        << ", \"peak_requested\": " << s.peak_requested << ", \"peak_top\": " << s.peak_top << ", \"top\": " << s.top
+        << ", \"free_bytes\": " << s.free_bytes << ", \"largest_free\": " << s.largest_free
+        << ", \"free_blocks\": " << s.free_blocks << ", \"utilization\": " << s.utilization()
+        << ", \"internal_fragmentation\": " << s.internalFragmentation()
+        << ", \"external_fragmentation\": " << s.externalFragmentation() << "},\n";
+    out << "  \"truncated\": " << (spans.size() > max_spans ? "true" : "false") << ",\n  \"variables\": [";
+    char address[24];
+    for (size_t i = 0; i < spans.size() && i < max_spans; i++) {
+        const Span &span = spans[i];
+        snprintf(address, sizeof(address), "0x%llX", (unsigned long long)span.address);
+        out << (i ? ",\n    " : "\n    ");
+        if (span.used) {
+            out << "{\"name\": \"block " << i << "\", \"value\": \"" << span.requested
+                << " bytes requested\", \"type\": \"used\"";
+        } else {
+            out << "{\"name\": \"free\", \"value\": \"" << span.size << " bytes free\", \"type\": \"free\"";
+        }
+        out << ", \"address\": \"" << address << "\", \"size\": " << span.size << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+}  // namespace heapsim
+
+#endif  // HEAP_SIM_HPP
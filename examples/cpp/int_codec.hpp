@@ -0,0 +1,549 @@
+/*
+ * int_codec.hpp - Storing Small Integers in Fewer Bytes
+ * 1_data_types.cpp gives every int 4 bytes; most stored ints need 1 or 2.
+ *
+ * Four ways to spend only the bits a value needs:
+ *
+ *   varint (LEB128)  7 bits per byte, high bit = "more bytes follow":
+ *                    300 = 0b1_0010_1100 -> AC 02 (2 bytes, not 4)
+ *   zigzag           signed to unsigned so small negatives stay small:
+ *                    0, -1, 1, -2, 2 ... -> 0, 1, 2, 3, 4 ...
+ *   frame of         blocks of 128: store the block's minimum once, then
+ *   reference (FOR)  every value minus it in just enough bits for the
+ *                    largest (bit width 0 to 32), packed end to end
+ *   delta            sorted values become the gaps between them, and
+ *                    small gaps pack into a few bits each
+ *
+ * Packed blocks use four 32-bit lanes: value 4j + l lives in lane l, so
+ * one SSE instruction shifts, masks or adds four values at once, and four
+ * decoded values are four neighbours in the output. Varints decode 16
+ * bytes per step: one table lookup on their "more bytes" bits gives a
+ * byte shuffle that lines up the next 4 to 16 values (the method of
+ * Masked VByte, Plaisance, Kurz & Lemire).
+ *
+ *   std::vector<uint8_t> bytes(intcodec::maxPackedBytes(n));
+ *   size_t used = intcodec::packDelta(sorted, n, bytes.data());
+ *   const uint8_t *end = intcodec::unpackDelta(bytes.data(), bytes.data() + used, out, n);
+ *   if (!end) ...                        // cut short or not our format
+ *
+ *   uint8_t *p = intcodec::putVarint(buffer, 300);           // 2 bytes
+ *   uint32_t u = intcodec::zigzagEncode(int32_t(-3));         // 5
+ *
+ * A packed stream (packFor / packDelta), for n values:
+ *   n / 128 blocks:  base (varint), bit width (1 byte), 16 x width bytes
+ *   n % 128 values:  varints (minus the last value, for delta)
+ * The count is not stored: like a raw array, the caller keeps n.
+ * Any values round-trip with delta (gaps wrap around modulo 2^32), but
+ * only sorted ones shrink.
+ */
+
+#ifndef INT_CODEC_HPP
+#define INT_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define INT_CODEC_X86 1
+#else
+#define INT_CODEC_X86 0
+#endif
+
+namespace intcodec {
+
+enum class Kernel { Scalar, Sse41 };
+
+inline const char *kernelName(Kernel k) {
+    return k == Kernel::Sse41 ? "sse4.1" : "scalar";
+}
+
+constexpr size_t kBlock = 128;
+
+// ---- Zigzag ----
+
+inline uint32_t zigzagEncode(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+inline uint64_t zigzagEncode(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+inline int32_t zigzagDecode(uint32_t u) { return int32_t((u >> 1) ^ (0u - (u & 1))); }
+inline int64_t zigzagDecode(uint64_t u) { return int64_t((u >> 1) ^ (0ull - (u & 1))); }
+
+inline void zigzagEncode(const int32_t *values, size_t n, uint32_t *out) {
+    for (size_t i = 0; i < n; i++) out[i] = zigzagEncode(values[i]);
+}
+
+inline void zigzagDecode(const uint32_t *values, size_t n, int32_t *out) {
+    for (size_t i = 0; i < n; i++) out[i] = zigzagDecode(values[i]);
+}
+
+// ---- One varint ----
+
+inline size_t varintLength(uint64_t v) {
+    size_t bytes = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        bytes++;
+    }
+    return bytes;
+}
+
+// Writes 1 to 10 bytes; returns just past them
+inline uint8_t *putVarint(uint8_t *out, uint64_t v) {
+    while (v >= 0x80) {
+        *out++ = uint8_t(v | 0x80);
+        v >>= 7;
+    }
+    *out++ = uint8_t(v);
+    return out;
+}
+
+// Returns just past the varint, or nullptr if it runs past `end` or
+// past 64 bits
+inline const uint8_t *getVarint(const uint8_t *in, const uint8_t *end, uint64_t &value) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        if (shift == 63 && byte > 1) return nullptr;
+        v |= uint64_t(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            value = v;
+            return in;
+        }
+    }
+    return nullptr;
+}
+
+namespace detail {
+
+inline const uint8_t *getVarint32(const uint8_t *in, const uint8_t *end, uint32_t &value) {
+    uint64_t v;
+    in = getVarint(in, end, v);
+    if (!in || v > 0xFFFFFFFFu) return nullptr;
+    value = uint32_t(v);
+    return in;
+}
+
+inline int bitsNeeded(uint32_t v) { return v ? 32 - __builtin_clz(v) : 0; }
+
+constexpr uint32_t lowMask(int bits) { return bits >= 32 ? ~0u : (1u << bits) - 1; }
+
+// Packed words sit at any byte offset
+inline uint32_t loadWord(const uint8_t *p) {
+    uint32_t w;
+    memcpy(&w, p, 4);
+    return w;
+}
+
+inline void storeWord(uint8_t *p, uint32_t w) { memcpy(p, &w, 4); }
+
+// ---- Packing one block of 128, plain loops ----
+
+// Lane l keeps values l, l+4, l+8 ... as one stream of `bits`-bit fields;
+// word k of lane l is word 4k + l of the output
+template <int B>
+void packScalar(const uint32_t *in, uint32_t base, uint8_t *out) {
+    constexpr uint32_t mask = lowMask(B);
+    for (int lane = 0; lane < 4; lane++) {
+        uint32_t word = 0;
+        int k = 0;
+        for (int j = 0; j < 32; j++) {
+            const int shift = (j * B) & 31;
+            const uint32_t v = (in[4 * j + lane] - base) & mask;
+            word |= v << shift;
+            if (shift + B >= 32) {
+                storeWord(out + 4 * (4 * k++ + lane), word);
+                word = shift + B > 32 ? uint32_t(uint64_t(v) >> (32 - shift)) : 0;
+            }
+        }
+    }
+}
+
+// `last` is the value before the block (delta) and becomes its last value
+template <int B, bool Delta>
+void unpackScalar(const uint8_t *in, uint32_t base, uint32_t *out, uint32_t &last) {
+    if constexpr (B == 0) {
+        // No payload at all (`in` may be the end of the buffer): every value is the base
+        for (size_t i = 0; i < kBlock; i++) out[i] = Delta ? last += base : base;
+        return;
+    }
+    constexpr uint32_t mask = lowMask(B);
+    for (int lane = 0; lane < 4; lane++) {
+        for (int j = 0; j < 32; j++) {
+            const int bit = j * B, k = bit >> 5, shift = bit & 31;
+            uint32_t v = loadWord(in + 4 * (4 * k + lane)) >> shift;
+            if (shift + B > 32) v |= uint32_t(uint64_t(loadWord(in + 4 * (4 * (k + 1) + lane))) << (32 - shift));
+            out[4 * j + lane] = (v & mask) + base;
+        }
+    }
+    if (Delta) {
+        for (size_t i = 0; i < kBlock; i++) out[i] = last += out[i];
+    }
+}
+
+#if INT_CODEC_X86
+
+// ---- SSE4.1: four lanes per instruction ----
+
+#define INT_CODEC_SIMD __attribute__((target("sse4.1"), always_inline)) inline
+
+INT_CODEC_SIMD __m128i load4(const void *p) { return _mm_loadu_si128(static_cast<const __m128i *>(p)); }
+INT_CODEC_SIMD void store4(void *p, __m128i v) { _mm_storeu_si128(static_cast<__m128i *>(p), v); }
+
+template <int B>
+__attribute__((target("sse4.1"))) void packSse41(const uint32_t *in, uint32_t base, uint8_t *out) {
+    const __m128i mask = _mm_set1_epi32(int(lowMask(B))), bases = _mm_set1_epi32(int(base));
+    __m128i word = _mm_setzero_si128();
+    int k = 0;
+#pragma GCC unroll 32
+    for (int j = 0; j < 32; j++) {
+        const int shift = (j * B) & 31;
+        const __m128i v = _mm_and_si128(_mm_sub_epi32(load4(in + 4 * j), bases), mask);
+        word = _mm_or_si128(word, _mm_slli_epi32(v, shift));
+        if (shift + B >= 32) {
+            store4(out + 16 * k++, word);
+            word = shift + B > 32 ? _mm_srli_epi32(v, 32 - shift) : _mm_setzero_si128();
+        }
+    }
+}
+
+template <int B, bool Delta>
+__attribute__((target("sse4.1"))) void unpackSse41(const uint8_t *in, uint32_t base, uint32_t *out,
+                                                    uint32_t &last) {
+    const __m128i mask = _mm_set1_epi32(int(lowMask(B))), bases = _mm_set1_epi32(int(base));
+    __m128i word = B ? load4(in) : _mm_setzero_si128(), previous = _mm_set1_epi32(int(last));
+    int k = 0;
+#pragma GCC unroll 32
+    for (int j = 0; j < 32; j++) {
+        const int shift = (j * B) & 31;
+        __m128i v = _mm_srli_epi32(word, shift);
+        if (shift + B > 32) {
+            word = load4(in + 16 * ++k);
+            v = _mm_or_si128(v, _mm_slli_epi32(word, 32 - shift));
+        } else if (shift + B == 32 && j < 31) {
+            word = load4(in + 16 * ++k);
+        }
+        v = _mm_add_epi32(_mm_and_si128(v, mask), bases);
+        if (Delta) {
+            // Running sum of four gaps, plus the value before them
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi32(v, previous);
+            previous = _mm_shuffle_epi32(v, 0xFF);
+        }
+        store4(out + 4 * j, v);
+    }
+    if (Delta) last = uint32_t(_mm_cvtsi128_si32(previous));
+}
+
+#endif  // INT_CODEC_X86
+
+// One packing and one unpacking function per bit width, picked at run time
+using PackFn = void (*)(const uint32_t *, uint32_t, uint8_t *);
+using UnpackFn = void (*)(const uint8_t *, uint32_t, uint32_t *, uint32_t &);
+
+struct BlockKernels {
+    PackFn pack[33];
+    UnpackFn unpack[33], unpackDelta[33];
+};
+
+template <size_t... B>
+constexpr BlockKernels scalarKernels(std::index_sequence<B...>) {
+    return {{&packScalar<int(B)>...}, {&unpackScalar<int(B), false>...}, {&unpackScalar<int(B), true>...}};
+}
+
+#if INT_CODEC_X86
+template <size_t... B>
+constexpr BlockKernels sse41Kernels(std::index_sequence<B...>) {
+    return {{&packSse41<int(B)>...}, {&unpackSse41<int(B), false>...}, {&unpackSse41<int(B), true>...}};
+}
+#endif
+
+inline const BlockKernels &blockKernels(Kernel k) {
+    static constexpr BlockKernels scalar = scalarKernels(std::make_index_sequence<33>());
+#if INT_CODEC_X86
+    static constexpr BlockKernels sse41 = sse41Kernels(std::make_index_sequence<33>());
+    if (k == Kernel::Sse41) return sse41;
+#else
+    (void)k;
+#endif
+    return scalar;
+}
+
+// ---- Varints, 16 bytes at a time ----
+
+#if INT_CODEC_X86
+
+// What to do with 16 bytes whose first 12 have these "more bytes" bits:
+// gather the next `count` values (each at most 2 bytes into 16-bit lanes,
+// or at most 4 bytes into 32-bit lanes) with one shuffle
+struct VarintShape {
+    uint8_t shuffle[16];
+    uint8_t count;     // values decoded (0: let the plain loop do one)
+    uint8_t consumed;  // bytes they took
+    uint8_t wide;      // 32-bit lanes instead of 16-bit
+};
+
+struct VarintShapes {
+    VarintShape shape[1 << 12];
+
+    VarintShapes() {
+        for (unsigned mask = 0; mask < (1u << 12); mask++) {
+            // Lengths of the values that end inside the 12 bytes
+            int lengths[12], values = 0;
+            for (int pos = 0; pos < 12;) {
+                int length = 1;
+                while (pos + length - 1 < 12 && (mask >> (pos + length - 1) & 1)) length++;
+                if (pos + length > 12) break;
+                lengths[values++] = length;
+                pos += length;
+            }
+            int narrow = 0, wide = 0;
+            while (narrow < values && narrow < 8 && lengths[narrow] <= 2) narrow++;
+            while (wide < values && wide < 4 && lengths[wide] <= 4) wide++;
+
+            VarintShape &s = shape[mask];
+            memset(s.shuffle, 0x80, sizeof s.shuffle);  // 0x80: shuffle in a zero
+            s.wide = wide > narrow;
+            s.count = uint8_t(s.wide ? wide : narrow);
+            const int lane_bytes = s.wide ? 4 : 2;
+            int pos = 0;
+            for (int i = 0; i < s.count; i++) {
+                for (int b = 0; b < lengths[i]; b++) s.shuffle[lane_bytes * i + b] = uint8_t(pos + b);
+                pos += lengths[i];
+            }
+            s.consumed = uint8_t(pos);
+        }
+    }
+};
+
+inline const VarintShapes &varintShapes() {
+    static const VarintShapes shapes;
+    return shapes;
+}
+
+__attribute__((target("sse4.1"))) inline const uint8_t *decodeVarintsSse41(const uint8_t *in, const uint8_t *end,
+                                                                          uint32_t *out, size_t n) {
+    const VarintShapes &shapes = varintShapes();
+    const __m128i low7 = _mm_set1_epi32(0x7F);
+    size_t i = 0;
+    while (n - i >= 16 && end - in >= 16) {
+        const __m128i bytes = load4(in);
+        const unsigned more = unsigned(_mm_movemask_epi8(bytes));
+        if (more == 0) {  // 16 one-byte values
+            store4(out + i, _mm_cvtepu8_epi32(bytes));
+            store4(out + i + 4, _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4)));
+            store4(out + i + 8, _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+            store4(out + i + 12, _mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12)));
+            in += 16;
+            i += 16;
+            continue;
+        }
+        const VarintShape &s = shapes.shape[more & 0xFFF];
+        if (s.count == 0) {  // a 5-byte value (or a bad one)
+            in = getVarint32(in, end, out[i]);
+            if (!in) return nullptr;
+            i++;
+            continue;
+        }
+        const __m128i v = _mm_shuffle_epi8(bytes, load4(s.shuffle));
+        if (s.wide) {
+            // Four lanes of up to 4 bytes: drop each byte's top bit
+            __m128i r = _mm_and_si128(v, low7);
+            r = _mm_or_si128(r, _mm_and_si128(_mm_srli_epi32(v, 1), _mm_slli_epi32(low7, 7)));
+            r = _mm_or_si128(r, _mm_and_si128(_mm_srli_epi32(v, 2), _mm_slli_epi32(low7, 14)));
+            r = _mm_or_si128(r, _mm_and_si128(_mm_srli_epi32(v, 3), _mm_slli_epi32(low7, 21)));
+            store4(out + i, r);
+        } else {
+            // Eight lanes of up to 2 bytes
+            __m128i r = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi16(0x7F)),
+                                     _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi16(0x3F80)));
+            store4(out + i, _mm_cvtepu16_epi32(r));
+            store4(out + i + 4, _mm_cvtepu16_epi32(_mm_srli_si128(r, 8)));
+        }
+        in += s.consumed;
+        i += s.count;
+    }
+    for (; i < n; i++) {
+        in = getVarint32(in, end, out[i]);
+        if (!in) return nullptr;
+    }
+    return in;
+}
+
+// Values below 128 are single bytes: narrow 16 of them at once
+__attribute__((target("sse4.1"))) inline size_t encodeVarintsSse41(const uint32_t *values, size_t n,
+                                                                  uint8_t *out) {
+    uint8_t *start = out;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i a = load4(values + i), b = load4(values + i + 4);
+        const __m128i c = load4(values + i + 8), d = load4(values + i + 12);
+        const __m128i all = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+        if (_mm_testz_si128(all, _mm_set1_epi32(~0x7F))) {
+            store4(out, _mm_packus_epi16(_mm_packus_epi32(a, b), _mm_packus_epi32(c, d)));
+            out += 16;
+        } else {
+            for (size_t k = i; k < i + 16; k++) out = putVarint(out, values[k]);
+        }
+    }
+    for (; i < n; i++) out = putVarint(out, values[i]);
+    return size_t(out - start);
+}
+
+#undef INT_CODEC_SIMD
+
+#endif  // INT_CODEC_X86
+
+}  // namespace detail
+
+// ---- Pick the best kernel once, when first used ----
+
+inline Kernel detectKernel() {
+#if INT_CODEC_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) return Kernel::Sse41;
+#endif
+    return Kernel::Scalar;
+}
+
+inline Kernel bestKernel() {
+    static const Kernel best = detectKernel();
+    return best;
+}
+
+// ---- Arrays of varints ----
+
+constexpr size_t maxVarintBytes(size_t n) { return 5 * n; }
+
+// Returns the bytes written (at most maxVarintBytes(n))
+inline size_t encodeVarintsWith(Kernel k, const uint32_t *values, size_t n, uint8_t *out) {
+#if INT_CODEC_X86
+    if (k == Kernel::Sse41) return detail::encodeVarintsSse41(values, n, out);
+#else
+    (void)k;
+#endif
+    uint8_t *p = out;
+    for (size_t i = 0; i < n; i++) p = putVarint(p, values[i]);
+    return size_t(p - out);
+}
+
+// Reads n values; returns just past them, or nullptr if the bytes run
+// out or one is not a 32-bit varint
+inline const uint8_t *decodeVarintsWith(Kernel k, const uint8_t *in, const uint8_t *end, uint32_t *out,
+                                        size_t n) {
+#if INT_CODEC_X86
+    if (k == Kernel::Sse41) return detail::decodeVarintsSse41(in, end, out, n);
+#else
+    (void)k;
+#endif
+    for (size_t i = 0; i < n && in; i++) in = detail::getVarint32(in, end, out[i]);
+    return in;
+}
+
+inline size_t encodeVarints(const uint32_t *values, size_t n, uint8_t *out) {
+    return encodeVarintsWith(bestKernel(), values, n, out);
+}
+
+inline const uint8_t *decodeVarints(const uint8_t *in, const uint8_t *end, uint32_t *out, size_t n) {
+    return decodeVarintsWith(bestKernel(), in, end, out, n);
+}
+
+// ---- Packed blocks of 128 ----
+
+constexpr size_t maxPackedBytes(size_t n) { return n / kBlock * (5 + 1 + 4 * kBlock) + n % kBlock * 5; }
+
+namespace detail {
+
+inline size_t packBlocks(Kernel k, const uint32_t *values, size_t n, uint8_t *out, bool delta) {
+    const BlockKernels &kernels = blockKernels(k);
+    uint8_t *p = out;
+    uint32_t last = 0, gaps[kBlock];
+    size_t i = 0;
+    for (; i + kBlock <= n; i += kBlock) {
+        const uint32_t *block = values + i;
+        if (delta) {
+            for (size_t j = 0; j < kBlock; j++) gaps[j] = values[i + j] - (j ? values[i + j - 1] : last);
+            last = values[i + kBlock - 1];
+            block = gaps;
+        }
+        uint32_t low = block[0], high = block[0];
+        for (size_t j = 1; j < kBlock; j++) {
+            low = block[j] < low ? block[j] : low;
+            high = block[j] > high ? block[j] : high;
+        }
+        const int bits = bitsNeeded(high - low);
+        p = putVarint(p, low);
+        *p++ = uint8_t(bits);
+        kernels.pack[bits](block, low, p);
+        p += size_t(bits) * 16;
+    }
+    for (; i < n; i++) {
+        p = putVarint(p, delta ? values[i] - last : values[i]);
+        last = values[i];
+    }
+    return size_t(p - out);
+}
+
+inline const uint8_t *unpackBlocks(Kernel k, const uint8_t *in, const uint8_t *end, uint32_t *out, size_t n,
+                                   bool delta) {
+    const BlockKernels &kernels = blockKernels(k);
+    const UnpackFn *unpack = delta ? kernels.unpackDelta : kernels.unpack;
+    uint32_t last = 0;
+    size_t i = 0;
+    for (; i + kBlock <= n; i += kBlock) {
+        uint32_t base;
+        in = getVarint32(in, end, base);
+        if (!in || in == end || *in > 32) return nullptr;
+        const size_t bytes = size_t(*in++) * 16;
+        if (size_t(end - in) < bytes) return nullptr;
+        unpack[bytes / 16](in, base, out + i, last);
+        in += bytes;
+    }
+    for (; i < n; i++) {
+        in = getVarint32(in, end, out[i]);
+        if (!in) return nullptr;
+        if (delta) out[i] = last += out[i];
+    }
+    return in;
+}
+
+}  // namespace detail
+
+// Frame of reference: each block's minimum, then the differences from it
+inline size_t packForWith(Kernel k, const uint32_t *values, size_t n, uint8_t *out) {
+    return detail::packBlocks(k, values, n, out, false);
+}
+
+inline const uint8_t *unpackForWith(Kernel k, const uint8_t *in, const uint8_t *end, uint32_t *out, size_t n) {
+    return detail::unpackBlocks(k, in, end, out, n, false);
+}
+
+// Delta, then frame of reference on the gaps
+inline size_t packDeltaWith(Kernel k, const uint32_t *values, size_t n, uint8_t *out) {
+    return detail::packBlocks(k, values, n, out, true);
+}
+
+inline const uint8_t *unpackDeltaWith(Kernel k, const uint8_t *in, const uint8_t *end, uint32_t *out, size_t n) {
+    return detail::unpackBlocks(k, in, end, out, n, true);
+}
+
+inline size_t packFor(const uint32_t *values, size_t n, uint8_t *out) {
+    return packForWith(bestKernel(), values, n, out);
+}
+
+inline const uint8_t *unpackFor(const uint8_t *in, const uint8_t *end, uint32_t *out, size_t n) {
+    return unpackForWith(bestKernel(), in, end, out, n);
+}
+
+inline size_t packDelta(const uint32_t *values, size_t n, uint8_t *out) {
+    return packDeltaWith(bestKernel(), values, n, out);
+}
+
+inline const uint8_t *unpackDelta(const uint8_t *in, const uint8_t *end, uint32_t *out, size_t n) {
+    return unpackDeltaWith(bestKernel(), in, end, out, n);
+}
+
+}  // namespace intcodec
+
+#endif  // INT_CODEC_HPP
@@ -0,0 +1,304 @@
+/*
+ * int_parse.hpp - Binary, Decimal and Hex Text to Integers, 16 Characters at a Time
+ * The other direction from binfmt.h and hexcodec.h: text -> uint64_t.
+ *
+ * NumberConverter.jsx calls parseInt() on one field. Here every 16
+ * characters are checked with a few SSE instructions (is each one a
+ * digit?), and the digits are combined with multiply-add instructions:
+ * pairs of digits, then fours, then eights - instead of one
+ * "value = value * 10 + digit" per character.
+ *
+ * Results and errors work exactly like std::from_chars:
+ *
+ *   uint64_t v;
+ *   auto r = intparse::parse(text, text + len, v, 16);
+ *   if (r.ec == std::errc::invalid_argument) ...   // no digits at all
+ *   if (r.ec == std::errc::result_out_of_range) ...  // more than 64 bits
+ *   // r.ptr points just past the last digit; v is untouched on error
+ *
+ *   std::vector<uint64_t> all;
+ *   auto b = intparse::parseLines(data, data + size, 10, all);  // one per line
+ *   if (!b.ok()) ...                                            // b.where, b.ec
+ *
+ * Bases 2, 10 and 16 get the SIMD kernel; other bases up to 16 use the
+ * plain loop. No prefix, sign or whitespace is accepted (like from_chars).
+ */
+
+#ifndef INT_PARSE_HPP
+#define INT_PARSE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define INT_PARSE_X86 1
+#else
+#define INT_PARSE_X86 0
+#endif
+
+namespace intparse {
+
+// Same shape as std::from_chars_result
+struct Result {
+    const char *ptr;
+    std::errc ec;
+};
+
+enum class Kernel { Scalar, Sse41 };
+
+inline const char *kernelName(Kernel k) {
+    return k == Kernel::Sse41 ? "sse4.1" : "scalar";
+}
+
+// ---- Plain C++: one character at a time ----
+
+inline unsigned digitValue(char c) {
+    unsigned d = unsigned(c) - '0';
+    if (d < 10) return d;
+    unsigned letter = (unsigned(c) | 0x20) - 'a';
+    return letter < 6 ? letter + 10 : 255;
+}
+
+inline Result parseScalar(const char *first, const char *last, uint64_t &value, int base) {
+    const char *p = first;
+    uint64_t v = 0;
+    bool overflow = false;
+    for (; p < last; p++) {
+        unsigned d = digitValue(*p);
+        if (d >= unsigned(base)) break;
+        // Keep going after an overflow: ptr must end up past every digit
+        if (!overflow && (__builtin_mul_overflow(v, uint64_t(base), &v) || __builtin_add_overflow(v, d, &v))) {
+            overflow = true;
+        }
+    }
+    if (p == first) return {first, std::errc::invalid_argument};
+    if (overflow) return {p, std::errc::result_out_of_range};
+    value = v;
+    return {p, std::errc()};
+}
+
+#if INT_PARSE_X86
+
+// ---- SSE4.1: 16 characters per step ----
+
+#define INT_PARSE_SIMD __attribute__((target("sse4.1"), always_inline)) inline
+
+// Load 16 bytes without reading past `last` (missing bytes become 0,
+// which is not a digit in any base)
+INT_PARSE_SIMD __m128i load16(const char *p, const char *last) {
+    if (last - p >= 16) return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    alignas(16) char padded[16] = {};
+    if (last > p) memcpy(padded, p, size_t(last - p));
+    return _mm_load_si128(reinterpret_cast<const __m128i *>(padded));
+}
+
+// One bit per character that is a digit of `base`; digit values go to `values`
+INT_PARSE_SIMD unsigned classify(__m128i text, int base, __m128i &values) {
+    __m128i d = _mm_sub_epi8(text, _mm_set1_epi8('0'));
+    if (base == 10 || base == 2) {
+        // Unsigned d <= 9 (or <= 1): min(d, 9) == d
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(char(base - 1))), d);
+        values = d;
+        return unsigned(_mm_movemask_epi8(is_digit));
+    }
+    __m128i is_number = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(text, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+    values = _mm_or_si128(_mm_and_si128(is_number, d),
+                          _mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+    return unsigned(_mm_movemask_epi8(_mm_or_si128(is_number, is_letter)));
+}
+
+// Move the first n values to the end of the register, zeros in front:
+// then the last digit is always in byte 15, whatever n is
+INT_PARSE_SIMD __m128i alignRight(__m128i values, size_t n) {
+    alignas(16) static const uint8_t table[32] = {
+        0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i *>(table + n));
+    return _mm_shuffle_epi8(values, shuffle);
+}
+
+// 16 right-aligned decimal digits -> value (at most 9999999999999999)
+INT_PARSE_SIMD uint64_t decimal16(__m128i digits) {
+    // 1 7 3 4 ...  ->  17 34 ...  ->  1734 ...  ->  17345678 ...
+    __m128i pairs = _mm_maddubs_epi16(digits, _mm_set_epi8(1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10));
+    __m128i fours = _mm_madd_epi16(pairs, _mm_set_epi16(1, 100, 1, 100, 1, 100, 1, 100));
+    __m128i fours16 = _mm_packus_epi32(fours, fours);
+    __m128i eights = _mm_madd_epi16(fours16, _mm_set_epi16(1, 10000, 1, 10000, 1, 10000, 1, 10000));
+    uint64_t high = uint32_t(_mm_cvtsi128_si32(eights));
+    uint64_t low = uint32_t(_mm_extract_epi32(eights, 1));
+    return high * 100000000 + low;
+}
+
+// 16 right-aligned hex digits -> value
+INT_PARSE_SIMD uint64_t hex16(__m128i digits) {
+    // a b c d ...  ->  0xab 0xcd ...  ->  eight bytes, most significant first
+    __m128i bytes = _mm_maddubs_epi16(digits, _mm_set_epi8(1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16, 1, 16));
+    bytes = _mm_packus_epi16(bytes, bytes);
+    return __builtin_bswap64(uint64_t(_mm_cvtsi128_si64(bytes)));
+}
+
+// Up to 16 binary digits (values 0/1) -> value, first digit highest
+INT_PARSE_SIMD uint64_t binary16(__m128i digits, size_t n) {
+    const __m128i reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    // Reversed, the first character lands in bit 15 of the mask
+    __m128i top_bits = _mm_slli_epi64(_mm_shuffle_epi8(digits, reverse), 7);
+    return unsigned(_mm_movemask_epi8(top_bits)) >> (16 - n);
+}
+
+// How many digits of `base` start at p
+INT_PARSE_SIMD size_t digitRun(const char *p, const char *last, int base) {
+    size_t run = 0;
+    while (p < last) {
+        __m128i values;
+        unsigned not_digit = ~classify(load16(p, last), base, values) & 0xFFFF;
+        if (not_digit) return run + size_t(__builtin_ctz(not_digit));
+        run += 16;
+        p += 16;
+    }
+    return run;
+}
+
+// n (at most the base's limit) digits starting at p -> value; false on overflow
+INT_PARSE_SIMD bool valueOf(const char *p, size_t n, const char *last, int base, uint64_t &value) {
+    __m128i values;
+    if (base == 2) {
+        uint64_t v = 0;
+        for (; n >= 16; n -= 16, p += 16) {
+            classify(load16(p, last), base, values);
+            v = (v << 16) | binary16(values, 16);
+        }
+        if (n) {
+            classify(load16(p, last), base, values);
+            v = (v << n) | binary16(values, n);
+        }
+        value = v;
+        return true;
+    }
+    if (base == 16) {
+        classify(load16(p, last), base, values);
+        value = hex16(alignRight(values, n));
+        return true;
+    }
+    if (n <= 16) {
+        classify(load16(p, last), base, values);
+        value = decimal16(alignRight(values, n));
+        return true;
+    }
+    // 17..20 digits: the first 1..4 one at a time, the last 16 at once
+    uint64_t head = 0;
+    for (size_t i = 0; i < n - 16; i++) head = head * 10 + unsigned(p[i] - '0');
+    classify(load16(p + n - 16, last), base, values);
+    uint64_t tail = decimal16(values);
+    return !__builtin_mul_overflow(head, uint64_t(10000000000000000), &head) &&
+           !__builtin_add_overflow(head, tail, &value);
+}
+
+__attribute__((target("sse4.1")))
+inline Result parseSse41(const char *first, const char *last, uint64_t &value, int base) {
+    if (base != 2 && base != 10 && base != 16) return parseScalar(first, last, value, base);
+    __m128i values;
+
+    // Most numbers: fewer than 16 digits, no leading zero - one load does it all
+    if (last - first >= 16) {
+        unsigned not_digit = ~classify(_mm_loadu_si128(reinterpret_cast<const __m128i *>(first)), base, values) & 0xFFFF;
+        size_t n = size_t(__builtin_ctz(not_digit | 0x10000));
+        if (n == 0) return {first, std::errc::invalid_argument};
+        if (n < 16 && (first[0] != '0' || n == 1)) {
+            __m128i digits = alignRight(values, n);
+            value = base == 10 ? decimal16(digits) : base == 16 ? hex16(digits) : binary16(values, n);
+            return {first + n, std::errc()};
+        }
+    }
+
+    // Everything else: find the end of the digits, skip leading zeros
+    size_t run = digitRun(first, last, base);
+    if (run == 0) return {first, std::errc::invalid_argument};
+    const char *end = first + run;
+    const char *p = first;
+    while (p < end - 1 && *p == '0') p++;
+    size_t n = size_t(end - p);
+    size_t max_digits = base == 2 ? 64 : base == 10 ? 20 : 16;
+    uint64_t v;
+    if (n > max_digits || !valueOf(p, n, last, base, v)) return {end, std::errc::result_out_of_range};
+    value = v;
+    return {end, std::errc()};
+}
+
+#undef INT_PARSE_SIMD
+
+#endif  // INT_PARSE_X86
+
+// ---- Pick the best kernel once, when first used ----
+
+inline Kernel detectKernel() {
+#if INT_PARSE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) return Kernel::Sse41;
+#endif
+    return Kernel::Scalar;
+}
+
+inline Kernel bestKernel() {
+    static const Kernel best = detectKernel();
+    return best;
+}
+
+inline Result parseWith(Kernel k, const char *first, const char *last, uint64_t &value, int base) {
+#if INT_PARSE_X86
+    if (k == Kernel::Sse41) return parseSse41(first, last, value, base);
+#else
+    (void)k;
+#endif
+    return parseScalar(first, last, value, base);
+}
+
+inline Result parse(const char *first, const char *last, uint64_t &value, int base = 10) {
+    return parseWith(bestKernel(), first, last, value, base);
+}
+
+// What parseLines() found
+struct BatchResult {
+    size_t count = 0;            // numbers added to `out`
+    std::errc ec = std::errc();  // the first error (invalid_argument if a line has anything but digits)
+    const char *where = nullptr; // start of the bad line
+
+    bool ok() const { return ec == std::errc(); }
+};
+
+// One number per line ('\n' or "\r\n"), appended to `out`. Stops at the
+// first bad line. A final newline is optional.
+inline BatchResult parseLinesWith(Kernel k, const char *first, const char *last, int base,
+                                  std::vector<uint64_t> &out) {
+    BatchResult b;
+    const char *p = first;
+    while (p < last) {
+        uint64_t v;
+        Result r = parseWith(k, p, last, v, base);
+        const char *end = r.ptr;
+        if (r.ec == std::errc() && end < last && *end == '\r') end++;
+        if (r.ec == std::errc() && end < last && *end != '\n') r.ec = std::errc::invalid_argument;
+        if (r.ec != std::errc()) {
+            b.ec = r.ec;
+            b.where = p;
+            return b;
+        }
+        out.push_back(v);
+        b.count++;
+        p = end < last ? end + 1 : last;
+    }
+    return b;
+}
+
+inline BatchResult parseLines(const char *first, const char *last, int base, std::vector<uint64_t> &out) {
+    return parseLinesWith(bestKernel(), first, last, base, out);
+}
+
+}  // namespace intparse
+
+#endif  // INT_PARSE_HPP
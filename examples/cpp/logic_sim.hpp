@@ -0,0 +1,525 @@
+/*
+ * logic_sim.hpp - Simulate a Logic Circuit 64 (or 256) Inputs at a Time
+ * LogicGates.jsx works out one gate for one set of inputs. A CPU's AND
+ * works on a whole 64-bit word - so give every wire a word, let bit j of
+ * each word be "test vector" j, and one AND instruction evaluates the gate
+ * for 64 different inputs at once (256 with AVX2).
+ *
+ * A netlist names the wires and the gates that drive them (the ISCAS
+ * ".bench" format, so real benchmark circuits load as they are):
+ *
+ *   # full adder            (gates: AND OR XOR NAND NOR XNOR NOT BUF)
+ *   INPUT(a) INPUT(b) INPUT(cin)
+ *   OUTPUT(sum) OUTPUT(cout)
+ *   sum  = XOR(a, b, cin)
+ *   cout = OR(ab, ct)
+ *   ab   = AND(a, b)
+ *   ct   = AND(cin, x)
+ *   x    = XOR(a, b)
+ *
+ * compile() puts the gates in dependency order, splits them into 2-input
+ * steps, and packs them into one flat array of {op, out, a, b}. Steps are
+ * grouped by level (steps in a level don't depend on each other) and by op,
+ * so the loop runs long stretches of the same operation; wires share
+ * storage once nobody reads them any more, keeping the working set small.
+ *
+ *   logicsim::Netlist net = logicsim::Netlist::parse(text);
+ *   logicsim::Circuit circuit = logicsim::Circuit::compile(net);
+ *   if (!circuit.ok()) std::cerr << circuit.error() << "\n";
+ *   logicsim::Simulator sim(circuit);
+ *   sim.exhaustive([&](uint64_t first, const uint64_t *in, const uint64_t *out) {
+ *       // out[o * sim.words() + w], bit j: output o for vector first + 64*w + j
+ *       return true;                                   // false stops early
+ *   });
+ */
+
+#ifndef LOGIC_SIM_HPP
+#define LOGIC_SIM_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define LOGIC_SIM_X86 1
+#else
+#define LOGIC_SIM_X86 0
+#endif
+
+namespace logicsim {
+
+enum class GateType : uint8_t { And, Or, Xor, Nand, Nor, Xnor, Not };
+
+inline const char *gateName(GateType type) {
+    static const char *names[] = {"AND", "OR", "XOR", "NAND", "NOR", "XNOR", "NOT"};
+    return names[int(type)];
+}
+
+struct Gate {
+    GateType type;
+    uint32_t output;               // signal ids
+    std::vector<uint32_t> inputs;
+    size_t line;                   // where it was in the text (0 = made in code)
+};
+
+// The circuit as written: named signals, and the gates that drive them
+struct Netlist {
+    std::vector<std::string> names;  // signal id -> name
+    std::vector<uint32_t> inputs;
+    std::vector<uint32_t> outputs;
+    std::vector<Gate> gates;
+    size_t error_line = 0;           // the first line that didn't parse (1-based)
+    std::string error;
+
+    bool ok() const { return error.empty(); }
+
+    // The id of a signal, made on first use
+    uint32_t signal(const std::string &name) {
+        auto found = ids_.emplace(name, uint32_t(names.size()));
+        if (found.second) names.push_back(name);
+        return found.first->second;
+    }
+    void addInput(const std::string &name) { inputs.push_back(signal(name)); }
+    void addOutput(const std::string &name) { outputs.push_back(signal(name)); }
+    // A 1-input AND/OR/XOR is a buffer; a 1-input NAND/NOR/XNOR is a NOT
+    void addGate(GateType type, uint32_t output, std::vector<uint32_t> inputs_, size_t line = 0) {
+        gates.push_back(Gate{type, output, std::move(inputs_), line});
+    }
+
+    static Netlist parse(const std::string &text) {
+        Netlist net;
+        size_t line = 0, start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == std::string::npos) end = text.size();
+            std::string s = text.substr(start, end - start);
+            start = end + 1;
+            line++;
+            s = s.substr(0, s.find('#'));
+            for (char &c : s) {
+                if (c == '(' || c == ')' || c == ',' || c == '\t' || c == '\r') c = ' ';
+            }
+            if (!net.parseLine(s, line)) {
+                net.error_line = line;
+                return net;
+            }
+        }
+        return net;
+    }
+
+private:
+    static std::vector<std::string> split(const std::string &s) {
+        std::vector<std::string> words;
+        size_t i = 0;
+        while (i < s.size()) {
+            while (i < s.size() && s[i] == ' ') i++;
+            size_t j = i;
+            while (j < s.size() && s[j] != ' ') j++;
+            if (j > i) words.push_back(s.substr(i, j - i));
+            i = j;
+        }
+        return words;
+    }
+
+    static std::string upper(std::string s) {
+        for (char &c : s) c = char(toupper((unsigned char)c));
+        return s;
+    }
+
+    bool parseLine(const std::string &s, size_t line) {
+        size_t eq = s.find('=');
+        if (eq == std::string::npos) {
+            std::vector<std::string> words = split(s);
+            if (words.empty()) return true;
+            std::string kind = upper(words[0]);
+            if (kind != "INPUT" && kind != "OUTPUT") {
+                error = "expected INPUT, OUTPUT or \"signal = GATE(inputs)\"";
+                return false;
+            }
+            for (size_t i = 1; i < words.size(); i++) {  // "INPUT(a) INPUT(b)" or "INPUT a b"
+                std::string word = upper(words[i]);
+                if (word == "INPUT" || word == "OUTPUT") kind = word;
+                else if (kind == "INPUT") addInput(words[i]);
+                else addOutput(words[i]);
+            }
+            return true;
+        }
+        std::vector<std::string> left = split(s.substr(0, eq)), right = split(s.substr(eq + 1));
+        if (left.size() != 1 || right.size() < 2) {
+            error = "expected \"signal = GATE(inputs)\"";
+            return false;
+        }
+        static const std::pair<const char *, GateType> kinds[] = {
+            {"AND", GateType::And},   {"OR", GateType::Or},   {"XOR", GateType::Xor}, {"NAND", GateType::Nand},
+            {"NOR", GateType::Nor},   {"XNOR", GateType::Xnor}, {"NOT", GateType::Not}, {"BUF", GateType::And},
+            {"BUFF", GateType::And}};
+        std::string name = upper(right[0]);
+        const std::pair<const char *, GateType> *kind = nullptr;
+        for (const auto &k : kinds) {
+            if (name == k.first) kind = &k;
+        }
+        if (!kind) {
+            error = "unknown gate " + right[0];
+            return false;
+        }
+        bool one_input = kind->second == GateType::Not || name == "BUF" || name == "BUFF";
+        if (one_input && right.size() != 2) {
+            error = name + " takes one input";
+            return false;
+        }
+        std::vector<uint32_t> ins;
+        for (size_t i = 1; i < right.size(); i++) ins.push_back(signal(right[i]));
+        addGate(kind->second, signal(left[0]), std::move(ins), line);
+        return true;
+    }
+
+    std::unordered_map<std::string, uint32_t> ids_;
+};
+
+// One step: out = a op b (b == a for NOT)
+struct Instr {
+    GateType op;
+    uint32_t out, a, b;  // slots: which word of storage holds the wire
+};
+
+// Steps [begin, end) all have the same op
+struct Run {
+    GateType op;
+    uint32_t begin, end;
+};
+
+class Circuit {
+public:
+    static Circuit compile(const Netlist &net) {
+        Circuit c;
+        if (!net.ok()) return c.fail("line " + std::to_string(net.error_line) + ": " + net.error);
+        c.inputs_ = net.inputs.size();
+        size_t signals = net.names.size();
+
+        // Who drives each signal: an input (-2), a gate, or nothing yet (-1)
+        std::vector<int64_t> driver(signals, -1);
+        for (uint32_t s : net.inputs) {
+            if (driver[s] != -1) return c.fail("input " + net.names[s] + " is listed twice");
+            driver[s] = -2;
+        }
+        for (size_t g = 0; g < net.gates.size(); g++) {
+            uint32_t s = net.gates[g].output;
+            if (driver[s] != -1) return c.fail(where(net.gates[g]) + net.names[s] + " is driven twice");
+            driver[s] = int64_t(g);
+        }
+        for (const Gate &gate : net.gates) {
+            if (gate.inputs.empty() || (gate.type == GateType::Not && gate.inputs.size() != 1)) {
+                return c.fail(where(gate) + gateName(gate.type) + " driving " + net.names[gate.output] +
+                              " has the wrong number of inputs");
+            }
+            for (uint32_t s : gate.inputs) {
+                if (driver[s] == -1) return c.fail(where(gate) + net.names[s] + " is never driven");
+            }
+        }
+        for (uint32_t s : net.outputs) {
+            if (driver[s] == -1) return c.fail("output " + net.names[s] + " is never driven");
+        }
+
+        // Dependency order (Kahn): a gate is ready once all its inputs are
+        std::vector<uint32_t> waiting(net.gates.size(), 0), order;
+        std::vector<uint32_t> first_reader(signals + 1, 0), readers;
+        for (const Gate &gate : net.gates) {
+            for (uint32_t s : gate.inputs) first_reader[s + 1]++;
+        }
+        for (size_t s = 0; s < signals; s++) first_reader[s + 1] += first_reader[s];
+        readers.resize(first_reader[signals]);
+        std::vector<uint32_t> fill(first_reader.begin(), first_reader.end() - 1);
+        for (size_t g = 0; g < net.gates.size(); g++) {
+            for (uint32_t s : net.gates[g].inputs) {
+                readers[fill[s]++] = uint32_t(g);
+                if (driver[s] >= 0) waiting[g]++;
+            }
+        }
+        for (size_t g = 0; g < net.gates.size(); g++) {
+            if (waiting[g] == 0) order.push_back(uint32_t(g));
+        }
+        for (size_t i = 0; i < order.size(); i++) {
+            uint32_t s = net.gates[order[i]].output;
+            for (uint32_t r = first_reader[s]; r < first_reader[s + 1]; r++) {
+                if (--waiting[readers[r]] == 0) order.push_back(readers[r]);
+            }
+        }
+        if (order.size() < net.gates.size()) {
+            for (size_t g = 0; g < net.gates.size(); g++) {
+                if (waiting[g]) return c.fail(where(net.gates[g]) + "a loop runs through " + net.names[net.gates[g].output]);
+            }
+        }
+
+        // Split gates into 2-input steps; extra wires get ids from `signals` up
+        std::vector<Instr> steps;
+        std::vector<uint32_t> level(signals, 0);
+        uint32_t next_id = uint32_t(signals);
+        auto step = [&](GateType op, uint32_t out, uint32_t a, uint32_t b) {
+            if (out >= level.size()) level.resize(out + 1, 0);
+            level[out] = 1 + std::max(level[a], level[b]);
+            steps.push_back(Instr{op, out, a, b});
+        };
+        for (uint32_t g : order) {
+            const Gate &gate = net.gates[g];
+            const std::vector<uint32_t> &in = gate.inputs;
+            GateType op = gate.type;
+            if (in.size() == 1) {
+                bool inverts = op == GateType::Not || op == GateType::Nand || op == GateType::Nor || op == GateType::Xnor;
+                step(inverts ? GateType::Not : GateType::And, gate.output, in[0], in[0]);
+                continue;
+            }
+            GateType base = op == GateType::Nand ? GateType::And
+                          : op == GateType::Nor  ? GateType::Or
+                          : op == GateType::Xnor ? GateType::Xor
+                          : op;
+            uint32_t acc = in[0];
+            for (size_t i = 1; i + 1 < in.size(); i++) {
+                step(base, next_id, acc, in[i]);
+                acc = next_id++;
+            }
+            step(op, gate.output, acc, in.back());
+        }
+
+        // Level by level, and by op inside a level (stable: keeps the order)
+        std::stable_sort(steps.begin(), steps.end(), [&](const Instr &x, const Instr &y) {
+            if (level[x.out] != level[y.out]) return level[x.out] < level[y.out];
+            return x.op < y.op;
+        });
+        c.levels_ = steps.empty() ? 0 : level[steps.back().out];
+
+        // Storage: a wire's slot is reused after its last reader
+        const uint32_t kForever = ~uint32_t(0), kNever = kForever - 1;
+        std::vector<uint32_t> last_use(next_id, kNever), slot(next_id, 0);
+        for (uint32_t i = 0; i < steps.size(); i++) last_use[steps[i].a] = last_use[steps[i].b] = i;
+        for (uint32_t s : net.outputs) last_use[s] = kForever;
+        for (size_t i = 0; i < c.inputs_; i++) slot[net.inputs[i]] = uint32_t(i);
+        std::vector<uint32_t> free_slots;
+        uint32_t slots = uint32_t(c.inputs_);
+        c.code_.reserve(steps.size());
+        for (uint32_t i = 0; i < steps.size(); i++) {
+            const Instr &s = steps[i];
+            Instr out{s.op, 0, slot[s.a], slot[s.b]};
+            if (last_use[s.a] == i) free_slots.push_back(slot[s.a]);
+            if (s.b != s.a && last_use[s.b] == i) free_slots.push_back(slot[s.b]);
+            if (free_slots.empty()) {
+                out.out = slots++;
+            } else {
+                out.out = free_slots.back();
+                free_slots.pop_back();
+            }
+            slot[s.out] = out.out;
+            if (last_use[s.out] == kNever) free_slots.push_back(out.out);  // nobody reads it
+            c.code_.push_back(out);
+        }
+        c.slots_ = std::max<size_t>(slots, 1);
+        for (uint32_t s : net.outputs) c.outputs_.push_back(slot[s]);
+        for (uint32_t i = 0; i < c.code_.size(); i++) {
+            if (c.runs_.empty() || c.runs_.back().op != c.code_[i].op) c.runs_.push_back(Run{c.code_[i].op, i, i});
+            c.runs_.back().end = i + 1;
+        }
+        return c;
+    }
+
+    bool ok() const { return error_.empty(); }
+    const std::string &error() const { return error_; }
+
+    size_t inputCount() const { return inputs_; }     // input i lives in slot i
+    size_t outputCount() const { return outputs_.size(); }
+    size_t gateCount() const { return code_.size(); }  // 2-input steps
+    size_t levels() const { return levels_; }          // the longest path, in steps
+    size_t slots() const { return slots_; }            // words of storage per vector-word
+
+    const std::vector<Instr> &instructions() const { return code_; }
+    const std::vector<Run> &runs() const { return runs_; }
+    const std::vector<uint32_t> &outputSlots() const { return outputs_; }
+
+private:
+    static std::string where(const Gate &gate) {
+        return gate.line ? "line " + std::to_string(gate.line) + ": " : "";
+    }
+    Circuit &fail(const std::string &message) {
+        error_ = message;
+        return *this;
+    }
+
+    size_t inputs_ = 0, levels_ = 0, slots_ = 0;
+    std::vector<Instr> code_;
+    std::vector<Run> runs_;
+    std::vector<uint32_t> outputs_;
+    std::string error_;
+};
+
+// ==================================================
+// Kernels: every step, for one word (64 vectors) or four (256)
+// ==================================================
+
+enum class Kernel { Scalar, Avx2 };
+
+#define LOGIC_SIM_LOOP(EXPR)                                          \
+    for (uint32_t i = run.begin; i < run.end; i++) {                   \
+        const Instr &g = code[i];                                      \
+        Word a = v[g.a], b = v[g.b];                                   \
+        (void)b;                                                       \
+        v[g.out] = EXPR;                                               \
+    }                                                                  \
+    break
+
+inline void runScalar(const Circuit &circuit, uint64_t *values) {
+    using Word = uint64_t;
+    Word *v = values;
+    const Instr *code = circuit.instructions().data();
+    for (const Run &run : circuit.runs()) {
+        switch (run.op) {
+        case GateType::And:  LOGIC_SIM_LOOP(a & b);
+        case GateType::Or:   LOGIC_SIM_LOOP(a | b);
+        case GateType::Xor:  LOGIC_SIM_LOOP(a ^ b);
+        case GateType::Nand: LOGIC_SIM_LOOP(~(a & b));
+        case GateType::Nor:  LOGIC_SIM_LOOP(~(a | b));
+        case GateType::Xnor: LOGIC_SIM_LOOP(~(a ^ b));
+        case GateType::Not:  LOGIC_SIM_LOOP(~a);
+        }
+    }
+}
+
+#if LOGIC_SIM_X86
+
+// values must be 32-byte aligned
+__attribute__((target("avx2")))
+inline void runAvx2(const Circuit &circuit, uint64_t *values) {
+    using Word = __m256i;
+    Word *v = reinterpret_cast<Word *>(values);
+    const Word ones = _mm256_set1_epi64x(-1);
+    const Instr *code = circuit.instructions().data();
+    for (const Run &run : circuit.runs()) {
+        switch (run.op) {
+        case GateType::And:  LOGIC_SIM_LOOP(_mm256_and_si256(a, b));
+        case GateType::Or:   LOGIC_SIM_LOOP(_mm256_or_si256(a, b));
+        case GateType::Xor:  LOGIC_SIM_LOOP(_mm256_xor_si256(a, b));
+        case GateType::Nand: LOGIC_SIM_LOOP(_mm256_andnot_si256(_mm256_and_si256(a, b), ones));
+        case GateType::Nor:  LOGIC_SIM_LOOP(_mm256_andnot_si256(_mm256_or_si256(a, b), ones));
+        case GateType::Xnor: LOGIC_SIM_LOOP(_mm256_andnot_si256(_mm256_xor_si256(a, b), ones));
+        case GateType::Not:  LOGIC_SIM_LOOP(_mm256_xor_si256(a, ones));
+        }
+    }
+}
+
+#endif  // LOGIC_SIM_X86
+
+#undef LOGIC_SIM_LOOP
+
+inline Kernel detectKernel() {
+#if LOGIC_SIM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Kernel::Avx2;
+#endif
+    return Kernel::Scalar;
+}
+
+inline Kernel bestKernel() {
+    static const Kernel best = detectKernel();
+    return best;
+}
+
+// ==================================================
+// Simulator: feeds a compiled circuit its input vectors
+// ==================================================
+
+class Simulator {
+public:
+    // Kernel::Avx2 falls back to Scalar where AVX2 isn't available
+    explicit Simulator(const Circuit &circuit, Kernel kernel = bestKernel())
+        : circuit_(circuit),
+          kernel_(kernel == Kernel::Avx2 && bestKernel() == Kernel::Avx2 ? Kernel::Avx2 : Kernel::Scalar),
+          words_(kernel_ == Kernel::Avx2 ? 4 : 1),
+          storage_(circuit.slots() * size_t(words_) + 4),
+          inputs_(circuit.inputCount() * size_t(words_)),
+          outputs_(circuit.outputCount() * size_t(words_)) {
+        // Line the storage up on 32 bytes for the AVX2 loads and stores
+        values_ = storage_.data() + (-(reinterpret_cast<uintptr_t>(storage_.data()) / 8) & 3);
+    }
+
+    Kernel kernel() const { return kernel_; }
+    const char *kernelName() const { return kernel_ == Kernel::Avx2 ? "avx2" : "scalar"; }
+    int words() const { return words_; }            // 64-bit words per wire
+    int vectors() const { return 64 * words_; }     // input vectors per pass
+
+    // One pass. inputs[i * words() + w], bit j = input i of vector 64*w + j;
+    // outputs are laid out the same way.
+    void run(const uint64_t *inputs, uint64_t *outputs) {
+        size_t w = size_t(words_);
+        memcpy(values_, inputs, circuit_.inputCount() * w * sizeof(uint64_t));
+#if LOGIC_SIM_X86
+        if (kernel_ == Kernel::Avx2) runAvx2(circuit_, values_);
+        else runScalar(circuit_, values_);
+#else
+        runScalar(circuit_, values_);
+#endif
+        const std::vector<uint32_t> &slots = circuit_.outputSlots();
+        for (size_t o = 0; o < slots.size(); o++) {
+            memcpy(outputs + o * w, values_ + slots[o] * w, w * sizeof(uint64_t));
+        }
+    }
+
+    // Every combination of the inputs (at most 40 of them): vector number n
+    // has input i = bit i of n. With fewer than log2(vectors()) inputs, the
+    // vectors past 2^inputs repeat the first ones. visit(first_vector,
+    // inputs, outputs) sees each pass; returning false stops. Returns the
+    // number of passes made.
+    template <typename Visit>
+    uint64_t exhaustive(Visit visit) {
+        size_t n = circuit_.inputCount();
+        if (n > 40) return 0;
+        uint64_t total = n >= 6 ? (uint64_t(1) << n) : 64;
+        uint64_t passes = std::max<uint64_t>(1, total / uint64_t(vectors()));
+        static const uint64_t patterns[6] = {0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+                                             0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull};
+        for (uint64_t pass = 0; pass < passes; pass++) {
+            uint64_t first = pass * uint64_t(vectors());
+            for (size_t i = 0; i < n; i++) {
+                for (int w = 0; w < words_; w++) {
+                    uint64_t base = first + 64 * uint64_t(w);  // bits 0..5 of it are 0
+                    inputs_[i * size_t(words_) + size_t(w)] = i < 6 ? patterns[i] : 0 - (base >> i & 1);
+                }
+            }
+            run(inputs_.data(), outputs_.data());
+            if (!visit(first, inputs_.data(), outputs_.data())) return pass + 1;
+        }
+        return passes;
+    }
+
+    // `passes` passes of random inputs (the same ones for the same seed)
+    template <typename Visit>
+    uint64_t random(uint64_t passes, uint64_t seed, Visit visit) {
+        uint64_t state = seed | 1;
+        for (uint64_t pass = 0; pass < passes; pass++) {
+            for (uint64_t &word : inputs_) {
+                state ^= state << 13;  // xorshift64
+                state ^= state >> 7;
+                state ^= state << 17;
+                word = state;
+            }
+            run(inputs_.data(), outputs_.data());
+            if (!visit(pass * uint64_t(vectors()), inputs_.data(), outputs_.data())) return pass + 1;
+        }
+        return passes;
+    }
+
+private:
+    const Circuit &circuit_;
+    Kernel kernel_;
+    int words_;
+    std::vector<uint64_t> storage_;
+    uint64_t *values_;
+    std::vector<uint64_t> inputs_, outputs_;
+};
+
+}  // namespace logicsim
+
+#endif  // LOGIC_SIM_HPP
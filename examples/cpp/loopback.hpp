@@ -0,0 +1,917 @@
+/*
+ * loopback.hpp - A Server and a Client That Really Talk, Measured
+ * InternetWorks.jsx animates requests and responses; this sends them.
+ *
+ * The server answers framed messages over TCP or UDP: a 16-byte Header,
+ * then a payload. It echoes the payload back, or replies with as many
+ * bytes of its own as the request asks for. On 127.0.0.1 (the LOOPBACK
+ * interface) every byte goes through the whole network stack, but never
+ * onto a wire, so what we measure is the software.
+ *
+ *   - epoll, edge-triggered: one thread watches many sockets and is told
+ *     only when something CHANGES (bytes arrived, room to send again), so
+ *     it reads and writes each socket until the kernel says EAGAIN.
+ *   - Multi-reactor: N event loops, each with its own thread and its own
+ *     socket on the same port (SO_REUSEPORT). The kernel spreads the
+ *     connections (or UDP senders) across them; they share nothing.
+ *   - Gather writes: a reply is a header plus bytes already in memory (the
+ *     request's payload, or a fixed body). sendmsg takes a list of pieces,
+ *     like writev, so replies are never copied into one buffer first.
+ *   - UDP batching: recvmmsg/sendmmsg move many datagrams per system call.
+ *
+ *   loopback::Server server;
+ *   std::string error = server.start(loopback::ServerConfig());  // TCP, a free port
+ *   loopback::LoadConfig load;
+ *   load.port = server.port();
+ *   load.connections = 8;
+ *   load.depth = 4;                          // requests in flight on each
+ *   loopback::LoadResult r = loopback::runLoad(load);
+ *   if (!r.ok()) ...                         // r.error
+ *   r.requestsPerSec(), r.percentileUs(0.999)
+ *
+ * Linux only (epoll, recvmmsg, sendmmsg); compile with -pthread.
+ */
+
+#ifndef LOOPBACK_HPP
+#define LOOPBACK_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace loopback {
+
+enum class Protocol { Tcp, Udp };
+enum class Reply { Echo, Fixed };
+
+// Every message is this header, then `length` payload bytes. The byte
+// order is the machine's own: both ends run here.
+struct Header {
+    uint32_t length;
+    uint32_t reply_length;  // requests: payload bytes wanted back, or kEcho
+    uint64_t id;            // copied into the reply
+};
+static_assert(sizeof(Header) == 16, "Header is sent as raw bytes");
+
+constexpr uint32_t kEcho = 0xFFFFFFFFu;
+constexpr size_t kMaxTcpPayload = 16 << 20;                // a longer message closes the connection
+constexpr size_t kMaxUdpPayload = 65507 - sizeof(Header);  // what fits in one IPv4 datagram
+
+// Request payloads depend on the id, so echoes can be checked; fixed
+// replies are the same for every request
+inline uint8_t requestByte(uint64_t id, size_t i) { return uint8_t(id * 131 + i * 7 + 1); }
+inline uint8_t replyByte(size_t i) { return uint8_t('a' + i % 26); }
+
+inline uint64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000u + uint64_t(ts.tv_nsec);
+}
+
+inline std::string systemError(const char *what) { return std::string(what) + ": " + std::strerror(errno); }
+
+struct ServerConfig {
+    Protocol protocol = Protocol::Tcp;
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;            // 0: any free port (see Server::port)
+    unsigned reactors = 1;        // event loops; more than one share the port with SO_REUSEPORT
+    bool pin = false;             // run reactor i on core i
+    unsigned batch = 32;          // UDP: datagrams per recvmmsg/sendmmsg (1: a call for each)
+    size_t max_reply = 1 << 20;   // the largest Fixed reply
+};
+
+struct LoadConfig {
+    Protocol protocol = Protocol::Tcp;
+    std::string host = "127.0.0.1";
+    uint16_t port = 0;
+    unsigned connections = 1;   // TCP connections, or UDP sockets
+    unsigned threads = 1;       // client threads, each with its own epoll loop
+    unsigned depth = 1;         // requests in flight per connection (UDP: sent as one batch)
+    bool batch_calls = true;    // UDP: sendmmsg/recvmmsg for a batch; false: a send/recv each
+    size_t request_bytes = 64;  // payload of each request
+    Reply reply = Reply::Echo;
+    size_t reply_bytes = 64;    // payload of each Fixed reply
+    double seconds = 1;
+    bool verify = false;        // check every reply's bytes
+};
+
+struct LoadResult {
+    std::string error;
+    uint64_t requests = 0;  // answered
+    uint64_t lost = 0;      // UDP requests not answered within kUdpTimeoutNs
+    uint64_t bytes = 0;     // payload bytes, both ways
+    double seconds = 0;
+    std::vector<uint32_t> latency_ns;  // send to reply, one per answered request, sorted
+
+    bool ok() const { return error.empty(); }
+    double requestsPerSec() const { return seconds > 0 ? double(requests) / seconds : 0; }
+    double mbPerSec() const { return seconds > 0 ? double(bytes) / seconds / 1e6 : 0; }
+
+    double percentileUs(double fraction) const {
+        if (latency_ns.empty()) return 0;
+        size_t i = std::min(latency_ns.size() - 1, size_t(fraction * double(latency_ns.size())));
+        return latency_ns[i] / 1e3;
+    }
+};
+
+constexpr uint64_t kUdpTimeoutNs = 100000000;  // a datagram unanswered this long was dropped
+
+namespace detail {
+
+inline bool address(const std::string &host, uint16_t port, sockaddr_in &addr) {
+    std::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    return ::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1;
+}
+
+// Send small messages at once, instead of waiting to fill a packet (Nagle)
+inline void setNoDelay(int fd) {
+    int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+}
+
+inline bool watch(int epoll_fd, int fd, uint32_t events) {
+    epoll_event event;
+    std::memset(&event, 0, sizeof event);
+    event.events = events;
+    event.data.fd = fd;
+    return ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+// Bytes a socket didn't take yet, sent when it has room again
+struct Pending {
+    std::vector<uint8_t> bytes;
+    size_t sent = 0;
+
+    size_t size() const { return bytes.size() - sent; }
+    bool empty() const { return sent == bytes.size(); }
+
+    void append(const iovec *iov, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t *p = static_cast<const uint8_t *>(iov[i].iov_base);
+            bytes.insert(bytes.end(), p, p + iov[i].iov_len);
+        }
+    }
+
+    // Send what the socket takes; false if the connection is broken
+    bool flush(int fd) {
+        while (!empty()) {
+            ssize_t n = ::send(fd, bytes.data() + sent, size(), MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            sent += size_t(n);
+        }
+        bytes.clear();
+        sent = 0;
+        return true;
+    }
+};
+
+// Send the pieces in order, as many per system call as the kernel allows
+// (sendmsg is writev with flags: MSG_NOSIGNAL turns a closed peer into an
+// error instead of SIGPIPE). What the socket won't take now is copied to
+// `pending`, behind anything already waiting there. Trims `iov` in place.
+inline bool gatherSend(int fd, iovec *iov, size_t count, Pending &pending) {
+    if (!pending.empty()) {
+        pending.append(iov, count);
+        return pending.flush(fd);
+    }
+    while (count > 0) {
+        msghdr msg;
+        std::memset(&msg, 0, sizeof msg);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = std::min<size_t>(count, IOV_MAX);
+        ssize_t n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return false;
+            break;
+        }
+        // Drop the pieces that went out, and the sent part of the next one
+        size_t sent = size_t(n);
+        while (count > 0 && sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    pending.append(iov, count);
+    return true;
+}
+
+// A buffer that keeps the start of an unfinished message
+struct InBuffer {
+    std::vector<uint8_t> data;
+    size_t used = 0;
+
+    explicit InBuffer(size_t size) : data(size) {}
+
+    // Room for at least one more read, and for the whole message at the front
+    void reserve() {
+        if (used >= sizeof(Header)) {
+            Header h;
+            std::memcpy(&h, data.data(), sizeof h);
+            size_t whole = sizeof h + std::min<size_t>(h.length, kMaxTcpPayload);
+            if (whole > data.size()) data.resize(whole);
+        }
+        if (data.size() - used < 4096) data.resize(data.size() * 2);
+    }
+
+    void consume(size_t bytes) {
+        std::memmove(data.data(), data.data() + bytes, used - bytes);
+        used -= bytes;
+    }
+};
+
+// ---- The server: one Reactor per event loop ----
+
+struct Connection {
+    int fd;
+    InBuffer in{16384};
+    Pending out;
+    explicit Connection(int f) : fd(f) {}
+    ~Connection() { ::close(fd); }
+};
+
+constexpr size_t kMaxPending = 4 << 20;  // stop reading from a peer that isn't reading its replies
+constexpr size_t kDatagram = 65536;
+
+class Reactor {
+public:
+    std::atomic<uint64_t> requests{0};
+    std::atomic<uint64_t> connections{0};
+
+    Reactor(const ServerConfig &config, const std::vector<uint8_t> &body) : config_(config), body_(body) {}
+
+    ~Reactor() {
+        stop();
+        connections_.clear();
+        if (fd_ >= 0) ::close(fd_);
+        if (wake_fd_ >= 0) ::close(wake_fd_);
+        if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    }
+
+    Reactor(const Reactor &) = delete;
+    Reactor &operator=(const Reactor &) = delete;
+
+    // Bind the socket and set up the event loop; "" on success
+    std::string open(uint16_t port) {
+        const bool tcp = config_.protocol == Protocol::Tcp;
+        sockaddr_in addr;
+        if (!address(config_.host, port, addr)) return "not an IPv4 address: " + config_.host;
+        fd_ = ::socket(AF_INET, (tcp ? SOCK_STREAM : SOCK_DGRAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0) return systemError("socket");
+        int one = 1;
+        ::setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        if (config_.reactors > 1 && ::setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof one) != 0) {
+            return systemError("SO_REUSEPORT");
+        }
+        if (::bind(fd_, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0) return systemError("bind");
+        if (tcp && ::listen(fd_, SOMAXCONN) != 0) return systemError("listen");
+        socklen_t length = sizeof addr;
+        ::getsockname(fd_, reinterpret_cast<sockaddr *>(&addr), &length);
+        port_ = ntohs(addr.sin_port);
+
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) return systemError("epoll_create1");
+        wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd_ < 0) return systemError("eventfd");
+        if (!watch(epoll_fd_, fd_, EPOLLIN | EPOLLET) || !watch(epoll_fd_, wake_fd_, EPOLLIN)) {
+            return systemError("epoll_ctl");
+        }
+        if (!tcp) {
+            const unsigned batch = std::max(1u, config_.batch);
+            datagrams_.resize(batch * kDatagram);
+            in_iov_.resize(batch);
+            in_msgs_.resize(batch);
+            from_.resize(batch);
+            out_msgs_.resize(batch);
+            iov_.resize(2 * batch);
+            replies_.resize(batch);
+            for (unsigned i = 0; i < batch; i++) {
+                in_iov_[i] = {&datagrams_[i * kDatagram], kDatagram};
+                std::memset(&in_msgs_[i], 0, sizeof in_msgs_[i]);
+                in_msgs_[i].msg_hdr.msg_iov = &in_iov_[i];
+                in_msgs_[i].msg_hdr.msg_iovlen = 1;
+                in_msgs_[i].msg_hdr.msg_name = &from_[i];
+            }
+        }
+        return "";
+    }
+
+    uint16_t port() const { return port_; }
+
+    void start(unsigned index) {
+        thread_ = std::thread([this] { loop(); });
+        if (config_.pin) {
+            cpu_set_t cores;
+            CPU_ZERO(&cores);
+            CPU_SET(index % std::max(1u, std::thread::hardware_concurrency()), &cores);
+            pthread_setaffinity_np(thread_.native_handle(), sizeof cores, &cores);
+        }
+    }
+
+    void stop() {
+        if (!thread_.joinable()) return;
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wake_fd_, &one, sizeof one);
+        (void)ignored;
+        thread_.join();
+    }
+
+private:
+    void loop() {
+        epoll_event events[64];
+        for (;;) {
+            int n = ::epoll_wait(epoll_fd_, events, 64, -1);
+            if (n < 0 && errno != EINTR) return;
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (fd == wake_fd_) return;
+                if (fd == fd_) {
+                    if (config_.protocol == Protocol::Tcp) {
+                        acceptAll();
+                    } else {
+                        answerDatagrams();
+                    }
+                } else if (!serve(*connections_[size_t(fd)])) {
+                    connections_[size_t(fd)].reset();  // closes it, which also leaves epoll
+                }
+            }
+        }
+    }
+
+    void acceptAll() {
+        for (;;) {
+            int fd = ::accept4(fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                return;  // EAGAIN: none left
+            }
+            setNoDelay(fd);
+            if (size_t(fd) >= connections_.size()) connections_.resize(size_t(fd) + 1);
+            connections_[size_t(fd)].reset(new Connection(fd));
+            connections.fetch_add(1, std::memory_order_relaxed);
+            // Already-waiting bytes are reported right away
+            watch(epoll_fd_, fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET);
+        }
+    }
+
+    // Something changed on a connection: send what was waiting, then read
+    // and answer until the socket is empty. False closes the connection.
+    bool serve(Connection &c) {
+        if (!c.out.flush(c.fd)) return false;
+        while (c.out.size() < kMaxPending) {
+            c.in.reserve();
+            ssize_t n = ::recv(c.fd, c.in.data.data() + c.in.used, c.in.data.size() - c.in.used, 0);
+            if (n == 0) return false;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            c.in.used += size_t(n);
+            if (!answer(c)) return false;
+        }
+        // Too much unsent: the EPOLLOUT edge when the peer catches up
+        // brings us back here to read the rest
+        return true;
+    }
+
+    // Reply to every complete request in the buffer with one gather write
+    bool answer(Connection &c) {
+        replies_.clear();
+        sources_.clear();
+        size_t at = 0;
+        while (c.in.used - at >= sizeof(Header)) {
+            Header h;
+            std::memcpy(&h, c.in.data.data() + at, sizeof h);
+            const bool echo = h.reply_length == kEcho;
+            if (h.length > kMaxTcpPayload || (!echo && h.reply_length > body_.size())) return false;
+            if (c.in.used - at < sizeof h + h.length) break;
+            replies_.push_back({echo ? h.length : h.reply_length, 0, h.id});
+            sources_.push_back(echo ? c.in.data.data() + at + sizeof h : body_.data());
+            at += sizeof h + h.length;
+        }
+        if (!replies_.empty()) {
+            iov_.clear();
+            for (size_t i = 0; i < replies_.size(); i++) {
+                iov_.push_back({&replies_[i], sizeof(Header)});
+                if (replies_[i].length) iov_.push_back({const_cast<uint8_t *>(sources_[i]), replies_[i].length});
+            }
+            requests.fetch_add(replies_.size(), std::memory_order_relaxed);
+            // Unsent bytes are copied out before the buffer moves below
+            if (!gatherSend(c.fd, iov_.data(), iov_.size(), c.out)) return false;
+        }
+        c.in.consume(at);
+        return true;
+    }
+
+    // Receive datagrams in batches and answer each batch with one call
+    void answerDatagrams() {
+        const unsigned batch = unsigned(in_msgs_.size());
+        for (;;) {
+            for (unsigned i = 0; i < batch; i++) in_msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            int n = ::recvmmsg(fd_, in_msgs_.data(), batch, MSG_DONTWAIT, nullptr);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;  // EAGAIN: all read
+            unsigned count = 0;
+            for (int i = 0; i < n; i++) {
+                const uint8_t *data = &datagrams_[size_t(i) * kDatagram];
+                size_t size = in_msgs_[i].msg_len;
+                Header h;
+                if (size < sizeof h) continue;
+                std::memcpy(&h, data, sizeof h);
+                const bool echo = h.reply_length == kEcho;
+                if (h.length != size - sizeof h || (!echo && h.reply_length > body_.size())) continue;
+                replies_[count] = {echo ? h.length : h.reply_length, 0, h.id};
+                iovec *iov = &iov_[2 * count];
+                iov[0] = {&replies_[count], sizeof(Header)};
+                iov[1] = {const_cast<uint8_t *>(echo ? data + sizeof h : body_.data()), replies_[count].length};
+                msghdr &msg = out_msgs_[count].msg_hdr;
+                std::memset(&msg, 0, sizeof msg);
+                msg.msg_name = &from_[i];
+                msg.msg_namelen = in_msgs_[i].msg_hdr.msg_namelen;
+                msg.msg_iov = iov;
+                msg.msg_iovlen = 2;
+                count++;
+            }
+            requests.fetch_add(count, std::memory_order_relaxed);
+            for (unsigned sent = 0; sent < count;) {
+                int m = ::sendmmsg(fd_, out_msgs_.data() + sent, count - sent, 0);
+                if (m < 0 && errno == EINTR) continue;
+                if (m <= 0) break;  // buffer full: UDP may drop, the client counts it lost
+                sent += unsigned(m);
+            }
+        }
+    }
+
+    const ServerConfig &config_;
+    const std::vector<uint8_t> &body_;
+    int fd_ = -1, epoll_fd_ = -1, wake_fd_ = -1;
+    uint16_t port_ = 0;
+    std::thread thread_;
+    std::vector<std::unique_ptr<Connection>> connections_;  // by file descriptor
+    // Reused for every batch of replies
+    std::vector<Header> replies_;
+    std::vector<const uint8_t *> sources_;
+    std::vector<iovec> iov_;
+    // UDP
+    std::vector<uint8_t> datagrams_;
+    std::vector<iovec> in_iov_;
+    std::vector<mmsghdr> in_msgs_, out_msgs_;
+    std::vector<sockaddr_in> from_;
+};
+
+}  // namespace detail
+
+class Server {
+public:
+    Server() = default;
+    ~Server() { stop(); }
+
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    // Open the sockets and start the event loops; "" on success
+    std::string start(const ServerConfig &config) {
+        stop();
+        config_ = config;
+        config_.reactors = std::max(1u, config_.reactors);
+        size_t body = config_.protocol == Protocol::Udp ? std::min(config_.max_reply, kMaxUdpPayload)
+                                                        : config_.max_reply;
+        body_.resize(body);
+        for (size_t i = 0; i < body; i++) body_[i] = replyByte(i);
+        uint16_t port = config_.port;
+        for (unsigned i = 0; i < config_.reactors; i++) {
+            reactors_.emplace_back(new detail::Reactor(config_, body_));
+            std::string error = reactors_.back()->open(port);
+            if (!error.empty()) {
+                stop();
+                return error;
+            }
+            port = reactors_.back()->port();  // the others join the first one's port
+        }
+        port_ = port;
+        for (unsigned i = 0; i < config_.reactors; i++) reactors_[i]->start(i);
+        return "";
+    }
+
+    void stop() { reactors_.clear(); }
+
+    uint16_t port() const { return port_; }
+
+    uint64_t requests() const {
+        uint64_t total = 0;
+        for (const auto &r : reactors_) total += r->requests.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // How the kernel spread the work
+    std::vector<uint64_t> requestsPerReactor() const {
+        std::vector<uint64_t> counts;
+        for (const auto &r : reactors_) counts.push_back(r->requests.load(std::memory_order_relaxed));
+        return counts;
+    }
+
+    std::vector<uint64_t> connectionsPerReactor() const {
+        std::vector<uint64_t> counts;
+        for (const auto &r : reactors_) counts.push_back(r->connections.load(std::memory_order_relaxed));
+        return counts;
+    }
+
+private:
+    ServerConfig config_;
+    std::vector<uint8_t> body_;
+    std::vector<std::unique_ptr<detail::Reactor>> reactors_;
+    uint16_t port_ = 0;
+};
+
+// ---- The load generator ----
+
+namespace detail {
+
+// One client thread: its share of the connections on its own epoll loop.
+// Each connection keeps `depth` requests in flight; an answer is followed
+// at once by a new request (a closed loop).
+class LoadThread {
+public:
+    LoadResult result;
+
+    LoadThread(const LoadConfig &config, unsigned connections) : config_(config), peers_(connections) {
+        depth_ = std::max(1u, config.depth);
+        reply_bytes_ = config.reply == Reply::Echo ? config.request_bytes : config.reply_bytes;
+        payload_.resize(config.request_bytes);
+        for (size_t i = 0; i < payload_.size(); i++) payload_[i] = requestByte(0, i);
+    }
+
+    ~LoadThread() {
+        for (Peer &p : peers_) {
+            if (p.fd >= 0) ::close(p.fd);
+        }
+        if (epoll_fd_ >= 0) ::close(epoll_fd_);
+    }
+
+    LoadThread(const LoadThread &) = delete;
+    LoadThread &operator=(const LoadThread &) = delete;
+
+    void run() {
+        const bool tcp = config_.protocol == Protocol::Tcp;
+        if (!connectAll(tcp)) return;
+        const uint64_t start = nowNs();
+        const uint64_t deadline = start + uint64_t(config_.seconds * 1e9);
+        uint64_t drain_deadline = 0;
+        last_reply_ = start;
+        for (Peer &p : peers_) {
+            if (!(tcp ? sendRequests(p, depth_) : sendBatch(p))) return;
+        }
+        epoll_event events[64];
+        while (result.ok()) {
+            uint64_t now = nowNs();
+            if (!stopping_ && now >= deadline) {
+                stopping_ = true;  // no new requests; wait for the ones in flight
+                drain_deadline = now + 1000000000;
+            }
+            if (!tcp) expireBatches(now);
+            if (stopping_ && (inFlight() == 0 || now >= drain_deadline)) break;
+            int n = ::epoll_wait(epoll_fd_, events, 64, 1);
+            if (n < 0 && errno != EINTR) {
+                result.error = systemError("epoll_wait");
+                break;
+            }
+            for (int i = 0; i < n && result.ok(); i++) {
+                Peer &p = peers_[events[i].data.fd];
+                if (tcp) {
+                    if (!p.out.flush(p.fd)) result.error = systemError("send");
+                    readReplies(p);
+                } else {
+                    readDatagrams(p);
+                }
+            }
+        }
+        result.seconds = double(last_reply_ - start) / 1e9;
+    }
+
+private:
+    struct Peer {
+        int fd = -1;
+        InBuffer in{65536};
+        Pending out;
+        std::vector<uint64_t> sent_at;  // by id % depth
+        std::vector<bool> answered;     // UDP: by slot in the batch
+        uint64_t next_id = 0;           // the next request's id
+        unsigned in_flight = 0;
+        uint64_t batch_start = 0;       // UDP: when the batch was sent
+    };
+
+    bool connectAll(bool tcp) {
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            result.error = systemError("epoll_create1");
+            return false;
+        }
+        sockaddr_in addr;
+        if (!address(config_.host, config_.port, addr)) {
+            result.error = "not an IPv4 address: " + config_.host;
+            return false;
+        }
+        for (size_t i = 0; i < peers_.size(); i++) {
+            Peer &p = peers_[i];
+            p.sent_at.resize(depth_);
+            p.answered.resize(depth_);
+            p.fd = ::socket(AF_INET, (tcp ? SOCK_STREAM : SOCK_DGRAM) | SOCK_CLOEXEC, 0);
+            if (p.fd < 0 || ::connect(p.fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) != 0) {
+                result.error = systemError("connect");
+                return false;
+            }
+            if (tcp) setNoDelay(p.fd);
+            ::fcntl(p.fd, F_SETFL, ::fcntl(p.fd, F_GETFL) | O_NONBLOCK);
+            // The peer's index stands in for the descriptor in events
+            epoll_event event;
+            std::memset(&event, 0, sizeof event);
+            event.events = EPOLLIN | EPOLLET | (tcp ? EPOLLOUT | EPOLLRDHUP : 0u);
+            event.data.fd = int(i);
+            if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, p.fd, &event) != 0) {
+                result.error = systemError("epoll_ctl");
+                return false;
+            }
+        }
+        if (!tcp) {
+            const size_t slot = sizeof(Header) + reply_bytes_;
+            datagrams_.resize(depth_ * slot);
+            in_iov_.resize(depth_);
+            in_msgs_.resize(depth_);
+            for (unsigned i = 0; i < depth_; i++) {
+                in_iov_[i] = {&datagrams_[i * slot], slot};
+                std::memset(&in_msgs_[i], 0, sizeof in_msgs_[i]);
+                in_msgs_[i].msg_hdr.msg_iov = &in_iov_[i];
+                in_msgs_[i].msg_hdr.msg_iovlen = 1;
+            }
+        }
+        return true;
+    }
+
+    unsigned inFlight() const {
+        unsigned total = 0;
+        for (const Peer &p : peers_) total += p.in_flight;
+        return total;
+    }
+
+    // Headers and payload pieces for `count` new requests, in iov_
+    void buildRequests(Peer &p, unsigned count, uint64_t now) {
+        const size_t size = config_.request_bytes;
+        const uint32_t reply = config_.reply == Reply::Echo ? kEcho : uint32_t(config_.reply_bytes);
+        headers_.resize(count);
+        if (config_.verify) scratch_.resize(count * size);
+        iov_.clear();
+        for (unsigned k = 0; k < count; k++) {
+            uint64_t id = p.next_id++;
+            headers_[k] = {uint32_t(size), reply, id};
+            p.sent_at[id % depth_] = now;
+            uint8_t *payload = payload_.data();
+            if (config_.verify) {
+                payload = &scratch_[k * size];
+                for (size_t i = 0; i < size; i++) payload[i] = requestByte(id, i);
+            }
+            iov_.push_back({&headers_[k], sizeof(Header)});
+            iov_.push_back({payload, size});
+        }
+        p.in_flight += count;
+    }
+
+    bool rightReply(const Header &h, const uint8_t *payload) const {
+        if (h.length != reply_bytes_) return false;
+        if (!config_.verify) return true;
+        for (size_t i = 0; i < h.length; i++) {
+            uint8_t expected = config_.reply == Reply::Echo ? requestByte(h.id, i) : replyByte(i);
+            if (payload[i] != expected) return false;
+        }
+        return true;
+    }
+
+    void answered(const Peer &p, uint64_t id, uint64_t now) {
+        result.requests++;
+        result.bytes += config_.request_bytes + reply_bytes_;
+        uint64_t took = now - p.sent_at[id % depth_];
+        result.latency_ns.push_back(uint32_t(std::min<uint64_t>(took, UINT32_MAX)));
+        last_reply_ = now;
+    }
+
+    // ---- TCP: requests pipelined on a stream, replies in order ----
+
+    bool sendRequests(Peer &p, unsigned count) {
+        buildRequests(p, count, nowNs());
+        if (!gatherSend(p.fd, iov_.data(), iov_.size(), p.out)) {
+            result.error = systemError("send");
+            return false;
+        }
+        return true;
+    }
+
+    void readReplies(Peer &p) {
+        while (result.ok()) {
+            p.in.reserve();
+            ssize_t n = ::recv(p.fd, p.in.data.data() + p.in.used, p.in.data.size() - p.in.used, 0);
+            if (n == 0) {
+                result.error = "the server closed the connection";
+                return;
+            }
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) result.error = systemError("recv");
+                return;
+            }
+            const uint64_t now = nowNs();
+            p.in.used += size_t(n);
+            size_t at = 0;
+            unsigned done = 0;
+            while (p.in.used - at >= sizeof(Header)) {
+                Header h;
+                std::memcpy(&h, p.in.data.data() + at, sizeof h);
+                if (h.length > kMaxTcpPayload) {
+                    result.error = "a reply longer than any request asks for";
+                    return;
+                }
+                if (p.in.used - at < sizeof h + h.length) break;
+                if (p.in_flight == 0 || h.id != p.next_id - p.in_flight ||
+                    !rightReply(h, p.in.data.data() + at + sizeof h)) {
+                    result.error = "wrong reply to request " + std::to_string(p.next_id - p.in_flight);
+                    return;
+                }
+                answered(p, h.id, now);
+                p.in_flight--;
+                done++;
+                at += sizeof h + h.length;
+            }
+            p.in.consume(at);
+            if (done > 0 && !stopping_ && !sendRequests(p, done)) return;
+        }
+    }
+
+    // ---- UDP: a batch of datagrams, then wait for all their replies ----
+
+    bool sendBatch(Peer &p) {
+        uint64_t now = nowNs();
+        uint64_t first = p.next_id;
+        buildRequests(p, depth_, now);
+        p.batch_start = now;
+        std::fill(p.answered.begin(), p.answered.end(), false);
+        out_msgs_.resize(depth_);
+        for (unsigned k = 0; k < depth_; k++) {
+            std::memset(&out_msgs_[k], 0, sizeof out_msgs_[k]);
+            out_msgs_[k].msg_hdr.msg_iov = &iov_[2 * k];
+            out_msgs_[k].msg_hdr.msg_iovlen = 2;
+        }
+        for (unsigned sent = 0; sent < depth_;) {
+            int m;
+            if (config_.batch_calls) {
+                m = ::sendmmsg(p.fd, out_msgs_.data() + sent, depth_ - sent, 0);
+            } else {
+                p.sent_at[(first + sent) % depth_] = nowNs();
+                m = ::sendmsg(p.fd, &out_msgs_[sent].msg_hdr, 0) < 0 ? -1 : 1;
+            }
+            if (m < 0 && errno == EINTR) continue;
+            if (m < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS) {
+                result.error = systemError("send");
+                return false;
+            }
+            if (m <= 0) break;  // no room: the rest will time out as lost
+            sent += unsigned(m);
+        }
+        return true;
+    }
+
+    void readDatagrams(Peer &p) {
+        while (result.ok()) {
+            int n;
+            if (config_.batch_calls) {
+                n = ::recvmmsg(p.fd, in_msgs_.data(), depth_, MSG_DONTWAIT, nullptr);
+            } else {
+                ssize_t r = ::recv(p.fd, in_iov_[0].iov_base, in_iov_[0].iov_len, MSG_DONTWAIT);
+                in_msgs_[0].msg_len = unsigned(std::max<ssize_t>(r, 0));
+                n = r < 0 ? -1 : 1;
+            }
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                // ECONNREFUSED: nobody listens on the port
+                if (errno != EAGAIN && errno != EWOULDBLOCK) result.error = systemError("recv");
+                return;
+            }
+            const uint64_t now = nowNs();
+            const uint64_t first = p.next_id - depth_;
+            for (int i = 0; i < n; i++) {
+                const uint8_t *data = static_cast<const uint8_t *>(in_iov_[i].iov_base);
+                Header h;
+                if (in_msgs_[i].msg_len < sizeof h) continue;
+                std::memcpy(&h, data, sizeof h);
+                // Late answers to a batch already given up on are ignored
+                if (h.id < first || h.id >= p.next_id || p.answered[h.id - first] || p.in_flight == 0) continue;
+                if (h.length != in_msgs_[i].msg_len - sizeof h || !rightReply(h, data + sizeof h)) {
+                    result.error = "wrong reply to request " + std::to_string(h.id);
+                    return;
+                }
+                p.answered[h.id - first] = true;
+                answered(p, h.id, now);
+                p.in_flight--;
+            }
+            if (p.in_flight == 0 && !stopping_ && !sendBatch(p)) return;
+        }
+    }
+
+    // UDP gives no second chance: a batch with answers missing for too
+    // long counts them lost and moves on
+    void expireBatches(uint64_t now) {
+        for (Peer &p : peers_) {
+            if (p.in_flight == 0 || now - p.batch_start < kUdpTimeoutNs) continue;
+            result.lost += p.in_flight;
+            p.in_flight = 0;
+            if (!stopping_ && !sendBatch(p)) return;
+        }
+    }
+
+    const LoadConfig &config_;
+    std::vector<Peer> peers_;
+    unsigned depth_;
+    size_t reply_bytes_;
+    int epoll_fd_ = -1;
+    bool stopping_ = false;
+    uint64_t last_reply_ = 0;
+    std::vector<uint8_t> payload_, scratch_;
+    std::vector<Header> headers_;
+    std::vector<iovec> iov_;
+    // UDP
+    std::vector<uint8_t> datagrams_;
+    std::vector<iovec> in_iov_;
+    std::vector<mmsghdr> in_msgs_, out_msgs_;
+};
+
+}  // namespace detail
+
+// Keep a server busy for config.seconds and measure every answer
+inline LoadResult runLoad(const LoadConfig &config) {
+    LoadResult result;
+    const size_t limit = config.protocol == Protocol::Udp ? kMaxUdpPayload : kMaxTcpPayload;
+    const size_t reply = config.reply == Reply::Echo ? config.request_bytes : config.reply_bytes;
+    if (config.request_bytes > limit || reply > limit) {
+        result.error = "messages are limited to " + std::to_string(limit) + " bytes";
+        return result;
+    }
+    if (config.connections == 0) {
+        result.error = "no connections";
+        return result;
+    }
+    const unsigned threads = std::min(std::max(1u, config.threads), config.connections);
+    std::vector<std::unique_ptr<detail::LoadThread>> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        unsigned share = config.connections / threads + (t < config.connections % threads ? 1 : 0);
+        workers.emplace_back(new detail::LoadThread(config, share));
+    }
+    if (threads == 1) {
+        workers[0]->run();
+    } else {
+        std::vector<std::thread> running;
+        for (auto &w : workers) running.emplace_back([&w] { w->run(); });
+        for (std::thread &t : running) t.join();
+    }
+    for (auto &w : workers) {
+        const LoadResult &part = w->result;
+        if (result.ok() && !part.ok()) result.error = part.error;
+        result.requests += part.requests;
+        result.lost += part.lost;
+        result.bytes += part.bytes;
+        result.seconds = std::max(result.seconds, part.seconds);
+        result.latency_ns.insert(result.latency_ns.end(), part.latency_ns.begin(), part.latency_ns.end());
+    }
+    std::sort(result.latency_ns.begin(), result.latency_ns.end());
+    return result;
+}
+
+}  // namespace loopback
+
+#endif
@@ -0,0 +1,326 @@
+/*
+ * number_stream.hpp - Convert Millions of Numbers Between Bases
+ * NumberConverter.jsx in the learning app, for whole files at a time.
+ *
+ * "cout << n << endl" is fine for a few lines, but endl also FLUSHES:
+ * every line becomes its own write() system call. This header does the
+ * work in big pieces instead:
+ *   - numbers are parsed straight out of the input bytes (no streams),
+ *   - results go into one big reusable OutputBuffer, written with a
+ *     single write() when it fills up (no flush per line, no allocation
+ *     per number),
+ *   - the input is split into chunks at whitespace, and each thread
+ *     converts its own chunk into its own buffer.
+ *
+ *   numconv::Options opt;
+ *   opt.from = 10;
+ *   opt.to = 16;
+ *   numconv::Converter conv(opt, 4);           // 4 threads
+ *   numconv::Result r = conv.convertFd(0, 1);  // stdin -> stdout
+ *   if (!r.ok()) ...                            // r.error_offset, r.error
+ *
+ * Numbers are unsigned 64-bit, separated by whitespace. Input may use
+ * the 0b/0o/0x prefix of its base. Output is one number per line.
+ */
+
+#ifndef NUMBER_STREAM_HPP
+#define NUMBER_STREAM_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace numconv {
+
+struct Options {
+    int from = 10;        // input base: 2, 8, 10 or 16
+    int to = 16;          // output base: 2, 8, 10 or 16
+    bool prefix = false;  // write 0b / 0o / 0x in front
+    bool upper = false;   // A-F instead of a-f
+};
+
+enum class Status { Ok, BadDigit, Overflow, TooLong, ReadFailed, WriteFailed };
+
+inline const char *statusText(Status s) {
+    switch (s) {
+    case Status::Ok:          return "ok";
+    case Status::BadDigit:    return "not a number in this base";
+    case Status::Overflow:    return "too big for 64 bits";
+    case Status::TooLong:     return "token too long to be a number";
+    case Status::ReadFailed:  return "can't read input";
+    default:                  return "can't write output";
+    }
+}
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// Value of one digit (any base up to 16), or 255 if it isn't one
+inline unsigned digitValue(char c) {
+    if (c >= '0' && c <= '9') return unsigned(c - '0');
+    unsigned lower = unsigned(c | 0x20);
+    if (lower >= 'a' && lower <= 'f') return lower - 'a' + 10;
+    return 255;
+}
+
+inline const char *basePrefix(int base) {
+    return base == 2 ? "0b" : base == 8 ? "0o" : base == 16 ? "0x" : "";
+}
+
+// Parse [begin, end) as one number. Accepts the base's own prefix.
+inline Status parseNumber(const char *begin, const char *end, int base, uint64_t &value) {
+    const char *prefix = basePrefix(base);
+    if (prefix[0] && end - begin > 2 && begin[0] == '0' && (begin[1] | 0x20) == prefix[1]) begin += 2;
+    if (begin == end) return Status::BadDigit;
+    uint64_t v = 0;
+    for (const char *p = begin; p < end; p++) {
+        unsigned d = digitValue(*p);
+        if (d >= unsigned(base)) return Status::BadDigit;
+        if (__builtin_mul_overflow(v, uint64_t(base), &v) || __builtin_add_overflow(v, d, &v)) {
+            return Status::Overflow;
+        }
+    }
+    value = v;
+    return Status::Ok;
+}
+
+// Write v in the base (no prefix, no '\0'); returns the length (max 64)
+inline size_t formatNumber(char *out, uint64_t v, int base, bool upper) {
+    static const char digits_lower[] = "0123456789abcdef";
+    static const char digits_upper[] = "0123456789ABCDEF";
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+    if (v == 0) { out[0] = '0'; return 1; }
+    char tmp[64];
+    char *p = tmp + sizeof(tmp);
+    if (base == 10) {
+        // Two digits per divide: half as many slow divisions
+        while (v >= 100) {
+            unsigned two = unsigned(v % 100);
+            v /= 100;
+            *--p = pairs[2 * two + 1];
+            *--p = pairs[2 * two];
+        }
+        if (v >= 10) { *--p = pairs[2 * v + 1]; *--p = pairs[2 * v]; }
+        else *--p = char('0' + v);
+    } else {
+        // Powers of two: each digit is just a few bits, no division
+        const char *digits = upper ? digits_upper : digits_lower;
+        unsigned shift = base == 16 ? 4 : base == 8 ? 3 : 1;
+        uint64_t mask = uint64_t(base - 1);
+        while (v) { *--p = digits[v & mask]; v >>= shift; }
+    }
+    size_t len = size_t(tmp + sizeof(tmp) - p);
+    memcpy(out, p, len);
+    return len;
+}
+
+// A growable byte buffer that is cleared, never freed, between uses
+class OutputBuffer {
+public:
+    explicit OutputBuffer(size_t capacity = 1 << 20) : bytes_(capacity) {}
+
+    // Room for at least n more bytes; write there, then commit()
+    char *reserve(size_t n) {
+        if (used_ + n > bytes_.size()) bytes_.resize((used_ + n) * 2);
+        return bytes_.data() + used_;
+    }
+    void commit(size_t n) { used_ += n; }
+    void append(const char *text, size_t n) { memcpy(reserve(n), text, n); commit(n); }
+
+    const char *data() const { return bytes_.data(); }
+    size_t size() const { return used_; }
+    void clear() { used_ = 0; }
+
+    // Write everything to fd (retrying short writes) and clear
+    bool flushTo(int fd) {
+        size_t done = 0;
+        while (done < used_) {
+            ssize_t n = ::write(fd, bytes_.data() + done, used_ - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            done += size_t(n);
+        }
+        used_ = 0;
+        return true;
+    }
+
+private:
+    std::vector<char> bytes_;
+    size_t used_ = 0;
+};
+
+// What one piece of input turned into
+struct Result {
+    Status status = Status::Ok;
+    uint64_t numbers = 0;
+    uint64_t error_offset = 0;  // byte offset of the bad token in the input
+    std::string error;          // the bad token itself
+
+    bool ok() const { return status == Status::Ok; }
+};
+
+// Convert every number in [begin, end) into out. Stops at the first
+// bad token; `base_offset` is where `begin` sits in the whole input.
+inline Result convertChunk(const char *begin, const char *end, const Options &opt,
+                           OutputBuffer &out, uint64_t base_offset = 0) {
+    Result r;
+    const char *prefix = opt.prefix ? basePrefix(opt.to) : "";
+    size_t prefix_len = strlen(prefix);
+    const char *p = begin;
+    for (;;) {
+        while (p < end && isBlank(*p)) p++;
+        if (p == end) break;
+        const char *token = p;
+        while (p < end && !isBlank(*p)) p++;
+        uint64_t value;
+        Status s = parseNumber(token, p, opt.from, value);
+        if (s != Status::Ok) {
+            r.status = s;
+            r.error_offset = base_offset + uint64_t(token - begin);
+            r.error.assign(token, size_t(p - token) > 64 ? 64 : size_t(p - token));
+            break;
+        }
+        char *dst = out.reserve(prefix_len + 65);
+        memcpy(dst, prefix, prefix_len);
+        size_t len = prefix_len + formatNumber(dst + prefix_len, value, opt.to, opt.upper);
+        dst[len++] = '\n';
+        out.commit(len);
+        r.numbers++;
+    }
+    return r;
+}
+
+// Converts a whole input in rounds: each round, every thread converts
+// one block (split at whitespace), then the blocks are written in order.
+class Converter {
+public:
+    explicit Converter(const Options &opt, unsigned threads = 1, size_t block_bytes = 4 << 20)
+        : opt_(opt), threads_(threads ? threads : 1), block_(block_bytes),
+          buffers_(threads_), results_(threads_) {}
+
+    // Input that is already in memory (e.g. an mmap'ed file)
+    Result convertMemory(const char *data, size_t size, int out_fd) {
+        Result total;
+        size_t pos = 0;
+        while (pos < size && total.ok()) {
+            size_t take = cutAtBlank(data + pos, size - pos, block_ * threads_, true);
+            runRound(data + pos, take, pos, out_fd, total);
+            pos += take;
+        }
+        return total;
+    }
+
+    // Input from a pipe or file descriptor, read in big pieces. A number
+    // cut off at the end of a read is carried over to the next round.
+    // A read error stops with ReadFailed (errno is left as read() set it).
+    Result convertFd(int in_fd, int out_fd) {
+        Result total;
+        std::vector<char> input(block_ * threads_ + 4096);
+        size_t have = 0;
+        uint64_t offset = 0;
+        bool eof = false;
+        while (total.ok() && (!eof || have > 0)) {
+            while (!eof && have < input.size()) {
+                ssize_t n = ::read(in_fd, input.data() + have, input.size() - have);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0) {
+                    total.status = Status::ReadFailed;
+                    total.error_offset = offset + have;
+                    return total;
+                }
+                if (n == 0) eof = true;
+                else have += size_t(n);
+            }
+            size_t take = cutAtBlank(input.data(), have, have, eof);
+            if (take == 0) {
+                if (eof) break;
+                if (input.size() >= kMaxToken) {
+                    // No number is this long: stop rather than grow forever
+                    total.status = Status::TooLong;
+                    total.error_offset = offset;
+                    total.error.assign(input.data(), 64);
+                    return total;
+                }
+                input.resize(input.size() * 2);  // one giant token: read more
+                continue;
+            }
+            runRound(input.data(), take, offset, out_fd, total);
+            memmove(input.data(), input.data() + take, have - take);
+            have -= take;
+            offset += take;
+        }
+        return total;
+    }
+
+private:
+    // The read buffer only grows past this for one token that fills it
+    static constexpr size_t kMaxToken = 16 << 20;
+
+    // How much of [data, data + size) to take so it ends at whitespace
+    // (at most `limit`, all of it at the end of the input)
+    static size_t cutAtBlank(const char *data, size_t size, size_t limit, bool at_end) {
+        if (size <= limit && at_end) return size;
+        size_t cut = size < limit ? size : limit;
+        while (cut > 0 && !isBlank(data[cut - 1])) cut--;
+        if (cut == 0 && at_end) {
+            // One token longer than the limit: take all of it
+            cut = limit;
+            while (cut < size && !isBlank(data[cut])) cut++;
+        }
+        return cut;
+    }
+
+    void runRound(const char *data, size_t size, uint64_t offset, int out_fd, Result &total) {
+        // Split into one piece per thread, each ending at whitespace
+        std::vector<size_t> starts(threads_ + 1, size);
+        starts[0] = 0;
+        for (unsigned t = 1; t < threads_; t++) {
+            size_t cut = size * t / threads_;
+            if (cut < starts[t - 1]) cut = starts[t - 1];
+            while (cut < size && !isBlank(data[cut])) cut++;
+            starts[t] = cut;
+        }
+        auto work = [&](unsigned t) {
+            buffers_[t].clear();
+            results_[t] = convertChunk(data + starts[t], data + starts[t + 1], opt_, buffers_[t],
+                                       offset + starts[t]);
+        };
+        if (threads_ == 1) {
+            work(0);
+        } else {
+            std::vector<std::thread> pool;
+            for (unsigned t = 0; t < threads_; t++) pool.emplace_back(work, t);
+            for (auto &th : pool) th.join();
+        }
+        // Write in input order; stop after the first error
+        for (unsigned t = 0; t < threads_; t++) {
+            total.numbers += results_[t].numbers;
+            if (!buffers_[t].flushTo(out_fd)) { total.status = Status::WriteFailed; return; }
+            if (!results_[t].ok()) {
+                total.status = results_[t].status;
+                total.error_offset = results_[t].error_offset;
+                total.error = results_[t].error;
+                return;
+            }
+        }
+    }
+
+    Options opt_;
+    unsigned threads_;
+    size_t block_;
+    std::vector<OutputBuffer> buffers_;
+    std::vector<Result> results_;
+};
+
+}  // namespace numconv
+
+#endif  // NUMBER_STREAM_HPP
@@ -0,0 +1,448 @@
+/*
+ * rank_select.hpp - Counting and Finding Set Bits in Billions, Instantly
+ * 2_binary_ops.cpp tests one bit; this answers questions about all of them.
+ *
+ * Two questions come up whenever bits mark things (rows, words, nodes):
+ *   rank1(i)    how many 1s are before position i?
+ *   select1(k)  where is the k-th 1 (counting from 0)?
+ * Counting from the start every time costs a pass over the bits. A small
+ * directory of counts, built once, answers both with a few memory reads:
+ *
+ *   bits:    [ 2048-bit block | 2048-bit block | ... ]   32 words each
+ *   blocks:  one 64-bit entry per block: the 1s before the block (32 bits),
+ *            and the 1s in its first three 512-bit sub-blocks (10 bits
+ *            each; the fourth follows from the next entry)
+ *   l0:      the 1s before every 2^32 bits, so 32 bits above are enough
+ *   samples: the block of every 8192nd 1, where select starts looking
+ *
+ * That is 64 bits per 2048, about 3.1% on top of the bits (plus 0.2% or
+ * less for samples). rank1 reads one entry and counts up to 8 words with
+ * POPCNT. select1 jumps to its sample, binary-searches the few blocks up
+ * to the next one, picks the sub-block and word, and finds the bit inside
+ * the word with one PDEP (BMI2) instruction.
+ *
+ *   succinct::Builder b;                     // bits arrive as a stream
+ *   b.push(true);                            // one bit
+ *   b.pushWord(word, 64);                    // or up to 64 at a time
+ *   succinct::BitVector v = b.finish();      // directory built on the way
+ *   v.rank1(1000), v.select1(7), v[42]
+ *   v.save("bits.rs");                       // "" on success
+ *   succinct::BitVector m;
+ *   m.open("bits.rs");                       // mmap: nothing read up front
+ *
+ * File format (native byte order; a check word rejects the other one):
+ *   0   "RANKSEL1", byte-order check (u64 0x0102030405060708)
+ *   16  bits, ones, word count, l0 count, block entry count, sample count
+ *       (u64 each), then zeros up to 64
+ *   64  words, l0, block entries, samples: each starts at a multiple of 64
+ *
+ * Up to 2^43 bits (sample entries are 32-bit block numbers).
+ */
+
+#ifndef RANK_SELECT_HPP
+#define RANK_SELECT_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define RANK_SELECT_X86 1
+#else
+#define RANK_SELECT_X86 0
+#endif
+
+namespace succinct {
+
+const uint64_t kBlockBits = 2048;
+const uint64_t kBlockWords = kBlockBits / 64;
+const uint64_t kSubBlockWords = 8;
+const uint64_t kL0Bits = uint64_t(1) << 32;
+const uint64_t kBlocksPerL0 = kL0Bits / kBlockBits;
+const uint64_t kSampleRate = 8192;  // a select sample every this many 1s
+const char kFileMagic[9] = "RANKSEL1";
+const uint64_t kOrderCheck = 0x0102030405060708ull;
+
+// ---- Selecting inside one word: the position of its r-th 1 (r < popcount) ----
+
+// Clear the lowest 1 r times
+inline unsigned selectInWordLoop(uint64_t word, unsigned r) {
+    for (; r > 0; r--) word &= word - 1;
+    return unsigned(__builtin_ctzll(word));
+}
+
+// Halve the word by popcount until a byte is left, then loop at most 7 times
+inline unsigned selectInWordBroadword(uint64_t word, unsigned r) {
+    unsigned pos = 0;
+    for (unsigned half = 32; half >= 8; half /= 2) {
+        unsigned low = unsigned(__builtin_popcountll(word & ((uint64_t(1) << half) - 1)));
+        if (r >= low) {
+            r -= low;
+            word >>= half;
+            pos += half;
+        }
+    }
+    return pos + selectInWordLoop(word, r);
+}
+
+#if RANK_SELECT_X86
+// PDEP spreads the bits of 1 << r onto the 1s of the word: exactly the
+// r-th 1 survives, and counting trailing zeros gives its position.
+// (Fast on Intel since Haswell and AMD since Zen 3; older AMD runs it in
+// microcode, slower than the broadword version.)
+__attribute__((target("bmi,bmi2")))
+inline unsigned selectInWordPdep(uint64_t word, unsigned r) {
+    return unsigned(_tzcnt_u64(_pdep_u64(uint64_t(1) << r, word)));
+}
+#endif
+
+struct Cpu {
+    bool popcnt = false;
+    bool bmi2 = false;
+};
+
+inline const Cpu &cpu() {
+    static const Cpu found = [] {
+        Cpu c;
+#if RANK_SELECT_X86
+        __builtin_cpu_init();
+        c.popcnt = __builtin_cpu_supports("popcnt");
+        c.bmi2 = c.popcnt && __builtin_cpu_supports("bmi2");
+#endif
+        return c;
+    }();
+    return found;
+}
+
+class Builder;
+
+class BitVector {
+public:
+    static constexpr uint64_t npos = ~uint64_t(0);
+
+    BitVector() = default;
+    ~BitVector() { unmap(); }
+
+    BitVector(BitVector &&other) noexcept { *this = static_cast<BitVector &&>(other); }
+    BitVector &operator=(BitVector &&other) noexcept {
+        if (this == &other) return *this;
+        unmap();
+        bits_ = other.bits_;
+        ones_ = other.ones_;
+        words_ = other.words_;
+        l0_ = other.l0_;
+        blocks_ = other.blocks_;
+        samples_ = other.samples_;
+        word_count_ = other.word_count_;
+        l0_count_ = other.l0_count_;
+        block_count_ = other.block_count_;
+        sample_count_ = other.sample_count_;
+        // Moving a vector keeps its buffer, so the pointers stay right
+        own_words_ = static_cast<std::vector<uint64_t> &&>(other.own_words_);
+        own_l0_ = static_cast<std::vector<uint64_t> &&>(other.own_l0_);
+        own_blocks_ = static_cast<std::vector<uint64_t> &&>(other.own_blocks_);
+        own_samples_ = static_cast<std::vector<uint32_t> &&>(other.own_samples_);
+        map_ = other.map_;
+        map_size_ = other.map_size_;
+        other.map_ = nullptr;
+        other.bits_ = other.ones_ = 0;
+        other.word_count_ = other.l0_count_ = other.block_count_ = other.sample_count_ = 0;
+        return *this;
+    }
+
+    BitVector(const BitVector &) = delete;
+    BitVector &operator=(const BitVector &) = delete;
+
+    uint64_t size() const { return bits_; }
+    uint64_t ones() const { return ones_; }
+    const uint64_t *words() const { return words_; }
+    uint64_t wordCount() const { return word_count_; }
+    bool mapped() const { return map_ != nullptr; }
+
+    // Bytes of the bits themselves, and of the directory on top
+    uint64_t bitBytes() const { return word_count_ * 8; }
+    uint64_t indexBytes() const { return (l0_count_ + block_count_) * 8 + sample_count_ * 4; }
+
+    bool operator[](uint64_t i) const { return (words_[i / 64] >> (i % 64)) & 1; }
+
+    // The 1s in positions [0, i), for i from 0 to size()
+    uint64_t rank1(uint64_t i) const {
+#if RANK_SELECT_X86
+        if (cpu().popcnt) return rankPopcnt(i);
+#endif
+        return rankAt(i);
+    }
+
+    uint64_t rank0(uint64_t i) const { return i - rank1(i); }
+
+    // The position of the k-th 1 (k from 0), or npos if k >= ones()
+    uint64_t select1(uint64_t k) const {
+        if (k >= ones_) return npos;
+#if RANK_SELECT_X86
+        if (cpu().bmi2) return selectPdep(k);
+        if (cpu().popcnt) return selectPopcnt(k);
+#endif
+        return selectAt<false>(k);
+    }
+
+    // select1 with the broadword in-word step instead of PDEP, to compare
+    // (and for older AMD CPUs, where PDEP is slow)
+    uint64_t select1NoPdep(uint64_t k) const {
+        if (k >= ones_) return npos;
+#if RANK_SELECT_X86
+        if (cpu().popcnt) return selectPopcnt(k);
+#endif
+        return selectAt<false>(k);
+    }
+
+    // Write the bits and the directory; "" on success
+    std::string save(const std::string &path) const {
+        FILE *f = std::fopen(path.c_str(), "wb");
+        if (!f) return "cannot create " + path + ": " + std::strerror(errno);
+        uint64_t header[8] = {0, kOrderCheck, bits_, ones_, word_count_, l0_count_, block_count_, sample_count_};
+        std::memcpy(&header[0], kFileMagic, 8);
+        bool good = std::fwrite(header, sizeof header, 1, f) == 1;
+        uint64_t at = sizeof header;
+        const void *parts[4] = {words_, l0_, blocks_, samples_};
+        const uint64_t sizes[4] = {word_count_ * 8, l0_count_ * 8, block_count_ * 8, sample_count_ * 4};
+        static const uint8_t zeros[64] = {};
+        for (int p = 0; p < 4 && good; p++) {
+            // An empty part may have no buffer at all, and fwrite wants one
+            good = sizes[p] == 0 || std::fwrite(parts[p], 1, sizes[p], f) == sizes[p];
+            at += sizes[p];
+            size_t pad = size_t(roundUp(at) - at);
+            good = good && std::fwrite(zeros, 1, pad, f) == pad;
+            at += pad;
+        }
+        if (std::fclose(f) != 0) good = false;
+        return good ? "" : "cannot write " + path + ": " + std::strerror(errno);
+    }
+
+    // Map a file written by save(), read-only. Nothing is read or rebuilt
+    // up front: queries fault in the pages they touch. "" on success.
+    std::string open(const std::string &path) {
+        *this = BitVector();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0) {
+            if (fd >= 0) ::close(fd);
+            return "cannot open " + path + ": " + std::strerror(errno);
+        }
+        uint64_t size = uint64_t(st.st_size);
+        void *map = size >= 64 ? ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (map == MAP_FAILED) return size < 64 ? path + " is too short" : std::string("mmap: ") + std::strerror(errno);
+        map_ = map;
+        map_size_ = size;
+        std::string error = attach(static_cast<const uint8_t *>(map), size);
+        if (!error.empty()) {
+            *this = BitVector();
+            return path + ": " + error;
+        }
+        return "";
+    }
+
+private:
+    friend class Builder;
+
+    static uint64_t roundUp(uint64_t n) { return (n + 63) / 64 * 64; }
+
+    // Point into a mapped file, after checking every size against it
+    std::string attach(const uint8_t *file, uint64_t size) {
+        uint64_t header[8];
+        std::memcpy(header, file, sizeof header);
+        if (std::memcmp(file, kFileMagic, 8) != 0) return "not a rank/select file";
+        if (header[1] != kOrderCheck) return "written with the other byte order";
+        bits_ = header[2];
+        ones_ = header[3];
+        word_count_ = header[4];
+        l0_count_ = header[5];
+        block_count_ = header[6];
+        sample_count_ = header[7];
+        const uint64_t blocks = (word_count_ + kBlockWords - 1) / kBlockWords;
+        if (word_count_ != (bits_ + 63) / 64 || block_count_ != blocks + 1 ||
+            l0_count_ != blocks / kBlocksPerL0 + 1 || sample_count_ != (ones_ + kSampleRate - 1) / kSampleRate) {
+            return "sizes do not fit together";
+        }
+        uint64_t at = 64;
+        const uint8_t *parts[4];
+        const uint64_t sizes[4] = {word_count_ * 8, l0_count_ * 8, block_count_ * 8, sample_count_ * 4};
+        for (int p = 0; p < 4; p++) {
+            if (at + sizes[p] > size) return "cut short";
+            parts[p] = file + at;
+            at = roundUp(at + sizes[p]);
+        }
+        words_ = reinterpret_cast<const uint64_t *>(parts[0]);
+        l0_ = reinterpret_cast<const uint64_t *>(parts[1]);
+        blocks_ = reinterpret_cast<const uint64_t *>(parts[2]);
+        samples_ = reinterpret_cast<const uint32_t *>(parts[3]);
+        return "";
+    }
+
+    void unmap() {
+        if (map_) ::munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+
+    // The 1s before block b
+    uint64_t before(uint64_t b) const { return l0_[b / kBlocksPerL0] + uint32_t(blocks_[b]); }
+
+    __attribute__((always_inline)) uint64_t rankAt(uint64_t i) const {
+        const uint64_t entry = blocks_[i / kBlockBits];
+        uint64_t r = l0_[i / kL0Bits] + uint32_t(entry);
+        // Earlier sub-blocks of this block: their 10-bit counts
+        const unsigned sub = unsigned(i / 512 % 4);
+        const uint64_t counts = entry >> 32;
+        r += (counts & 1023) * (sub > 0) + (counts >> 10 & 1023) * (sub > 1) + (counts >> 20 & 1023) * (sub > 2);
+        // Then whole words, and the part of the last one below i
+        const uint64_t word = i / 64;
+        for (uint64_t w = word & ~(kSubBlockWords - 1); w < word; w++) r += uint64_t(__builtin_popcountll(words_[w]));
+        if (i % 64) r += uint64_t(__builtin_popcountll(words_[word] & ((uint64_t(1) << (i % 64)) - 1)));
+        return r;
+    }
+
+    template <bool kPdep>
+    __attribute__((always_inline)) uint64_t selectAt(uint64_t k) const {
+        // The sampled block holds the (k rounded down to a sample)-th 1, the
+        // next sample's block holds a later one: the answer is in between
+        const uint64_t s = k / kSampleRate;
+        uint64_t lo = samples_[s];
+        uint64_t hi = s + 1 < sample_count_ ? samples_[s + 1] + 1 : block_count_ - 1;
+        while (hi - lo > 8) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (before(mid) <= k) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        while (lo + 1 < hi && before(lo + 1) <= k) lo++;
+
+        unsigned r = unsigned(k - before(lo));
+        const uint64_t counts = blocks_[lo] >> 32;
+        uint64_t w = lo * kBlockWords;
+        for (unsigned sub = 0; sub < 3; sub++) {
+            unsigned c = unsigned(counts >> (10 * sub) & 1023);
+            if (r < c) break;
+            r -= c;
+            w += kSubBlockWords;
+        }
+        for (;;) {
+            unsigned c = unsigned(__builtin_popcountll(words_[w]));
+            if (r < c) break;
+            r -= c;
+            w++;
+        }
+#if RANK_SELECT_X86
+        if (kPdep) return w * 64 + unsigned(__builtin_ctzll(__builtin_ia32_pdep_di(uint64_t(1) << r, words_[w])));
+#endif
+        return w * 64 + selectInWordBroadword(words_[w], r);
+    }
+
+#if RANK_SELECT_X86
+    // The same code, compiled with POPCNT (and PDEP) for CPUs that have them
+    __attribute__((target("popcnt"))) uint64_t rankPopcnt(uint64_t i) const { return rankAt(i); }
+    __attribute__((target("popcnt"))) uint64_t selectPopcnt(uint64_t k) const { return selectAt<false>(k); }
+    __attribute__((target("popcnt,bmi,bmi2"))) uint64_t selectPdep(uint64_t k) const { return selectAt<true>(k); }
+#endif
+
+    uint64_t bits_ = 0, ones_ = 0;
+    const uint64_t *words_ = nullptr, *l0_ = nullptr, *blocks_ = nullptr;
+    const uint32_t *samples_ = nullptr;
+    uint64_t word_count_ = 0, l0_count_ = 0, block_count_ = 0, sample_count_ = 0;
+    // Built in memory: the arrays the pointers point into
+    std::vector<uint64_t> own_words_, own_l0_, own_blocks_;
+    std::vector<uint32_t> own_samples_;
+    // Opened from a file
+    void *map_ = nullptr;
+    uint64_t map_size_ = 0;
+};
+
+// Collects bits in order and builds the directory as they arrive, so one
+// pass over the input is all it takes
+class Builder {
+public:
+    void reserve(uint64_t bits) { words_.reserve(size_t((bits + 63) / 64)); }
+    uint64_t size() const { return bits_; }
+
+    void push(bool bit) {
+        current_ |= uint64_t(bit) << (bits_ % 64);
+        if (++bits_ % 64 == 0) addWord();
+    }
+
+    // The low `count` bits of `word`, lowest first
+    void pushWord(uint64_t word, unsigned count = 64) {
+        if (count == 0) return;
+        if (count < 64) word &= (uint64_t(1) << count) - 1;
+        const unsigned used = unsigned(bits_ % 64);
+        current_ |= word << used;
+        bits_ += count;
+        if (used + count >= 64) {
+            addWord();
+            current_ = used ? word >> (64 - used) : 0;
+        }
+    }
+
+    BitVector finish() {
+        if (bits_ % 64) addWord();
+        // One more entry after the last block, so rank1(size()) and the
+        // select search have an end
+        startBlock();
+        BitVector v;
+        v.bits_ = bits_;
+        v.ones_ = ones_;
+        v.own_words_.swap(words_);
+        v.own_l0_.swap(l0_);
+        v.own_blocks_.swap(blocks_);
+        v.own_samples_.swap(samples_);
+        v.words_ = v.own_words_.data();
+        v.l0_ = v.own_l0_.data();
+        v.blocks_ = v.own_blocks_.data();
+        v.samples_ = v.own_samples_.data();
+        v.word_count_ = v.own_words_.size();
+        v.l0_count_ = v.own_l0_.size();
+        v.block_count_ = v.own_blocks_.size();
+        v.sample_count_ = v.own_samples_.size();
+        *this = Builder();
+        return v;
+    }
+
+private:
+    void startBlock() {
+        if (blocks_.size() % kBlocksPerL0 == 0) l0_.push_back(ones_);
+        blocks_.push_back(ones_ - l0_.back());
+    }
+
+    void addWord() {
+        const uint64_t w = words_.size();
+        if (w % kBlockWords == 0) startBlock();
+        const uint64_t ones = uint64_t(__builtin_popcountll(current_));
+        const unsigned sub = unsigned(w / kSubBlockWords % 4);
+        if (sub < 3) blocks_.back() += ones << (32 + 10 * sub);
+        // Sample the block of every kSampleRate-th 1 that is in this word
+        for (; next_sample_ < ones_ + ones; next_sample_ += kSampleRate) {
+            samples_.push_back(uint32_t(w / kBlockWords));
+        }
+        ones_ += ones;
+        words_.push_back(current_);
+        current_ = 0;
+    }
+
+    std::vector<uint64_t> words_, l0_, blocks_;
+    std::vector<uint32_t> samples_;
+    uint64_t current_ = 0;  // bits not yet in a whole word
+    uint64_t bits_ = 0, ones_ = 0, next_sample_ = 0;
+};
+
+}  // namespace succinct
+
+#endif
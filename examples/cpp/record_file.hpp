@@ -0,0 +1,641 @@
+/*
+ * record_file.hpp - Binary Record Files You Can mmap and Read in Place
+ * The basic types of 1_data_types.cpp, stored as bytes instead of text.
+ *
+ * "cout << age << ' ' << height" turns every number into characters, and
+ * reading it back parses every character again. A record file keeps the
+ * bytes the CPU already uses:
+ *   - a schema names each field and its type (bool, char, short, int,
+ *     long, float, double - always 1, 1, 2, 4, 8, 4 and 8 bytes),
+ *   - the header says the byte order of the data (little or big endian),
+ *     and every field sits at a multiple of its own size,
+ *   - the reader maps the file into memory and hands out typed views
+ *     straight into it: nothing is parsed or copied.
+ *
+ *   struct Person { int32_t age; char initial; float height; ... };
+ *   recfile::Schema schema = recfile::Schema::of<Person>()
+ *                                .field("age", &Person::age)
+ *                                .field("height", &Person::height);
+ *   recfile::Writer out("people.rec", schema);
+ *   out.append(&person);                  // or append(people, n)
+ *   out.finish();
+ *
+ *   recfile::Reader in("people.rec");
+ *   if (!in.ok()) ...                     // in.error()
+ *   recfile::FieldView<float> h = in.field<float>("height");
+ *   for (uint64_t i = 0; i < h.size(); i++) total += h[i];
+ *   const Person *all = in.rows<Person>();  // or the whole struct array
+ *
+ * Two layouts:
+ *   Layout::Rows     one record after another, like an array of structs
+ *   Layout::Columns  one array per field, like a struct of arrays
+ *                    (see 10_struct_layout.cpp): reading one field reads
+ *                    only that field's bytes
+ *
+ * File format (the header itself is always little endian):
+ *   0   "RECFILE1"
+ *   8   byte order 'L'/'B', layout 'R'/'C', field count (u16),
+ *       record size (u32)
+ *   16  record count (u64)
+ *   24  data offset (u64), then zeros up to 64
+ *   64  32 bytes per field: name (16 bytes, zero padded), type (u8),
+ *       3 zeros, offset in the record (u32), column offset in the file
+ *       (u64, columns only)
+ *   data starts and every column starts at a multiple of 64 bytes
+ *
+ * Linux/POSIX only (open, mmap, ftruncate).
+ */
+
+#ifndef RECORD_FILE_HPP
+#define RECORD_FILE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace recfile {
+
+enum class Type : uint8_t { Bool = 1, Char, Short, Int, Long, Float, Double };
+enum class Layout : uint8_t { Rows = 'R', Columns = 'C' };
+enum class ByteOrder : uint8_t { Little = 'L', Big = 'B' };
+
+inline size_t typeSize(Type t) {
+    switch (t) {
+    case Type::Bool:
+    case Type::Char: return 1;
+    case Type::Short: return 2;
+    case Type::Int:
+    case Type::Float: return 4;
+    case Type::Long:
+    case Type::Double: return 8;
+    }
+    return 0;
+}
+
+inline const char *typeName(Type t) {
+    switch (t) {
+    case Type::Bool: return "bool";
+    case Type::Char: return "char";
+    case Type::Short: return "short";
+    case Type::Int: return "int";
+    case Type::Long: return "long";
+    case Type::Float: return "float";
+    case Type::Double: return "double";
+    }
+    return "?";
+}
+
+// The fixed-size C++ type that holds a field (a file "long" is always 8 bytes)
+inline const char *cppTypeName(Type t) {
+    switch (t) {
+    case Type::Bool: return "bool";
+    case Type::Char: return "char";
+    case Type::Short: return "int16_t";
+    case Type::Int: return "int32_t";
+    case Type::Long: return "int64_t";
+    case Type::Float: return "float";
+    case Type::Double: return "double";
+    }
+    return "?";
+}
+
+// The field type of a C++ member: decided by kind and size, so int32_t and
+// int are both Int, and int64_t, long and long long are all Long
+template <typename T>
+constexpr Type typeOf() {
+    static_assert(std::is_arithmetic<T>::value, "record fields must be bool, integers or floating point");
+    static_assert(sizeof(T) <= 8 && (!std::is_floating_point<T>::value || sizeof(T) >= 4),
+                  "record fields are at most 8 bytes");
+    if (std::is_same<T, bool>::value) return Type::Bool;
+    if (std::is_floating_point<T>::value) return sizeof(T) == 4 ? Type::Float : Type::Double;
+    return sizeof(T) == 1 ? Type::Char : sizeof(T) == 2 ? Type::Short : sizeof(T) == 4 ? Type::Int : Type::Long;
+}
+
+inline ByteOrder nativeOrder() {
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? ByteOrder::Little : ByteOrder::Big;
+}
+
+// Reverse the bytes of one value: 0x12345678 <-> 0x78563412
+template <typename T>
+inline T swapBytes(T value) {
+    if (sizeof(T) == 1) return value;
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(T));
+    if (sizeof(T) == 2) bits = __builtin_bswap16(uint16_t(bits));
+    if (sizeof(T) == 4) bits = __builtin_bswap32(uint32_t(bits));
+    if (sizeof(T) == 8) bits = __builtin_bswap64(bits);
+    std::memcpy(&value, &bits, sizeof(T));
+    return value;
+}
+
+// Copy one field of `size` bytes, reversing its bytes if `swap`
+inline void copyField(uint8_t *dst, const uint8_t *src, size_t size, bool swap) {
+    if (!swap || size == 1) {
+        std::memcpy(dst, src, size);
+    } else if (size == 2) {
+        uint16_t v;
+        std::memcpy(&v, src, 2);
+        v = __builtin_bswap16(v);
+        std::memcpy(dst, &v, 2);
+    } else if (size == 4) {
+        uint32_t v;
+        std::memcpy(&v, src, 4);
+        v = __builtin_bswap32(v);
+        std::memcpy(dst, &v, 4);
+    } else {
+        uint64_t v;
+        std::memcpy(&v, src, 8);
+        v = __builtin_bswap64(v);
+        std::memcpy(dst, &v, 8);
+    }
+}
+
+// Copy field `n` times from src (every `stride` bytes) to a packed column
+template <typename U>
+inline void gatherColumn(uint8_t *dst, const uint8_t *src, uint64_t n, size_t stride, bool swap) {
+    for (uint64_t i = 0; i < n; i++) {
+        U v;
+        std::memcpy(&v, src + i * stride, sizeof(U));
+        if (swap) v = swapBytes(v);
+        std::memcpy(dst + i * sizeof(U), &v, sizeof(U));
+    }
+}
+
+inline void gatherColumn(uint8_t *dst, const uint8_t *src, uint64_t n, size_t size, size_t stride, bool swap) {
+    switch (size) {
+    case 1: gatherColumn<uint8_t>(dst, src, n, stride, swap); break;
+    case 2: gatherColumn<uint16_t>(dst, src, n, stride, swap); break;
+    case 4: gatherColumn<uint32_t>(dst, src, n, stride, swap); break;
+    default: gatherColumn<uint64_t>(dst, src, n, stride, swap); break;
+    }
+}
+
+inline uint64_t roundUp(uint64_t n, uint64_t align) { return (n + align - 1) / align * align; }
+
+struct Field {
+    std::string name;
+    Type type;
+    uint32_t offset;  // where the field sits inside one record
+};
+
+// The fields of a record and where each one sits
+class Schema {
+public:
+    static const size_t kMaxName = 15;  // plus the terminating zero
+
+    Schema() = default;
+
+    // A schema that matches the struct S byte for byte: its record size is
+    // sizeof(S), and field() takes the offsets from S's members. S must be
+    // default-constructible (one is made to measure it).
+    template <typename S>
+    static Schema of() {
+        static_assert(std::is_trivially_copyable<S>::value, "records are copied as bytes");
+        Schema s;
+        s.record_size_ = uint32_t(sizeof(S));
+        s.fixed_ = true;
+        return s;
+    }
+
+    template <typename S, typename M>
+    Schema &field(const std::string &name, M S::*member) {
+        static const S probe{};
+        size_t offset = size_t(reinterpret_cast<const char *>(&(probe.*member)) -
+                               reinterpret_cast<const char *>(&probe));
+        fields_.push_back({name, typeOf<M>(), uint32_t(offset)});
+        if (!fixed_) record_size_ = uint32_t(std::max<size_t>(record_size_, offset + sizeof(M)));
+        return *this;
+    }
+
+    // Add a field after the last one, at the next multiple of its size;
+    // the record grows to a multiple of its largest field, like a C struct
+    Schema &add(const std::string &name, Type type) {
+        uint32_t size = uint32_t(typeSize(type));
+        uint32_t offset = uint32_t(roundUp(end_, size));
+        fields_.push_back({name, type, offset});
+        end_ = offset + size;
+        max_align_ = std::max(max_align_, size);
+        record_size_ = uint32_t(roundUp(end_, max_align_));
+        return *this;
+    }
+
+    // Fields at given offsets in records of a given size (as read from a file)
+    static Schema withFields(const std::vector<Field> &fields, uint32_t record_size) {
+        Schema s;
+        s.fields_ = fields;
+        s.record_size_ = record_size;
+        s.fixed_ = true;
+        return s;
+    }
+
+    const std::vector<Field> &fields() const { return fields_; }
+    uint32_t recordSize() const { return record_size_; }
+
+    const Field *find(const std::string &name) const {
+        for (const Field &f : fields_) {
+            if (f.name == name) return &f;
+        }
+        return nullptr;
+    }
+
+    // Empty if the schema can be written, or what is wrong with it
+    std::string check() const {
+        if (fields_.empty()) return "the schema has no fields";
+        for (size_t i = 0; i < fields_.size(); i++) {
+            const Field &f = fields_[i];
+            if (f.name.empty() || f.name.size() > kMaxName) return "field name '" + f.name + "' is empty or too long";
+            if (f.offset % typeSize(f.type) != 0) return "field '" + f.name + "' is not aligned to its size";
+            if (f.offset + typeSize(f.type) > record_size_) return "field '" + f.name + "' ends past the record";
+            for (size_t j = 0; j < i; j++) {
+                if (fields_[j].name == f.name) return "field '" + f.name + "' appears twice";
+            }
+        }
+        return "";
+    }
+
+    // A C++ struct with the same layout, to read a Rows file with rows<T>();
+    // padding bytes become explicit `uint8_t padN[]` members
+    std::string cppStruct(const std::string &name) const {
+        std::vector<const Field *> order;
+        for (const Field &f : fields_) order.push_back(&f);
+        std::sort(order.begin(), order.end(), [](const Field *a, const Field *b) { return a->offset < b->offset; });
+        std::string out = "struct " + name + " {\n";
+        uint32_t at = 0;
+        int pads = 0;
+        auto pad = [&](uint32_t to) {
+            if (to > at) out += "    uint8_t pad" + std::to_string(pads++) + "[" + std::to_string(to - at) + "];\n";
+        };
+        for (const Field *f : order) {
+            if (f->offset < at) continue;  // overlaps the previous field
+            pad(f->offset);
+            std::string member = "    " + std::string(cppTypeName(f->type)) + " " + f->name + ";";
+            member.resize(std::max<size_t>(member.size() + 1, 28), ' ');
+            out += member + "// offset " + std::to_string(f->offset) + "\n";
+            at = f->offset + uint32_t(typeSize(f->type));
+        }
+        pad(record_size_);
+        return out + "};  // " + std::to_string(record_size_) + " bytes\n";
+    }
+
+private:
+    std::vector<Field> fields_;
+    uint32_t record_size_ = 0;
+    uint32_t end_ = 0;
+    uint32_t max_align_ = 1;
+    bool fixed_ = false;
+};
+
+// One field of every record, read in place. In a Columns file of this
+// machine's byte order it is a plain array (data() != nullptr); otherwise
+// each [] is one load from a stride, with the bytes reversed if needed.
+template <typename T>
+class FieldView {
+public:
+    FieldView() = default;
+    FieldView(const uint8_t *base, size_t stride, uint64_t count, bool swap)
+        : base_(base), stride_(stride), count_(count), swap_(swap) {}
+
+    bool ok() const { return base_ != nullptr; }
+    uint64_t size() const { return count_; }
+    size_t stride() const { return stride_; }
+
+    T operator[](uint64_t i) const {
+        T value;
+        std::memcpy(&value, base_ + i * stride_, sizeof(T));
+        return swap_ ? swapBytes(value) : value;
+    }
+
+    const T *data() const {
+        return stride_ == sizeof(T) && !swap_ ? reinterpret_cast<const T *>(base_) : nullptr;
+    }
+
+private:
+    const uint8_t *base_ = nullptr;
+    size_t stride_ = 0;
+    uint64_t count_ = 0;
+    bool swap_ = false;
+};
+
+static const char kMagic[8] = {'R', 'E', 'C', 'F', 'I', 'L', 'E', '1'};
+static const size_t kHeaderSize = 64;
+static const size_t kFieldEntrySize = 32;
+static const size_t kDataAlign = 64;
+
+inline void storeLE(uint8_t *p, uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) p[i] = uint8_t(value >> (8 * i));
+}
+
+inline uint64_t loadLE(const uint8_t *p, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) value |= uint64_t(p[i]) << (8 * i);
+    return value;
+}
+
+inline uint64_t dataOffset(size_t fields) { return roundUp(kHeaderSize + kFieldEntrySize * fields, kDataAlign); }
+
+struct WriteOptions {
+    Layout layout = Layout::Rows;
+    ByteOrder order = nativeOrder();
+    uint64_t expected_records = 0;  // a hint: space for this many is made up front
+};
+
+// Writes records into a memory-mapped file that grows as needed (doubling).
+// The header goes in last, by finish(): a file that was never finished has
+// no magic and every Reader refuses it.
+class Writer {
+public:
+    Writer(const std::string &path, const Schema &schema, WriteOptions options = WriteOptions())
+        : schema_(schema), options_(options), swap_(options.order != nativeOrder()) {
+        error_ = schema.check();
+        if (!error_.empty()) return;
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            error_ = "cannot create " + path + ": " + std::strerror(errno);
+            return;
+        }
+        reserve(std::max<uint64_t>(options.expected_records, 4096));
+    }
+
+    ~Writer() {
+        if (fd_ >= 0) finish();
+    }
+
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+
+    bool ok() const { return error_.empty(); }
+    const std::string &error() const { return error_; }
+    uint64_t size() const { return count_; }
+
+    // Append one record, laid out as the schema says
+    void append(const void *record) { append(record, 1); }
+
+    // Append n records stored back to back (recordSize() bytes each)
+    void append(const void *records, uint64_t n) {
+        if (!ok() || n == 0) return;
+        if (count_ + n > capacity_ && !reserve(std::max(capacity_ * 2, count_ + n))) return;
+        const uint8_t *src = static_cast<const uint8_t *>(records);
+        const size_t stride = schema_.recordSize();
+        if (options_.layout == Layout::Rows) {
+            uint8_t *dst = map_ + data_offset_ + count_ * stride;
+            if (!swap_) {
+                std::memcpy(dst, src, n * stride);
+            } else {
+                std::memset(dst, 0, n * stride);
+                for (uint64_t i = 0; i < n; i++) {
+                    for (const Field &f : schema_.fields()) {
+                        copyField(dst + i * stride + f.offset, src + i * stride + f.offset, typeSize(f.type), true);
+                    }
+                }
+            }
+        } else {
+            // One field at a time: each column is written front to back
+            for (size_t c = 0; c < schema_.fields().size(); c++) {
+                const Field &f = schema_.fields()[c];
+                const size_t size = typeSize(f.type);
+                gatherColumn(map_ + columns_[c] + count_ * size, src + f.offset, n, size, stride, swap_);
+            }
+        }
+        count_ += n;
+    }
+
+    // Write the header, trim the file to its final size and close it
+    bool finish() {
+        if (fd_ < 0) return ok();
+        uint64_t end = 0;
+        if (ok()) {
+            if (options_.layout == Layout::Columns) {
+                // Close the gaps the spare capacity left between the columns
+                std::vector<uint64_t> tight = columnOffsets(count_, &end);
+                for (size_t c = 0; c < tight.size(); c++) {
+                    std::memmove(map_ + tight[c], map_ + columns_[c], count_ * typeSize(schema_.fields()[c].type));
+                }
+                columns_ = tight;
+            } else {
+                end = data_offset_ + count_ * schema_.recordSize();
+            }
+            writeHeader();
+        }
+        if (map_) ::munmap(map_, map_size_);
+        map_ = nullptr;
+        if (ok() && ::ftruncate(fd_, off_t(end)) != 0) error_ = std::string("ftruncate: ") + std::strerror(errno);
+        if (::close(fd_) != 0 && ok()) error_ = std::string("close: ") + std::strerror(errno);
+        fd_ = -1;
+        return ok();
+    }
+
+private:
+    // Where each column starts when there is room for `records` records
+    std::vector<uint64_t> columnOffsets(uint64_t records, uint64_t *end) const {
+        std::vector<uint64_t> offsets;
+        uint64_t at = data_offset_;
+        for (const Field &f : schema_.fields()) {
+            offsets.push_back(at);
+            at = roundUp(at + records * typeSize(f.type), kDataAlign);
+        }
+        *end = at;
+        return offsets;
+    }
+
+    // Grow the file and its mapping to hold `records` records
+    bool reserve(uint64_t records) {
+        uint64_t size = 0;
+        std::vector<uint64_t> offsets;
+        if (options_.layout == Layout::Columns) {
+            offsets = columnOffsets(records, &size);
+        } else {
+            size = data_offset_ + records * schema_.recordSize();
+        }
+        if (::ftruncate(fd_, off_t(size)) != 0) {
+            error_ = std::string("ftruncate: ") + std::strerror(errno);
+            return false;
+        }
+        void *map = map_ ? ::mremap(map_, map_size_, size, MREMAP_MAYMOVE)
+                         : ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (map == MAP_FAILED) {
+            error_ = std::string("mmap: ") + std::strerror(errno);
+            return false;
+        }
+        map_ = static_cast<uint8_t *>(map);
+        map_size_ = size;
+        // Columns move up to their new places, the last one first
+        for (size_t c = offsets.size(); c-- > 0 && !columns_.empty();) {
+            std::memmove(map_ + offsets[c], map_ + columns_[c], count_ * typeSize(schema_.fields()[c].type));
+        }
+        columns_ = offsets;
+        capacity_ = records;
+        return true;
+    }
+
+    void writeHeader() {
+        uint8_t *h = map_;
+        std::memset(h, 0, data_offset_);
+        std::memcpy(h, kMagic, 8);
+        h[8] = uint8_t(options_.order);
+        h[9] = uint8_t(options_.layout);
+        storeLE(h + 10, schema_.fields().size(), 2);
+        storeLE(h + 12, schema_.recordSize(), 4);
+        storeLE(h + 16, count_, 8);
+        storeLE(h + 24, data_offset_, 8);
+        for (size_t c = 0; c < schema_.fields().size(); c++) {
+            const Field &f = schema_.fields()[c];
+            uint8_t *e = h + kHeaderSize + c * kFieldEntrySize;
+            std::memcpy(e, f.name.data(), f.name.size());
+            e[16] = uint8_t(f.type);
+            storeLE(e + 20, f.offset, 4);
+            if (options_.layout == Layout::Columns) storeLE(e + 24, columns_[c], 8);
+        }
+    }
+
+    Schema schema_;
+    WriteOptions options_;
+    bool swap_;
+    std::string error_;
+    int fd_ = -1;
+    uint8_t *map_ = nullptr;
+    uint64_t map_size_ = 0;
+    uint64_t data_offset_ = dataOffset(schema_.fields().size());
+    uint64_t count_ = 0;
+    uint64_t capacity_ = 0;
+    std::vector<uint64_t> columns_;  // file offset of each column
+};
+
+// Maps a record file read-only and checks its header; every view points
+// straight into the mapping, so the Reader must outlive them
+class Reader {
+public:
+    explicit Reader(const std::string &path) {
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd_ < 0 || ::fstat(fd_, &st) != 0) {
+            error_ = "cannot open " + path + ": " + std::strerror(errno);
+            return;
+        }
+        size_ = uint64_t(st.st_size);
+        if (size_ < kHeaderSize) {
+            error_ = path + " is too short for a record file";
+            return;
+        }
+        void *map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (map == MAP_FAILED) {
+            error_ = std::string("mmap: ") + std::strerror(errno);
+            return;
+        }
+        map_ = static_cast<const uint8_t *>(map);
+        ::madvise(const_cast<uint8_t *>(map_), size_, MADV_SEQUENTIAL);
+        error_ = parseHeader();
+        if (!error_.empty()) error_ = path + ": " + error_;
+    }
+
+    ~Reader() {
+        if (map_) ::munmap(const_cast<uint8_t *>(map_), size_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+
+    bool ok() const { return error_.empty(); }
+    const std::string &error() const { return error_; }
+    const Schema &schema() const { return schema_; }
+    Layout layout() const { return layout_; }
+    ByteOrder order() const { return order_; }
+    uint64_t size() const { return count_; }
+
+    // The field `name` of every record; an empty view (ok() false) if there
+    // is no such field or it is not of type T
+    template <typename T>
+    FieldView<T> field(const std::string &name) const {
+        if (!ok()) return FieldView<T>();
+        for (size_t c = 0; c < schema_.fields().size(); c++) {
+            const Field &f = schema_.fields()[c];
+            if (f.name != name) continue;
+            if (f.type != typeOf<T>()) return FieldView<T>();
+            bool swap = order_ != nativeOrder();
+            if (layout_ == Layout::Columns) return FieldView<T>(map_ + columns_[c], sizeof(T), count_, swap);
+            return FieldView<T>(map_ + data_offset_ + f.offset, schema_.recordSize(), count_, swap);
+        }
+        return FieldView<T>();
+    }
+
+    // All records as an array of T, for a Rows file of this machine's byte
+    // order whose record size is sizeof(T) (see Schema::cppStruct); else
+    // nullptr. Which member is which is up to the caller.
+    template <typename T>
+    const T *rows() const {
+        if (!ok() || layout_ != Layout::Rows || order_ != nativeOrder() || schema_.recordSize() != sizeof(T)) {
+            return nullptr;
+        }
+        return reinterpret_cast<const T *>(map_ + data_offset_);
+    }
+
+private:
+    std::string parseHeader() {
+        const uint8_t *h = map_;
+        if (std::memcmp(h, kMagic, 8) != 0) return "not a record file (or it was never finished)";
+        order_ = ByteOrder(h[8]);
+        layout_ = Layout(h[9]);
+        if (order_ != ByteOrder::Little && order_ != ByteOrder::Big) return "unknown byte order";
+        if (layout_ != Layout::Rows && layout_ != Layout::Columns) return "unknown layout";
+        size_t fields = size_t(loadLE(h + 10, 2));
+        uint32_t record_size = uint32_t(loadLE(h + 12, 4));
+        count_ = loadLE(h + 16, 8);
+        data_offset_ = loadLE(h + 24, 8);
+        if (data_offset_ != dataOffset(fields) || data_offset_ > size_) return "bad data offset";
+
+        // The schema, taken as written: offsets are kept, not recomputed
+        Schema schema;
+        std::vector<Field> list;
+        for (size_t c = 0; c < fields; c++) {
+            const uint8_t *e = h + kHeaderSize + c * kFieldEntrySize;
+            size_t len = 0;
+            while (len < 16 && e[len]) len++;
+            Type type = Type(e[16]);
+            if (typeSize(type) == 0) return "field " + std::to_string(c) + " has an unknown type";
+            list.push_back({std::string(reinterpret_cast<const char *>(e), len), type, uint32_t(loadLE(e + 20, 4))});
+            columns_.push_back(loadLE(e + 24, 8));
+        }
+        schema_ = Schema::withFields(list, record_size);
+        std::string bad = schema_.check();
+        if (!bad.empty()) return bad;
+
+        // Every byte a view can reach must be inside the file
+        uint64_t room = size_ - data_offset_;
+        if (layout_ == Layout::Rows) {
+            if (record_size == 0 || count_ > room / record_size) return "file is shorter than its records";
+        } else {
+            for (size_t c = 0; c < fields; c++) {
+                size_t size = typeSize(list[c].type);
+                if (columns_[c] % size != 0 || columns_[c] < data_offset_ || columns_[c] > size_ ||
+                    count_ > (size_ - columns_[c]) / size) {
+                    return "column '" + list[c].name + "' is outside the file";
+                }
+            }
+        }
+        return "";
+    }
+
+    std::string error_;
+    int fd_ = -1;
+    const uint8_t *map_ = nullptr;
+    uint64_t size_ = 0;
+    Schema schema_;
+    Layout layout_ = Layout::Rows;
+    ByteOrder order_ = ByteOrder::Little;
+    uint64_t count_ = 0;
+    uint64_t data_offset_ = 0;
+    std::vector<uint64_t> columns_;
+};
+
+}  // namespace recfile
+
+#endif
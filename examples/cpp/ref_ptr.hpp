@@ -0,0 +1,159 @@
+/*
+ * ref_ptr.hpp - A Reference-Counted Pointer That Keeps Its Count Inside the Object
+ * The "smart pointers" 3_memory.cpp mentions, with the cost made visible.
+ *
+ * std::shared_ptr keeps the count in a separate "control block": one more
+ * allocation (unless you use make_shared), two pointers per shared_ptr,
+ * and the count always changes with atomic instructions - even when only
+ * one thread ever touches it. An *intrusive* pointer puts the count in
+ * the object itself:
+ *
+ *   struct Node : RefCounted<Node> {           // atomic count (thread-safe)
+ *       int value = 0;
+ *   };
+ *   struct Token : RefCounted<Token, PlainCount> { ... };  // one thread only
+ *
+ *   RefPtr<Node> a = makeRef<Node>();          // one allocation, count = 1
+ *   RefPtr<Node> b = a;                        // count = 2
+ *   a.reset();                                 // count = 1
+ *   b->value = 5;                              // deleted when b goes away
+ *
+ * sizeof(RefPtr<T>) is one pointer. RefPtr works with any class that has
+ * addRef() and release(), not just RefCounted ones. If you delete through
+ * a base class, give that base a virtual destructor (as with delete).
+ */
+
+#ifndef REF_PTR_HPP
+#define REF_PTR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// A count for objects shared between threads. Adding a reference needs no
+// ordering (relaxed); dropping one is acq_rel, so the thread that deletes
+// sees every other thread's writes to the object.
+class AtomicCount {
+public:
+    void increment() { count_.fetch_add(1, std::memory_order_relaxed); }
+    // True when that was the last reference
+    bool decrement() {
+        // The only owner: nobody else can add a reference, so the (slow)
+        // locked subtract can be skipped
+        if (count_.load(std::memory_order_acquire) == 1) return true;
+        return count_.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+    uint32_t load() const { return count_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> count_{0};
+};
+
+// A plain integer: no lock prefix, but only safe in one thread
+class PlainCount {
+public:
+    void increment() { count_++; }
+    bool decrement() { return --count_ == 0; }
+    uint32_t load() const { return count_; }
+
+private:
+    uint32_t count_ = 0;
+};
+
+// Base class with the count. Derived is the class that inherits from it
+// (so release() can delete the whole object without a virtual call).
+template <typename Derived, typename Count = AtomicCount>
+class RefCounted {
+public:
+    void addRef() const { count_.increment(); }
+    void release() const {
+        if (count_.decrement()) delete static_cast<const Derived *>(this);
+    }
+    uint32_t refCount() const { return count_.load(); }
+
+protected:
+    RefCounted() = default;
+    // A copy of an object is a new object: it starts with no owners
+    RefCounted(const RefCounted &) {}
+    RefCounted &operator=(const RefCounted &) { return *this; }
+    ~RefCounted() = default;
+
+private:
+    mutable Count count_;
+};
+
+// Tag for taking over a reference that was already counted
+struct AdoptRef {};
+
+template <typename T>
+class RefPtr {
+public:
+    RefPtr() = default;
+    RefPtr(std::nullptr_t) {}
+    explicit RefPtr(T *p) : ptr_(p) { if (ptr_) ptr_->addRef(); }
+    RefPtr(T *p, AdoptRef) : ptr_(p) {}
+
+    RefPtr(const RefPtr &other) : ptr_(other.ptr_) { if (ptr_) ptr_->addRef(); }
+    RefPtr(RefPtr &&other) noexcept : ptr_(other.ptr_) { other.ptr_ = nullptr; }
+
+    // RefPtr<Derived> -> RefPtr<Base>
+    template <typename U>
+    RefPtr(const RefPtr<U> &other) : ptr_(other.get()) { if (ptr_) ptr_->addRef(); }
+    template <typename U>
+    RefPtr(RefPtr<U> &&other) noexcept : ptr_(other.detach()) {}
+
+    ~RefPtr() { if (ptr_) ptr_->release(); }
+
+    RefPtr &operator=(const RefPtr &other) {
+        RefPtr(other).swap(*this);
+        return *this;
+    }
+    RefPtr &operator=(RefPtr &&other) noexcept {
+        RefPtr(std::move(other)).swap(*this);
+        return *this;
+    }
+    RefPtr &operator=(std::nullptr_t) {
+        reset();
+        return *this;
+    }
+
+    T *get() const { return ptr_; }
+    T &operator*() const { return *ptr_; }
+    T *operator->() const { return ptr_; }
+    explicit operator bool() const { return ptr_ != nullptr; }
+
+    void reset() { RefPtr().swap(*this); }
+    void swap(RefPtr &other) noexcept { std::swap(ptr_, other.ptr_); }
+
+    // Give up ownership without releasing (the caller now owns one reference)
+    T *detach() {
+        T *p = ptr_;
+        ptr_ = nullptr;
+        return p;
+    }
+
+    uint32_t useCount() const { return ptr_ ? ptr_->refCount() : 0; }
+
+private:
+    T *ptr_ = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const RefPtr<T> &a, const RefPtr<U> &b) { return a.get() == b.get(); }
+template <typename T, typename U>
+bool operator!=(const RefPtr<T> &a, const RefPtr<U> &b) { return a.get() != b.get(); }
+template <typename T>
+bool operator==(const RefPtr<T> &a, std::nullptr_t) { return !a; }
+template <typename T>
+bool operator!=(const RefPtr<T> &a, std::nullptr_t) { return static_cast<bool>(a); }
+
+// Like std::make_shared: one allocation holds the object and its count
+template <typename T, typename... Args>
+RefPtr<T> makeRef(Args &&...args) {
+    T *p = new T(std::forward<Args>(args)...);
+    p->addRef();
+    return RefPtr<T>(p, AdoptRef{});
+}
+
+#endif  // REF_PTR_HPP
@@ -0,0 +1,505 @@
+/*
+ * small_vector.hpp - Vectors and Strings That Keep a Few Elements Inside
+ * 3_memory.cpp's stack vs heap, applied to containers.
+ *
+ * std::vector keeps its elements on the heap, always: even one int costs
+ * a call to new, and reading it follows a pointer somewhere else. Most
+ * vectors in real programs stay small, so SmallVector<T, N> keeps up to N
+ * elements INSIDE the object (on the stack, or inline in whatever holds
+ * it). Only the (N+1)-th element moves them all out, to the heap or to
+ * any std::pmr::memory_resource, like the arena in arena.hpp.
+ *
+ * std::string already does this for short text (the "small string
+ * optimization": 15 chars in libstdc++, 22 in libc++, and sizeof(string)
+ * is 32 either way). SmallString<N> lets you pick N.
+ *
+ *   SmallVector<int, 8> ids;               // room for 8 ints inline
+ *   ids.push_back(3);                      // no allocation
+ *   ids.isInline()                         // true until the 9th
+ *   SmallVector<int, 8> other = std::move(ids);  // heap: takes the buffer;
+ *                                          // inline: moves each element
+ *   SmallVector<int, 8> temp(&arena);      // spills into an arena
+ *
+ *   SmallString<32> name("Ada Lovelace");  // 32 chars inline, then heap
+ *   name += " (1815)";
+ *   std::string_view view = name;          // name.c_str() for C
+ *
+ * The price: a bigger object (N elements plus a 32-byte header), and
+ * moving an inline SmallVector moves every element instead of a pointer.
+ * The memory resource stays with the container: assigning or moving
+ * copies the elements across when the two resources differ.
+ * Needs C++17 (the default for g++ 11 and newer).
+ */
+
+#ifndef SMALL_VECTOR_HPP
+#define SMALL_VECTOR_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+template <typename T, size_t N>
+class SmallVector {
+public:
+    using value_type = T;
+    using size_type = size_t;
+    using reference = T &;
+    using const_reference = const T &;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+    static constexpr size_t kInlineCapacity = N;
+
+    explicit SmallVector(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) noexcept
+        : data_(inlineData()), resource_(resource) {}
+
+    SmallVector(size_t count, const T &value,
+                std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : SmallVector(resource) {
+        resize(count, value);
+    }
+
+    SmallVector(std::initializer_list<T> items,
+                std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : SmallVector(resource) {
+        append(items.begin(), items.end());
+    }
+
+    template <typename It, typename = std::enable_if_t<!std::is_integral<It>::value>>
+    SmallVector(It first, It last, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : SmallVector(resource) {
+        append(first, last);
+    }
+
+    SmallVector(const SmallVector &other) : SmallVector(other.resource_) { append(other.begin(), other.end()); }
+
+    SmallVector(SmallVector &&other) noexcept(std::is_nothrow_move_constructible<T>::value)
+        : SmallVector(other.resource_) {
+        takeFrom(other);
+    }
+
+    ~SmallVector() {
+        std::destroy(begin(), end());
+        release();
+    }
+
+    SmallVector &operator=(const SmallVector &other) {
+        if (this != &other) assign(other.begin(), other.end());
+        return *this;
+    }
+
+    // Not noexcept (like std::pmr::vector): with a different memory
+    // resource the elements are moved into a new buffer, which may throw
+    SmallVector &operator=(SmallVector &&other) {
+        if (this != &other) {
+            clear();
+            takeFrom(other);
+        }
+        return *this;
+    }
+
+    SmallVector &operator=(std::initializer_list<T> items) {
+        assign(items.begin(), items.end());
+        return *this;
+    }
+
+    template <typename It>
+    void assign(It first, It last) {
+        clear();
+        append(first, last);
+    }
+
+    // ---- Size and storage ----
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return size_ == 0; }
+    bool isInline() const { return data_ == inlineData(); }
+    std::pmr::memory_resource *resource() const { return resource_; }
+
+    void reserve(size_t count) {
+        if (count > capacity_) reallocate(count);
+    }
+
+    // Back inside the object if the elements fit again, or down to size()
+    void shrink_to_fit() {
+        if (isInline() || size_ == capacity_) return;
+        if (size_ <= N) {
+            T *heap = data_;
+            const size_t heap_capacity = capacity_;
+            data_ = inlineData();
+            capacity_ = N;
+            relocate(heap, size_, data_);
+            resource_->deallocate(heap, heap_capacity * sizeof(T), alignof(T));
+        } else {
+            reallocate(size_);
+        }
+    }
+
+    // ---- Elements ----
+
+    T *data() { return data_; }
+    const T *data() const { return data_; }
+    iterator begin() { return data_; }
+    iterator end() { return data_ + size_; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+
+    T &operator[](size_t i) { return data_[i]; }
+    const T &operator[](size_t i) const { return data_[i]; }
+    T &at(size_t i) {
+        if (i >= size_) throw std::out_of_range("SmallVector::at");
+        return data_[i];
+    }
+    const T &at(size_t i) const { return const_cast<SmallVector *>(this)->at(i); }
+    T &front() { return data_[0]; }
+    const T &front() const { return data_[0]; }
+    T &back() { return data_[size_ - 1]; }
+    const T &back() const { return data_[size_ - 1]; }
+
+    // ---- Adding and removing ----
+
+    template <typename... Args>
+    T &emplace_back(Args &&...args) {
+        if (size_ == capacity_) return growAndEmplace(std::forward<Args>(args)...);
+        T *slot = ::new (static_cast<void *>(data_ + size_)) T(std::forward<Args>(args)...);
+        size_++;
+        return *slot;
+    }
+
+    void push_back(const T &value) { emplace_back(value); }
+    void push_back(T &&value) { emplace_back(std::move(value)); }
+
+    void pop_back() {
+        size_--;
+        std::destroy_at(data_ + size_);
+    }
+
+    // Copies of [first, last) at the end; the range may be part of this vector
+    template <typename It>
+    void append(It first, It last) {
+        using Category = typename std::iterator_traits<It>::iterator_category;
+        if constexpr (std::is_base_of<std::forward_iterator_tag, Category>::value) {
+            const size_t count = size_t(std::distance(first, last));
+            if (size_ + count > capacity_) {
+                // Copy the new elements first, while the old buffer (which the
+                // range may point into) is still there
+                const size_t new_capacity = std::max(size_ + count, 2 * capacity_);
+                T *fresh = allocate(new_capacity);
+                try {
+                    std::uninitialized_copy(first, last, fresh + size_);
+                } catch (...) {
+                    resource_->deallocate(fresh, new_capacity * sizeof(T), alignof(T));
+                    throw;
+                }
+                adopt(fresh, new_capacity);
+            } else {
+                std::uninitialized_copy(first, last, end());
+            }
+            size_ += count;
+        } else {
+            for (; first != last; ++first) emplace_back(*first);
+        }
+    }
+
+    iterator insert(const_iterator pos, T value) {
+        const size_t index = size_t(pos - begin());
+        if (index == size_) {
+            emplace_back(std::move(value));
+        } else {
+            emplace_back(std::move(back()));
+            std::move_backward(begin() + index, end() - 2, end() - 1);
+            data_[index] = std::move(value);
+        }
+        return begin() + index;
+    }
+
+    iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        T *from = begin() + (first - begin());
+        if (first == last) return from;  // else every element after it moves onto itself
+        T *to = begin() + (last - begin());
+        T *new_end = std::move(to, end(), from);
+        std::destroy(new_end, end());
+        size_ = size_t(new_end - begin());
+        return from;
+    }
+
+    void clear() {
+        std::destroy(begin(), end());
+        size_ = 0;
+    }
+
+    void resize(size_t count) {
+        if (count < size_) {
+            erase(begin() + count, end());
+            return;
+        }
+        reserve(count);
+        std::uninitialized_value_construct(end(), begin() + count);
+        size_ = count;
+    }
+
+    void resize(size_t count, const T &value) {
+        if (count < size_) {
+            erase(begin() + count, end());
+            return;
+        }
+        if (count > capacity_) {
+            T copy(value);  // `value` may be one of our elements
+            reserve(count);
+            std::uninitialized_fill(end(), begin() + count, copy);
+        } else {
+            std::uninitialized_fill(end(), begin() + count, value);
+        }
+        size_ = count;
+    }
+
+    void swap(SmallVector &other) {
+        SmallVector temp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(temp);
+    }
+
+private:
+    T *inlineData() { return reinterpret_cast<T *>(storage_); }
+    const T *inlineData() const { return reinterpret_cast<const T *>(storage_); }
+
+    T *allocate(size_t count) { return static_cast<T *>(resource_->allocate(count * sizeof(T), alignof(T))); }
+
+    void release() {
+        if (!isInline()) resource_->deallocate(data_, capacity_ * sizeof(T), alignof(T));
+        data_ = inlineData();
+        capacity_ = N;
+    }
+
+    // Move-construct count elements into raw memory, and end the originals
+    static void relocate(T *from, size_t count, T *to) {
+        if constexpr (std::is_trivially_copyable<T>::value) {
+            if (count) std::memcpy(static_cast<void *>(to), from, count * sizeof(T));
+        } else {
+            std::uninitialized_move(from, from + count, to);
+            std::destroy(from, from + count);
+        }
+    }
+
+    // Move our elements into `fresh` and make it the buffer
+    void adopt(T *fresh, size_t new_capacity) {
+        relocate(data_, size_, fresh);
+        release();
+        data_ = fresh;
+        capacity_ = new_capacity;
+    }
+
+    void reallocate(size_t new_capacity) { adopt(allocate(new_capacity), new_capacity); }
+
+    template <typename... Args>
+    T &growAndEmplace(Args &&...args) {
+        const size_t new_capacity = std::max<size_t>(2 * capacity_, 4);
+        T *fresh = allocate(new_capacity);
+        // Build the new element before the old ones move: args may refer to them
+        try {
+            ::new (static_cast<void *>(fresh + size_)) T(std::forward<Args>(args)...);
+        } catch (...) {
+            resource_->deallocate(fresh, new_capacity * sizeof(T), alignof(T));
+            throw;
+        }
+        adopt(fresh, new_capacity);
+        return data_[size_++];
+    }
+
+    // Take other's heap buffer if we share a resource, or else move its
+    // elements one by one; other ends up empty and inline
+    void takeFrom(SmallVector &other) {
+        if (!other.isInline() && *resource_ == *other.resource_) {
+            release();
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.data_ = other.inlineData();
+            other.capacity_ = N;
+        } else {
+            reserve(other.size_);
+            std::uninitialized_move(other.begin(), other.end(), end());
+            size_ = other.size_;
+            other.clear();
+            other.release();
+        }
+        other.size_ = 0;
+    }
+
+    T *data_;
+    size_t size_ = 0;
+    size_t capacity_ = N;
+    std::pmr::memory_resource *resource_;
+    alignas(T) unsigned char storage_[N > 0 ? N * sizeof(T) : 1];
+};
+
+template <typename T, size_t N, size_t M>
+bool operator==(const SmallVector<T, N> &a, const SmallVector<T, M> &b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+template <typename T, size_t N, size_t M>
+bool operator!=(const SmallVector<T, N> &a, const SmallVector<T, M> &b) {
+    return !(a == b);
+}
+
+template <typename T, size_t N, size_t M>
+bool operator<(const SmallVector<T, N> &a, const SmallVector<T, M> &b) {
+    return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+}
+
+// Text with room for N chars inside the object (plus the terminating
+// zero, so c_str() always works)
+template <size_t N>
+class SmallString {
+public:
+    static constexpr size_t kInlineCapacity = N;
+
+    explicit SmallString(std::pmr::memory_resource *resource = std::pmr::get_default_resource()) noexcept
+        : chars_(resource) {
+        chars_.push_back('\0');
+    }
+
+    SmallString(const char *text, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : SmallString(std::string_view(text), resource) {}
+
+    SmallString(std::string_view text, std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : chars_(resource) {
+        chars_.reserve(text.size() + 1);
+        chars_.append(text.begin(), text.end());
+        chars_.push_back('\0');
+    }
+
+    SmallString(const SmallString &) = default;
+    SmallString &operator=(const SmallString &other) {
+        if (this != &other) *this = other.view();
+        return *this;
+    }
+
+    // The moved-from string is left empty, not without its zero
+    SmallString(SmallString &&other) noexcept : chars_(std::move(other.chars_)) { other.chars_.push_back('\0'); }
+
+    // May allocate, and throw, when the two use different resources; this
+    // string is then left empty (the SmallVector move already cleared it)
+    SmallString &operator=(SmallString &&other) {
+        if (this != &other) {
+            try {
+                chars_ = std::move(other.chars_);
+            } catch (...) {
+                chars_.clear();
+                chars_.push_back('\0');  // fits: capacity is never below N + 1
+                throw;
+            }
+            other.chars_.push_back('\0');
+        }
+        return *this;
+    }
+
+    // Unchanged if the allocation throws. The text may be part of this string
+    SmallString &operator=(std::string_view text) {
+        if (text.size() + 1 > chars_.capacity()) {
+            SmallString fresh(text, chars_.resource());
+            chars_ = std::move(fresh.chars_);  // same resource: takes the buffer
+            return *this;
+        }
+        chars_.clear();
+        chars_.append(text.begin(), text.end());
+        chars_.push_back('\0');
+        return *this;
+    }
+
+    size_t size() const { return chars_.size() - 1; }
+    size_t length() const { return size(); }
+    size_t capacity() const { return chars_.capacity() - 1; }
+    bool empty() const { return size() == 0; }
+    bool isInline() const { return chars_.isInline(); }
+
+    const char *c_str() const { return chars_.data(); }
+    const char *data() const { return chars_.data(); }
+    char *data() { return chars_.data(); }
+    char *begin() { return chars_.begin(); }
+    char *end() { return chars_.end() - 1; }
+    const char *begin() const { return chars_.begin(); }
+    const char *end() const { return chars_.end() - 1; }
+    char &operator[](size_t i) { return chars_[i]; }
+    char operator[](size_t i) const { return chars_[i]; }
+
+    std::string_view view() const { return std::string_view(data(), size()); }
+    operator std::string_view() const { return view(); }
+    std::string str() const { return std::string(data(), size()); }
+
+    void reserve(size_t count) { chars_.reserve(count + 1); }
+    void shrink_to_fit() { chars_.shrink_to_fit(); }
+
+    void clear() {
+        chars_.clear();
+        chars_.push_back('\0');
+    }
+
+    void resize(size_t count, char fill = '\0') {
+        chars_.reserve(count + 1);  // the only step that can throw
+        chars_.pop_back();
+        chars_.resize(count, fill);
+        chars_.push_back('\0');
+    }
+
+    // The text may be part of this string. Grows first, so a throw
+    // leaves the string as it was
+    SmallString &append(std::string_view text) {
+        const size_t needed = chars_.size() + text.size();
+        if (needed > chars_.capacity()) {
+            const std::less_equal<const char *> before;
+            const bool ours = before(begin(), text.data()) && before(text.data(), end());
+            const size_t offset = ours ? size_t(text.data() - begin()) : 0;
+            chars_.reserve(std::max(needed, 2 * chars_.capacity()));
+            if (ours) text = std::string_view(begin() + offset, text.size());
+        }
+        chars_.pop_back();
+        chars_.append(text.begin(), text.end());
+        chars_.push_back('\0');
+        return *this;
+    }
+
+    void push_back(char c) {
+        chars_.push_back('\0');  // grow first, so a throw changes nothing
+        chars_[chars_.size() - 2] = c;
+    }
+
+    SmallString &operator+=(std::string_view text) { return append(text); }
+    SmallString &operator+=(char c) {
+        push_back(c);
+        return *this;
+    }
+
+    friend bool operator==(const SmallString &a, const SmallString &b) { return a.view() == b.view(); }
+    friend bool operator==(const SmallString &a, std::string_view b) { return a.view() == b; }
+    friend bool operator==(std::string_view a, const SmallString &b) { return a == b.view(); }
+    friend bool operator!=(const SmallString &a, const SmallString &b) { return a.view() != b.view(); }
+    friend bool operator!=(const SmallString &a, std::string_view b) { return a.view() != b; }
+    friend bool operator!=(std::string_view a, const SmallString &b) { return a != b.view(); }
+    friend bool operator==(const SmallString &a, const char *b) { return a.view() == b; }
+    friend bool operator!=(const SmallString &a, const char *b) { return a.view() != b; }
+    friend bool operator<(const SmallString &a, const SmallString &b) { return a.view() < b.view(); }
+
+    friend std::ostream &operator<<(std::ostream &out, const SmallString &s) { return out << s.view(); }
+
+private:
+    SmallVector<char, N + 1> chars_;  // always ends with '\0'
+};
+
+#endif  // SMALL_VECTOR_HPP
@@ -0,0 +1,506 @@
+/*
+ * storage_io.hpp - Reading and Writing Files Four Ways, Measured
+ * DataStorage.jsx quotes device speeds; this measures them.
+ *
+ * The same blocks of a file can be moved with:
+ *   - read()/write(): through the page cache, the kernel's copy of the
+ *     file in RAM. Reads after the first can come from memory.
+ *   - mmap: the file's pages are mapped into our memory. Touching one
+ *     that isn't in RAM yet is a page fault, and the kernel reads it in.
+ *   - O_DIRECT: no page cache. Each request goes straight between the
+ *     device and our buffer, which must be aligned to 4096 bytes.
+ *   - io_uring: many requests in flight at once (the QUEUE DEPTH). They
+ *     go into a ring buffer shared with the kernel, and one system call
+ *     submits a whole batch. Fast devices need depth to reach full speed.
+ *
+ *   storio::Job job;
+ *   job.backend = storio::Backend::Uring;
+ *   job.direct = true;                         // O_DIRECT as well
+ *   job.pattern = storio::Pattern::Random;
+ *   job.block_size = 4096;
+ *   job.queue_depth = 32;
+ *   storio::Result r = storio::run("test.dat", job);
+ *   if (!r.ok()) ...                           // r.error
+ *   r.mbPerSec(), r.iops(), r.percentileUs(0.99)
+ *
+ * Every request is timed on its own (submit to completion), so results
+ * come with latency percentiles. io_uring is driven with raw system calls
+ * (no liburing needed); it needs Linux 5.6 or newer, and containers may
+ * block it (run() then reports the error).
+ */
+
+#ifndef STORAGE_IO_HPP
+#define STORAGE_IO_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace storio {
+
+enum class Backend { Read, Mmap, Uring };
+enum class Pattern { Sequential, Random };
+enum class Op { Read, Write };
+
+struct Job {
+    Backend backend = Backend::Read;
+    bool direct = false;  // O_DIRECT (Read and Uring backends)
+    Op op = Op::Read;
+    Pattern pattern = Pattern::Sequential;
+    size_t block_size = 1 << 20;
+    unsigned queue_depth = 1;  // requests in flight (Uring; the others wait for each one)
+    uint64_t max_bytes = 0;    // stop after this many bytes (0: the whole file once)
+    double max_seconds = 2;    // ... or after this long
+    bool drop_cache = true;    // evict the file from the page cache first
+    bool sync = true;          // writes: fsync (msync for mmap) at the end, inside the time
+    bool verify = false;       // writes fill, and reads check, fillPattern's bytes
+    uint64_t seed = 1;
+};
+
+inline std::string jobName(const Job &job) {
+    std::string name = job.backend == Backend::Mmap    ? "mmap"
+                       : job.backend == Backend::Uring ? "io_uring"
+                       : job.op == Op::Read            ? "read"
+                                                       : "write";
+    return job.direct ? name + " + O_DIRECT" : name;
+}
+
+struct Result {
+    std::string error;
+    uint64_t requests = 0;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    std::vector<uint32_t> latency_ns;  // one per request, sorted
+
+    bool ok() const { return error.empty(); }
+    double mbPerSec() const { return seconds > 0 ? double(bytes) / seconds / 1e6 : 0; }
+    double iops() const { return seconds > 0 ? double(requests) / seconds : 0; }
+
+    double percentileUs(double fraction) const {
+        if (latency_ns.empty()) return 0;
+        size_t i = std::min(latency_ns.size() - 1, size_t(fraction * double(latency_ns.size())));
+        return latency_ns[i] / 1e3;
+    }
+};
+
+inline uint64_t nowNs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000u + uint64_t(ts.tv_nsec);
+}
+
+inline std::string systemError(const char *what) { return std::string(what) + ": " + std::strerror(errno); }
+
+// ---- Test data ----
+
+// The 8 bytes at file offset o (a multiple of 8) hold a number made from o,
+// so any block can be checked without keeping a copy
+inline uint64_t patternWord(uint64_t offset) { return (offset * 0x9E3779B97F4A7C15ull) ^ 0x5A5A5A5A5A5A5A5Aull; }
+
+inline void fillPattern(void *buf, uint64_t offset, size_t length) {
+    uint8_t *p = static_cast<uint8_t *>(buf);
+    for (size_t i = 0; i + 8 <= length; i += 8) {
+        uint64_t word = patternWord(offset + i);
+        std::memcpy(p + i, &word, 8);
+    }
+}
+
+inline bool checkPattern(const void *buf, uint64_t offset, size_t length) {
+    const uint8_t *p = static_cast<const uint8_t *>(buf);
+    for (size_t i = 0; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, p + i, 8);
+        if (word != patternWord(offset + i)) return false;
+    }
+    return true;
+}
+
+// Write a file of `size` bytes (a multiple of 4096) full of the pattern
+inline std::string createFile(const std::string &path, uint64_t size) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return systemError(("cannot create " + path).c_str());
+    std::vector<uint8_t> chunk(1 << 20);
+    std::string error;
+    for (uint64_t at = 0; at < size && error.empty(); at += chunk.size()) {
+        size_t length = size_t(std::min<uint64_t>(chunk.size(), size - at));
+        fillPattern(chunk.data(), at, length);
+        if (::pwrite(fd, chunk.data(), length, off_t(at)) != ssize_t(length)) error = systemError("write");
+    }
+    if (error.empty() && ::fsync(fd) != 0) error = systemError("fsync");
+    ::close(fd);
+    return error;
+}
+
+// Forget the file's pages in the page cache (no root needed, unlike
+// /proc/sys/vm/drop_caches), so the next read really reads the device
+inline void dropCache(int fd) {
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+// ---- io_uring with raw system calls ----
+
+class Uring {
+public:
+    explicit Uring(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof params);
+        fd_ = int(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            error_ = systemError("io_uring_setup");
+            return;
+        }
+        entries_ = params.sq_entries;
+        sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+        sq_ring_ = map(sq_size_, IORING_OFF_SQ_RING);
+        cq_ring_ = single ? sq_ring_ : map(cq_size_, IORING_OFF_CQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(map(sqes_size_, IORING_OFF_SQES));
+        if (!ok()) return;
+        uint8_t *sq = static_cast<uint8_t *>(sq_ring_);
+        uint8_t *cq = static_cast<uint8_t *>(cq_ring_);
+        sq_head_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        tail_ = *sq_tail_;
+    }
+
+    ~Uring() {
+        if (sqes_) ::munmap(sqes_, sqes_size_);
+        if (cq_ring_ && cq_ring_ != sq_ring_) ::munmap(cq_ring_, cq_size_);
+        if (sq_ring_) ::munmap(sq_ring_, sq_size_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    Uring(const Uring &) = delete;
+    Uring &operator=(const Uring &) = delete;
+
+    bool ok() const { return error_.empty(); }
+    const std::string &error() const { return error_; }
+
+    // A cleared request to fill in, or nullptr if the ring is full
+    io_uring_sqe *next() {
+        unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (tail_ - head >= entries_) return nullptr;
+        unsigned index = tail_ & sq_mask_;
+        io_uring_sqe *sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof *sqe);
+        sq_array_[index] = index;
+        tail_++;
+        pending_++;
+        return sqe;
+    }
+
+    // Hand every request from next() to the kernel in one system call,
+    // and wait until at least `wait` have finished. Returns false on error.
+    bool submit(unsigned wait) {
+        __atomic_store_n(sq_tail_, tail_, __ATOMIC_RELEASE);
+        for (;;) {
+            long r = ::syscall(__NR_io_uring_enter, fd_, pending_, wait, wait ? IORING_ENTER_GETEVENTS : 0u,
+                               nullptr, 0);
+            if (r >= 0) {
+                pending_ -= unsigned(r);
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN) {
+                error_ = systemError("io_uring_enter");
+                return false;
+            }
+        }
+    }
+
+    // Call done(cqe) for each finished request; returns how many
+    template <typename Done>
+    unsigned reap(Done done) {
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        unsigned count = tail - head;
+        for (; head != tail; head++) done(cqes_[head & cq_mask_]);
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+private:
+    void *map(size_t size, uint64_t offset) {
+        if (!ok()) return nullptr;
+        void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, off_t(offset));
+        if (p == MAP_FAILED) {
+            error_ = systemError("mmap io_uring");
+            return nullptr;
+        }
+        return p;
+    }
+
+    std::string error_;
+    int fd_ = -1;
+    unsigned entries_ = 0;
+    void *sq_ring_ = nullptr;
+    void *cq_ring_ = nullptr;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sq_size_ = 0, cq_size_ = 0, sqes_size_ = 0;
+    unsigned *sq_head_ = nullptr, *sq_tail_ = nullptr, *sq_array_ = nullptr;
+    unsigned *cq_head_ = nullptr, *cq_tail_ = nullptr;
+    unsigned sq_mask_ = 0, cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+    unsigned tail_ = 0;     // our copy of the submission tail
+    unsigned pending_ = 0;  // filled in but not yet taken by the kernel
+};
+
+// ---- Running a job ----
+
+// Which block each request uses: one after another (wrapping around), or
+// uniformly random
+class Offsets {
+public:
+    Offsets(const Job &job, uint64_t blocks) : random_(job.pattern == Pattern::Random), blocks_(blocks),
+                                                 block_(job.block_size), state_(job.seed | 1) {}
+
+    uint64_t next() {
+        if (!random_) return (count_++ % blocks_) * block_;
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return (state_ % blocks_) * block_;
+    }
+
+private:
+    bool random_;
+    uint64_t blocks_, block_, state_, count_ = 0;
+};
+
+// Buffers aligned for O_DIRECT, freed automatically
+struct AlignedBuffer {
+    uint8_t *data = nullptr;
+    explicit AlignedBuffer(size_t size) {
+        void *p = nullptr;
+        if (posix_memalign(&p, 4096, std::max<size_t>(size, 4096)) == 0) data = static_cast<uint8_t *>(p);
+    }
+    ~AlignedBuffer() { std::free(data); }
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+};
+
+namespace detail {
+
+// Shared state of one run: where to go next, when to stop, what happened
+struct Runner {
+    const Job &job;
+    Result &result;
+    Offsets offsets;
+    uint64_t limit;  // requests
+    uint64_t deadline;
+
+    Runner(const Job &j, Result &r, uint64_t blocks)
+        : job(j), result(r), offsets(j, blocks),
+          limit(j.max_bytes ? std::max<uint64_t>(j.max_bytes / j.block_size, 1) : blocks),
+          deadline(nowNs() + uint64_t(j.max_seconds * 1e9)) {
+        result.latency_ns.reserve(size_t(std::min<uint64_t>(limit, 1 << 24)));
+    }
+
+    bool ok() const { return result.ok(); }
+    bool more(uint64_t started) const { return started < limit && nowNs() < deadline; }
+
+    void finished(uint64_t start_ns, uint64_t end_ns) {
+        result.requests++;
+        result.bytes += job.block_size;
+        uint64_t took = end_ns - start_ns;
+        result.latency_ns.push_back(uint32_t(std::min<uint64_t>(took, UINT32_MAX)));
+    }
+
+    // Before a write: the block's pattern (only when verifying; otherwise
+    // the buffer keeps whatever it has, so filling costs nothing)
+    void prepare(uint8_t *buf, uint64_t offset) const {
+        if (job.verify && job.op == Op::Write) fillPattern(buf, offset, job.block_size);
+    }
+
+    bool check(const uint8_t *buf, uint64_t offset) {
+        if (job.verify && job.op == Op::Read && !checkPattern(buf, offset, job.block_size)) {
+            result.error = "wrong data read at offset " + std::to_string(offset);
+            return false;
+        }
+        return true;
+    }
+};
+
+inline void runSync(int fd, Runner &run) {
+    AlignedBuffer buf(run.job.block_size);
+    fillPattern(buf.data, 0, run.job.block_size);
+    const bool reading = run.job.op == Op::Read;
+    for (uint64_t i = 0; run.more(i); i++) {
+        uint64_t offset = run.offsets.next();
+        run.prepare(buf.data, offset);
+        uint64_t t0 = nowNs();
+        ssize_t n = reading ? ::pread(fd, buf.data, run.job.block_size, off_t(offset))
+                            : ::pwrite(fd, buf.data, run.job.block_size, off_t(offset));
+        uint64_t t1 = nowNs();
+        if (n != ssize_t(run.job.block_size)) {
+            run.result.error = n < 0 ? systemError(reading ? "read" : "write") : "short transfer";
+            return;
+        }
+        run.finished(t0, t1);
+        if (!run.check(buf.data, offset)) return;
+    }
+}
+
+inline void runMmap(int fd, uint64_t size, Runner &run) {
+    const bool reading = run.job.op == Op::Read;
+    void *map = ::mmap(nullptr, size, reading ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        run.result.error = systemError("mmap");
+        return;
+    }
+    uint8_t *file = static_cast<uint8_t *>(map);
+    ::madvise(map, size, run.job.pattern == Pattern::Random ? MADV_RANDOM : MADV_SEQUENTIAL);
+    AlignedBuffer buf(run.job.block_size);
+    fillPattern(buf.data, 0, run.job.block_size);
+    for (uint64_t i = 0; run.more(i); i++) {
+        uint64_t offset = run.offsets.next();
+        run.prepare(buf.data, offset);
+        uint64_t t0 = nowNs();
+        if (reading) {
+            std::memcpy(buf.data, file + offset, run.job.block_size);
+        } else {
+            std::memcpy(file + offset, buf.data, run.job.block_size);
+        }
+        uint64_t t1 = nowNs();
+        run.finished(t0, t1);
+        if (!run.check(buf.data, offset)) break;
+    }
+    if (!reading && run.job.sync && ::msync(map, size, MS_SYNC) != 0) run.result.error = systemError("msync");
+    ::munmap(map, size);
+}
+
+inline void runUring(int fd, Runner &run) {
+    const unsigned depth = std::max(1u, run.job.queue_depth);
+    Uring ring(depth);
+    if (!ring.ok()) {
+        run.result.error = ring.error();
+        return;
+    }
+    struct Slot {
+        uint64_t offset;
+        uint64_t start;
+    };
+    const size_t block = run.job.block_size;
+    AlignedBuffer buffers(block * depth);
+    fillPattern(buffers.data, 0, block * depth);
+    std::vector<Slot> slots(depth);
+    std::vector<unsigned> free_slots;
+    for (unsigned s = depth; s-- > 0;) free_slots.push_back(s);
+    const bool reading = run.job.op == Op::Read;
+
+    uint64_t started = 0;
+    unsigned in_flight = 0;
+    while (run.ok()) {
+        // Refill every free slot, then submit them all with one call
+        while (!free_slots.empty() && run.more(started)) {
+            io_uring_sqe *sqe = ring.next();
+            if (!sqe) break;
+            unsigned s = free_slots.back();
+            free_slots.pop_back();
+            slots[s].offset = run.offsets.next();
+            run.prepare(buffers.data + s * block, slots[s].offset);
+            sqe->opcode = reading ? IORING_OP_READ : IORING_OP_WRITE;
+            sqe->fd = fd;
+            sqe->addr = uint64_t(uintptr_t(buffers.data + s * block));
+            sqe->len = uint32_t(block);
+            sqe->off = slots[s].offset;
+            sqe->user_data = s;
+            slots[s].start = nowNs();
+            started++;
+            in_flight++;
+        }
+        if (in_flight == 0) break;
+        if (!ring.submit(1)) {
+            run.result.error = ring.error();
+            break;
+        }
+        uint64_t now = nowNs();
+        ring.reap([&](const io_uring_cqe &cqe) {
+            unsigned s = unsigned(cqe.user_data);
+            in_flight--;
+            free_slots.push_back(s);
+            if (!run.ok()) return;
+            if (cqe.res != int(block)) {
+                errno = -cqe.res;
+                run.result.error = cqe.res < 0 ? systemError(reading ? "io_uring read" : "io_uring write")
+                                               : "short transfer";
+                return;
+            }
+            run.finished(slots[s].start, now);
+            run.check(buffers.data + s * block, slots[s].offset);
+        });
+    }
+    // On an error, wait for the requests still using the buffers
+    while (in_flight > 0 && ring.submit(1)) in_flight -= ring.reap([](const io_uring_cqe &) {});
+}
+
+}  // namespace detail
+
+// Run one job on an existing file (see createFile). Reads and writes stay
+// inside the file; writes need it to be writable.
+inline Result run(const std::string &path, const Job &job) {
+    Result result;
+    if (job.block_size < 4096 || job.block_size % 4096 != 0) {
+        result.error = "block size must be a multiple of 4096";
+        return result;
+    }
+    int flags = job.op == Op::Read ? O_RDONLY : O_RDWR;
+    if (job.direct && job.backend != Backend::Mmap) flags |= O_DIRECT;
+    int fd = ::open(path.c_str(), flags);
+    if (fd < 0) {
+        result.error = errno == EINVAL && job.direct ? "O_DIRECT is not supported by this file system"
+                                                     : systemError(("cannot open " + path).c_str());
+        return result;
+    }
+    struct stat st;
+    uint64_t size = ::fstat(fd, &st) == 0 ? uint64_t(st.st_size) : 0;
+    uint64_t blocks = size / job.block_size;
+    if (blocks == 0) {
+        result.error = path + " is smaller than one block";
+        ::close(fd);
+        return result;
+    }
+    if (job.drop_cache) dropCache(fd);
+
+    struct detail::Runner runner(job, result, blocks);
+    uint64_t t0 = nowNs();
+    if (job.backend == Backend::Mmap) {
+        detail::runMmap(fd, blocks * job.block_size, runner);
+    } else if (job.backend == Backend::Uring) {
+        detail::runUring(fd, runner);
+    } else {
+        detail::runSync(fd, runner);
+    }
+    if (result.ok() && job.op == Op::Write && job.sync && job.backend != Backend::Mmap && ::fsync(fd) != 0) {
+        result.error = systemError("fsync");
+    }
+    result.seconds = double(nowNs() - t0) / 1e9;
+    ::close(fd);
+    std::sort(result.latency_ns.begin(), result.latency_ns.end());
+    return result;
+}
+
+}  // namespace storio
+
+#endif
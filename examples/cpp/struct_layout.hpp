@@ -0,0 +1,199 @@
+/*
+ * struct_layout.hpp - See Where the Bytes in a Struct Go
+ * sizeof() of a struct is often bigger than the sum of its members.
+ *
+ * Every member must start at a multiple of its alignment, so the
+ * compiler inserts unused "padding" bytes between members (and at the
+ * end, so arrays of the struct stay aligned). Declaring the same
+ * members in a different order can make those holes disappear.
+ *
+ * C++ can't list a struct's members by itself, so you name them:
+ *
+ *   struct Particle { char tag; double mass; int id; };
+ *
+ *   StructLayout layout = StructLayout::of<Particle>("Particle")
+ *       .field("tag", &Particle::tag)
+ *       .field("mass", &Particle::mass)
+ *       .field("id", &Particle::id);
+ *   layout.print(std::cout);      // offsets, sizes, holes
+ *   layout.printSuggestion(std::cout);   // an order with less padding
+ *
+ * .LAYOUT_FIELD(Particle, mass) is short for .field("mass", &Particle::mass).
+ * List every member: bytes of members you leave out count as padding.
+ * The struct must be default-constructible (one is made to measure it).
+ */
+
+#ifndef STRUCT_LAYOUT_HPP
+#define STRUCT_LAYOUT_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define LAYOUT_FIELD(Type, member) field(#member, &Type::member)
+
+class StructLayout {
+public:
+    static constexpr size_t kCacheLine = 64;
+
+    struct Field {
+        std::string name;
+        size_t offset;
+        size_t size;
+        size_t align;
+        size_t padding_after;  // unused bytes before the next member (or the end)
+    };
+
+    template <typename T>
+    class Builder;
+
+    template <typename T>
+    static Builder<T> of(std::string name) {
+        return Builder<T>(std::move(name));
+    }
+
+    const std::string &name() const { return name_; }
+    size_t size() const { return size_; }
+    size_t align() const { return align_; }
+    const std::vector<Field> &fields() const { return fields_; }
+
+    // Bytes that hold no member at all
+    size_t paddingBytes() const {
+        size_t total = 0;
+        for (const Field &f : fields_) total += f.padding_after;
+        return total;
+    }
+
+    // The smallest size any order of these members can reach
+    size_t packedSize() const {
+        return roundUp(bestOrderSize(), align_);
+    }
+
+    // Members sorted from strictest to loosest alignment (ties keep
+    // their order). This never has holes between members, because each
+    // one starts where a stricter one ended.
+    std::vector<Field> suggestedOrder() const {
+        std::vector<Field> order = fields_;
+        std::stable_sort(order.begin(), order.end(), [](const Field &a, const Field &b) {
+            return a.align > b.align;
+        });
+        return layOut(order);
+    }
+
+    void print(std::ostream &out) const {
+        out << "   struct " << name_ << ": sizeof " << size_ << ", alignof " << align_ << "\n";
+        printFields(out, fields_);
+        size_t lines = (size_ + kCacheLine - 1) / kCacheLine;
+        out << "   " << paddingBytes() << " of " << size_ << " bytes are padding; ";
+        if (size_ <= kCacheLine) {
+            out << kCacheLine / size_ << " fit in one " << kCacheLine << "-byte cache line\n";
+        } else {
+            out << "each one needs " << lines << " cache lines\n";
+        }
+    }
+
+    void printSuggestion(std::ostream &out) const {
+        std::vector<Field> order = suggestedOrder();
+        size_t better = packedSize();
+        if (better >= size_) {
+            out << "   " << name_ << " is already as small as it can be (" << size_ << " bytes)\n";
+            return;
+        }
+        out << "   Suggested order for " << name_ << ": " << size_ << " -> " << better
+            << " bytes (" << std::fixed << std::setprecision(0)
+            << 100.0 * (size_ - better) / size_ << "% smaller)\n" << std::defaultfloat;
+        printFields(out, order);
+    }
+
+private:
+    template <typename T>
+    friend class Builder;
+
+    StructLayout(std::string name, size_t size, size_t align)
+        : name_(std::move(name)), size_(size), align_(align) {}
+
+    static size_t roundUp(size_t n, size_t align) { return (n + align - 1) / align * align; }
+
+    size_t bestOrderSize() const {
+        std::vector<Field> order = suggestedOrder();
+        return order.empty() ? 0 : order.back().offset + order.back().size;
+    }
+
+    // Give each field the offset the compiler would, in this order
+    std::vector<Field> layOut(std::vector<Field> order) const {
+        size_t offset = 0;
+        for (Field &f : order) {
+            f.offset = roundUp(offset, f.align);
+            offset = f.offset + f.size;
+        }
+        size_t end = roundUp(offset, align_);
+        for (size_t i = 0; i < order.size(); i++) {
+            size_t next = i + 1 < order.size() ? order[i + 1].offset : end;
+            order[i].padding_after = next - order[i].offset - order[i].size;
+        }
+        return order;
+    }
+
+    // Sort by offset and measure the gap after each member
+    void finish() {
+        std::stable_sort(fields_.begin(), fields_.end(), [](const Field &a, const Field &b) {
+            return a.offset < b.offset;
+        });
+        for (size_t i = 0; i < fields_.size(); i++) {
+            size_t next = i + 1 < fields_.size() ? fields_[i + 1].offset : size_;
+            size_t end = fields_[i].offset + fields_[i].size;
+            fields_[i].padding_after = next > end ? next - end : 0;
+        }
+    }
+
+    static void printFields(std::ostream &out, const std::vector<Field> &fields) {
+        out << "      offset  size  align  member\n";
+        for (const Field &f : fields) {
+            out << "      " << std::setw(6) << f.offset << std::setw(6) << f.size
+                << std::setw(7) << f.align << "  " << f.name;
+            if (f.offset / kCacheLine != (f.offset + f.size - 1) / kCacheLine) {
+                out << "  (crosses a cache line)";
+            }
+            out << "\n";
+            if (f.padding_after > 0) {
+                out << "      " << std::setw(6) << f.offset + f.size << std::setw(6)
+                    << f.padding_after << "         [padding]\n";
+            }
+        }
+    }
+
+    std::string name_;
+    size_t size_;
+    size_t align_;
+    std::vector<Field> fields_;
+};
+
+template <typename T>
+class StructLayout::Builder {
+public:
+    explicit Builder(std::string name) : layout_(std::move(name), sizeof(T), alignof(T)) {}
+
+    // Works for any member type, including arrays and nested structs
+    template <typename M>
+    Builder &field(std::string name, M T::*member) {
+        static const T sample{};
+        const char *base = reinterpret_cast<const char *>(&sample);
+        const char *where = reinterpret_cast<const char *>(&(sample.*member));
+        layout_.fields_.push_back({std::move(name), size_t(where - base), sizeof(M), alignof(M), 0});
+        return *this;
+    }
+
+    operator StructLayout() {
+        layout_.finish();
+        return layout_;
+    }
+
+private:
+    StructLayout layout_;
+};
+
+#endif  // STRUCT_LAYOUT_HPP
@@ -0,0 +1,503 @@
+/*
+ * utf8.hpp - Checking and Decoding Real-World UTF-8 Text
+ * NameDecoder.jsx turns every character into one byte - fine for "Hi",
+ * wrong for "Zoë" or "東京". In UTF-8 a character (code point) takes
+ * 1 to 4 bytes:
+ *
+ *   0xxxxxxx                              U+0000 .. U+007F   (ASCII)
+ *   110xxxxx 10xxxxxx                     U+0080 .. U+07FF
+ *   1110xxxx 10xxxxxx 10xxxxxx            U+0800 .. U+FFFF
+ *   11110xxx 10xxxxxx 10xxxxxx 10xxxxxx   U+10000 .. U+10FFFF
+ *
+ * and plenty of byte strings are NOT valid UTF-8 (a 10xxxxxx on its own,
+ * a missing one, "overlong" forms like C0 80 for U+0000, surrogates,
+ * values above U+10FFFF). This header:
+ *   - validates 32 bytes per step with AVX2 (three table lookups per
+ *     byte pair, the method of Keiser & Lemire), and skips plain ASCII
+ *     64 bytes at a time,
+ *   - decodes to UTF-32 or UTF-16, widening ASCII runs 32 bytes at a time,
+ *   - lists every code point with its bytes and bits, for learning.
+ *
+ *   utf8::Result r = utf8::validate(text, len);
+ *   if (!r.ok()) printf("%s at byte %zu\n", utf8::errorText(r.error), r.position);
+ *
+ *   std::vector<char32_t> wide(len);                // never more than len
+ *   r = utf8::toUtf32(text, len, wide.data());      // r.written code points
+ *
+ *   std::vector<utf8::CodePoint> cps;
+ *   utf8::codePoints(text, len, cps);
+ *   utf8::byteBits(text, cps[0]);                   // "110|00011 10|101001"
+ */
+
+#ifndef UTF8_HPP
+#define UTF8_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define UTF8_X86 1
+#else
+#define UTF8_X86 0
+#endif
+
+namespace utf8 {
+
+enum class Error {
+    None,
+    UnexpectedContinuation,  // 10xxxxxx where a character should start
+    MissingContinuation,     // a character cut short (also at the end of the text)
+    Overlong,                // more bytes than the value needs (C0 80 for U+0000)
+    Surrogate,               // U+D800 .. U+DFFF are reserved for UTF-16
+    TooLarge,                // above U+10FFFF
+    InvalidByte              // F8 .. FF never appear in UTF-8
+};
+
+inline const char *errorText(Error e) {
+    switch (e) {
+    case Error::None:                   return "valid";
+    case Error::UnexpectedContinuation: return "unexpected continuation byte";
+    case Error::MissingContinuation:    return "missing continuation byte";
+    case Error::Overlong:               return "overlong encoding";
+    case Error::Surrogate:              return "UTF-16 surrogate";
+    case Error::TooLarge:               return "above U+10FFFF";
+    default:                            return "invalid byte";
+    }
+}
+
+struct Result {
+    Error error = Error::None;
+    size_t position = 0;  // where the bad character starts (or the input length)
+    size_t written = 0;   // code points (UTF-32) or code units (UTF-16) written
+
+    bool ok() const { return error == Error::None; }
+};
+
+enum class Kernel { Scalar, Avx2 };
+
+inline const char *kernelName(Kernel k) {
+    return k == Kernel::Avx2 ? "avx2" : "scalar";
+}
+
+// One code point and where it sits in the text
+struct CodePoint {
+    char32_t value;
+    size_t offset;  // first byte
+    int length;     // 1 .. 4 bytes
+};
+
+// ---- Plain C++: one character at a time ----
+
+// Decode the character at p: returns its length, or 0 and sets error
+inline int decodeOne(const uint8_t *p, const uint8_t *end, char32_t &value, Error &error) {
+    uint8_t lead = p[0];
+    if (lead < 0x80) { value = lead; return 1; }
+    int length;
+    char32_t min;
+    if (lead < 0xC0) { error = Error::UnexpectedContinuation; return 0; }
+    if (lead < 0xE0) { length = 2; value = lead & 0x1F; min = 0x80; }
+    else if (lead < 0xF0) { length = 3; value = lead & 0x0F; min = 0x800; }
+    else if (lead < 0xF8) { length = 4; value = lead & 0x07; min = 0x10000; }
+    else { error = Error::InvalidByte; return 0; }
+    for (int i = 1; i < length; i++) {
+        if (p + i >= end || (p[i] & 0xC0) != 0x80) { error = Error::MissingContinuation; return 0; }
+        value = (value << 6) | (p[i] & 0x3F);
+    }
+    if (value < min) error = Error::Overlong;
+    else if (value > 0x10FFFF) error = Error::TooLarge;
+    else if (value >= 0xD800 && value <= 0xDFFF) error = Error::Surrogate;
+    else return length;
+    return 0;
+}
+
+inline size_t asciiLengthScalar(const char *data, size_t len) {
+    size_t i = 0;
+    // Eight bytes at a time: any high bit set means "not ASCII"
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        if (word & 0x8080808080808080ull) break;
+    }
+    while (i < len && (uint8_t(data[i]) & 0x80) == 0) i++;
+    return i;
+}
+
+inline Result validateScalar(const char *data, size_t len) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data), *end = p + len;
+    Result r;
+    size_t i = 0;
+    while (i < len) {
+        if (p[i] < 0x80) { i++; continue; }
+        char32_t value;
+        int n = decodeOne(p + i, end, value, r.error);
+        if (n == 0) { r.position = i; return r; }
+        i += size_t(n);
+    }
+    r.position = len;
+    return r;
+}
+
+// Write one code point: UTF-32 is the value itself, UTF-16 is one unit
+// or a surrogate pair
+inline size_t putUnits(char32_t *out, char32_t value) {
+    out[0] = value;
+    return 1;
+}
+
+inline size_t putUnits(char16_t *out, char32_t value) {
+    if (value < 0x10000) { out[0] = char16_t(value); return 1; }
+    value -= 0x10000;
+    out[0] = char16_t(0xD800 + (value >> 10));
+    out[1] = char16_t(0xDC00 + (value & 0x3FF));
+    return 2;
+}
+
+// Decode [i, stop) (and the rest of the character at stop) into out
+template <typename Unit>
+inline bool decodeRange(const uint8_t *p, size_t len, size_t &i, size_t stop, Unit *out, Result &r) {
+    while (i < stop) {
+        if (p[i] < 0x80) { out[r.written++] = Unit(p[i++]); continue; }
+        char32_t value;
+        int n = decodeOne(p + i, p + len, value, r.error);
+        if (n == 0) { r.position = i; return false; }
+        r.written += putUnits(out + r.written, value);
+        i += size_t(n);
+    }
+    return true;
+}
+
+template <typename Unit>
+inline Result transcodeScalar(const char *data, size_t len, Unit *out) {
+    Result r;
+    size_t i = 0;
+    if (decodeRange(reinterpret_cast<const uint8_t *>(data), len, i, len, out, r)) r.position = len;
+    return r;
+}
+
+#if UTF8_X86
+
+// ---- AVX2: 32 bytes per step ----
+
+#define UTF8_SIMD __attribute__((target("avx2"), always_inline)) inline
+
+UTF8_SIMD __m256i load32(const uint8_t *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+// Bytes that came just before each byte of input (prev = the block before)
+template <int N>
+UTF8_SIMD __m256i previous(__m256i input, __m256i prev) {
+    return _mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+}
+
+UTF8_SIMD __m256i lookup16(__m256i table, __m256i index) {
+    return _mm256_shuffle_epi8(table, index);
+}
+
+// Each error kind is one bit. A byte pair is bad when the same bit is set
+// in all three lookups: high nibble of the first byte, its low nibble,
+// and high nibble of the second byte.
+enum : uint8_t {
+    kTooShort = 1 << 0,   // lead byte followed by lead byte or ASCII
+    kTooLong = 1 << 1,    // ASCII followed by a continuation byte
+    kOverlong3 = 1 << 2,  // E0 followed by 80 .. 9F
+    kTooLarge = 1 << 3,   // F4 90 and above
+    kSurrogate = 1 << 4,  // ED followed by A0 .. BF
+    kOverlong2 = 1 << 5,  // C0 / C1
+    kTooLarge1000 = 1 << 6,
+    kOverlong4 = 1 << 6,  // F0 followed by 80 .. 8F
+    kTwoConts = 1 << 7,   // two continuation bytes (allowed only inside a 3/4-byte character)
+    kCarry = kTooShort | kTooLong | kTwoConts
+};
+
+UTF8_SIMD __m256i specialCases(__m256i input, __m256i prev1) {
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i byte1_high_table = _mm256_setr_epi8(
+        kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+        kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+        kTooShort | kOverlong2, kTooShort, kTooShort | kOverlong3 | kSurrogate,
+        kTooShort | kTooLarge | kTooLarge1000 | kOverlong4,
+        kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+        kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+        kTooShort | kOverlong2, kTooShort, kTooShort | kOverlong3 | kSurrogate,
+        kTooShort | kTooLarge | kTooLarge1000 | kOverlong4);
+    const uint8_t big = kCarry | kTooLarge | kTooLarge1000;
+    const __m256i byte1_low_table = _mm256_setr_epi8(
+        kCarry | kOverlong3 | kOverlong2 | kOverlong4, kCarry | kOverlong2, kCarry, kCarry,
+        kCarry | kTooLarge, big, big, big, big, big, big, big, big, big | kSurrogate, big, big,
+        kCarry | kOverlong3 | kOverlong2 | kOverlong4, kCarry | kOverlong2, kCarry, kCarry,
+        kCarry | kTooLarge, big, big, big, big, big, big, big, big, big | kSurrogate, big, big);
+    const uint8_t cont80 = kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4;
+    const uint8_t cont90 = kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge;
+    const uint8_t contA0 = kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge;
+    const __m256i byte2_high_table = _mm256_setr_epi8(
+        kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+        cont80, cont90, contA0, contA0, kTooShort, kTooShort, kTooShort, kTooShort,
+        kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+        cont80, cont90, contA0, contA0, kTooShort, kTooShort, kTooShort, kTooShort);
+
+    __m256i byte1_high = lookup16(byte1_high_table, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+    __m256i byte1_low = lookup16(byte1_low_table, _mm256_and_si256(prev1, nibble));
+    __m256i byte2_high = lookup16(byte2_high_table, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+    return _mm256_and_si256(_mm256_and_si256(byte1_high, byte1_low), byte2_high);
+}
+
+// Errors in one block: the special cases above, plus "a second
+// continuation byte is allowed exactly where a 3/4-byte lead came 2/3
+// bytes earlier"
+UTF8_SIMD __m256i checkBlock(__m256i input, __m256i prev) {
+    __m256i prev1 = previous<1>(input, prev);
+    __m256i special = specialCases(input, prev1);
+    __m256i third = _mm256_subs_epu8(previous<2>(input, prev), _mm256_set1_epi8(char(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(previous<3>(input, prev), _mm256_set1_epi8(char(0xF0 - 0x80)));
+    __m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(char(0x80)));
+    return _mm256_xor_si256(must_continue, special);
+}
+
+// Non-zero where the last bytes of a block start a character that
+// doesn't end in it
+UTF8_SIMD __m256i incompleteAtEnd(__m256i input) {
+    const __m256i max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        char(0xF0 - 1), char(0xE0 - 1), char(0xC0 - 1));
+    return _mm256_subs_epu8(input, max);
+}
+
+__attribute__((target("avx2")))
+inline size_t asciiLengthAvx2(const char *data, size_t len) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        if (_mm256_movemask_epi8(_mm256_or_si256(load32(p + i), load32(p + i + 32)))) break;
+    }
+    for (; i + 32 <= len; i += 32) {
+        unsigned high_bits = unsigned(_mm256_movemask_epi8(load32(p + i)));
+        if (high_bits) return i + size_t(__builtin_ctz(high_bits));
+    }
+    return i + asciiLengthScalar(data + i, len - i);
+}
+
+// The vector check only says "somewhere in these 64 bytes (or a
+// character cut off just before them)". The scalar code finds the exact
+// spot, starting at the first character that begins in the 3 bytes
+// before the block.
+inline Result locateError(const char *data, size_t len, size_t block) {
+    size_t start = block >= 3 ? block - 3 : 0;
+    while (start < block && (uint8_t(data[start]) & 0xC0) == 0x80) start++;
+    Result r = validateScalar(data + start, len - start);
+    r.position += start;
+    return r;
+}
+
+__attribute__((target("avx2")))
+inline Result validateAvx2(const char *data, size_t len) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    __m256i prev = _mm256_setzero_si256();
+    __m256i prev_incomplete = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m256i a = load32(p + i), b = load32(p + i + 32);
+        __m256i error;
+        if (_mm256_movemask_epi8(_mm256_or_si256(a, b)) == 0) {
+            // All ASCII: only the end of the previous block can be wrong
+            error = prev_incomplete;
+            prev_incomplete = _mm256_setzero_si256();
+        } else {
+            error = _mm256_or_si256(checkBlock(a, prev), checkBlock(b, a));
+            prev_incomplete = incompleteAtEnd(b);
+        }
+        prev = b;
+        if (!_mm256_testz_si256(error, error)) return locateError(data, len, i);
+    }
+    // The rest, padded with zeros: a character cut off at the end now
+    // looks like a lead byte followed by ASCII
+    alignas(32) uint8_t tail[64] = {};
+    memcpy(tail, p + i, len - i);
+    __m256i a = load32(tail), b = load32(tail + 32);
+    __m256i error = _mm256_or_si256(checkBlock(a, prev), checkBlock(b, a));
+    if (!_mm256_testz_si256(error, error)) return locateError(data, len, i);
+    Result r;
+    r.position = len;
+    return r;
+}
+
+// Widen 32 ASCII bytes to UTF-32 / UTF-16
+__attribute__((target("avx2")))
+inline void widenAscii(__m256i bytes, char32_t *out) {
+    __m128i low = _mm256_castsi256_si128(bytes), high = _mm256_extracti128_si256(bytes, 1);
+    __m256i *dst = reinterpret_cast<__m256i *>(out);
+    _mm256_storeu_si256(dst + 0, _mm256_cvtepu8_epi32(low));
+    _mm256_storeu_si256(dst + 1, _mm256_cvtepu8_epi32(_mm_srli_si128(low, 8)));
+    _mm256_storeu_si256(dst + 2, _mm256_cvtepu8_epi32(high));
+    _mm256_storeu_si256(dst + 3, _mm256_cvtepu8_epi32(_mm_srli_si128(high, 8)));
+}
+
+__attribute__((target("avx2")))
+inline void widenAscii(__m256i bytes, char16_t *out) {
+    __m256i *dst = reinterpret_cast<__m256i *>(out);
+    _mm256_storeu_si256(dst + 0, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+    _mm256_storeu_si256(dst + 1, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+}
+
+// A character already known to be valid: no checks needed
+template <typename Unit>
+UTF8_SIMD void decodeValid(const uint8_t *p, size_t &i, Unit *out, size_t &written) {
+    uint8_t lead = p[i];
+    char32_t value;
+    if (lead < 0x80) {
+        out[written++] = Unit(lead);
+        i++;
+        return;
+    }
+    if (lead < 0xE0) {
+        value = char32_t(lead & 0x1F) << 6 | (p[i + 1] & 0x3F);
+        i += 2;
+    } else if (lead < 0xF0) {
+        value = char32_t(lead & 0x0F) << 12 | char32_t(p[i + 1] & 0x3F) << 6 | (p[i + 2] & 0x3F);
+        i += 3;
+    } else {
+        value = char32_t(lead & 0x07) << 18 | char32_t(p[i + 1] & 0x3F) << 12 | char32_t(p[i + 2] & 0x3F) << 6 |
+                (p[i + 3] & 0x3F);
+        i += 4;
+    }
+    written += putUnits(out + written, value);
+}
+
+// Check everything with the vector validator first, then decode the
+// valid part without checks: ASCII blocks are widened whole, other
+// blocks go one character at a time
+template <typename Unit>
+__attribute__((target("avx2")))
+inline Result transcodeAvx2(const char *data, size_t len, Unit *out) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    Result r = validateAvx2(data, len);
+    size_t valid = r.position;
+    size_t i = 0;
+    while (i + 32 <= valid) {
+        __m256i bytes = load32(p + i);
+        if (_mm256_movemask_epi8(bytes) == 0) {
+            widenAscii(bytes, out + r.written);
+            r.written += 32;
+            i += 32;
+        } else {
+            for (size_t stop = i + 32; i < stop;) decodeValid(p, i, out, r.written);
+        }
+    }
+    while (i < valid) decodeValid(p, i, out, r.written);
+    return r;
+}
+
+#undef UTF8_SIMD
+
+#endif  // UTF8_X86
+
+// ---- Pick the best kernel once, when first used ----
+
+inline Kernel detectKernel() {
+#if UTF8_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Kernel::Avx2;
+#endif
+    return Kernel::Scalar;
+}
+
+inline Kernel bestKernel() {
+    static const Kernel best = detectKernel();
+    return best;
+}
+
+// Length of the ASCII-only start of the text
+inline size_t asciiLengthWith(Kernel k, const char *data, size_t len) {
+#if UTF8_X86
+    if (k == Kernel::Avx2) return asciiLengthAvx2(data, len);
+#else
+    (void)k;
+#endif
+    return asciiLengthScalar(data, len);
+}
+
+inline Result validateWith(Kernel k, const char *data, size_t len) {
+#if UTF8_X86
+    if (k == Kernel::Avx2) return validateAvx2(data, len);
+#else
+    (void)k;
+#endif
+    return validateScalar(data, len);
+}
+
+// out needs room for len code points; stops at the first error
+inline Result toUtf32With(Kernel k, const char *data, size_t len, char32_t *out) {
+#if UTF8_X86
+    if (k == Kernel::Avx2) return transcodeAvx2(data, len, out);
+#else
+    (void)k;
+#endif
+    return transcodeScalar(data, len, out);
+}
+
+// out needs room for len code units; stops at the first error
+inline Result toUtf16With(Kernel k, const char *data, size_t len, char16_t *out) {
+#if UTF8_X86
+    if (k == Kernel::Avx2) return transcodeAvx2(data, len, out);
+#else
+    (void)k;
+#endif
+    return transcodeScalar(data, len, out);
+}
+
+inline size_t asciiLength(const char *data, size_t len) { return asciiLengthWith(bestKernel(), data, len); }
+inline Result validate(const char *data, size_t len) { return validateWith(bestKernel(), data, len); }
+inline Result toUtf32(const char *data, size_t len, char32_t *out) { return toUtf32With(bestKernel(), data, len, out); }
+inline Result toUtf16(const char *data, size_t len, char16_t *out) { return toUtf16With(bestKernel(), data, len, out); }
+
+// ---- Looking inside the characters ----
+
+// Every code point in the text, appended to out (stops at the first error)
+inline Result codePoints(const char *data, size_t len, std::vector<CodePoint> &out) {
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(data);
+    Result r;
+    size_t i = 0;
+    while (i < len) {
+        char32_t value;
+        int n = decodeOne(p + i, p + len, value, r.error);
+        if (n == 0) { r.position = i; return r; }
+        out.push_back({value, i, n});
+        r.written++;
+        i += size_t(n);
+    }
+    r.position = len;
+    return r;
+}
+
+// The character's bytes in binary, marker bits split from payload bits:
+// "110|00011 10|101001" for U+00E9 (é)
+inline std::string byteBits(const char *data, const CodePoint &cp) {
+    std::string bits;
+    for (int i = 0; i < cp.length; i++) {
+        uint8_t byte = uint8_t(data[cp.offset + size_t(i)]);
+        int marker = i > 0 ? 2 : cp.length == 1 ? 1 : cp.length + 1;
+        if (i > 0) bits += ' ';
+        for (int bit = 7; bit >= 0; bit--) {
+            bits += char('0' + ((byte >> bit) & 1));
+            if (bit == 8 - marker) bits += '|';
+        }
+    }
+    return bits;
+}
+
+// Just the payload bits, joined: the code point's value (7, 11, 16 or 21 bits)
+inline std::string payloadBits(const CodePoint &cp) {
+    static const int widths[] = {0, 7, 11, 16, 21};
+    std::string bits;
+    for (int bit = widths[cp.length] - 1; bit >= 0; bit--) bits += char('0' + ((cp.value >> bit) & 1));
+    return bits;
+}
+
+}  // namespace utf8
+
+#endif  // UTF8_HPP